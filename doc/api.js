@@ -136,11 +136,25 @@ global.sys.runFile = function (filename, persists) {};
  */
 
 /**
- * TODO: Fill in event
+ * Emitted when F10 is pressed, writes the profiler capture window as a trace
+ * in the same way as captureTrace.
  * 
  * @event dumpProfile
  */
 
+/**
+ * Writes the last core.debug.profiler.traceWindow seconds of profiler zones
+ * from every thread in the Chrome Trace Event format. Open the file with
+ * chrome://tracing or ui.perfetto.dev. Emits onSaveTrace once it's written.
+ * Params:
+ * 		string filename = optional, defaults to /profilerDumps/trace_<time>.json
+ * 
+ * @example
+ * event.captureTrace({filename: "spike.json"});
+ * 
+ * @event captureTrace
+ */
+
 /**
  * Called when the mouse is clicked
  * Params:
@@ -439,6 +453,64 @@ ThreadAPI.prototype.sleep = function (secs) { };
  */
 ThreadAPI.prototype.emit = function (target, args) { };
 
+/**
+ * Sends value to the Worker's onmessage handler on the main thread. Values are copied in a compact binary form,
+ * ArrayBuffers and typed arrays listed in transfer move to the main thread without a copy and are left empty here.
+ * Functions and native objects like textures can't be posted
+ * @param  {*} value
+ * @param  {Array.<ArrayBuffer|ArrayBufferView>} [transfer]
+ */
+ThreadAPI.prototype.postMessage = function (value, transfer) { };
+
+/**
+ * Stops the worker once the current message has been handled, messages already posted still arrive
+ */
+ThreadAPI.prototype.close = function () { };
+
+/**
+ * Set by the worker function to receive messages from Worker.postMessage. Workers that don't set it exit once their function returns
+ * @type {function(MessageEvent)}
+ */
+ThreadAPI.prototype.onmessage = null;
+
+/**
+ * @typedef {Object} MessageEvent
+ * @property {*} data The value passed to postMessage
+ */
+
+/** @namespace */
+function Worker () { }
+
+/**
+ * Sends value to the worker's thread.onmessage handler, works the same way as ThreadAPI.postMessage
+ * @example
+ * var worker = sys.createWorker(function (thread) {
+ * 	thread.onmessage = function (e) {
+ * 		var verts = e.data;
+ * 		for (var i = 0; i < verts.length; i++) verts[i] *= 2;
+ * 		thread.postMessage(verts, [verts.buffer]);
+ * 	};
+ * });
+ * worker.onmessage = function (e) { console.log(e.data.length); };
+ * var verts = new Float32Array(100000);
+ * worker.postMessage(verts, [verts.buffer]); // verts.length is 0 now
+ * @param  {*} value
+ * @param  {Array.<ArrayBuffer|ArrayBufferView>} [transfer]
+ */
+Worker.prototype.postMessage = function (value, transfer) { };
+
+/**
+ * Stops the worker thread even if it's script is stuck in a loop, messages it posted that haven't been handled yet are dropped.
+ * Messages posted to a worker that has stopped are ignored
+ */
+Worker.prototype.terminate = function () { };
+
+/**
+ * Called on the main thread during the frame for each message the worker posts
+ * @type {function(MessageEvent)}
+ */
+Worker.prototype.onmessage = null;
+
 /**
  * @callback WorkerFunction
  * This API uses a little black magic, internaly the source of the function is fetched and dispatched to a worker thread where
@@ -450,9 +522,76 @@ ThreadAPI.prototype.emit = function (target, args) { };
 /**
  * Creates a new thread executing workerFunc
  * @param  {WorkerFunction} workerFunc
+ * @return {Worker}
  */
 global.sys.createWorker = function (workerFunc) { };
 
+/** @namespace */
+function ComputeTask () { }
+
+/**
+ * The ID the pool tracks the task by
+ * @type {Number}
+ */
+ComputeTask.prototype.id = 0;
+
+/**
+ * Skips chunks that haven't started and terminates the ones that are running, the callback is still called with "Cancelled"
+ * @return {Boolean} false if the task already finished
+ */
+ComputeTask.prototype.cancel = function () { };
+
+/**
+ * @typedef {Object} ComputeOptions
+ * @property {Number} [components=1] Floats per item in input
+ * @property {Number} [outComponents=1] Floats per item in output, parallelMap only
+ * @property {Number} [chunkSize] Items per chunk, defaults to splitting the input 4 ways per compute isolate
+ * @property {Number} [deadline] Seconds from now the task is cancelled at with "Deadline exceeded"
+ * @property {*} [args] Copied to every chunk the same way as Worker.postMessage
+ */
+
+/**
+ * Runs func over chunks of input on the pool of compute isolates (core.jobs.computeIsolates), each chunk gets Float32Array
+ * views of it's part of input and output. Like createWorker func is compiled in a seperate V8 instance so it can't see globals.
+ * input and output are copied when the task starts so they can be changed straight away, the results are written back
+ * into output just before the callback is called.
+ * @example
+ * var pos = new Float32Array(200000), out = new Float32Array(100000);
+ * sys.parallelMap(function (input, output, begin, args) {
+ * 	for (var i = 0; i < output.length; i++) {
+ * 		output[i] = Math.sqrt(input[i * 2] * input[i * 2] + input[i * 2 + 1] * input[i * 2 + 1]) * args.scale;
+ * 	}
+ * }, pos, out, {components: 2, args: {scale: 0.5}}, function (err, out) {
+ * 	if (err) return console.error(err);
+ * 	console.log(out[0]);
+ * });
+ * @param  {function(Float32Array, Float32Array, Number, *)} func Called with (input, output, begin, args), begin is the index of the first item
+ * @param  {Float32Array} input
+ * @param  {Float32Array} output
+ * @param  {ComputeOptions} [options]
+ * @param  {function(?String, Float32Array)} callback Called during the frame once every chunk has finished
+ * @return {ComputeTask}
+ */
+global.sys.parallelMap = function (func, input, output, options, callback) { };
+
+/**
+ * Runs func over chunks of input on the pool of compute isolates, the number each chunk returns is collected in chunk order
+ * @example
+ * sys.parallelReduce(function (input) {
+ * 	var sum = 0;
+ * 	for (var i = 0; i < input.length; i++) sum += input[i];
+ * 	return sum;
+ * }, values, function (err, sums) {
+ * 	console.log(sums.reduce(function (a, b) { return a + b; }, 0));
+ * });
+ * @param  {function(Float32Array, Number, *)} func Called with (input, begin, args)
+ * @param  {Float32Array} input
+ * @param  {ComputeOptions} [options]
+ * @param  {function(?String, Array.<Number>)} callback
+ * @return {ComputeTask}
+ */
+global.sys.parallelReduce = function (func, input, options, callback) { };
+
 /**
  * The current platform the engine is running on, the value can be "Windows"|"Darwin (OSX)"|"Linux"
  * @type {String}
@@ -641,15 +780,15 @@ global.draw.grad = function (x, y, w, h, col1, col2, orientation) {};
  * @param  {number} y
  * @param  {number} radius
  * @param  {number} [innerRadius] - Set to radius to draw a regular circle, radius by default
- * @param  {number} [numberOfSides] - The number of vertex's at the edge of the circle, radius * 5 by default
+ * @param  {number} [numberOfSides] - The number of vertex's at the edge of the circle, 0 or leaving it out picks enough to keep within core.render.tessellationError pixels
  * @param  {number} [startPos] - Start persent of the circle, 0.0 by default
  * @param  {number} [endPos] - End persent of the circle, 1.0 by default
- * @param  {number} [fillStyle] - Fill the inside of the circle or draw a line strip at the edge
+ * @param  {number} [fillStyle] - Fill the inside of the circle or draw lines around the edge
  */
 global.draw.circle = function (x, y, radius, innerRadius, numberOfSides, startPos, endPos, fillStyle) {};
 
 /**
- * Draw a cubic benzier curve from x0, y0, to x3, y3 through x1, y1 and x2, y2
+ * Draw a cubic benzier curve from x0, y0, to x3, y3 through x1, y1 and x2, y2. The number of segments is picked from core.render.tessellationError
  * @param  {number} x0
  * @param  {number} y0
  * @param  {number} x1
@@ -671,7 +810,7 @@ global.draw.curve = function (x0, y0, x1, y1, x2, y2, x3, y3) {};
 global.draw.line = function (x0, y0, x1, y1) {};
 
 /**
- * Renders a polygon using a triangle fan with arr points
+ * Fills the polygon made by arr points, concave polygons are supported
  * @param  {number} xCenter [description]
  * @param  {number} yCenter [description]
  * @param  {number[]} arr     In the format [x1, y1, x2, y2, ...]
@@ -792,6 +931,48 @@ global.draw.drawSub = function (texId, x, y, w, h, xSub, ySub, wSub, hSub) {};
  */
 global.draw.drawSprite = function (spriteSheet, sprite, x, y, w, h) {};
 
+/**
+ * Draws many copies of a texture in one call. Where OpenGL supports instancing this is a single draw call
+ * no matter how many sprites there are. Sprites are rotated around their center
+ * @param  {Texture|null} texId     The texture every sprite uses, null draws the colors alone
+ * @param  {Float32Array} sprites   9 values per sprite: x, y, w, h, u1, v1, u2, v2, rotation in radians
+ * @param  {Uint8Array} [colors]    4 values per sprite: r, g, b, a from 0 to 255, draw.drawColor is used when missing
+ * @example <caption>Draw 2 sprites from a texture, the second one upside down</caption>
+ * 	var sprites = new Float32Array([
+ * 		0, 0, 32, 32, 0, 0, 1, 1, 0,
+ * 		40, 0, 32, 32, 0, 0, 1, 1, Math.PI
+ * 	]);
+ * 	draw.drawSprites(tex, sprites);
+ */
+global.draw.drawSprites = function (texId, sprites, colors) {};
+
+/**
+ * Draws a batch of rectangles from a packed array, this crosses into C++ once no matter how many rects there are.
+ * Reuse the arrays between frames to avoid creating garbage
+ * @param  {Float32Array} rects   4 values per rect: x, y, w, h
+ * @param  {Uint8Array} [colors]  4 values per rect: r, g, b, a from 0 to 255, draw.drawColor is used when missing
+ * @example <caption>Draw 2 rects, one red and one blue</caption>
+ * 	draw.rects(new Float32Array([0, 0, 32, 32, 40, 0, 32, 32]),
+ * 		new Uint8Array([255, 0, 0, 255, 0, 0, 255, 255]));
+ */
+global.draw.rects = function (rects, colors) {};
+
+/**
+ * Draws a batch of sprites from spriteSheet, each sprite picks its name from names by index. Animations advance
+ * once per call rather than once per sprite
+ * @param  {SpriteSheet} spriteSheet The spritesheet to use
+ * @param  {string[]} names          The sprites or animations the batch uses
+ * @param  {Float32Array} sprites    5 values per sprite: x, y, w, h, index into names. Sprites with a NaN or infinite index are skipped
+ * @param  {Uint8Array} [colors]     4 values per sprite: r, g, b, a from 0 to 255, draw.drawColor is used when missing
+ */
+global.draw.sprites = function (spriteSheet, names, sprites, colors) {};
+
+/**
+ * Draws a batch of line segments in the current color
+ * @param  {Float32Array} lines 4 values per line: x1, y1, x2, y2
+ */
+global.draw.lines = function (lines) {};
+
 /**
  * Loads filename as a image, most file formats are supported using FreeImage
  * @param  {string} filename
@@ -807,8 +988,10 @@ global.draw.openImage = function (filename) {};
 global.draw.openSpriteSheet = function (filename) {};
 
 /**
- * @typedef {number[]} Image
- * Image is optimised for loading using {@link global.draw.createImage}
+ * @typedef {Float32Array|Uint8Array} Image
+ * Image is optimised for loading using {@link global.draw.createImage}. Pixels are RGBA in row-major order so the
+ * red channel of (x, y) is at (y * width + x) * 4. Float images use 0.0 to 1.0, rgba8 images use 0 to 255.
+ * The pixels live outside the V8 heap and are passed to OpenGL without copying them
  * @property {number} width The width of the image
  * @property {number} height The height of the image
  */
@@ -816,18 +999,44 @@ global.draw.openSpriteSheet = function (filename) {};
 /**
  * Loads filename as a image returning the raw pixel array
  * @param  {string} filename
+ * @param  {string} [format] "float" (the default) for a Float32Array or "rgba8" for a Uint8Array
+ * @return {Image}
+ */
+global.draw.getImageArray = function (filename, format) {};
+
+/**
+ * Creates a opaque black {@link Image} for scripts that generate textures
+ * @param  {number} w
+ * @param  {number} h
+ * @param  {string} [format] "float" (the default) for a Float32Array or "rgba8" for a Uint8Array
  * @return {Image}
+ * @example <caption>Update a procedural texture every frame without creating a new one</caption>
+ * 	var img = draw.createImageArray(256, 256, "rgba8"), tex = null;
+ * 	sys.drawFunc(function () {
+ * 		img[Math.floor(Math.random() * img.length)] = 255;
+ * 		tex = draw.createImage(img, 256, 256, tex);
+ * 		draw.draw(tex, 0, 0, 256, 256);
+ * 	});
  */
-global.draw.getImageArray = function (filename) {};
+global.draw.createImageArray = function (w, h, format) {};
 
 /**
- * Converts a {@link Image} into a {@link TextureID}
+ * Reorders the channels of every pixel in a rgba8 {@link Image} in place
+ * @param  {Uint8Array} arr
+ * @param  {string} order The source channel for each output channel, "bgra" swaps red and blue
+ */
+global.draw.swizzleImage = function (arr, order) {};
+
+/**
+ * Converts a {@link Image} into a {@link Texture}
  * @param  {Image|number[]} arr - {@link Image} is strongly prefered to number[]
  * @param  {number} w - The width of the Image to create
  * @param  {number} h - The height of the Image to create
- * @return {TextureID}
+ * @param  {Texture} [tex] - A texture with the same size is updated in place and returned instead of creating a new one,
+ * updated textures stop using mipmaps. Throws for anything other than a texture, undefined or null
+ * @return {Texture}
  */
-global.draw.createImage = function (arr, w, h) {};
+global.draw.createImage = function (arr, w, h, tex) {};
 
 /**
  * Save texId to filename, requires fs.configDir to be called before hand
@@ -902,6 +1111,20 @@ global.draw.isFontLoaded = function (prettyName) {};
  */
 global.draw.setCenter = function (x, y) {};
 
+/**
+ * Set's the layer new primitives are drawn on. When core.render.batching is
+ * enabled lower layers are drawn first and primitives inside a layer are
+ * grouped by texture, the layer is reset to 0 every frame
+ * @param {number} layer
+ */
+global.draw.setLayer = function (layer) {};
+
+/**
+ * Returns the layer primitives are currently drawn on
+ * @return {number}
+ */
+global.draw.getLayer = function () {};
+
 /**
  * Read/Write value for draw color
  * @type {Color}
@@ -997,7 +1220,8 @@ global.draw.VertexBuffer2D.prototype.draw = function () { };
 global.draw.VertexBuffer2D.prototype.save = function (filename) { };
 
 /**
- * Replases the vertexBuffer with the content of the file
+ * Replases the vertexBuffer with the content of the file. Files on disk are memory mapped
+ * and uploaded without a copy until the vertexBuffer is edited.
  * @param  {string} filename The filename to load the vertexBuffer from
  */
 global.draw.VertexBuffer2D.prototype.load = function (filename) { };
@@ -1032,10 +1256,36 @@ global.draw.VertexBuffer2D.prototype.setDepthTest = function (enable) { };
 global.draw.VertexBuffer2D.prototype.setWireframe = function (enable) { };
 
 /**
- * Use vertex data to compute vertex normals on the vertexBufffer
+ * Upload vertexes in a 20 byte format instead of 40 bytes. The z coordinate is dropped, colors
+ * are stored with 8 bits per channel and texture coordinates as half floats
+ * @param {boolean} enable
+ */
+global.draw.VertexBuffer2D.prototype.setCompact = function (enable) { };
+
+/**
+ * Use vertex data to compute vertex normals on the vertexBufffer. The normals are bound to the
+ * effect's "normal" vertexBufferParam, vertex colors are left alone
  */
 global.draw.VertexBuffer2D.prototype.computeNormals = function () { };
 
+/**
+ * Add vertex indexes to the vertexBuffer, once any are added the buffer is drawn as indexed triangles
+ * @param {...number|number[]} index The index of a vertex already added with addVert
+ * @example <caption>Build a quad from 4 vertexes</caption>
+ * 	vBuff.addVert(-1, -1, vCol);
+ * 	vBuff.addVert(1, -1, vCol);
+ * 	vBuff.addVert(1, 1, vCol);
+ * 	vBuff.addVert(-1, 1, vCol);
+ * 	vBuff.addIndex([0, 1, 2, 0, 2, 3]);
+ */
+global.draw.VertexBuffer2D.prototype.addIndex = function (index) { };
+
+/**
+ * Merge duplicate vertexes and reorder the triangles to make better use of the GPU's vertex cache.
+ * Unindexed buffers are converted to indexed buffers
+ */
+global.draw.VertexBuffer2D.prototype.optimize = function () { };
+
 /**
  * Create a new instace of Texture from a image file or a raw pixel array
  * @class A class for storing a image in graphics memeory
@@ -1193,6 +1443,179 @@ global.Math.Random.prototype.nextDouble = function () { };
  */
 global.Math.Random.prototype.nextNormal = function (mean, sd) { };
 
+/**
+ * Creates a new noise generator, it uses the same permutation table and seeding as res/lib/perlin.js
+ * so perlin2, perlin3, simplex2 and simplex3 return the same values as the script version
+ * @class Native perlin, simplex and value noise. Values are from -1.0 to 1.0
+ * @param {number} [seed] From 0.0 to 1.0 or 0 to 65535
+ */
+global.Math.Noise = function (seed) { };
+
+/**
+ * @param {number} seed From 0.0 to 1.0 or 0 to 65535
+ */
+global.Math.Noise.prototype.seed = function (seed) { };
+
+/**
+ * perlin3, perlin4, simplex2, simplex3, simplex4, value2, value3 and value4 work the same way
+ * @param  {number} x
+ * @param  {number} y
+ * @return {number}
+ */
+global.Math.Noise.prototype.perlin2 = function (x, y) { };
+
+/**
+ * @typedef {Object} NoiseOptions
+ * @property {string} [type]        "perlin", "simplex" or "value", defaults to "simplex"
+ * @property {string} [fractal]     "none", "fbm" or "ridged", defaults to "none"
+ * @property {number} [octaves]     Octaves for fbm and ridged noise, defaults to 4
+ * @property {number} [frequency]   Defaults to 1.0
+ * @property {number} [lacunarity]  Frequency multiplier for each octave, defaults to 2.0
+ * @property {number} [gain]        Amplitude multiplier for each octave, defaults to 0.5
+ * @property {number} [dims]        2, 3 or 4. Only used by fillGrid and fillImage
+ * @property {number} [x]           Origin of the grid. z and w set the slice for 3D and 4D noise
+ * @property {number} [y]
+ * @property {number} [z]
+ * @property {number} [w]
+ * @property {number} [step]        Distance between each grid value, defaults to 1.0
+ */
+
+/**
+ * Samples noise at every point in points. Large arrays are split across the worker threads
+ * @param  {Float32Array} points
+ * @param  {number} dims             2, 3 or 4 values per point
+ * @param  {Float32Array} out        Gets one value per point
+ * @param  {NoiseOptions} [options]
+ * @return {Float32Array}            out
+ */
+global.Math.Noise.prototype.fill = function (points, dims, out, options) { };
+
+/**
+ * Fills out with width * height values in row-major order, value (px, py) is sampled at (x + px * step, y + py * step)
+ * @param  {Float32Array} out
+ * @param  {number} width
+ * @param  {number} height
+ * @param  {NoiseOptions} [options]
+ * @return {Float32Array}            out
+ */
+global.Math.Noise.prototype.fillGrid = function (out, width, height, options) { };
+
+/**
+ * Fills a image array from draw.createImageArray with greyscale noise. Noise is mapped to 0.0 to 1.0 and alpha is set to 1.0
+ * @example
+ * var image = draw.createImageArray(256, 256);
+ * new Math.Noise(0.5).fillImage(image, {fractal: "fbm", step: 1 / 64});
+ * var tex = draw.createImage(image, 256, 256);
+ * @param  {Float32Array|Uint8Array} image
+ * @param  {NoiseOptions} [options]
+ * @return {Float32Array|Uint8Array} image
+ */
+global.Math.Noise.prototype.fillImage = function (image, options) { };
+
+/**
+ * Normalizes every vector in src and writes them to dst. Vectors with a length of 0 stay 0
+ * @param  {Float32Array} src
+ * @param  {Float32Array} dst        Can be the same array as src
+ * @param  {number} components       2, 3 or 4 values per vector
+ * @return {Float32Array}            dst
+ */
+global.Math.normalizeVectors = function (src, dst, components) { };
+
+/**
+ * @class A 4 component vector with x, y, z and a properties. add, sub, mul, cross and rotate return a new Vector,
+ * the Self methods change the vector in place and return it so hot loops don't create garbage
+ * @param {number} [x]
+ * @param {number} [y]
+ * @param {number} [z]
+ * @param {number} [a]
+ */
+global.Math.Vector = function (x, y, z, a) { };
+
+/**
+ * @return {number}
+ */
+global.Math.Vector.prototype.length = function () { };
+
+/**
+ * Sets every component, missing components become 0
+ * @return {Math.Vector} this
+ */
+global.Math.Vector.prototype.set = function (x, y, z, a) { };
+
+/**
+ * @param  {Math.Vector} vec
+ * @return {Math.Vector} this
+ */
+global.Math.Vector.prototype.addSelf = function (vec) { };
+
+/**
+ * @param  {Math.Vector} vec
+ * @return {Math.Vector} this
+ */
+global.Math.Vector.prototype.subSelf = function (vec) { };
+
+/**
+ * @param  {number|Math.Vector|Math.Matrix} value
+ * @return {Math.Vector} this
+ */
+global.Math.Vector.prototype.mulSelf = function (value) { };
+
+/**
+ * @return {Math.Vector} this
+ */
+global.Math.Vector.prototype.normalizeSelf = function () { };
+
+/**
+ * Hands the vector back so the next allocating operation (add, sub, mul, cross or rotate)
+ * reuses it instead of creating a new object. The vector must not be used afterwards.
+ * @example
+ * var next = pos.add(vel);
+ * pos.release();
+ * pos = next;
+ */
+global.Math.Vector.prototype.release = function () { };
+
+/**
+ * @class A 4x4 matrix starting as the identity matrix, translate, scale and rotate change it in place
+ */
+global.Math.Matrix = function () { };
+
+/**
+ * this = this * mat
+ * @param  {Math.Matrix} mat
+ * @return {Math.Matrix} this
+ */
+global.Math.Matrix.prototype.mulSelf = function (mat) { };
+
+/**
+ * out = this * mat without creating a new Matrix
+ * @param  {Math.Matrix} mat
+ * @param  {Math.Matrix} out
+ * @return {Math.Matrix} out
+ */
+global.Math.Matrix.prototype.mulMat4Into = function (mat, out) { };
+
+/**
+ * Transforms every point in src by this matrix and writes them to dst. Missing z values are 0 and missing w values are 1
+ * @param  {Float32Array} src
+ * @param  {Float32Array} dst        Can be the same array as src
+ * @param  {number} components       2, 3 or 4 values per point
+ * @return {Float32Array}            dst
+ * @example <caption>Rotate 1000 2D points around the origin</caption>
+ * 	var points = new Float32Array(2000), mat = new Math.Matrix();
+ * 	mat.rotate(Math.PI_4, new Math.Vector(0, 0, 1));
+ * 	mat.transformPoints(points, points, 2);
+ */
+global.Math.Matrix.prototype.transformPoints = function (src, dst, components) { };
+
+/**
+ * Multiplies every 16 value column-major matrix in src by this matrix, dst[i] = this * src[i]
+ * @param  {Float32Array} src
+ * @param  {Float32Array} dst        Can be the same array as src
+ * @return {Float32Array}            dst
+ */
+global.Math.Matrix.prototype.mulMatrices = function (src, dst) { };
+
 /**
  * Exposed as a dynamicly loadable lib, test.js uses
  * sys.runFile("modules/js_unsafe.dylib", false)
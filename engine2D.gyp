@@ -3,6 +3,7 @@
 		"WINDOW%": "glfw",
 		"GPERFTOOLS%": "off",
 		"PROFILER%": "off",
+		"COUNT_ALLOCATIONS%": "off",
 		"BUILD_DEBUG_SYMBOLS%": "off"
 	},
 	"targets": [
@@ -24,6 +25,14 @@
 				}]
 			]
 		},
+		{
+			"target_name": "objToEglb",
+			"type": "executable",
+			"dependencies": ["libengine2D"],
+			"sources": [
+				"src/objToEglb.cpp"
+			]
+		},
 		{
 			"target_name": "libengine2D",
 			"type": "shared_library",
@@ -33,22 +42,31 @@
 				"src/Database.cpp",
 				"src/Filesystem.cpp",
 				"src/GL3Buffer.cpp",
+				"src/MeshConverter.cpp",
+				"src/SpriteRenderer.cpp",
+				"src/CameraBlock.cpp",
 				"src/Shader.cpp",
 				"src/EngineUI.cpp",
 				"src/Draw2D.cpp",
+				"src/Tessellator.cpp",
+				"src/Noise.cpp",
 				"src/Draw3D.cpp",
 				"src/RenderDriver.cpp",
 				"src/RenderGL3.cpp",
+				"src/RenderCommandList.cpp",
 				"src/Logger.cpp",
 				"src/Profiler.cpp",
 				"src/FramePerfMonitor.cpp",
 				"src/ResourceManager.cpp",
 				"src/Config.cpp",
 				"src/Util.cpp",
+				"src/VectorMath.cpp",
 				"src/Platform_mac.cpp",
 				"src/Platform_win.cpp",
 				"src/Platform_linux.cpp",
 				"src/Events.cpp",
+				"src/EventQueue.cpp",
+				"src/EventPayloads.cpp",
 				"src/TestSuite.cpp",
 				"src/Application.cpp",
 				"src/PlatformTests.cpp",
@@ -56,12 +74,16 @@
 				"src/ScriptingTests.cpp",
 				"src/StdLibTests.cpp",
 				"src/PackageTests.cpp",
+				"src/RenderTests.cpp",
 				"src/SpriteSheet.cpp",
 				"src/FontSheet.cpp",
 				"src/TextureLoader.cpp",
+				"src/TextureAtlas.cpp",
 				"src/Timer.cpp",
 				"src/ScriptingManager.cpp",
 				"src/WorkerThreadPool.cpp",
+				"src/WorkerMessage.cpp",
+				"src/ComputePool.cpp",
 				"src/Package.cpp",
 				"src/Addon.cpp",
 
@@ -309,6 +331,11 @@
 						"PROFILER"
 					]
 				}],
+				['"<(COUNT_ALLOCATIONS)" == "on"', {
+					"defines": [
+						"ENGINE_COUNT_ALLOCATIONS"
+					]
+				}],
 				['("<(BUILD_DEBUG_SYMBOLS)" != "off") & (OS == "win")', {
 					"msvs_settings": {
 						"VCLinkerTool": {
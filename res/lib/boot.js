@@ -67,6 +67,15 @@
 	};
 
 	var libraries = ["timers", "perlin", "detailProfiler"];
+
+	// the benchmark is only loaded when someone asks for it
+	global.sys.on("drawBenchmark", "boot.drawBenchmark", function (args) {
+		if (!global.drawBenchmark && (!global.sys.runFile("lib/drawBenchmark", false) || !global.drawBenchmark)) {
+			console.error("drawBenchmark could not be loaded");
+			return;
+		}
+		global.drawBenchmark.start(args.count || 10000, args.frames || 60);
+	});
 	var currentLib = 0;
 
 	function runLibs(cb) {
@@ -97,6 +106,10 @@
 			testNum++;
 		});
 
+		global.sys.on("testingTypedEventJS", "boot.TestTypedEventJS", function (e) {
+			testNum += e.rawKey;
+		});
+
 		global.sys.on("testScreenshot", "boot.testScreenshot", function () {
 			if (!fs.hasSetConfigDir) {
 				console.warn("configDir has not been set for TestScreenshot defaulting to testScreenshot");
@@ -0,0 +1,101 @@
+/*
+   Filename: drawBenchmark.js
+   Purpose:  Compares per call drawing with the typed array batch API
+
+   Part of Engine2D
+
+   Copyright (C) 2014 Vbitz
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+(function (global) {
+	function fill(count, rects, colors, lines) {
+		for (var i = 0; i < count; i++) {
+			var x = Math.random() * 800, y = Math.random() * 600;
+			rects[i * 4] = x;
+			rects[i * 4 + 1] = y;
+			rects[i * 4 + 2] = 4;
+			rects[i * 4 + 3] = 4;
+			colors[i * 4] = Math.random() * 255;
+			colors[i * 4 + 1] = Math.random() * 255;
+			colors[i * 4 + 2] = Math.random() * 255;
+			colors[i * 4 + 3] = 255;
+			lines[i * 4] = x;
+			lines[i * 4 + 1] = y;
+			lines[i * 4 + 2] = x + 8;
+			lines[i * 4 + 3] = y + 8;
+		}
+	}
+
+	function drawPerCall(count, rects, colors, lines) {
+		for (var i = 0; i < count; i++) {
+			global.draw.setColorF(colors[i * 4] / 255, colors[i * 4 + 1] / 255, colors[i * 4 + 2] / 255);
+			global.draw.rect(rects[i * 4], rects[i * 4 + 1], rects[i * 4 + 2], rects[i * 4 + 3]);
+		}
+		for (i = 0; i < count; i++) {
+			global.draw.line(lines[i * 4], lines[i * 4 + 1], lines[i * 4 + 2], lines[i * 4 + 3]);
+		}
+	}
+
+	function drawBatched(count, rects, colors, lines) {
+		global.draw.rects(rects, colors);
+		global.draw.lines(lines);
+	}
+
+	function start(count, frames) {
+		var rects = new Float32Array(count * 4),
+			colors = new Uint8Array(count * 4),
+			lines = new Float32Array(count * 4),
+			modes = [
+				{name: "perCall", func: drawPerCall, time: 0},
+				{name: "batched", func: drawBatched, time: 0}
+			],
+			currentMode = 0,
+			currentFrames = 0,
+			listenerName = "drawBenchmark_listener_" + Math.random();
+
+		fill(count, rects, colors, lines);
+
+		global.sys.on("draw", listenerName, function () {
+			var mode = modes[currentMode];
+
+			var startTime = global.sys.microtime();
+			mode.func(count, rects, colors, lines);
+			mode.time += global.sys.microtime() - startTime;
+
+			if (++currentFrames < frames) {
+				return;
+			}
+
+			currentFrames = 0;
+			if (++currentMode < modes.length) {
+				return;
+			}
+
+			global.sys.clearEvent(listenerName);
+			modes.forEach(function (mode) {
+				console.log("drawBenchmark: " + mode.name + " " + (count * 2) + " shapes " +
+					(mode.time / frames * 1000).toFixed(3) + "ms per frame, " +
+					(count * 2 * frames / mode.time).toFixed(0) + " shapes per second");
+			});
+			console.log("drawBenchmark: batched is " + (modes[0].time / modes[1].time).toFixed(2) + "x faster");
+		});
+	}
+
+	// loaded by boot.js the first time drawBenchmark is emitted
+	global.drawBenchmark = {
+		start: start
+	};
+
+})(this);
\ No newline at end of file
@@ -175,6 +175,24 @@ var tests = {
 
 		return true;
 	},
+	"WorkerMessages": function () {
+		var worker = sys.createWorker(function (thread) {
+			thread.onmessage = function (e) {
+				thread.postMessage({length: e.data.values.length, name: e.data.name}, []);
+				thread.close();
+			};
+		});
+
+		worker.onmessage = function (e) {
+			console.log("From WorkerMessages: " + e.data.name + " " + e.data.length);
+		};
+
+		var values = new Float32Array(1024);
+		worker.postMessage({values: values, name: "test"}, [values.buffer]);
+
+		// the buffer moved to the worker so it's empty here
+		return values.length === 0;
+	},
 	"EventMagic": function () {
 		var count = 0;
 		sys.on("eventMagicTestTarget", "test.eventMagicTestTarget1", function (e) {
@@ -0,0 +1,80 @@
+// Compares the allocating Math.Vector/Math.Matrix methods with the in place and bulk versions
+// Reports operations per second and bytes of V8 heap allocated per operation
+
+var OP_COUNT = 200000;
+var CHUNK_SIZE = 5000;
+
+function measure(name, ops, func) {
+	var startTime = sys.microtime();
+	for (var i = 0; i < ops; i += CHUNK_SIZE) {
+		func(CHUNK_SIZE);
+	}
+	var time = sys.microtime() - startTime;
+
+	// a chunk is small enough to fit in the new space so heapUsed only grows inside it
+	sys.gc();
+	var before = sys.heapStats().heapUsed;
+	func(CHUNK_SIZE);
+	var allocated = sys.heapStats().heapUsed - before;
+
+	console.log("mathBenchmark: " + name + " " + (ops / time).toFixed(0) + " ops/s | " +
+		(allocated / CHUNK_SIZE).toFixed(1) + " bytes/op | " + (allocated / CHUNK_SIZE * ops / time / 1024 / 1024).toFixed(2) + " MB/s allocated");
+}
+
+var pos = new Math.Vector(0, 0, 0, 0);
+var vel = new Math.Vector(0.5, 0.25, 0, 0);
+var mat = new Math.Matrix();
+mat.rotate(0.01, new Math.Vector(0, 0, 1));
+var out = new Math.Matrix();
+
+measure("vector.add", OP_COUNT, function (count) {
+	for (var i = 0; i < count; i++) {
+		pos = pos.add(vel);
+	}
+});
+
+measure("vector.add + release", OP_COUNT, function (count) {
+	for (var i = 0; i < count; i++) {
+		var next = pos.add(vel);
+		pos.release();
+		pos = next;
+	}
+});
+
+measure("vector.addSelf", OP_COUNT, function (count) {
+	for (var i = 0; i < count; i++) {
+		pos.addSelf(vel);
+	}
+});
+
+measure("vector.mul(matrix)", OP_COUNT, function (count) {
+	for (var i = 0; i < count; i++) {
+		pos = pos.mul(mat);
+	}
+});
+
+measure("vector.mulSelf(matrix)", OP_COUNT, function (count) {
+	for (var i = 0; i < count; i++) {
+		pos.mulSelf(mat);
+	}
+});
+
+measure("matrix.mulMat4Into", OP_COUNT, function (count) {
+	for (var i = 0; i < count; i++) {
+		mat.mulMat4Into(mat, out);
+	}
+});
+
+// a bulk call handles a whole chunk so each point counts as one operation
+var points = new Float32Array(CHUNK_SIZE * 2);
+for (var i = 0; i < points.length; i++) {
+	points[i] = Math.random() * 100;
+}
+
+measure("matrix.transformPoints vec2", OP_COUNT, function (count) {
+	mat.transformPoints(points, points, 2);
+});
+
+measure("Math.normalizeVectors vec2", OP_COUNT, function (count) {
+	Math.normalizeVectors(points, points, 2);
+});
\ No newline at end of file
@@ -1,4 +1,4 @@
-// wow this is really slow if you don't use the fast way
+// Math.Noise fills the whole image natively, res/lib/perlin.js is still loaded for comparison
 
 var IMAGE_WIDTH = 1024;
 var IMAGE_HEIGHT = 1024;
@@ -7,32 +7,15 @@ var NOISE_SCALE = 0.03;
 IMAGE_WIDTH = IMAGE_WIDTH / SCALE;
 IMAGE_HEIGHT = IMAGE_HEIGHT / SCALE;
 
-function setXY(array, x, y, z, value) {
-	var index = 0;
-	index += x * IMAGE_HEIGHT * 4;
-	index += y * 4;
-	index += z;
-	array[index] = value;
-}
-
-function _noise(arr, level, width, height) {
+function _noise(arr) {
 	sys.perf("noiseGen", function () {
-		noise.seed(Math.random());
-		for (var x = 0; x < width; x++) {
-			for (var y = 0; y < height; y++) {
-				var val = Math.abs(noise.simplex2(x * NOISE_SCALE, y * NOISE_SCALE));
-				setXY(arr, x, y, 0, val);
-				setXY(arr, x, y, 1, val);
-				setXY(arr, x, y, 2, val);
-				setXY(arr, x, y, 3, 1.0);
-			}
-		}
+		new Math.Noise(Math.random()).fillImage(arr, {type: "simplex", step: NOISE_SCALE});
 	});
 	return arr;
 }
 
 var noiseField = draw.createImageArray(IMAGE_WIDTH, IMAGE_HEIGHT);
-noiseField = _noise(noiseField, 512, IMAGE_WIDTH, IMAGE_HEIGHT);
+noiseField = _noise(noiseField);
 
 var img = draw.createImage(noiseField, IMAGE_WIDTH, IMAGE_HEIGHT);
 
@@ -0,0 +1,75 @@
+// Compares res/lib/perlin.js with the native Math.Noise fills on the same grid
+// Both use the same permutation table so simplex2 results should match
+
+var GRID_SIZE = 512;
+var STEP = 0.01;
+var OCTAVES = 4;
+
+var values = new Float32Array(GRID_SIZE * GRID_SIZE);
+var reference = new Float32Array(GRID_SIZE * GRID_SIZE);
+
+function measure(name, func) {
+	var startTime = sys.microtime();
+	func();
+	var time = sys.microtime() - startTime;
+	console.log("noiseBenchmark: " + name + " " + (time * 1000).toFixed(2) + "ms | " +
+		(GRID_SIZE * GRID_SIZE / time / 1000000).toFixed(2) + " Msamples/s");
+}
+
+noise.seed(0.5);
+var native = new Math.Noise(0.5);
+
+measure("perlin.js simplex2", function () {
+	for (var y = 0; y < GRID_SIZE; y++) {
+		for (var x = 0; x < GRID_SIZE; x++) {
+			reference[y * GRID_SIZE + x] = noise.simplex2(x * STEP, y * STEP);
+		}
+	}
+});
+
+measure("Math.Noise.simplex2", function () {
+	for (var y = 0; y < GRID_SIZE; y++) {
+		for (var x = 0; x < GRID_SIZE; x++) {
+			values[y * GRID_SIZE + x] = native.simplex2(x * STEP, y * STEP);
+		}
+	}
+});
+
+measure("Math.Noise.fillGrid simplex", function () {
+	native.fillGrid(values, GRID_SIZE, GRID_SIZE, {type: "simplex", step: STEP});
+});
+
+var maxDifference = 0;
+for (var i = 0; i < values.length; i++) {
+	maxDifference = Math.max(maxDifference, Math.abs(values[i] - reference[i]));
+}
+console.log("noiseBenchmark: max difference from perlin.js " + maxDifference);
+
+measure("perlin.js simplex2 fBm x " + OCTAVES, function () {
+	for (var y = 0; y < GRID_SIZE; y++) {
+		for (var x = 0; x < GRID_SIZE; x++) {
+			var sum = 0, amplitude = 1, frequency = 1, total = 0;
+			for (var o = 0; o < OCTAVES; o++) {
+				sum += noise.simplex2(x * STEP * frequency, y * STEP * frequency) * amplitude;
+				total += amplitude;
+				amplitude *= 0.5;
+				frequency *= 2;
+			}
+			reference[y * GRID_SIZE + x] = sum / total;
+		}
+	}
+});
+
+measure("Math.Noise.fillGrid simplex fBm x " + OCTAVES, function () {
+	native.fillGrid(values, GRID_SIZE, GRID_SIZE, {type: "simplex", fractal: "fbm", octaves: OCTAVES, step: STEP});
+});
+
+["perlin", "value"].forEach(function (type) {
+	measure("Math.Noise.fillGrid " + type, function () {
+		native.fillGrid(values, GRID_SIZE, GRID_SIZE, {type: type, step: STEP});
+	});
+});
+
+measure("Math.Noise.fillGrid simplex 3D", function () {
+	native.fillGrid(values, GRID_SIZE, GRID_SIZE, {type: "simplex", dims: 3, z: 0.5, step: STEP});
+});
\ No newline at end of file
@@ -0,0 +1,51 @@
+// Sends a large Float32Array to a worker and back, once copied and once transferred
+// Transferred buffers move between the isolates without being copied or serialized
+
+var FLOAT_COUNT = 4 * 1024 * 1024;
+var ROUND_TRIPS = 20;
+
+var worker = sys.createWorker(function (thread) {
+	thread.onmessage = function (e) {
+		var verts = e.data.verts;
+		verts[0] += 1;
+		if (e.data.transfer) {
+			thread.postMessage(e.data, [verts.buffer]);
+		} else {
+			thread.postMessage(e.data);
+		}
+	};
+});
+
+function run(transfer, done) {
+	var verts = new Float32Array(FLOAT_COUNT);
+	var trips = 0;
+	var startTime = sys.microtime();
+
+	worker.onmessage = function (e) {
+		verts = e.data.verts;
+		if (++trips < ROUND_TRIPS) {
+			send();
+			return;
+		}
+		var time = sys.microtime() - startTime;
+		console.log("workerMessageBenchmark: " + (transfer ? "transfer" : "copy") + " " + (FLOAT_COUNT * 4 / 1024 / 1024) + "MB x " +
+			ROUND_TRIPS + " round trips: " + (time * 1000 / ROUND_TRIPS).toFixed(2) + "ms each | verts[0] = " + verts[0]);
+		done();
+	};
+
+	function send() {
+		if (transfer) {
+			worker.postMessage({verts: verts, transfer: true}, [verts.buffer]);
+		} else {
+			worker.postMessage({verts: verts, transfer: false});
+		}
+	}
+
+	send();
+}
+
+run(false, function () {
+	run(true, function () {
+		worker.terminate();
+	});
+});
\ No newline at end of file
@@ -3,8 +3,11 @@ in vec4 color;
 in vec3 texCoard;
 
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+// RenderDriver::SetCameraBlock shares these with every shader
+layout(std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+};
 
 out vec4 postColor;
 out vec3 postTexCoard;
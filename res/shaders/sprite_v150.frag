@@ -0,0 +1,10 @@
+in vec4 postColor;
+in vec2 postTexCoard;
+
+out vec4 outColor;
+
+uniform sampler2D tex1;
+
+void main() {
+	outColor = texture(tex1, postTexCoard) * postColor;
+}
\ No newline at end of file
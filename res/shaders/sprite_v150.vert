@@ -0,0 +1,31 @@
+in vec2 corner;
+
+in vec4 spriteRect;
+in vec4 texCoard;
+in vec4 color;
+in float spriteRotation;
+
+uniform mat4 model;
+// RenderDriver::SetCameraBlock shares these with every shader
+layout(std140) uniform Camera {
+	mat4 view;
+	mat4 projection;
+};
+
+uniform vec2 uvOffset;
+uniform vec2 uvScale;
+
+out vec4 postColor;
+out vec2 postTexCoard;
+
+void main() {
+	vec2 extent = spriteRect.zw * 0.5;
+	vec2 local = corner * spriteRect.zw - extent;
+	float s = sin(spriteRotation);
+	float c = cos(spriteRotation);
+	vec2 pos = spriteRect.xy + extent + vec2(local.x * c - local.y * s, local.x * s + local.y * c);
+	
+	postColor = color;
+	postTexCoard = uvOffset + uvScale * mix(texCoard.xy, texCoard.zw, corner);
+	gl_Position = (projection * view * model) * vec4(pos, 0.0, 1.0);
+}
\ No newline at end of file
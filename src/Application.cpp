@@ -35,12 +35,15 @@
 
 #include "FramePerfMonitor.hpp"
 #include "Timer.hpp"
+#include "WorkerThreadPool.hpp"
+#include "ComputePool.hpp"
 
 #include "PlatformTests.hpp"
 #include "CoreTests.hpp"
 #include "ScriptingTests.hpp"
 #include "StdLibTests.hpp"
 #include "PackageTests.hpp"
+#include "RenderTests.hpp"
 
 #include "EngineUI.hpp"
 
@@ -120,6 +123,10 @@ namespace Engine {
         Config::SetBoolean( "core.devMode",                         this->_developerMode);
         Config::SetBoolean( "core.testMode",                        this->_testMode);
         
+        // Jobs
+        Config::SetNumber(  "core.jobs.workerCount",                0); // 0 uses one worker per processor
+        Config::SetNumber(  "core.jobs.computeIsolates",            0); // isolates for sys.parallelMap, 0 uses one per processor
+        
         // Window
         Config::SetNumber(  "core.window.width",                    800);
         Config::SetNumber(  "core.window.height",                   600);
@@ -136,6 +143,22 @@ namespace Engine {
         Config::SetBoolean( "core.render.forceMipmaps",             true);
         Config::SetNumber(  "core.render.fovy",                     45.0f);
         Config::SetBoolean( "core.render.halfPix",                  false);
+        Config::SetBoolean( "core.render.streamingBuffer",          true);
+        Config::SetNumber(  "core.render.streamingBufferSize",      4 * 1024 * 1024);
+        Config::SetBoolean( "core.render.compactVertexes",          true); // 20 byte 2D vertexes, z and color precision are dropped
+        Config::SetBoolean( "core.render.instancing",               true); // DrawSprites uses one instanced draw when OpenGL supports it
+        Config::SetString(  "core.render.spriteEffect",             "shaders/sprite.json");
+        Config::SetBoolean( "core.render.batching",                 false);
+        Config::SetBoolean( "core.render.cpuTransform",             true);
+        Config::SetNumber(  "core.render.tessellationError",        0.25f); // in pixels
+        Config::SetBoolean( "core.render.atlas",                    true);
+        Config::SetNumber(  "core.render.atlas.pageSize",           2048); // at most 2048 with compactVertexes
+        Config::SetNumber(  "core.render.atlas.maxImageSize",       256);
+        Config::SetNumber(  "core.render.atlas.padding",            1);
+        Config::SetString(  "core.render.errorPolicy",              this->_debugMode ? "call" : "frame"); // off, frame or call
+
+        // Events
+        Config::SetNumber(  "core.events.pollBudget",               0.002f); // seconds per frame spent on messages from other threads, 0 for no limit
 
         // Content
         Config::SetString(  "core.content.fontPath",                "fonts/open_sans.json");
@@ -148,6 +171,8 @@ namespace Engine {
         Config::SetNumber(  "core.debug.profiler.maxFrameTime",     1.0f / 50.0f);
         Config::SetBoolean( "core.debug.profiler.dumpFrames",       this->_debugMode);
         Config::SetNumber(  "core.debug.profiler.dumpCooldown",     100);
+        Config::SetNumber(  "core.debug.profiler.traceWindow",      (this->_developerMode || this->_debugMode) ? 5 : 0);
+        Config::SetBoolean( "core.debug.profiler.captureTrace",     false);
         Config::SetBoolean( "core.debug.debugRenderer",             true);
         Config::SetBoolean( "core.debug.v8Debug",                   this->_developerMode);
         Config::SetNumber(  "core.debug.v8Debug.port",              5858);
@@ -178,6 +203,8 @@ namespace Engine {
         Config::SetBoolean( "core.log.levels.verbose",              this->_developerMode || this->_debugMode);
         Config::SetBoolean( "core.log.levels.onlyHighlight",        false);
         Config::SetBoolean( "core.log.showColors",                  true);
+        Config::SetBoolean( "core.log.async",                       true);
+        Config::SetNumber(  "core.log.historySize",                 10000);
         Config::SetBoolean( "core.log.src.undefinedValue",          this->_developerMode);
         Config::SetBoolean( "core.log.src.perfIssues",              this->_developerMode);
         Config::SetBoolean( "core.log.src.createImage",             true);
@@ -188,6 +215,12 @@ namespace Engine {
         return EM_OK;
     }
     
+    EventMagic Application::_config_CoreRenderErrorPolicy(Json::Value args, void* userPointer) {
+        RenderDriverPtr render = static_cast<ApplicationPtr>(userPointer)->GetRender();
+        render->SetErrorPolicy(RenderDriver::ParseErrorPolicy(Config::GetString("core.render.errorPolicy")));
+        return EM_OK;
+    }
+    
     EventMagic Application::_config_CoreWindowVSync(Json::Value args, void* userPointer) {
         static_cast<ApplicationPtr>(userPointer)->GetWindow()->SetVSync(Config::GetBoolean("core.window.vsync"));
         return EM_OK;
@@ -203,11 +236,31 @@ namespace Engine {
         return EM_OK;
     }
     
+    EventMagic Application::_config_CoreDebugProfilerTraceWindow(Json::Value args, void* userPointer) {
+        Profiler::SetCaptureWindow(Config::GetFloat("core.debug.profiler.traceWindow"));
+        return EM_OK;
+    }
+    
+    EventMagic Application::_config_CoreDebugProfilerCaptureTrace(Json::Value args, void* userPointer) {
+        if (Config::GetBoolean("core.debug.profiler.captureTrace")) {
+            Config::SetBoolean("core.debug.profiler.captureTrace", false); // setting it again captures another trace
+            _captureTrace(Json::Value(Json::objectValue), userPointer);
+        }
+        return EM_OK;
+    }
+    
     void Application::_hookConfigs() {
-        if (IsHeadlessMode()) return;
         EventEmitterPtr eventsSingilton = GetEventsSingilton();
+        
+        Profiler::SetCaptureWindow(Config::GetFloat("core.debug.profiler.traceWindow"));
+        
+        eventsSingilton->GetEvent("config:core.debug.profiler.traceWindow")->AddListener("Application::Config_CoreDebugProfilerTraceWindow", EventEmitter::MakeTarget(_config_CoreDebugProfilerTraceWindow, this));
+        eventsSingilton->GetEvent("config:core.debug.profiler.captureTrace")->AddListener("Application::Config_CoreDebugProfilerCaptureTrace", EventEmitter::MakeTarget(_config_CoreDebugProfilerCaptureTrace, this));
+        
+        if (IsHeadlessMode()) return;
 
         eventsSingilton->GetEvent("config:core.render.aa")->AddListener("Application::Config_CoreRenderAA", EventEmitter::MakeTarget(_config_CoreRenderAA, this));
+        eventsSingilton->GetEvent("config:core.render.errorPolicy")->AddListener("Application::Config_CoreRenderErrorPolicy", EventEmitter::MakeTarget(_config_CoreRenderErrorPolicy, this));
         eventsSingilton->GetEvent("config:core.window.vsync")->AddListener("Application::Config_CoreWindowVSync", EventEmitter::MakeTarget(_config_CoreWindowVSync, this));
         eventsSingilton->GetEvent("config:core.window.width")->AddListener("Application::ConfigWindowSize_Width", EventEmitter::MakeTarget(_config_CoreWindowSize, this));
         eventsSingilton->GetEvent("config:core.window.height")-> AddListener("Application::ConfigWindowSize_Height", EventEmitter::MakeTarget(_config_CoreWindowSize, this));
@@ -273,6 +326,8 @@ namespace Engine {
         eventsSingilton->GetEvent("restartRenderer")->AddListener("Application::_restartRenderer", EventEmitter::MakeTarget(_restartRenderer, this))->SetDefered(true);
         eventsSingilton->GetEvent("screenshot")->AddListener("Application::_saveScreenshot", EventEmitter::MakeTarget(_saveScreenshot, this))->SetDefered(true);
         eventsSingilton->GetEvent("dumpLog")->AddListener("Application::_dumpLog", EventEmitter::MakeTarget(_dumpLog, this));
+        eventsSingilton->GetEvent("captureTrace")->AddListener("Application::_captureTrace", EventEmitter::MakeTarget(_captureTrace, this));
+        eventsSingilton->GetEvent("dumpProfile")->AddListener("Application::_captureTrace", EventEmitter::MakeTarget(_captureTrace, this));
         
         eventsSingilton->GetEvent("runFile")->AddListener(10, "Application::_requireDynamicLibary", EventEmitter::MakeTarget(_requireDynamicLibary, this));
         eventsSingilton->GetEvent("runFile")->AddListener(10, "Application::_requireConfigFile", EventEmitter::MakeTarget(_requireConfigFile, this));
@@ -327,19 +382,19 @@ namespace Engine {
         this->_window = NULL;
     }
     
-    EventMagic Application::_rawInputHandler(Json::Value val, void* userPointer) {
+    EventMagic Application::_rawInputHandler(const InputEvent& e, void* userPointer) {
         ApplicationPtr app = static_cast<ApplicationPtr>(userPointer);
         
-        app->_engineUI->OnKeyPress(val["rawKey"].asInt(), val["rawPress"].asInt(), val["shift"].asBool());
+        app->_engineUI->OnKeyPress(e.rawKey, e.rawPress, e.shift);
         
         if (app->_engineUI->ConsoleActive()) {
             return EM_OK;
         }
         
-        std::string key = val["key"].asString();
+        std::string key = e.key;
         
-        GetEventsSingilton()->GetEvent("key_" + key)->Emit(val);
-        GetEventsSingilton()->GetEvent("input")->Emit(val);
+        GetEventsSingilton()->GetEvent("key_" + key)->EmitTyped(e);
+        GetEventsSingilton()->GetEvent("input")->EmitTyped(e);
         
         return EM_OK;
     }
@@ -356,7 +411,7 @@ namespace Engine {
         return EM_OK;
     }
     
-    EventMagic Application::_rawResizeHandler(Json::Value val, void* userPointer) {
+    EventMagic Application::_rawResizeHandler(const ResizeEvent& e, void* userPointer) {
         static_cast<ApplicationPtr>(userPointer)->UpdateScreen();
         return EM_OK;
     }
@@ -487,6 +542,9 @@ namespace Engine {
         LoadScriptingTests();
         LoadStdLibTests();
         LoadPackageTests();
+        if (!this->IsHeadlessMode()) {
+            LoadRenderTests();
+        }
     }
 	
 	// public methods
@@ -560,6 +618,33 @@ namespace Engine {
         return EM_OK;
     }
     
+    EventMagic Application::_captureTrace(Json::Value args, void* userPointer) {
+        if (Profiler::GetCaptureWindow() == 0.0) {
+            Logger::begin("Profiler", Logger::LogLevel_Warning) << "Trace capture is off, set core.debug.profiler.traceWindow to the number of seconds to keep" << Logger::end();
+            return EM_OK;
+        }
+        
+        if (!Filesystem::HasSetUserDir()) {
+            Logger::begin("Profiler", Logger::LogLevel_Error) << "Can't write a trace without a user directory" << Logger::end();
+            return EM_OK;
+        }
+        
+        std::string targetFilename = (args.isObject() && args.isMember("filename")) ? args["filename"].asString() : Profiler::GetDumpFilename("trace");
+        
+        if (!Profiler::WriteTrace(targetFilename)) {
+            Logger::begin("Profiler", Logger::LogLevel_Warning) << "No frames have been captured yet" << Logger::end();
+            return EM_OK;
+        }
+        
+        Json::Value saveArgs(Json::objectValue);
+        
+        saveArgs["filename"] = Filesystem::GetRealPath(targetFilename);
+        
+        GetEventsSingilton()->GetEvent("onSaveTrace")->Emit(saveArgs);
+        
+        return EM_OK;
+    }
+    
     EventMagic Application::_requireDynamicLibary(Json::Value args, void* userPointer) {
         static size_t endingLength = strlen(_PLATFORM_DYLINK);
         std::string filename = args["path"].asString();
@@ -684,6 +769,11 @@ namespace Engine {
     }
     
     void Application::_mainLoop() {
+        Config::ConfigVar<bool> runOnIdle("core.runOnIdle");
+        Config::ConfigVar<bool> throttleOnIdle("core.throttleOnIdle");
+        Config::ConfigVar<bool> gcOnFrame("core.script.gcOnFrame");
+        Config::ConfigVar<int> testFrames("core.test.testFrames");
+        
         this->_running = true;
         
 		while (this->_running) {
@@ -691,7 +781,7 @@ namespace Engine {
             if (!this->_window->ShouldClose() &&  // Check to make sure were not going to close
                 !this->_window->IsFocused()) { // Check to make sure were not focused
                 if (!this->_window->GetFullscreen() && // Check to make sure were not in fullscreen mode
-                    !Config::GetBoolean("core.runOnIdle")) {
+                    !runOnIdle) {
                     double startPauseTime = Platform::GetTime();
                     this->_window->WaitEvents();
                     Platform::Sleep(0);
@@ -699,7 +789,7 @@ namespace Engine {
                     Timer::NotifyPause(Platform::GetTime() - startPauseTime);
                     continue;
                 } else {
-                    if (Config::GetBoolean("core.throttleOnIdle") && !this->_window->GetFullscreen()) {
+                    if (throttleOnIdle && !this->_window->GetFullscreen()) {
                         Platform::NanoSleep(150000);
                     }
                 }
@@ -715,6 +805,8 @@ namespace Engine {
             FramePerfMonitor::BeginFrame();
             Timer::Update(); // Timer events may be emited now, this is the soonest into the frame that Javascript can run
             GetEventsSingilton()->PollDeferedMessages(); // Events from other threads will run here by default, Javascript may run at this time
+            WorkerThreadPool::PollMainThread(); // Continuations from jobs, Javascript may run at this time
+            ComputePool::CheckDeadlines();
             this->_processScripts();
             
 			this->_scripting->CheckUpdate();
@@ -731,22 +823,30 @@ namespace Engine {
 			{
                 Engine::Profiler::Scope profilerScopeDraw("DrawScope");
             
-                render->Begin2d();
-            
-                v8::Handle<v8::Value> args[1] = {
-                    f.NewNumber(FramePerfMonitor::GetFrameTime())
-                };
-                GetEventsSingilton()->GetEvent("draw")->Emit(Json::nullValue, 1, args); // this is when most Javascript runs
-            
-                render->End2d();
-            
-                render->Begin2d();
-            
-                //this->_cubeTest->Draw();
-            
-                this->_engineUI->Draw();
-            
-                render->End2d();
+                {
+                    RenderDebugGroup debugGroup(render, "Application::Draw");
+                    
+                    render->Begin2d();
+                
+                    v8::Handle<v8::Value> args[1] = {
+                        f.NewNumber(FramePerfMonitor::GetFrameTime())
+                    };
+                    GetEventsSingilton()->GetEvent("draw")->Emit(Json::nullValue, 1, args); // this is when most Javascript runs
+                
+                    render->End2d();
+                }
+                
+                {
+                    RenderDebugGroup debugGroup(render, "EngineUI::Draw");
+                    
+                    render->Begin2d();
+                
+                    //this->_cubeTest->Draw();
+                
+                    this->_engineUI->Draw();
+                
+                    render->End2d();
+                }
                 
 				profilerScopeDraw.Close();
             }
@@ -762,9 +862,9 @@ namespace Engine {
 				break;
 			}
             
-            render->CheckError("endOfRendering");
+            render->CheckFrameError("endOfRendering"); // the only error check in the frame unless core.render.errorPolicy is call
             
-            if (Config::GetBoolean("core.script.gcOnFrame")) {
+            if (gcOnFrame) {
                 this->GetScriptingContext()->TriggerGC();
 			}
             
@@ -778,7 +878,7 @@ namespace Engine {
                 if (!this->_testMode) this->_frames++;
             }
             
-            if (this->_testMode && this->_frames++ > Config::GetInt("core.test.testFrames")) {
+            if (this->_testMode && this->_frames++ > testFrames) {
                 this->Exit();
             }
             
@@ -795,6 +895,8 @@ namespace Engine {
         
         while (this->_running) {
             Timer::Update(); // Timer events may be emited now, this is the soonest into the frame that Javascript can run
+            WorkerThreadPool::PollMainThread();
+            ComputePool::CheckDeadlines();
             
             GetEventsSingilton()->GetEvent("headlessLoop")->Emit();
         }
@@ -842,12 +944,18 @@ namespace Engine {
             return 0;
         }
         
+        WorkerThreadPool::Init(Config::GetInt("core.jobs.workerCount"));
+        
+        // Jobs may now be submitted
+        
         this->_updateAddonLoad(LoadOrder::PreScript);
         
         ScriptingManager::Context::StaticInit();
         this->_scripting = new ScriptingManager::Context();
         this->_scripting->InitScripting();
         
+        ComputePool::Init(Config::GetInt("core.jobs.computeIsolates"));
+        
         // Scripting has now initalized, Javascript may punch in during any event
         
         this->_updateAddonLoad(LoadOrder::PreGraphics);
@@ -909,10 +1017,19 @@ namespace Engine {
             this->_shutdownOpenGL();
         }
         
+        ComputePool::Shutdown();
+        WorkerThreadPool::StopScriptWorkers();
+        
         delete this->_scripting;
         
         Addon::Shutdown();
         
+        WorkerThreadPool::Shutdown();
+        
+        Logger::Shutdown();
+        
+        Profiler::Shutdown();
+        
 		Filesystem::Destroy();
         
 		return 0;
@@ -31,6 +31,7 @@
 #include "ResourceManager.hpp"
 
 #include "Events.hpp"
+#include "EventPayloads.hpp"
 
 #include "Drawables/CubeDrawableTest.hpp"
 
@@ -139,6 +140,7 @@ namespace Engine {
         static EventMagic _toggleFullscreen(Json::Value args, void* userPointer);
         static EventMagic _restartRenderer(Json::Value args, void* userPointer);
         static EventMagic _dumpLog(Json::Value args, void* userPointer);
+        static EventMagic _captureTrace(Json::Value args, void* userPointer);
         static EventMagic _appEvent_Exit(Json::Value v, void* userPointer);
         static EventMagic _appEvent_DumpScripts(Json::Value v, void* userPointer);
         
@@ -147,16 +149,19 @@ namespace Engine {
         static EventMagic _requireConfigFile(Json::Value v, void* userPointer);
         
         // Window Events
-        static EventMagic _rawInputHandler(Json::Value v, void* userPointer);
+        static EventMagic _rawInputHandler(const InputEvent& e, void* userPointer);
         static EventMagic _rendererKillHandler(Json::Value v, void* userPointer);
         static EventMagic _postCreateContext(Json::Value v, void* userPointer);
-        static EventMagic _rawResizeHandler(Json::Value v, void* userPointer);
+        static EventMagic _rawResizeHandler(const ResizeEvent& e, void* userPointer);
         
         // Config Events
         static EventMagic _config_CoreRenderAA(Json::Value args, void* userPointer);
+        static EventMagic _config_CoreRenderErrorPolicy(Json::Value args, void* userPointer);
         static EventMagic _config_CoreWindowVSync(Json::Value args, void* userPointer);
         static EventMagic _config_CoreWindowSize(Json::Value args, void* userPointer);
         static EventMagic _config_CoreWindowTitle(Json::Value args, void* userPointer);
+        static EventMagic _config_CoreDebugProfilerTraceWindow(Json::Value args, void* userPointer);
+        static EventMagic _config_CoreDebugProfilerCaptureTrace(Json::Value args, void* userPointer);
         
         // Testing
         void _loadTests();
@@ -0,0 +1,97 @@
+/*
+ Filename: CameraBlock.cpp
+ Purpose:  Shares the view and projection matrices with every shader through a uniform buffer
+
+ Part of Engine2D
+
+ Copyright (C) 2014 Vbitz
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#define GLEW_STATIC
+#include "vendor/GL/glew.h"
+
+#include "CameraBlock.hpp"
+
+#include "Profiler.hpp"
+
+namespace Engine {
+    const char* CameraBlock::BlockName = "Camera";
+    
+    CameraBlock::CameraBlock(RenderDriverPtr render) : _render(render) {
+        this->_render->CheckError("CameraBlock::CameraBlock::Pre");
+        
+        GLint alignment = 256;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        if (alignment <= 0) alignment = 256;
+        
+        this->_slotSize = ((sizeof(BlockData) + alignment - 1) / alignment) * alignment;
+        
+        glGenBuffers(1, &this->_bufferPointer);
+        glBindBuffer(GL_UNIFORM_BUFFER, this->_bufferPointer);
+        glBufferData(GL_UNIFORM_BUFFER, this->_slotSize * SlotCount, NULL, GL_STREAM_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        
+        this->_render->TrackStat(RenderStatistic::BufferAlloc, 1);
+        
+        this->_render->CheckError("CameraBlock::CameraBlock::Post");
+    }
+    
+    CameraBlock::~CameraBlock() {
+        glDeleteBuffers(1, &this->_bufferPointer);
+    }
+    
+    bool CameraBlock::IsSupported(RenderDriverPtr render) {
+        OpenGLVersion version = render->GetOpenGLVersion();
+        
+        if (version.major < 3 || (version.major == 3 && version.minor < 1)) {
+            return false;
+        }
+        
+        return glBindBufferRange != NULL && glGetUniformBlockIndex != NULL && glUniformBlockBinding != NULL;
+    }
+    
+    void CameraBlock::Set(const glm::mat4& view, const glm::mat4& projection) {
+        if (this->_hasCurrent && this->_current.View == view && this->_current.Projection == projection) {
+            return;
+        }
+        
+        ENGINE_PROFILER_SCOPE;
+        
+        this->_current.View = view;
+        this->_current.Projection = projection;
+        this->_hasCurrent = true;
+        
+        glBindBuffer(GL_UNIFORM_BUFFER, this->_bufferPointer);
+        
+        if (this->_nextSlot == SlotCount) {
+            // Orphan the storage once every slot has been used, the driver hands back fresh memory
+            glBufferData(GL_UNIFORM_BUFFER, this->_slotSize * SlotCount, NULL, GL_STREAM_DRAW);
+            this->_render->TrackStat(RenderStatistic::BufferOrphan, 1);
+            this->_nextSlot = 0;
+        }
+        
+        size_t offset = this->_slotSize * this->_nextSlot++;
+        
+        glBufferSubData(GL_UNIFORM_BUFFER, offset, sizeof(BlockData), &this->_current);
+        glBindBufferRange(GL_UNIFORM_BUFFER, Binding, this->_bufferPointer, offset, sizeof(BlockData));
+        
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        
+        this->_render->TrackStat(RenderStatistic::BufferUpload, sizeof(BlockData));
+        this->_render->TrackStat(RenderStatistic::CameraUpdate, 1);
+        
+        this->_render->CheckError("CameraBlock::Set::Post");
+    }
+}
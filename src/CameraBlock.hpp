@@ -0,0 +1,68 @@
+/*
+ Filename: CameraBlock.hpp
+ Purpose:  Shares the view and projection matrices with every shader through a uniform buffer
+
+ Part of Engine2D
+
+ Copyright (C) 2014 Vbitz
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include "RenderDriver.hpp"
+
+#define GLM_FORCE_RADIANS
+#include "vendor/glm/glm.hpp"
+
+namespace Engine {
+    ENGINE_CLASS(CameraBlock);
+    
+    // Shaders opt in by declaring
+    //     layout(std140) uniform Camera { mat4 view; mat4 projection; };
+    // Shader binds the block to CameraBlock::Binding when it's linked.
+    class CameraBlock {
+    public:
+        static const char* BlockName;
+        static const unsigned int Binding = 0;
+        
+        CameraBlock(RenderDriverPtr render);
+        ~CameraBlock();
+        
+        // Uniform buffer objects are core from OpenGL 3.1
+        static bool IsSupported(RenderDriverPtr render);
+        
+        // Nothing is sent to the driver when the matrices match the last call
+        void Set(const glm::mat4& view, const glm::mat4& projection);
+    
+    private:
+        struct BlockData {
+            glm::mat4 View;
+            glm::mat4 Projection;
+        };
+        
+        RenderDriverPtr _render;
+        
+        unsigned int _bufferPointer = 0;
+        
+        // each camera gets a new slot so draws still reading the old one never wait on the write
+        size_t _slotSize = 0;
+        unsigned int _nextSlot = 0;
+        
+        BlockData _current;
+        bool _hasCurrent = false;
+        
+        static const unsigned int SlotCount = 64;
+    };
+}
@@ -0,0 +1,499 @@
+/*
+ Filename: ComputePool.cpp
+ Purpose:  Pool of warm isolates running script functions over Float32Arrays
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "ComputePool.hpp"
+
+#include <include/v8.h>
+
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <algorithm>
+#include <unordered_map>
+#include <condition_variable>
+
+#include "Logger.hpp"
+#include "Platform.hpp"
+#include "Profiler.hpp"
+#include "WorkerMessage.hpp"
+#include "WorkerThreadPool.hpp"
+
+namespace Engine {
+    namespace ComputePool {
+        ENGINE_CLASS(ComputeTask);
+        ENGINE_CLASS(ComputeIsolate);
+        
+        class ComputeTask {
+        public:
+            int ID;
+            ComputeRequest Request;
+            
+            std::atomic<size_t> Remaining;
+            std::atomic<bool> Cancelled;
+            
+            std::mutex ErrorMutex;
+            std::string Error;
+            
+            std::vector<double> Values;
+            
+            // Owned copies of the request's arrays, Request.Input and Request.Output point into these
+            std::vector<float> Input;
+            std::vector<float> Output;
+            
+            bool Discarded = false; // main thread only
+        };
+        
+        struct ComputeChunk {
+            ComputeTaskPtr Task;
+            size_t Index;
+            size_t Begin;
+            size_t Count;
+        };
+        
+        // Compiled functions are kept per isolate, scripts rarely use more than a handful
+        static const size_t MaxCachedFunctions = 32;
+        
+        static std::vector<ComputeIsolatePtr> _isolates;
+        static std::atomic<bool> _poolRunning(false);
+        static std::atomic<int> _runningIsolates(0);
+        
+        static std::deque<ComputeChunk> _chunks;
+        static std::mutex _chunksMutex;
+        static std::condition_variable _chunksCondition;
+        
+        static std::map<int, ComputeTaskPtr> _tasks; // main thread only
+        static int _nextTaskID = 1;
+        
+        static void _failTask(ComputeTaskPtr task, std::string error);
+        
+        class ComputeIsolate {
+        public:
+            void CreateContext() {
+                // Only called from the isolate's own thread
+                this->_isolate = v8::Isolate::New();
+                this->_isolate->Enter();
+                
+                v8::HandleScope scp(this->_isolate);
+                
+                v8::Handle<v8::Context> context = v8::Context::New(this->_isolate);
+                context->Enter();
+                
+                this->_context.Reset(this->_isolate, context);
+            }
+            
+            void DisposeContext() {
+                {
+                    v8::HandleScope scp(this->_isolate);
+                    v8::Local<v8::Context>::New(this->_isolate, this->_context)->Exit();
+                }
+                
+                for (auto iter = this->_functions.begin(); iter != this->_functions.end(); iter++) {
+                    iter->second->Reset();
+                    delete iter->second;
+                }
+                this->_functions.clear();
+                
+                this->_context.Reset();
+                
+                this->_isolate->Exit();
+                this->_isolate->Dispose();
+                this->_isolate = NULL;
+            }
+            
+            void Run(ComputeChunk& chunk) {
+                ComputeTaskPtr task = chunk.Task;
+                WorkerMessagePtr args = task->Request.Args.empty() ? NULL : task->Request.Args[chunk.Index];
+                
+                if (!task->Cancelled && task->Request.Deadline > 0.0 && Platform::GetTime() > task->Request.Deadline) {
+                    _failTask(task, "Deadline exceeded");
+                }
+                
+                if (!task->Cancelled && chunk.Count > 0) {
+                    {
+                        std::lock_guard<std::mutex> lock(this->_runningMutex);
+                        this->_running = task;
+                    }
+                    
+                    this->_execute(chunk, args);
+                    args = NULL; // deserialized by _execute
+                    
+                    {
+                        std::lock_guard<std::mutex> lock(this->_runningMutex);
+                        this->_running = NULL;
+                    }
+                    
+                    // Cancel can only terminate while _running is set, anything it requested is cleared here
+                    v8::V8::CancelTerminateExecution(this->_isolate);
+                }
+                
+                if (args != NULL) {
+                    delete args;
+                }
+                
+                if (--task->Remaining == 0) {
+                    WorkerThreadPool::RunOnMainThread([task]() {
+                        ComputeResult result;
+                        result.Failed = task->Cancelled;
+                        result.Discarded = task->Discarded;
+                        result.Error = task->Error;
+                        result.Values.swap(task->Values);
+                        result.Output.swap(task->Output);
+                        
+                        _tasks.erase(task->ID);
+                        
+                        task->Request.Args.clear(); // already deleted by the chunks
+                        
+                        if (task->Request.OnComplete) {
+                            task->Request.OnComplete(result);
+                        }
+                        
+                        delete task;
+                    });
+                }
+            }
+            
+            // Can be called from any thread, stops the chunk this isolate is running if it belongs to task
+            void Terminate(ComputeTaskPtr task) {
+                std::lock_guard<std::mutex> lock(this->_runningMutex);
+                if (this->_running == task) {
+                    v8::V8::TerminateExecution(this->_isolate);
+                }
+            }
+            
+        private:
+            v8::Local<v8::Function> _getFunction(const std::string& source, std::string& error) {
+                auto iter = this->_functions.find(source);
+                if (iter != this->_functions.end()) {
+                    return v8::Local<v8::Function>::New(this->_isolate, *iter->second);
+                }
+                
+                if (this->_functions.size() >= MaxCachedFunctions) {
+                    for (auto iter = this->_functions.begin(); iter != this->_functions.end(); iter++) {
+                        iter->second->Reset();
+                        delete iter->second;
+                    }
+                    this->_functions.clear();
+                }
+                
+                v8::TryCatch tryCatch;
+                
+                std::string realSource = "(" + source + ")"; // needed to return the function
+                
+                v8::Local<v8::Script> script = v8::Script::Compile(v8::String::NewFromUtf8(this->_isolate, realSource.c_str()),
+                                                                   v8::String::NewFromUtf8(this->_isolate, "ComputePool"));
+                
+                v8::Local<v8::Value> func;
+                if (!script.IsEmpty()) {
+                    func = script->Run();
+                }
+                
+                if (func.IsEmpty() || !func->IsFunction()) {
+                    error = tryCatch.HasCaught() ? *v8::String::Utf8Value(tryCatch.Exception()) : "The compute source needs to be a function";
+                    return v8::Local<v8::Function>();
+                }
+                
+                this->_functions[source] = new v8::Persistent<v8::Function>(this->_isolate, func.As<v8::Function>());
+                
+                return func.As<v8::Function>();
+            }
+            
+            void _execute(ComputeChunk& chunk, WorkerMessagePtr args) {
+                ENGINE_PROFILER_SCOPE;
+                
+                ComputeRequest& request = chunk.Task->Request;
+                
+                v8::HandleScope scp(this->_isolate);
+                v8::Local<v8::Context> ctx = v8::Local<v8::Context>::New(this->_isolate, this->_context);
+                v8::Context::Scope ctxScope(ctx);
+                
+                v8::Local<v8::Value> argsValue = v8::Undefined(this->_isolate);
+                if (args != NULL) {
+                    argsValue = args->Deserialize(this->_isolate);
+                    delete args;
+                }
+                
+                std::string error;
+                v8::Local<v8::Function> func = this->_getFunction(request.Source, error);
+                
+                if (func.IsEmpty()) {
+                    _failTask(chunk.Task, error);
+                    return;
+                }
+                
+                // The chunk's floats are wrapped without a copy and detached afterwards so the
+                // function can't hold on to them
+                size_t inputLength = chunk.Count * request.InputComponents;
+                v8::Local<v8::ArrayBuffer> inputBuffer = v8::ArrayBuffer::New(this->_isolate,
+                    (void*) (request.Input + chunk.Begin * request.InputComponents), inputLength * sizeof(float));
+                
+                v8::Local<v8::ArrayBuffer> outputBuffer;
+                
+                v8::Local<v8::Value> callArgs[4];
+                int callArgCount = 0;
+                
+                callArgs[callArgCount++] = v8::Float32Array::New(inputBuffer, 0, inputLength);
+                
+                if (request.Type == ComputeTaskType::Map) {
+                    size_t outputLength = chunk.Count * request.OutputComponents;
+                    outputBuffer = v8::ArrayBuffer::New(this->_isolate,
+                        (void*) (chunk.Task->Output.data() + chunk.Begin * request.OutputComponents), outputLength * sizeof(float));
+                    callArgs[callArgCount++] = v8::Float32Array::New(outputBuffer, 0, outputLength);
+                }
+                
+                callArgs[callArgCount++] = v8::Number::New(this->_isolate, (double) chunk.Begin);
+                callArgs[callArgCount++] = argsValue;
+                
+                v8::TryCatch tryCatch;
+                
+                v8::Local<v8::Value> ret = func->Call(ctx->Global(), callArgCount, callArgs);
+                
+                inputBuffer->Neuter();
+                if (!outputBuffer.IsEmpty()) {
+                    outputBuffer->Neuter();
+                }
+                
+                if (tryCatch.HasTerminated() || chunk.Task->Cancelled) {
+                    return; // _failTask already recorded why
+                }
+                
+                if (tryCatch.HasCaught()) {
+                    _failTask(chunk.Task, *v8::String::Utf8Value(tryCatch.Exception()));
+                    return;
+                }
+                
+                if (request.Type == ComputeTaskType::Reduce) {
+                    chunk.Task->Values[chunk.Index] = ret->NumberValue();
+                }
+            }
+            
+            v8::Isolate* _isolate = NULL;
+            v8::Persistent<v8::Context> _context;
+            
+            std::unordered_map<std::string, v8::Persistent<v8::Function>*> _functions;
+            
+            std::mutex _runningMutex;
+            ComputeTaskPtr _running = NULL;
+        };
+        
+        static void _failTask(ComputeTaskPtr task, std::string error) {
+            {
+                std::lock_guard<std::mutex> lock(task->ErrorMutex);
+                if (task->Cancelled) {
+                    return; // keep the first reason
+                }
+                task->Error = error;
+                task->Cancelled = true;
+            }
+            
+            for (auto iter = _isolates.begin(); iter != _isolates.end(); iter++) {
+                (*iter)->Terminate(task);
+            }
+        }
+        
+        static bool _takeChunk(ComputeChunk& chunk) {
+            std::unique_lock<std::mutex> lock(_chunksMutex);
+            
+            _chunksCondition.wait(lock, [] { return !_chunks.empty() || !_poolRunning.load(); });
+            
+            if (_chunks.empty()) {
+                return false;
+            }
+            
+            chunk = _chunks.front();
+            _chunks.pop_front();
+            
+            return true;
+        }
+        
+        void* ComputeIsolateFunc(void* isolateArg) {
+            ComputeIsolatePtr isolate = (ComputeIsolatePtr) isolateArg;
+            
+            isolate->CreateContext();
+            
+            ComputeChunk chunk;
+            while (_takeChunk(chunk)) {
+                isolate->Run(chunk);
+            }
+            
+            isolate->DisposeContext();
+            
+            // hands the ring to whichever thread profiles next
+            Profiler::ReleaseThread();
+            
+            _runningIsolates--;
+            
+            return NULL;
+        }
+        
+        void Init(int isolateCount) {
+            if (!_isolates.empty()) {
+                return;
+            }
+            
+            if (isolateCount <= 0) {
+                isolateCount = std::max(1, Platform::GetProcesserCount() - 1);
+            }
+            
+            _poolRunning = true;
+            _runningIsolates = isolateCount;
+            
+            for (int i = 0; i < isolateCount; i++) {
+                ComputeIsolatePtr isolate = new ComputeIsolate();
+                _isolates.push_back(isolate);
+                Platform::CreateThread(ComputeIsolateFunc, isolate);
+            }
+            
+            Logger::begin("ComputePool", Logger::LogLevel_Log) << "Started " << isolateCount << " compute isolates" << Logger::end();
+        }
+        
+        void Shutdown() {
+            if (_isolates.empty()) {
+                return;
+            }
+            
+            // OnComplete can't call into a script context that's about to go away but it still
+            // has to free what it captured
+            for (auto iter = _tasks.begin(); iter != _tasks.end(); iter++) {
+                _failTask(iter->second, "Shutting down");
+                iter->second->Discarded = true;
+            }
+            
+            {
+                std::lock_guard<std::mutex> lock(_chunksMutex);
+                _poolRunning = false;
+                _chunksCondition.notify_all();
+            }
+            
+            // queued chunks still run so every task reaches 0, cancelled ones return straight away
+            while (_runningIsolates.load() > 0) {
+                Platform::NanoSleep(100000);
+            }
+            
+            for (auto iter = _isolates.begin(); iter != _isolates.end(); iter++) {
+                delete *iter;
+            }
+            _isolates.clear();
+            
+            // The last chunk of each task queued its continuation, the main loop won't poll again
+            WorkerThreadPool::PollMainThread();
+            
+            assert(_tasks.empty());
+        }
+        
+        int GetIsolateCount() {
+            return (int) _isolates.size();
+        }
+        
+        size_t PickChunkItems(size_t items, size_t chunkItems) {
+            if (chunkItems > 0) {
+                return chunkItems;
+            }
+            
+            // a few chunks per isolate so uneven chunks still balance out
+            size_t chunks = std::max<size_t>(1, _isolates.size() * 4);
+            return std::max<size_t>(1, (items + chunks - 1) / chunks);
+        }
+        
+        size_t GetChunkCount(size_t items, size_t chunkItems) {
+            chunkItems = PickChunkItems(items, chunkItems);
+            return (items + chunkItems - 1) / chunkItems;
+        }
+        
+        int Submit(ComputeRequest request) {
+            ENGINE_PROFILER_SCOPE;
+            
+            assert(!_isolates.empty());
+            
+            ComputeTaskPtr task = new ComputeTask();
+            task->ID = _nextTaskID++;
+            task->Request = request;
+            task->Cancelled = false;
+            
+            // The caller's arrays can be freed or detached as soon as Submit returns
+            if (request.Input != NULL) {
+                task->Input.assign(request.Input, request.Input + request.Items * request.InputComponents);
+            }
+            if (request.Type == ComputeTaskType::Map) {
+                if (request.Output != NULL) {
+                    task->Output.assign(request.Output, request.Output + request.Items * request.OutputComponents);
+                } else {
+                    task->Output.resize(request.Items * request.OutputComponents, 0.0f);
+                }
+            }
+            task->Request.Input = task->Input.data();
+            task->Request.Output = task->Output.data();
+            
+            size_t chunkItems = PickChunkItems(request.Items, request.ChunkItems);
+            size_t chunkCount = GetChunkCount(request.Items, request.ChunkItems);
+            
+            assert(request.Args.empty() || request.Args.size() == chunkCount);
+            
+            task->Values.resize(chunkCount, 0.0);
+            task->Remaining = std::max<size_t>(chunkCount, 1);
+            
+            _tasks[task->ID] = task;
+            
+            std::lock_guard<std::mutex> lock(_chunksMutex);
+            
+            if (chunkCount == 0) {
+                // nothing to run, still complete on the main thread like every other task
+                _chunks.push_back({task, 0, 0, 0});
+            }
+            
+            for (size_t i = 0; i < chunkCount; i++) {
+                size_t begin = i * chunkItems;
+                _chunks.push_back({task, i, begin, std::min(chunkItems, request.Items - begin)});
+            }
+            
+            _chunksCondition.notify_all();
+            
+            return task->ID;
+        }
+        
+        bool Cancel(int taskID, std::string reason) {
+            auto iter = _tasks.find(taskID);
+            if (iter == _tasks.end()) {
+                return false;
+            }
+            
+            _failTask(iter->second, reason);
+            
+            return true;
+        }
+        
+        void CheckDeadlines() {
+            if (_tasks.empty()) {
+                return;
+            }
+            
+            double now = Platform::GetTime();
+            
+            for (auto iter = _tasks.begin(); iter != _tasks.end(); iter++) {
+                ComputeTaskPtr task = iter->second;
+                if (task->Request.Deadline > 0.0 && now > task->Request.Deadline && !task->Cancelled) {
+                    _failTask(task, "Deadline exceeded");
+                }
+            }
+        }
+    }
+}
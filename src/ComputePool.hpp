@@ -0,0 +1,93 @@
+/*
+ Filename: ComputePool.hpp
+ Purpose:  Pool of warm isolates running script functions over Float32Arrays
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "stdlib.hpp"
+
+namespace Engine {
+    ENGINE_CLASS(WorkerMessage);
+    
+    namespace ComputePool {
+        enum class ComputeTaskType {
+            Map,    // func(input, output, begin, args) writes its part of output
+            Reduce  // func(input, begin, args) returns a number for each chunk
+        };
+        
+        struct ComputeResult {
+            bool Failed = false;
+            bool Discarded = false; // the pool is shutting down, only release what OnComplete holds
+            std::string Error;
+            std::vector<double> Values; // one per chunk for Reduce tasks
+            std::vector<float> Output; // Items * OutputComponents floats for Map tasks
+        };
+        
+        typedef std::function<void(ComputeResult& result)> ComputeCompleteFunc;
+        
+        struct ComputeRequest {
+            ComputeTaskType Type = ComputeTaskType::Map;
+            std::string Source; // source of a script function, compiled once per isolate
+            
+            // Input holds Items * InputComponents floats and Output Items * OutputComponents.
+            // Both are copied by Submit so scripts can neuter or transfer their arrays while the
+            // task runs, Output only gives the starting values and may be NULL for zeros.
+            // The results come back in ComputeResult::Output.
+            const float* Input = NULL;
+            const float* Output = NULL;
+            size_t Items = 0;
+            int InputComponents = 1;
+            int OutputComponents = 1;
+            
+            size_t ChunkItems = 0; // 0 picks a size from the isolate count
+            double Deadline = 0.0; // Platform::GetTime value the task is cancelled at, 0 for none
+            
+            std::vector<WorkerMessagePtr> Args; // empty or one per chunk, deleted by the pool
+            
+            ComputeCompleteFunc OnComplete; // runs on the main thread once every chunk has stopped
+        };
+        
+        // Creates isolateCount isolates on their own threads up front so tasks never pay for
+        // v8::Isolate::New, 0 uses one per processor leaving one for the main thread.
+        // Scripting has to be initialized first.
+        void Init(int isolateCount);
+        // Cancels every task and runs their OnComplete with Discarded set
+        void Shutdown();
+        
+        int GetIsolateCount();
+        
+        size_t GetChunkCount(size_t items, size_t chunkItems);
+        size_t PickChunkItems(size_t items, size_t chunkItems);
+        
+        // Returns a task ID for Cancel. Only called from the main thread.
+        int Submit(ComputeRequest request);
+        
+        // Skips chunks that haven't started and terminates the ones that are running,
+        // OnComplete still runs with Failed set. Returns false if the task already finished.
+        bool Cancel(int taskID, std::string reason = "Cancelled");
+        
+        // Called by the main loop once per frame, cancels tasks past their deadline
+        void CheckDeadlines();
+    }
+}
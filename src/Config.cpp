@@ -23,6 +23,9 @@
 
 #include "Events.hpp"
 
+#include <algorithm>
+#include <mutex>
+
 namespace Engine {
     namespace Config {
         std::unordered_map<std::string, float> _numberCvars;
@@ -31,22 +34,88 @@ namespace Engine {
         
         bool _configEventEnabled = false;
         
+        std::atomic<size_t> _lookupCount(0);
+        
+        // Function statics so they are constructed before, and destroyed after, the function static handles
+        static std::mutex& _handlesMutex() {
+            static std::mutex mutex;
+            return mutex;
+        }
+        
+        static std::unordered_map<std::string, std::vector<ConfigVarBase*>>& _handles() {
+            static std::unordered_map<std::string, std::vector<ConfigVarBase*>> handles;
+            return handles;
+        }
+        
+        static void _refreshHandles(const std::string& key) {
+            std::lock_guard<std::mutex> lock(_handlesMutex());
+            auto iter = _handles().find(key);
+            if (iter == _handles().end()) {
+                return;
+            }
+            for (auto handle = iter->second.begin(); handle != iter->second.end(); handle++) {
+                (*handle)->Refresh();
+            }
+        }
+        
+        ConfigVarBase::ConfigVarBase(std::string key) : _key(key) {
+            std::lock_guard<std::mutex> lock(_handlesMutex());
+            _handles()[key].push_back(this);
+        }
+        
+        ConfigVarBase::~ConfigVarBase() {
+            std::lock_guard<std::mutex> lock(_handlesMutex());
+            std::vector<ConfigVarBase*>& handles = _handles()[this->_key];
+            handles.erase(std::remove(handles.begin(), handles.end(), this), handles.end());
+        }
+        
+        template<> void ConfigVar<bool>::Set(bool value) {
+            SetBoolean(this->_key, value);
+        }
+        
+        template<> void ConfigVar<int>::Set(int value) {
+            SetNumber(this->_key, value);
+        }
+        
+        template<> void ConfigVar<float>::Set(float value) {
+            SetNumber(this->_key, value);
+        }
+        
+        // Refresh uses find so a handle for a key that isn't set yet doesn't create it
+        template<> void ConfigVar<bool>::Refresh() {
+            auto iter = _boolCvars.find(this->_key);
+            this->_value.store(iter != _boolCvars.end() ? iter->second : false, std::memory_order_relaxed);
+        }
+        
+        template<> void ConfigVar<int>::Refresh() {
+            auto iter = _numberCvars.find(this->_key);
+            this->_value.store(iter != _numberCvars.end() ? (int) iter->second : 0, std::memory_order_relaxed);
+        }
+        
+        template<> void ConfigVar<float>::Refresh() {
+            auto iter = _numberCvars.find(this->_key);
+            this->_value.store(iter != _numberCvars.end() ? iter->second : 0.0f, std::memory_order_relaxed);
+        }
+        
         void EnableConfigEvents() {
             _configEventEnabled = true;
         }
         
         void SetNumber(std::string key, int value) {
             _numberCvars[key] = value;
+            _refreshHandles(key);
             if (_configEventEnabled) GetEventsSingilton()->GetEvent("config:" + key)->Emit();
         }
         
         void SetNumber(std::string key, float value) {
             _numberCvars[key] = value;
+            _refreshHandles(key);
             if (_configEventEnabled) GetEventsSingilton()->GetEvent("config:" + key)->Emit();
         }
         
         void SetBoolean(std::string key, bool value) {
             _boolCvars[key] = value;
+            _refreshHandles(key);
             if (_configEventEnabled) GetEventsSingilton()->GetEvent("config:" + key)->Emit();
         }
         
@@ -121,21 +190,25 @@ namespace Engine {
         
         int GetInt(std::string key) {
             //std::cout << "Get Int: " << key << std::endl;
+            _lookupCount++;
             return (int) _numberCvars[key];
         }
         
         float GetFloat(std::string key) {
             //std::cout << "Get Float: " << key << std::endl;
+            _lookupCount++;
             return _numberCvars[key];
         }
         
         bool GetBoolean(std::string key) {
             //std::cout << "Get Bool: " << key << std::endl;
+            _lookupCount++;
             return _boolCvars[key];
         }
         
         std::string GetString(std::string key) {
             //std::cout << "Get String: " << key << std::endl;
+            _lookupCount++;
             return _stringCvars[key];
         }
         
@@ -159,6 +232,10 @@ namespace Engine {
             return true;
         }
         
+        size_t TakeLookupCount() {
+            return _lookupCount.exchange(0);
+        }
+        
         UIConfigCollection GetAllUI() {
             UIConfigCollection ret;
             for (auto iter = _numberCvars.begin(); iter != _numberCvars.end(); iter++) {
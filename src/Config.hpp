@@ -22,6 +22,7 @@
 #pragma once
 
 #include <string>
+#include <atomic>
 #include <unordered_map>
 #include <vector>
 #include <map>
@@ -60,5 +61,62 @@ namespace Engine {
         
         std::vector<std::string> GetAll();
         UIConfigCollection GetAllUI();
+        
+        // Number of GetInt/GetFloat/GetBoolean/GetString calls since the last call, the profiler
+        // reports it once per frame so string lookups left in hot paths stand out
+        size_t TakeLookupCount();
+        
+        // Handles are registered against their key once and Set* updates the cached value
+        // so reading one never touches the string maps. Construct them after the config
+        // defaults are loaded, as function statics or class members rather than globals.
+        class ConfigVarBase {
+        public:
+            ConfigVarBase(std::string key);
+            virtual ~ConfigVarBase();
+            
+            ConfigVarBase(const ConfigVarBase&) = delete;
+            ConfigVarBase& operator=(const ConfigVarBase&) = delete;
+            
+            const std::string& GetKey() const { return this->_key; }
+            
+            // Reloads the value from the config store, called by Set* for this key
+            virtual void Refresh() = 0;
+            
+        protected:
+            std::string _key;
+        };
+        
+        // Supports bool, int and float, any thread can read the value
+        template<typename T>
+        class ConfigVar : public ConfigVarBase {
+        public:
+            ConfigVar(std::string key) : ConfigVarBase(key) {
+                this->Refresh();
+            }
+            
+            T Get() const {
+                return this->_value.load(std::memory_order_relaxed);
+            }
+            
+            operator T() const {
+                return this->Get();
+            }
+            
+            // Goes through the same path as Config::Set* so events are emitted and other handles for the key are updated
+            void Set(T value);
+            
+            void Refresh() override;
+            
+        private:
+            std::atomic<T> _value;
+        };
+        
+        template<> void ConfigVar<bool>::Set(bool value);
+        template<> void ConfigVar<int>::Set(int value);
+        template<> void ConfigVar<float>::Set(float value);
+        
+        template<> void ConfigVar<bool>::Refresh();
+        template<> void ConfigVar<int>::Refresh();
+        template<> void ConfigVar<float>::Refresh();
     }
 }
\ No newline at end of file
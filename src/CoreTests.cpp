@@ -21,11 +21,69 @@
 
 #include "TestSuiteAPI.hpp"
 
+#include "Config.hpp"
 #include "Events.hpp"
+#include "EventPayloads.hpp"
+#include "Filesystem.hpp"
 #include "Logger.hpp"
+#include "Noise.hpp"
+#include "Profiler.hpp"
+#include "VectorMath.hpp"
+#include "WorkerThreadPool.hpp"
 
 #include "Platform.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <functional>
+#include <new>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <cmath>
+
+#include "vendor/glm/gtc/matrix_transform.hpp"
+
+// Counts heap allocations made while a benchmark has counting switched on. Replacing operator new
+// changes the allocator for the whole engine so it's only built with ENGINE_COUNT_ALLOCATIONS
+static std::atomic<bool> _countAllocations(false);
+static std::atomic<size_t> _allocationCount(0);
+
+#ifdef ENGINE_COUNT_ALLOCATIONS
+void* operator new(size_t size) {
+    if (_countAllocations.load(std::memory_order_relaxed)) {
+        _allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == NULL) throw std::bad_alloc();
+    return ptr;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) throw() {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) throw() {
+    std::free(ptr);
+}
+#endif
+
+static std::string _describeAllocations(int iterations, const char* unit) {
+#ifdef ENGINE_COUNT_ALLOCATIONS
+    std::stringstream ss;
+    ss << ((double) _allocationCount / iterations) << " allocs/" << unit;
+    return ss.str();
+#else
+    return "allocations not counted";
+#endif
+}
+
 namespace Engine {
     
     static int adder = 0;
@@ -149,6 +207,358 @@ namespace Engine {
         }
     };
     
+    struct EventQueueProducerArgs {
+        EventQueuePolicy policy;
+        int messages;
+        std::atomic<int>* finished;
+    };
+    
+    void* EventQueueProducer(void* argsPtr) {
+        EventQueueProducerArgs* args = (EventQueueProducerArgs*) argsPtr;
+        
+        for (int i = 0; i < args->messages; i++) {
+            Json::Value e(Json::objectValue);
+            e["index"] = i;
+            GetEventsSingilton()->EmitThread("CoreEventQueueTest", "testingThreadEvent", e, args->policy, "progress");
+        }
+        
+        (*args->finished)++;
+        
+        return NULL;
+    }
+    
+    static int threadEventCount = 0;
+    
+    EventMagic ThreadEventCounter(Json::Value val, void* userPointer) {
+        threadEventCount++;
+        return EM_OK;
+    }
+    
+    class CoreEventQueueTest : public Test {
+    public:
+        std::string GetName() override { return "CoreEventQueueTest"; }
+        
+        void Run() override {
+            this->_testPolicies();
+            
+            this->_runStress(EventQueuePolicy::Block, "Block", 4, 25000);
+            this->_runStress(EventQueuePolicy::DropOldest, "DropOldest", 4, 25000);
+            this->_runStress(EventQueuePolicy::Coalesce, "Coalesce", 4, 25000);
+        }
+    
+    private:
+        void _testPolicies() {
+            EventClass cls;
+            EventQueue queue(8);
+            
+            for (int i = 0; i < 20; i++) {
+                EventQueueMessage msg;
+                msg.Target = &cls;
+                msg.Args = i;
+                queue.Push(msg, EventQueuePolicy::DropOldest);
+            }
+            
+            this->Assert("DropOldest keeps the queue bounded", queue.GetDepth() == 8 && cls.GetQueueStats().Depth == 8);
+            this->Assert("DropOldest counts dropped messages", cls.GetQueueStats().Dropped == 12);
+            
+            EventQueueMessage msg;
+            queue.Pop(msg);
+            this->Assert("DropOldest keeps the newest messages", msg.Args.asInt() == 12);
+            while (queue.Pop(msg)) {}
+            
+            for (int i = 0; i < 100; i++) {
+                EventQueueMessage coalesced;
+                coalesced.Target = &cls;
+                coalesced.Args = i;
+                queue.Push(coalesced, EventQueuePolicy::Coalesce, "key");
+            }
+            
+            this->Assert("Coalesce keeps one message per key", queue.GetDepth() == 1 && cls.GetQueueStats().Coalesced == 99);
+            this->Assert("Coalesce keeps the newest value", queue.Pop(msg) && msg.Args.asInt() == 99);
+            this->Assert("Queue is empty", !queue.Pop(msg) && cls.GetQueueStats().Depth == 0);
+        }
+        
+        void _runStress(EventQueuePolicy policy, const char* name, int producers, int messagesEach) {
+            EventEmitterPtr events = GetEventsSingilton();
+            EventClassPtr cls = new EventClass();
+            
+            // Every run gets a fresh class so the counters only cover this run
+            events->GetEvent("testingThreadEvent") = cls;
+            cls->TargetName = "testingThreadEvent";
+            cls->AddListener("ThreadEventCounter", EventEmitter::MakeTarget(ThreadEventCounter));
+            
+            threadEventCount = 0;
+            std::atomic<int> finished(0);
+            
+            EventQueueProducerArgs args = {policy, messagesEach, &finished};
+            std::vector<Platform::ThreadPtr> threads;
+            
+            double startTime = Platform::GetTime();
+            
+            for (int i = 0; i < producers; i++) {
+                threads.push_back(Platform::CreateThread(EventQueueProducer, &args));
+            }
+            
+            while (finished < producers || events->GetThreadQueueDepth() > 0) {
+                events->PollDeferedMessages();
+                if (Platform::GetTime() - startTime > 30.0) {
+                    this->FailTest();
+                    break;
+                }
+            }
+            
+            double endTime = Platform::GetTime();
+            
+            EventQueueStats& stats = cls->GetQueueStats();
+            
+            Logger::begin("CoreEventQueueTest", Logger::LogLevel_Log) << name << " EmitThread x " << producers << " threads x " << messagesEach << ": "
+                << (endTime - startTime) << "s | " << (stats.Delivered / (endTime - startTime)) << " msg/s"
+                << " | Delivered: " << stats.Delivered << " | Dropped: " << stats.Dropped << " | Coalesced: " << stats.Coalesced
+                << " | p99: " << cls->GetQueueLatencyPercentile(0.99) * 1000.0 << "ms | Max: " << stats.MaxLatency * 1000.0 << "ms" << Logger::end();
+            
+            this->Assert("Every message is accounted for",
+                         stats.Delivered + stats.Dropped + stats.Coalesced == (size_t) (producers * messagesEach));
+            this->Assert("Listeners ran for every delivery", threadEventCount == (int) stats.Delivered);
+            if (policy == EventQueuePolicy::Block) {
+                this->Assert("Block never drops", stats.Dropped == 0 && stats.Delivered == (size_t) (producers * messagesEach));
+            }
+            
+            // Producers have exited once they are counted as finished
+            for (auto iter = threads.begin(); iter != threads.end(); iter++) {
+                delete *iter;
+            }
+            
+            cls->Clear("ThreadEventCounter");
+        }
+    };
+    
+    static int typedEventCount = 0;
+    
+    EventMagic TypedEventCounter(const InputEvent& e, void* userPointer) {
+        typedEventCount += e.rawKey;
+        return EM_OK;
+    }
+    
+    EventMagic JsonEventCounter(Json::Value e, void* userPointer) {
+        typedEventCount += e["rawKey"].asInt();
+        return EM_OK;
+    }
+    
+    static std::string typedEventKeys = "";
+    
+    EventMagic TypedEventKeyReader(const InputEvent& e, void* userPointer) {
+        typedEventKeys += "|" + std::string(e.key) + e.state;
+        return EM_OK;
+    }
+    
+    class CoreTypedEventTest : public Test {
+    public:
+        std::string GetName() override { return "CoreTypedEventTest"; }
+        
+        void Run() override {
+            EventEmitterPtr events = GetEventsSingilton();
+            
+            events->GetEvent("testingTypedEvent")->AddListener("TypedEventCounter", EventEmitter::MakeTarget(TypedEventCounter, NULL));
+            events->GetEvent("testingJsonEvent")->AddListener("JsonEventCounter", EventEmitter::MakeTarget(JsonEventCounter));
+            
+            InputEvent e = {1, "a", 1, "press", false};
+            
+            Json::Value json = InputEvent::GetSchema()->ToJson(&e);
+            
+            typedEventCount = 0;
+            this->_runBenchmark("C++ Json", [&]() { events->GetEvent("testingJsonEvent")->Emit(json); });
+            this->_runBenchmark("C++ Typed", [&]() { events->GetEvent("testingTypedEvent")->EmitTyped(e); });
+            this->Assert("Typed and Json listeners both ran", typedEventCount == 2 * iterations);
+            
+            // Typed listeners still get Json emits and the other way around
+            typedEventCount = 0;
+            events->GetEvent("testingTypedEvent")->Emit(json);
+            events->GetEvent("testingJsonEvent")->EmitTyped(e);
+            this->Assert("Payloads convert between Json and typed listeners", typedEventCount == 2);
+            
+            // Scripts can emit anything so missing or mistyped fields have to reach typed listeners safely
+            events->GetEvent("testingPartialEvent")->AddListener("TypedEventKeyReader", EventEmitter::MakeTarget(TypedEventKeyReader, NULL));
+            Json::Value partial(Json::objectValue);
+            partial["key"] = 5;
+            typedEventKeys = "";
+            events->GetEvent("testingPartialEvent")->Emit(Json::Value(Json::objectValue));
+            events->GetEvent("testingPartialEvent")->Emit(partial);
+            events->GetEvent("testingPartialEvent")->Emit(Json::Value(Json::nullValue));
+            this->Assert("Missing string fields are empty", typedEventKeys == "|||");
+            events->GetEvent("testingPartialEvent")->Clear("TypedEventKeyReader");
+            
+            // boot.js listens for testingTypedEventJS
+            this->_runBenchmark("C++ -> JavaScript Json", [&]() { events->GetEvent("testingTypedEventJS")->Emit(json); });
+            this->_runBenchmark("C++ -> JavaScript Typed", [&]() { events->GetEvent("testingTypedEventJS")->EmitTyped(e); });
+            
+            events->GetEvent("testingTypedEvent")->Clear("TypedEventCounter");
+            events->GetEvent("testingJsonEvent")->Clear("JsonEventCounter");
+        }
+    
+    private:
+        static const int iterations = 100000;
+        
+        void _runBenchmark(const char* name, std::function<void()> emit) {
+            emit(); // let JS compile the listener first
+            
+            _allocationCount = 0;
+            _countAllocations = true;
+            
+            double startTime = Platform::GetTime();
+            
+            for (int i = 0; i < iterations; i++) {
+                emit();
+            }
+            
+            double endTime = Platform::GetTime();
+            
+            _countAllocations = false;
+            
+            Logger::begin("CoreTypedEventTest", Logger::LogLevel_Log) << name << " Event::Emit x " << iterations << ": "
+                << (endTime - startTime) << "s | " << ((endTime - startTime) / iterations) * 1.0e9 << "ns/emit | "
+                << _describeAllocations(iterations, "emit") << Logger::end();
+        }
+    };
+    
+    static const Profiler::ZoneSite profilerTestOuterSite = {"CoreProfilerTest::Outer", NULL};
+    static const Profiler::ZoneSite profilerTestInnerSite = {"CoreProfilerTest::Inner", NULL};
+    static const Profiler::ZoneSite profilerTestWorkerSite = {"CoreProfilerTest::Worker", NULL};
+    
+    void* ProfilerWorker(void* args) {
+        for (int i = 0; i < 100; i++) {
+            Profiler::Scope scope(&profilerTestWorkerSite);
+        }
+        Profiler::ReleaseThread();
+        ((std::atomic<bool>*) args)->store(true);
+        return NULL;
+    }
+    
+    class CoreProfilerTest : public Test {
+    public:
+        std::string GetName() override { return "CoreProfilerTest"; }
+        
+        void Run() override {
+            std::atomic<bool> workerFinished(false);
+            
+            double oldCaptureWindow = Profiler::GetCaptureWindow();
+            Profiler::SetCaptureWindow(10.0);
+            
+            Profiler::BeginProfileFrame();
+            
+            Platform::ThreadPtr worker = Platform::CreateThread(ProfilerWorker, &workerFinished);
+            
+            for (int i = 0; i < 1000; i++) {
+                Profiler::Scope outer(&profilerTestOuterSite);
+                Profiler::Scope inner(&profilerTestInnerSite);
+                Profiler::Scope labeled(&profilerTestInnerSite, "Labeled");
+            }
+            
+            while (!workerFinished) {
+                Platform::NanoSleep(100000);
+            }
+            
+            Profiler::EndProfileFrame();
+            
+            delete worker;
+            
+            Json::Value frame = Profiler::GetLastFrame();
+            Json::Value& outer = frame["children"]["CoreProfilerTest::Outer"];
+            
+            this->Assert("Zones are counted", outer["count"].asInt() == 1000);
+            this->Assert("Zones nest", outer["children"]["CoreProfilerTest::Inner"]["count"].asInt() == 1000);
+            this->Assert("Labeled zones are interned",
+                         outer["children"]["CoreProfilerTest::Inner"]["children"]["CoreProfilerTest::Inner : Labeled"]["count"].asInt() == 1000);
+            
+            bool foundWorker = false;
+            for (auto iter = frame["children"].begin(); iter != frame["children"].end(); iter++) {
+                if ((*iter)["children"]["CoreProfilerTest::Worker"]["count"].asInt() == 100) {
+                    foundWorker = true;
+                }
+            }
+            this->Assert("Worker thread zones are recorded", foundWorker);
+            
+            if (Filesystem::HasSetUserDir()) {
+                this->_testTrace();
+            }
+            
+            this->_testThreadReuse();
+            
+            Profiler::SetCaptureWindow(oldCaptureWindow);
+            
+            this->_runBenchmark("Scope", [&]() { Profiler::Scope scope(&profilerTestOuterSite); });
+            this->_runBenchmark("Labeled Scope", [&]() { Profiler::Scope scope(&profilerTestOuterSite, "Labeled"); });
+        }
+    
+    private:
+        static const int iterations = 1000000;
+        
+        // More threads than the profiler has rings, each releases its ring as it exits
+        void _testThreadReuse() {
+            static const int threadRuns = 100;
+            
+            Profiler::BeginProfileFrame();
+            
+            for (int i = 0; i < threadRuns; i++) {
+                std::atomic<bool> workerFinished(false);
+                Platform::ThreadPtr worker = Platform::CreateThread(ProfilerWorker, &workerFinished);
+                while (!workerFinished) {
+                    Platform::NanoSleep(100000);
+                }
+                delete worker;
+            }
+            
+            Profiler::EndProfileFrame();
+            
+            Json::Value frame = Profiler::GetLastFrame();
+            int workerZones = 0;
+            for (auto iter = frame["children"].begin(); iter != frame["children"].end(); iter++) {
+                workerZones += (*iter)["children"]["CoreProfilerTest::Worker"]["count"].asInt();
+            }
+            this->Assert("Exited threads hand their ring to new threads", workerZones == threadRuns * 100);
+        }
+        
+        void _testTrace() {
+            this->Assert("Trace is written", Profiler::WriteTrace("/profilerTestTrace.json"));
+            
+            Json::Value trace;
+            Json::Reader reader;
+            this->Assert("Trace is valid JSON", reader.parse(Filesystem::GetFileContent("/profilerTestTrace.json"), trace));
+            
+            int outerCount = 0, workerCount = 0;
+            for (auto iter = trace["traceEvents"].begin(); iter != trace["traceEvents"].end(); iter++) {
+                if ((*iter)["name"].asString() == "CoreProfilerTest::Outer") outerCount++;
+                if ((*iter)["name"].asString() == "CoreProfilerTest::Worker") workerCount++;
+            }
+            this->Assert("Trace has every main thread zone", outerCount == 1000);
+            this->Assert("Trace has every worker thread zone", workerCount == 100);
+            
+            Filesystem::DeleteFile("/profilerTestTrace.json");
+        }
+        
+        void _runBenchmark(const char* name, std::function<void()> scope) {
+            Profiler::BeginProfileFrame();
+            
+            _allocationCount = 0;
+            _countAllocations = true;
+            
+            double startTime = Platform::GetTime();
+            
+            for (int i = 0; i < iterations; i++) {
+                scope();
+            }
+            
+            double endTime = Platform::GetTime();
+            
+            _countAllocations = false;
+            
+            Profiler::EndProfileFrame();
+            
+            Logger::begin("CoreProfilerTest", Logger::LogLevel_Log) << name << " x " << iterations << ": "
+                << (endTime - startTime) << "s | " << ((endTime - startTime) / iterations) * 1.0e9 << "ns/scope | "
+                << _describeAllocations(iterations, "scope") << Logger::end();
+        }
+    };
+    
     class CoreLoggerTest : public Test {
     public:
         
@@ -174,11 +584,393 @@ namespace Engine {
             
             endTime = Platform::GetTime();
             Logger::begin("CoreLoggerTest", Logger::LogLevel_Log) << "Logger::LogText Performance Test x 10: " << (endTime - startTime) << "s" << Logger::end();
+            
+            bool oldAsync = Config::GetBoolean("core.log.async");
+            bool oldConsole = Config::GetBoolean("core.log.enableConsole");
+            
+            this->_runBurst(false);
+            this->_runBurst(true);
+            
+            Config::SetBoolean("core.log.async", oldAsync);
+            Config::SetBoolean("core.log.enableConsole", oldConsole);
+        }
+        
+    private:
+        static const int burstLines = 5000;
+        
+        void _runBurst(bool async) {
+            const char* name = async ? "Async" : "Sync";
+            
+            Config::SetBoolean("core.log.async", async);
+            Config::SetBoolean("core.log.enableConsole", false); // only time the logger, not the terminal
+            
+            double startTime = Platform::GetTime();
+            
+            for (int i = 0; i < burstLines; i++) {
+                Logger::begin("CoreLoggerTest", Logger::LogLevel_Log) << name << " burst line " << i << Logger::end();
+            }
+            
+            double endTime = Platform::GetTime();
+            
+            Logger::Flush();
+            
+            double flushTime = Platform::GetTime();
+            
+            std::vector<Logger::LogEvent> lastEvents = Logger::GetRecentEvents(1);
+            std::stringstream lastLine;
+            lastLine << name << " burst line " << (burstLines - 1);
+            this->Assert("Every line reaches the history", lastEvents.size() == 1 && lastEvents[0].Event == lastLine.str());
+            
+            Config::SetBoolean("core.log.enableConsole", true);
+            
+            Logger::begin("CoreLoggerTest", Logger::LogLevel_Log) << name << " Logger::begin burst x " << burstLines << ": "
+                << (endTime - startTime) << "s on the calling thread | " << (flushTime - startTime) << "s until written" << Logger::end();
+        }
+    };
+    
+    class CoreConfigVarTest : public Test {
+    public:
+        std::string GetName() override { return "CoreConfigVarTest"; }
+        
+        void Run() override {
+            Config::SetBoolean("core.test.configVarBool", false);
+            Config::SetNumber("core.test.configVarNumber", 1.5f);
+            
+            Config::ConfigVar<bool> boolVar("core.test.configVarBool");
+            Config::ConfigVar<float> floatVar("core.test.configVarNumber");
+            Config::ConfigVar<int> intVar("core.test.configVarNumber");
+            
+            this->Assert("Handles load the current value", !boolVar && floatVar == 1.5f && intVar == 1);
+            
+            Config::SetBoolean("core.test.configVarBool", true);
+            Config::Set("core.test.configVarNumber", "4.25");
+            
+            this->Assert("Set updates handles", boolVar && floatVar == 4.25f && intVar == 4);
+            
+            floatVar.Set(8.0f);
+            
+            this->Assert("Handles set through the config store", Config::GetFloat("core.test.configVarNumber") == 8.0f && intVar == 8);
+            
+            {
+                Config::ConfigVar<bool> scopedVar("core.test.configVarBool");
+            }
+            Config::SetBoolean("core.test.configVarBool", false); // the destroyed handle must be unregistered
+            
+            this->Assert("Handles unregister when destroyed", !boolVar);
+            
+            const int iterations = 1000000;
+            
+            Config::TakeLookupCount();
+            
+            double startTime = Platform::GetTime();
+            
+            float sum = 0.0f;
+            for (int i = 0; i < iterations; i++) {
+                sum += Config::GetFloat("core.test.configVarNumber");
+            }
+            
+            double lookupTime = Platform::GetTime() - startTime;
+            
+            this->Assert("String lookups are counted", Config::TakeLookupCount() == iterations);
+            
+            startTime = Platform::GetTime();
+            
+            for (int i = 0; i < iterations; i++) {
+                sum += floatVar;
+            }
+            
+            double handleTime = Platform::GetTime() - startTime;
+            
+            this->Assert("Handle reads are not counted", Config::TakeLookupCount() == 0);
+            
+            Logger::begin("CoreConfigVarTest", Logger::LogLevel_Log) << "Config::GetFloat x " << iterations << ": " << lookupTime
+                << "s | ConfigVar<float> x " << iterations << ": " << handleTime << "s | " << sum << Logger::end();
+        }
+    };
+    
+    class CoreJobSystemTest : public Test {
+    public:
+        std::string GetName() override { return "CoreJobSystemTest"; }
+        
+        void Run() override {
+            using namespace WorkerThreadPool;
+            
+            this->Assert("Workers are running", GetWorkerCount() > 0);
+            
+            std::atomic<int> ran(0);
+            
+            {
+                JobCounter counter;
+                for (int i = 0; i < 1000; i++) {
+                    Submit([&]() { ran++; }, &counter);
+                }
+                Wait(counter);
+                this->Assert("Wait returns once every job has run", ran == 1000 && counter.IsDone());
+            }
+            
+            {
+                JobCounter first, second;
+                std::atomic<int> firstRan(0);
+                std::atomic<bool> orderKept(true);
+                
+                for (int i = 0; i < 100; i++) {
+                    Submit([&]() { Platform::NanoSleep(10000); firstRan++; }, &first);
+                }
+                for (int i = 0; i < 100; i++) {
+                    Submit([&]() { if (firstRan != 100) orderKept = false; }, &second, &first);
+                }
+                Wait(second);
+                this->Assert("Dependent jobs run after their dependency", orderKept);
+            }
+            
+            {
+                JobCounter counter;
+                std::atomic<int> nested(0);
+                for (int i = 0; i < 10; i++) {
+                    Submit([&]() {
+                        for (int x = 0; x < 10; x++) {
+                            Submit([&]() { nested++; }, &counter);
+                        }
+                    }, &counter);
+                }
+                Wait(counter);
+                this->Assert("Jobs can submit jobs", nested == 100);
+            }
+            
+            {
+                std::vector<int> values(100000, 1);
+                std::atomic<long> sum(0);
+                ParallelFor(values.size(), 0, [&](size_t begin, size_t end) {
+                    long localSum = 0;
+                    for (size_t i = begin; i < end; i++) {
+                        localSum += values[i];
+                    }
+                    sum += localSum;
+                });
+                this->Assert("ParallelFor covers the whole range once", sum == 100000);
+            }
+            
+            {
+                JobCounter work, done;
+                bool mainThread = false;
+                Submit([&]() { Platform::NanoSleep(10000); }, &work);
+                RunOnMainThread([&]() { mainThread = Platform::IsMainThread(); }, &done, &work);
+                while (!done.IsDone()) {
+                    PollMainThread();
+                }
+                this->Assert("Continuations run on the main thread", mainThread);
+            }
+            
+            {
+                JobCounter work;
+                bool otherRan = false, ownRan = false;
+                RunOnMainThread([&]() { otherRan = true; });
+                Submit([&]() { Platform::NanoSleep(10000); }, &work);
+                RunOnMainThread([&]() { ownRan = true; }, &work);
+                Wait(work);
+                this->Assert("Wait runs main thread jobs counted by it's counter", ownRan);
+                this->Assert("Wait leaves other continuations for PollMainThread", !otherRan);
+                PollMainThread();
+                this->Assert("PollMainThread runs the continuations Wait skipped", otherRan);
+            }
+            
+            this->_runThroughput();
+            this->_runLatency();
+        }
+        
+    private:
+        static const int jobCount = 100000;
+        
+        void _runThroughput() {
+            std::atomic<int> ran(0);
+            WorkerThreadPool::JobCounter counter;
+            
+            double startTime = Platform::GetTime();
+            
+            for (int i = 0; i < jobCount; i++) {
+                WorkerThreadPool::Submit([&]() { ran++; }, &counter);
+            }
+            WorkerThreadPool::Wait(counter);
+            
+            double endTime = Platform::GetTime();
+            
+            Logger::begin("CoreJobSystemTest", Logger::LogLevel_Log) << "Submit x " << jobCount << " on "
+                << WorkerThreadPool::GetWorkerCount() << " workers: " << (endTime - startTime) << "s | "
+                << (jobCount / (endTime - startTime)) << " jobs/s" << Logger::end();
+        }
+        
+        void _runLatency() {
+            double worstLatency = 0.0, totalLatency = 0.0;
+            
+            for (int i = 0; i < 100; i++) {
+                WorkerThreadPool::JobCounter counter;
+                std::atomic<double> startedAt(0.0);
+                
+                double submitTime = Platform::GetTime();
+                WorkerThreadPool::Submit([&]() { startedAt = Platform::GetTime(); }, &counter);
+                
+                // spin rather than Wait so a worker has to pick the job up
+                while (!counter.IsDone()) {
+                    std::this_thread::yield();
+                }
+                
+                double latency = startedAt - submitTime;
+                totalLatency += latency;
+                worstLatency = std::max(worstLatency, latency);
+                
+                Platform::NanoSleep(1000000); // give the workers time to go back to sleep
+            }
+            
+            Logger::begin("CoreJobSystemTest", Logger::LogLevel_Log) << "Submit to start latency: "
+                << (totalLatency / 100) * 1.0e6 << "us avg | " << worstLatency * 1.0e6 << "us worst" << Logger::end();
+        }
+    };
+    
+    class CoreVectorMathTest : public Test {
+    public:
+        std::string GetName() override { return "CoreVectorMathTest"; }
+        
+        void Run() override {
+            glm::mat4 matrix = glm::rotate(glm::translate(glm::mat4(), glm::vec3(4.0f, -2.0f, 1.0f)), 0.7f, glm::vec3(0.0f, 0.0f, 1.0f));
+            
+            std::vector<float> src(PointCount * 16), simd(PointCount * 16), scalar(PointCount * 16);
+            for (size_t i = 0; i < src.size(); i++) {
+                src[i] = (float) ((i * 7919) % 1000) / 100.0f - 5.0f;
+            }
+            src[0] = src[1] = src[2] = src[3] = 0.0f;
+            
+            for (int components = 2; components <= 4; components++) {
+                VectorMath::TransformPoints(matrix, src.data(), simd.data(), PointCount, components);
+                VectorMath::TransformPointsScalar(matrix, src.data(), scalar.data(), PointCount, components);
+                this->Assert("TransformPoints matches glm", this->_maxDifference(simd, scalar, PointCount * components) < 0.0001f);
+                
+                VectorMath::NormalizeVectors(src.data(), simd.data(), PointCount, components);
+                VectorMath::NormalizeVectorsScalar(src.data(), scalar.data(), PointCount, components);
+                this->Assert("NormalizeVectors matches glm", this->_maxDifference(simd, scalar, PointCount * components) < 0.0001f);
+                this->Assert("Zero length vectors stay zero", simd[0] == 0.0f && simd[1] == 0.0f);
+            }
+            
+            VectorMath::MultiplyMatrices(matrix, src.data(), simd.data(), PointCount);
+            VectorMath::MultiplyMatricesScalar(matrix, src.data(), scalar.data(), PointCount);
+            this->Assert("MultiplyMatrices matches glm", this->_maxDifference(simd, scalar, PointCount * 16) < 0.0001f);
+            
+            glm::vec4 point = matrix * glm::vec4(1.0f, 2.0f, 0.0f, 1.0f);
+            float in[2] = {1.0f, 2.0f}, out[2];
+            VectorMath::TransformPoints(matrix, in, out, 1, 2);
+            this->Assert("vec2 points use z = 0 and w = 1", std::abs(out[0] - point.x) < 0.0001f && std::abs(out[1] - point.y) < 0.0001f);
+            
+            double startTime = Platform::GetTime();
+            VectorMath::TransformPoints(matrix, src.data(), simd.data(), PointCount, 4);
+            double simdTime = Platform::GetTime() - startTime;
+            
+            startTime = Platform::GetTime();
+            VectorMath::TransformPointsScalar(matrix, src.data(), scalar.data(), PointCount, 4);
+            double scalarTime = Platform::GetTime() - startTime;
+            
+            Logger::begin("CoreVectorMathTest", Logger::LogLevel_Log) << "TransformPoints x " << PointCount << " vec4: "
+                << simdTime << "s | scalar: " << scalarTime << "s" << Logger::end();
+        }
+        
+    private:
+        static const int PointCount = 100000;
+        
+        float _maxDifference(const std::vector<float>& a, const std::vector<float>& b, size_t count) {
+            float difference = 0.0f;
+            for (size_t i = 0; i < count; i++) {
+                difference = std::max(difference, std::abs(a[i] - b[i]));
+            }
+            return difference;
+        }
+    };
+    
+    class CoreNoiseTest : public Test {
+    public:
+        std::string GetName() override { return "CoreNoiseTest"; }
+        
+        void Run() override {
+            Noise::NoiseGenerator noise(0.5);
+            
+            // reference values from res/lib/perlin.js with noise.seed(0.5)
+            this->Assert("Simplex2 matches perlin.js", std::abs(noise.Simplex2(0.3f, 0.7f) - 0.1362838f) < 0.0001f);
+            this->Assert("Perlin2 matches perlin.js", std::abs(noise.Perlin2(5.3f, -2.1f) - 0.1454000f) < 0.0001f);
+            this->Assert("Perlin3 matches perlin.js", std::abs(noise.Perlin3(1.3f, 2.7f, 0.4f) - 0.1388938f) < 0.0001f);
+            
+            float origin[4] = {-3.7f, 12.1f, 0.5f, -0.25f};
+            std::vector<float> grid(GridSize * GridSize), serial(GridSize * GridSize);
+            
+            Noise::NoiseType types[3] = {Noise::NoiseType::Perlin, Noise::NoiseType::Simplex, Noise::NoiseType::Value};
+            
+            for (int type = 0; type < 3; type++) {
+                Noise::NoiseSettings settings;
+                settings.Type = types[type];
+                
+                // 2D grids go through the 4 wide path, single points don't
+                noise.FillGrid(settings, grid.data(), GridSize, GridSize, origin, 0.173f);
+                float difference = 0.0f;
+                for (int y = 0; y < GridSize; y++) {
+                    for (int x = 0; x < GridSize; x++) {
+                        float expected = this->_basis2(noise, settings.Type, origin[0] + x * 0.173f, origin[1] + y * 0.173f);
+                        difference = std::max(difference, std::abs(grid[y * GridSize + x] - expected));
+                    }
+                }
+                this->Assert("Bulk 2D noise matches single points", difference < 0.0001f);
+                
+                for (int dimensions = 2; dimensions <= 4; dimensions++) {
+                    for (int fractal = 0; fractal < 3; fractal++) {
+                        settings.Dimensions = dimensions;
+                        settings.Fractal = (Noise::FractalType) fractal;
+                        settings.Parallel = true;
+                        noise.FillGrid(settings, grid.data(), GridSize, GridSize, origin, 0.173f);
+                        settings.Parallel = false;
+                        noise.FillGrid(settings, serial.data(), GridSize, GridSize, origin, 0.173f);
+                        
+                        this->Assert("Parallel fill matches serial fill", grid == serial);
+                        this->Assert("Noise stays between -1 and 1", std::all_of(grid.begin(), grid.end(), [](float value) {
+                            return value >= -1.0001f && value <= 1.0001f;
+                        }));
+                    }
+                }
+            }
+            
+            Noise::NoiseSettings settings;
+            settings.Fractal = Noise::FractalType::FBm;
+            settings.Parallel = false;
+            
+            double startTime = Platform::GetTime();
+            noise.FillGrid(settings, grid.data(), GridSize, GridSize, origin, 0.01f);
+            double serialTime = Platform::GetTime() - startTime;
+            
+            settings.Parallel = true;
+            startTime = Platform::GetTime();
+            noise.FillGrid(settings, grid.data(), GridSize, GridSize, origin, 0.01f);
+            double parallelTime = Platform::GetTime() - startTime;
+            
+            Logger::begin("CoreNoiseTest", Logger::LogLevel_Log) << "FillGrid " << GridSize << "x" << GridSize << " simplex2 fBm x "
+                << settings.Octaves << ": " << parallelTime << "s | serial: " << serialTime << "s" << Logger::end();
+        }
+        
+    private:
+        static const int GridSize = 256;
+        
+        float _basis2(Noise::NoiseGenerator& noise, Noise::NoiseType type, float x, float y) {
+            switch (type) {
+                case Noise::NoiseType::Perlin: return noise.Perlin2(x, y);
+                case Noise::NoiseType::Simplex: return noise.Simplex2(x, y);
+                case Noise::NoiseType::Value: return noise.Value2(x, y);
+            }
+            return 0.0f;
         }
     };
     
     void LoadCoreTests() {
         TestSuite::RegisterTest(new CoreEventTest());
+        TestSuite::RegisterTest(new CoreEventQueueTest());
+        TestSuite::RegisterTest(new CoreTypedEventTest());
+        TestSuite::RegisterTest(new CoreProfilerTest());
         TestSuite::RegisterTest(new CoreLoggerTest());
+        TestSuite::RegisterTest(new CoreConfigVarTest());
+        TestSuite::RegisterTest(new CoreJobSystemTest());
+        TestSuite::RegisterTest(new CoreVectorMathTest());
+        TestSuite::RegisterTest(new CoreNoiseTest());
     }
 }
\ No newline at end of file
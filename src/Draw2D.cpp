@@ -21,11 +21,20 @@
 
 #include "Draw2D.hpp"
 
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+
 #include "RenderDriver.hpp"
 
+#include "Config.hpp"
 #include "Profiler.hpp"
 
 namespace Engine {
+    Draw2D::Draw2D(RenderDriverPtr renderGL) : renderGL(renderGL) {
+        this->_tessellator.SetMaxError(Config::GetFloat("core.render.tessellationError"));
+    }
+    
     void Draw2D::Rect(float x, float y, float w, float h) {
         ENGINE_PROFILER_SCOPE;
         renderGL->BeginRendering(PolygonMode::Triangles);
@@ -103,6 +112,82 @@ namespace Engine {
         this->DrawImage(s.tex, x, y, w, h, s.loc.x, s.loc.y, s.loc.w, s.loc.h);
     }
     
+    void Draw2D::DrawSprites(TexturePtr tex, const SpriteInstance* sprites, size_t count) {
+        ENGINE_PROFILER_SCOPE;
+        renderGL->DrawSprites(tex, sprites, count);
+    }
+    
+    void Draw2D::Rects(const float* rects, size_t count, const unsigned char* colors) {
+        ENGINE_PROFILER_SCOPE;
+        
+        SpriteInstance defaultSprite;
+        defaultSprite.SetColor(renderGL->GetColor());
+        
+        this->_sprites.resize(count);
+        
+        for (size_t i = 0; i < count; i++) {
+            const float* rect = &rects[i * 4];
+            SpriteInstance& sprite = this->_sprites[i];
+            sprite.rect = glm::vec4(rect[0], rect[1], rect[2], rect[3]);
+            sprite.uv = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f);
+            sprite.rotation = 0.0f;
+            std::memcpy(sprite.col, colors != NULL ? &colors[i * 4] : defaultSprite.col, 4);
+        }
+        
+        renderGL->DrawSprites(NULL, this->_sprites.data(), count);
+    }
+    
+    void Draw2D::Sprites(SpriteSheetPtr sheet, const std::vector<std::string>& names, const float* sprites, size_t count, const unsigned char* colors) {
+        ENGINE_PROFILER_SCOPE;
+        
+        if (names.empty()) return;
+        
+        // Each name is looked up once so animations advance once per call like DrawSprite
+        std::vector<glm::vec4> uvs;
+        TexturePtr tex = NULL;
+        for (auto iter = names.begin(); iter != names.end(); iter++) {
+            Sprite s = sheet->GetSprite(*iter);
+            float width = s.tex->GetWidth(), height = s.tex->GetHeight();
+            uvs.push_back(glm::vec4(s.loc.x / width, s.loc.y / height, (s.loc.x + s.loc.w) / width, (s.loc.y + s.loc.h) / height));
+            tex = s.tex;
+        }
+        
+        SpriteInstance defaultSprite;
+        defaultSprite.SetColor(renderGL->GetColor());
+        
+        this->_sprites.resize(count);
+        
+        size_t drawn = 0;
+        
+        for (size_t i = 0; i < count; i++) {
+            const float* record = &sprites[i * 5];
+            
+            // NaN and infinity can't be converted to an index
+            if (!std::isfinite(record[4])) {
+                continue;
+            }
+            
+            SpriteInstance& sprite = this->_sprites[drawn++];
+            size_t index = (size_t) glm::clamp(record[4], 0.0f, (float) (uvs.size() - 1));
+            sprite.rect = glm::vec4(record[0], record[1], record[2], record[3]);
+            sprite.uv = uvs[index];
+            sprite.rotation = 0.0f;
+            std::memcpy(sprite.col, colors != NULL ? &colors[i * 4] : defaultSprite.col, 4);
+        }
+        
+        renderGL->DrawSprites(tex, this->_sprites.data(), drawn);
+    }
+    
+    void Draw2D::LineSegments(const float* lines, size_t count) {
+        ENGINE_PROFILER_SCOPE;
+        renderGL->BeginRendering(PolygonMode::Lines);
+        for (size_t i = 0; i < count * 4; i += 4) {
+            renderGL->AddVert(lines[i], lines[i + 1], 0);
+            renderGL->AddVert(lines[i + 2], lines[i + 3], 0);
+        }
+        renderGL->EndRendering();
+    }
+    
     void Draw2D::Grad(float x, float y, float w, float h, int col1, int col2, bool vert) {
         ENGINE_PROFILER_SCOPE;
         if (col1 > 256 * 256 * 256 || col2 > 256 * 256 * 256) {
@@ -162,11 +247,11 @@ namespace Engine {
     }
     
     void Draw2D::Circle(float xCenter, float yCenter, float radius) {
-        this->Circle(xCenter, yCenter, radius, radius * 5, 0.0f, 1.0f, true);
+        this->Circle(xCenter, yCenter, radius, 0, 0.0f, 1.0f, true);
     }
     
     void Draw2D::Circle(float xCenter, float yCenter, float radius, bool fill) {
-        this->Circle(xCenter, yCenter, radius, radius * 5, 0.0f, 1.0f, fill);
+        this->Circle(xCenter, yCenter, radius, 0, 0.0f, 1.0f, fill);
     }
     
     void Draw2D::Circle(float xCenter, float yCenter, float radius, int segments, bool fill) {
@@ -179,87 +264,42 @@ namespace Engine {
     
     void Draw2D::Circle(float xCenter, float yCenter, float radius, float innerRadius, int segments, float start, float end, bool fill) {
         ENGINE_PROFILER_SCOPE;
-        bool usingGl3 = renderGL->GetRendererType() == RendererType::OpenGL3;
-        static double pi2 = 2 * 3.14159265358979323846;
-        float rStart = pi2 * start;
-        float rEnd = pi2 * end;
-        float res = pi2 / segments;
-        if (usingGl3) {
-            renderGL->TrackStat(RenderStatistic::UserFlush, 1);
-            renderGL->FlushAll();
+        
+        if (segments <= 0) {
+            segments = this->_tessellator.GetCircleSegments(radius, renderGL->GetCameraScale());
         }
-        renderGL->BeginRendering(fill ? (innerRadius != radius ? PolygonMode::TriangleStrip // doughnut
-                               : PolygonMode::TriangleFan) // filled circle
-                       : (end == 1.0f ? PolygonMode::LineLoop // circle outline
-                          : PolygonMode::LineStrip // circle outline segment
-                          ));
+        
+        // Everything is emitted as plain triangles or lines so circles append to the current primitive
         if (fill) {
-            if (innerRadius == radius) {
-                renderGL->AddVert(xCenter, yCenter, 0.0f);
-            } else {
-                renderGL->AddVert(xCenter + radius * glm::cos(rStart), yCenter + radius * glm::sin(rStart), 0.0f);
-                renderGL->AddVert(xCenter + innerRadius * glm::cos(rStart), yCenter + innerRadius * glm::sin(rStart), 0.0f);
-            }
-        }
-        for (float i = rStart; i < rEnd; i += res) {
-                renderGL->AddVert(xCenter + radius * glm::cos(i), yCenter + radius * glm::sin(i), 0.0f);
-            if (innerRadius != radius && fill)
-                renderGL->AddVert(xCenter + innerRadius * glm::cos(i), yCenter + innerRadius * glm::sin(i), 0.0f);
-        }
-        if (fill && end == 1.0f && start == 0.0f) {
-            if (innerRadius == radius) {
-                renderGL->AddVert(xCenter + radius * glm::cos(rStart), yCenter + radius * glm::sin(rStart), 0.0f);
-            } else {
-                renderGL->AddVert(xCenter + radius * glm::cos(rStart), yCenter + radius * glm::sin(rStart), 0.0f);
-                renderGL->AddVert(xCenter + innerRadius * glm::cos(rStart), yCenter + innerRadius * glm::sin(rStart), 0.0f);
-            }
-        }
-        renderGL->EndRendering();
-        if (usingGl3) {
-            renderGL->TrackStat(RenderStatistic::UserFlush, 1);
-            renderGL->FlushAll();
+            this->_tessellator.Circle(glm::vec2(xCenter, yCenter), radius, innerRadius != radius ? innerRadius : 0.0f, segments, start, end);
+            this->_drawTessellated(PolygonMode::Triangles);
+        } else {
+            this->_tessellator.CircleOutline(glm::vec2(xCenter, yCenter), radius, segments, start, end);
+            this->_drawTessellated(PolygonMode::Lines);
         }
     }
     
     // points are in the format [x, y, x, y]
     void Draw2D::Polygon(float xCenter, float yCenter, float* points, int pointCount) {
-        renderGL->BeginRendering(PolygonMode::TriangleFan);
-        
-        renderGL->AddVert(xCenter, yCenter, 0.0f);
+        ENGINE_PROFILER_SCOPE;
         
+        this->_polygon.clear();
         for (int i = 0; i < pointCount; i++) {
-            renderGL->AddVert(xCenter + points[i * 2 + 0],
-                              yCenter + points[i * 2 + 1],
-                              0.0f);
+            this->_polygon.push_back(glm::vec2(xCenter + points[i * 2 + 0], yCenter + points[i * 2 + 1]));
         }
         
-        renderGL->EndRendering();
-        
-        if (renderGL->GetRendererType() == RendererType::OpenGL3) {
-            renderGL->TrackStat(RenderStatistic::UserFlush, 1);
-            renderGL->FlushAll();
+        if (this->_tessellator.Polygon(this->_polygon.data(), this->_polygon.size())) {
+            this->_drawTessellated(PolygonMode::Triangles);
         }
     }
     
-    // from http://devmag.org.za/2011/04/05/bzier-curves-a-tutorial/
-    inline glm::vec2 _calculateBezierPoint(float t, const glm::vec2 &p0, const glm::vec2 &p1, const glm::vec2 &p2, const glm::vec2 &p3) {
-        const float u = 1.0f - t;
-        
-        return ((u * u * u) * p0) +        //first term
-                (3 * (u * u) * t * p1) +   //second term
-                (3 * u * (t * t) * p2) +   //third term
-                ((t * t * t) * p3);        //fourth term
-    }
-    
     void Draw2D::BezierCurve(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4) {
         glm::vec2 vec1 = glm::vec2(x1, y1);
         glm::vec2 vec2 = glm::vec2(x2, y2);
         glm::vec2 vec3 = glm::vec2(x3, y3);
         glm::vec2 vec4 = glm::vec2(x4, y4);
         
-        float totalDistince = glm::distance(vec1, vec2) + glm::distance(vec2, vec3) + glm::distance(vec3, vec4);
-        
-        this->BezierCurve(vec1, vec2, vec3, vec4, glm::floor(totalDistince / 25));
+        this->BezierCurve(vec1, vec2, vec3, vec4, this->_tessellator.GetBezierSegments(vec1, vec2, vec3, vec4, renderGL->GetCameraScale()));
     }
     
     void Draw2D::BezierCurve(float x1, float y1, float x2, float y2, float x3, float y3, float x4, float y4, int segments) {
@@ -275,19 +315,22 @@ namespace Engine {
                              const glm::vec2 &vec3, const glm::vec2 &vec4,
                              int segments) {
         ENGINE_PROFILER_SCOPE;
-        glm::vec2 q0 = _calculateBezierPoint(0, vec1, vec2, vec3, vec4);
-        glm::vec2 q1;
-        
-        renderGL->BeginRendering(PolygonMode::Lines);
+        this->_tessellator.BezierCurve(vec1, vec2, vec3, vec4, segments);
+        this->_drawTessellated(PolygonMode::Lines);
+    }
+    
+    void Draw2D::_drawTessellated(PolygonMode mode) {
+        std::vector<glm::vec2>& points = this->_tessellator.GetPoints();
+        std::vector<unsigned int>& indices = this->_tessellator.GetIndices();
         
-        for (int i = 1; i <= segments; i++) {
-            q1 = _calculateBezierPoint((1 / (float) segments) * i
-                                       , vec1, vec2, vec3, vec4);
-            renderGL->AddVert(q0.x, q0.y, 0.0);
-            renderGL->AddVert(q1.x, q1.y, 0.0);
-            q0 = q1;
+        if (!indices.empty()) {
+            renderGL->BeginRendering(mode);
+            for (auto iter = indices.begin(); iter != indices.end(); iter++) {
+                renderGL->AddVert(points[*iter].x, points[*iter].y, 0.0f);
+            }
+            renderGL->EndRendering();
         }
         
-        renderGL->EndRendering();
+        this->_tessellator.Clear();
     }
 }
\ No newline at end of file
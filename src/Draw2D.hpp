@@ -28,6 +28,7 @@
 #include "vendor/glm/gtc/matrix_transform.hpp"
 
 #include "SpriteSheet.hpp"
+#include "Tessellator.hpp"
 
 #define BUFFER_SIZE 4096
 
@@ -38,7 +39,7 @@ namespace Engine {
     
     class Draw2D {
     public:
-        Draw2D(RenderDriverPtr renderGL) : renderGL(renderGL) {}
+        Draw2D(RenderDriverPtr renderGL);
         
         RenderDriverPtr GetRender() {
             return renderGL;
@@ -52,12 +53,26 @@ namespace Engine {
         void DrawImage(TexturePtr tex, float x1, float y1, float w1, float h1, float x2, float y2, float w2, float h2);
         void DrawSprite(SpriteSheetPtr sheet, std::string sprite, float x, float y, float w, float h);
         
+        // Every sprite shares tex so the whole array can be one instanced draw, tex can be NULL
+        void DrawSprites(TexturePtr tex, const SpriteInstance* sprites, size_t count);
+        
+        // Batch versions of the calls above for packed arrays. colors holds RGBA bytes for each
+        // record, the current color is used when it's NULL.
+        
+        // 4 floats per rect: x, y, w, h
+        void Rects(const float* rects, size_t count, const unsigned char* colors);
+        // 5 floats per sprite: x, y, w, h, index into names
+        void Sprites(SpriteSheetPtr sheet, const std::vector<std::string>& names, const float* sprites, size_t count, const unsigned char* colors);
+        // 4 floats per line: x1, y1, x2, y2
+        void LineSegments(const float* lines, size_t count);
+        
         void Grad(float x, float y, float w, float h, int col1, int col2, bool vert);
         
         void Line(float x1, float y1, float x2, float y2);
         void Lines(double* points, unsigned int count);
         void LineGraph(float xOff, float yOff, float xScale, float yScale, double* points, unsigned int count);
         
+        // Circles and curves without a segment count (or with one of 0) pick one from core.render.tessellationError
         void Circle(float xCenter, float yCenter, float radius);
         void Circle(float xCenter, float yCenter, float radius, bool fill);
         void Circle(float xCenter, float yCenter, float radius, int segments, bool fill);
@@ -73,6 +88,12 @@ namespace Engine {
                          const glm::vec2 &vec3, const glm::vec2 &vec4,
                          int segments);
     private:
+        void _drawTessellated(PolygonMode mode);
+        
         RenderDriverPtr renderGL;
+        
+        Tessellator _tessellator;
+        std::vector<glm::vec2> _polygon;
+        std::vector<SpriteInstance> _sprites;
     };
 }
\ No newline at end of file
@@ -82,7 +82,12 @@ namespace Engine {
     }
     
     void EngineUI::Draw() {
-        if (!Config::GetBoolean("core.debug.engineUI")) {
+        static Config::ConfigVar<bool> engineUI("core.debug.engineUI");
+        static Config::ConfigVar<bool> showVerboseLog("core.debug.engineUI.showVerboseLog");
+        static Config::ConfigVar<bool> profiler("core.debug.profiler");
+        static Config::ConfigVar<float> profilerScale("core.debug.engineUI.profilerScale");
+        
+        if (!engineUI) {
             return;
         }
         
@@ -131,13 +136,13 @@ namespace Engine {
             }
         } else {
             if (this->_currentView == CurrentView::Console) {
-                std::vector<Logger::LogEvent>* logEvents = Logger::GetEvents();
+                std::vector<Logger::LogEvent> logEvents = Logger::GetRecentEvents(windowSize.y / 6); // enough to fill the screen with hidden verbose lines
                 
-                bool showVerbose = Config::GetBoolean("core.debug.engineUI.showVerboseLog"); // pretty cheap
+                bool showVerbose = showVerboseLog;
                 
                 int i = windowSize.y - 40;
                 
-                for (auto iterator = logEvents->rbegin(); iterator < logEvents->rend(); iterator++) {
+                for (auto iterator = logEvents.begin(); iterator != logEvents.end(); iterator++) {
                     if (iterator->Hidden) {
                         continue; // don't show it if it's hidden
                     }
@@ -367,7 +372,7 @@ namespace Engine {
             renderGL->Print(250, 24, "Profiler (F3)");
         }
         
-        if (Config::GetBoolean("core.debug.profiler")) {
+        if (profiler) {
             double drawTime = FramePerfMonitor::GetDrawTime();
             this->_lastHeapUsages[this->_currentLastDrawTimePos] = _getHeapUsage();
             this->_lastFrameTimes[this->_currentLastDrawTimePos] = FramePerfMonitor::GetFrameTime();
@@ -381,7 +386,7 @@ namespace Engine {
             
             renderGL->SetLineWidth(0.1);
             
-            double lineGraphScale = Config::GetFloat("core.debug.engineUI.profilerScale");
+            double lineGraphScale = profilerScale;
             
             this->_draw->LineGraph(windowSize.x - 670, 14, 0.2, lineGraphScale, this->_lastDrawTimes, timingResolution);
             
@@ -392,6 +397,9 @@ namespace Engine {
             this->_ss.str("");
             this->_ss << "Draws: " << renderGL->GetStatistic(RenderStatistic::DrawCall) << "/" << renderGL->GetStatistic(RenderStatistic::CameraFlush) << "/" << renderGL->GetStatistic(RenderStatistic::TextureFlush) << "/" << renderGL->GetStatistic(RenderStatistic::EndRenderFlush) << "/" << renderGL->GetStatistic(RenderStatistic::UserFlush) << "/" << renderGL->GetStatistic(RenderStatistic::PrimitiveFlush) << "/" << renderGL->GetStatistic(RenderStatistic::PrimitiveEnd);
             this->_ss << " | Verts: " << renderGL->GetStatistic(RenderStatistic::Verts);
+            this->_ss << " | Upload: " << renderGL->GetStatistic(RenderStatistic::BufferUpload) / 1024 << "kb/" << renderGL->GetStatistic(RenderStatistic::BufferAlloc);
+            this->_ss << " | Uniforms: " << renderGL->GetStatistic(RenderStatistic::UniformUpload) << "/" << renderGL->GetStatistic(RenderStatistic::CameraUpdate);
+            this->_ss << " | GLErr: " << renderGL->GetStatistic(RenderStatistic::ErrorCheck);
         
             renderGL->Print(windowSize.x - 450, 4, this->_ss.str().c_str());
             
@@ -486,7 +494,9 @@ namespace Engine {
     }
 
     void EngineUI::OnKeyPress(int key, int press, bool shift) {
-        if (!Config::GetBoolean("core.debug.engineUI")) {
+        static Config::ConfigVar<bool> engineUI("core.debug.engineUI");
+        
+        if (!engineUI) {
             return;
         }
         
@@ -610,12 +620,12 @@ namespace Engine {
         return EM_OK;
     }
     
-    EventMagic EngineUI::_createToast(Json::Value args, void* userPointer) {
+    EventMagic EngineUI::_createToast(const LogMessageEvent& e, void* userPointer) {
         EngineUIPtr eui = static_cast<EngineUIPtr>(userPointer);
         
-        if (!args["isToast"].asBool()) return EM_OK;
+        if (!e.isToast) return EM_OK;
         
-        eui->_pushToast(args["domain"].asString(), args["str"].asString());
+        eui->_pushToast(e.domain, e.str);
         
         return EM_OK;
     }
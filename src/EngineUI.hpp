@@ -23,6 +23,7 @@
 
 #include "Application.hpp"
 #include "Draw2D.hpp"
+#include "EventPayloads.hpp"
 
 namespace Engine {
     ENGINE_CLASS(Application);
@@ -91,6 +92,6 @@ namespace Engine {
         
         static EventMagic _profilerHook(Json::Value args, void* userPointer);
         static EventMagic _captureLastDrawTimes(Json::Value args, void* userPointer);
-        static EventMagic _createToast(Json::Value args, void* userPointer);
+        static EventMagic _createToast(const LogMessageEvent& e, void* userPointer);
     };
 }
\ No newline at end of file
@@ -0,0 +1,64 @@
+/*
+   Filename: EventPayloads.cpp
+   Purpose:  Typed payloads for high frequency engine events
+
+   Part of Engine2D
+
+   Copyright (C) 2014 Vbitz
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "EventPayloads.hpp"
+
+namespace Engine {
+    EventSchemaPtr InputEvent::GetSchema() {
+        static EventSchema schema("InputEvent", {
+            ENGINE_EVENT_FIELD(InputEvent, rawKey, Int),
+            ENGINE_EVENT_FIELD(InputEvent, key, String),
+            ENGINE_EVENT_FIELD(InputEvent, rawPress, Int),
+            ENGINE_EVENT_FIELD(InputEvent, state, String),
+            ENGINE_EVENT_FIELD(InputEvent, shift, Bool)
+        });
+        return &schema;
+    }
+    
+    EventSchemaPtr MouseButtonEvent::GetSchema() {
+        static EventSchema schema("MouseButtonEvent", {
+            ENGINE_EVENT_FIELD(MouseButtonEvent, button, String),
+            ENGINE_EVENT_FIELD(MouseButtonEvent, action, String),
+            ENGINE_EVENT_FIELD(MouseButtonEvent, rawMods, Int),
+            ENGINE_EVENT_FIELD(MouseButtonEvent, x, Double),
+            ENGINE_EVENT_FIELD(MouseButtonEvent, y, Double)
+        });
+        return &schema;
+    }
+    
+    EventSchemaPtr ResizeEvent::GetSchema() {
+        static EventSchema schema("ResizeEvent", {
+            ENGINE_EVENT_FIELD(ResizeEvent, width, Int),
+            ENGINE_EVENT_FIELD(ResizeEvent, height, Int)
+        });
+        return &schema;
+    }
+    
+    EventSchemaPtr LogMessageEvent::GetSchema() {
+        static EventSchema schema("LogMessageEvent", {
+            ENGINE_EVENT_FIELD(LogMessageEvent, domain, String),
+            ENGINE_EVENT_FIELD(LogMessageEvent, level, String),
+            ENGINE_EVENT_FIELD(LogMessageEvent, str, String),
+            ENGINE_EVENT_FIELD(LogMessageEvent, isToast, Bool)
+        });
+        return &schema;
+    }
+}
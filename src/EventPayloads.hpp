@@ -0,0 +1,68 @@
+/*
+   Filename: EventPayloads.hpp
+   Purpose:  Typed payloads for high frequency engine events
+
+   Part of Engine2D
+
+   Copyright (C) 2014 Vbitz
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+
+#include "Events.hpp"
+
+namespace Engine {
+    // Field names match the Json objects these events used to carry so scripts see the same properties
+    
+    // rawInput, input and key_*
+    struct InputEvent {
+        int rawKey;
+        const char* key;
+        int rawPress;
+        const char* state;
+        bool shift;
+        
+        static EventSchemaPtr GetSchema();
+    };
+    
+    // mouseButton
+    struct MouseButtonEvent {
+        const char* button;
+        const char* action;
+        int rawMods;
+        double x;
+        double y;
+        
+        static EventSchemaPtr GetSchema();
+    };
+    
+    // rawResize
+    struct ResizeEvent {
+        int width;
+        int height;
+        
+        static EventSchemaPtr GetSchema();
+    };
+    
+    // logEvent
+    struct LogMessageEvent {
+        const char* domain;
+        const char* level;
+        const char* str;
+        bool isToast;
+        
+        static EventSchemaPtr GetSchema();
+    };
+}
@@ -0,0 +1,243 @@
+/*
+   Filename: EventQueue.cpp
+   Purpose:  Bounded multi-producer queue for events emitted from worker threads
+
+   Part of Engine2D
+
+   Copyright (C) 2014 Vbitz
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#include "EventQueue.hpp"
+
+#include <cassert>
+#include <cstdint>
+#include <functional>
+#include <thread>
+
+#include "Events.hpp"
+#include "Platform.hpp"
+
+namespace Engine {
+    EventQueue::EventQueue(size_t capacity) {
+        size_t size = 2;
+        while (size < capacity) size *= 2;
+        
+        this->_cells = new Cell[size];
+        this->_mask = size - 1;
+        
+        for (size_t i = 0; i < size; i++) {
+            this->_cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        
+        this->_enqueuePos.store(0, std::memory_order_relaxed);
+        this->_dequeuePos.store(0, std::memory_order_relaxed);
+        this->_coalescePending.store(0, std::memory_order_relaxed);
+        
+        for (size_t i = 0; i < CoalesceSlotCount; i++) {
+            this->_coalesceSlots[i].lock.clear();
+            this->_coalesceSlots[i].pending.store(false, std::memory_order_relaxed);
+        }
+    }
+    
+    EventQueue::~EventQueue() {
+        delete [] this->_cells;
+    }
+    
+    bool EventQueue::Push(EventQueueMessage& msg, EventQueuePolicy policy, std::string coalesceKey) {
+        assert(msg.Target != NULL);
+        
+        EventQueueStats& stats = msg.Target->GetQueueStats();
+        
+        msg.EnqueueTime = Platform::GetTime();
+        
+        if (policy == EventQueuePolicy::Coalesce && this->_pushCoalesced(msg, coalesceKey)) {
+            return true;
+        }
+        
+        // counted before the push so the consumer never sees the depth go below zero
+        stats.Depth++;
+        stats.Enqueued++;
+        
+        switch (policy) {
+            case EventQueuePolicy::Coalesce: // another key holds the slot, queue it normally and drop the oldest if needed
+            case EventQueuePolicy::DropOldest:
+                while (!this->_tryPush(msg)) {
+                    EventQueueMessage dropped;
+                    if (this->_tryPop(dropped)) {
+                        dropped.Target->GetQueueStats().Depth--;
+                        dropped.Target->GetQueueStats().Dropped++;
+                    }
+                }
+                break;
+            case EventQueuePolicy::Block:
+                for (int spins = 0; !this->_tryPush(msg); spins++) {
+                    if (spins < 64) {
+                        std::this_thread::yield();
+                    } else {
+                        Platform::NanoSleep(100000);
+                    }
+                }
+                break;
+        }
+        
+        return true;
+    }
+    
+    bool EventQueue::Pop(EventQueueMessage& msg) {
+        if (this->_coalescePending.load(std::memory_order_acquire) > 0 && this->_popCoalesced(msg)) {
+            return true;
+        }
+        
+        if (this->_tryPop(msg)) {
+            msg.Target->GetQueueStats().Depth--;
+            return true;
+        }
+        
+        return false;
+    }
+    
+    size_t EventQueue::GetCapacity() {
+        return this->_mask + 1;
+    }
+    
+    size_t EventQueue::GetDepth() {
+        size_t enqueuePos = this->_enqueuePos.load(std::memory_order_relaxed);
+        size_t dequeuePos = this->_dequeuePos.load(std::memory_order_relaxed);
+        return (enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0) + this->_coalescePending.load(std::memory_order_relaxed);
+    }
+    
+    bool EventQueue::_tryPush(EventQueueMessage& msg) {
+        Cell* cell;
+        size_t pos = this->_enqueuePos.load(std::memory_order_relaxed);
+        
+        while (true) {
+            cell = &this->_cells[pos & this->_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) pos;
+            if (diff == 0) {
+                if (this->_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // full
+            } else {
+                pos = this->_enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        
+        cell->message.Target = msg.Target;
+        cell->message.EnqueueTime = msg.EnqueueTime;
+        cell->message.Args.swap(msg.Args);
+        
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        
+        return true;
+    }
+    
+    bool EventQueue::_tryPop(EventQueueMessage& msg) {
+        Cell* cell;
+        size_t pos = this->_dequeuePos.load(std::memory_order_relaxed);
+        
+        while (true) {
+            cell = &this->_cells[pos & this->_mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t) seq - (intptr_t) (pos + 1);
+            if (diff == 0) {
+                if (this->_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                return false; // empty
+            } else {
+                pos = this->_dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        
+        msg.Target = cell->message.Target;
+        msg.EnqueueTime = cell->message.EnqueueTime;
+        msg.Args = Json::nullValue;
+        msg.Args.swap(cell->message.Args); // leaves the cell holding null
+        
+        cell->sequence.store(pos + this->_mask + 1, std::memory_order_release);
+        
+        return true;
+    }
+    
+    bool EventQueue::_pushCoalesced(EventQueueMessage& msg, std::string& key) {
+        size_t index = (std::hash<std::string>()(key) ^ std::hash<void*>()(msg.Target)) % CoalesceSlotCount;
+        CoalesceSlot& slot = this->_coalesceSlots[index];
+        
+        while (slot.lock.test_and_set(std::memory_order_acquire)) {
+            std::this_thread::yield();
+        }
+        
+        if (slot.pending.load(std::memory_order_relaxed)) {
+            if (slot.message.Target != msg.Target || slot.key != key) {
+                slot.lock.clear(std::memory_order_release);
+                return false;
+            }
+            
+            // keep the original enqueue time so latency covers the whole time the event was waiting
+            slot.message.Args.swap(msg.Args);
+            msg.Target->GetQueueStats().Coalesced++;
+            
+            slot.lock.clear(std::memory_order_release);
+            return true;
+        }
+        
+        slot.key = key;
+        slot.message.Target = msg.Target;
+        slot.message.EnqueueTime = msg.EnqueueTime;
+        slot.message.Args.swap(msg.Args);
+        slot.pending.store(true, std::memory_order_relaxed);
+        msg.Target->GetQueueStats().Depth++;
+        msg.Target->GetQueueStats().Enqueued++;
+        this->_coalescePending++;
+        
+        slot.lock.clear(std::memory_order_release);
+        return true;
+    }
+    
+    bool EventQueue::_popCoalesced(EventQueueMessage& msg) {
+        for (size_t i = 0; i < CoalesceSlotCount; i++) {
+            CoalesceSlot& slot = this->_coalesceSlots[i];
+            
+            if (!slot.pending.load(std::memory_order_relaxed)) continue;
+            
+            while (slot.lock.test_and_set(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            
+            if (!slot.pending.load(std::memory_order_relaxed)) {
+                slot.lock.clear(std::memory_order_release);
+                continue;
+            }
+            
+            msg.Target = slot.message.Target;
+            msg.EnqueueTime = slot.message.EnqueueTime;
+            msg.Args = Json::nullValue;
+            msg.Args.swap(slot.message.Args);
+            slot.pending.store(false, std::memory_order_relaxed);
+            this->_coalescePending--;
+            
+            slot.lock.clear(std::memory_order_release);
+            
+            msg.Target->GetQueueStats().Depth--;
+            return true;
+        }
+        
+        return false;
+    }
+}
@@ -0,0 +1,112 @@
+/*
+   Filename: EventQueue.hpp
+   Purpose:  Bounded multi-producer queue for events emitted from worker threads
+
+   Part of Engine2D
+
+   Copyright (C) 2014 Vbitz
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "vendor/json/json.h"
+
+#include "stdlib.hpp"
+
+namespace Engine {
+    ENGINE_CLASS(EventClass);
+    
+    // What a producer does when the queue is full
+    enum class EventQueuePolicy {
+        DropOldest,     // the oldest queued message is discarded to make room
+        Block,          // the producer waits for the main thread to drain the queue
+        Coalesce        // only the newest message for each event and key is kept
+    };
+    
+    struct EventQueueStats {
+        EventQueueStats() : Depth(0), Enqueued(0), Dropped(0), Coalesced(0) {}
+        
+        // Updated by producers
+        std::atomic<size_t> Depth;
+        std::atomic<size_t> Enqueued;
+        std::atomic<size_t> Dropped;
+        std::atomic<size_t> Coalesced;
+        
+        // Updated by the main thread when messages are delivered
+        size_t Delivered = 0;
+        double MaxLatency = 0.0;
+    };
+    
+    struct EventQueueMessage {
+        EventClassPtr Target = NULL;
+        Json::Value Args;
+        double EnqueueTime = 0.0;
+    };
+    
+    ENGINE_CLASS(EventQueue);
+    
+    // Based on Dmitry Vyukov's bounded MPMC queue. Producers pop as well to make room for
+    // DropOldest so both ends are safe to share, the main thread is the normal consumer.
+    class EventQueue {
+    public:
+        EventQueue(size_t capacity);
+        ~EventQueue();
+        
+        // Can be called from any thread, Args is moved out of msg
+        bool Push(EventQueueMessage& msg, EventQueuePolicy policy, std::string coalesceKey = "");
+        
+        // Coalesced messages live outside the ring and are popped first
+        bool Pop(EventQueueMessage& msg);
+        
+        size_t GetCapacity();
+        size_t GetDepth();
+    
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence;
+            EventQueueMessage message;
+        };
+        
+        struct CoalesceSlot {
+            std::atomic_flag lock;
+            std::atomic<bool> pending;
+            std::string key;
+            EventQueueMessage message;
+        };
+        
+        static const size_t CoalesceSlotCount = 64;
+        
+        bool _tryPush(EventQueueMessage& msg);
+        bool _tryPop(EventQueueMessage& msg);
+        bool _pushCoalesced(EventQueueMessage& msg, std::string& key);
+        bool _popCoalesced(EventQueueMessage& msg);
+        
+        Cell* _cells;
+        size_t _mask;
+        
+        // Keep the producer and consumer positions on their own cache lines
+        char _pad0[64];
+        std::atomic<size_t> _enqueuePos;
+        char _pad1[64];
+        std::atomic<size_t> _dequeuePos;
+        char _pad2[64];
+        
+        std::atomic<size_t> _coalescePending;
+        CoalesceSlot _coalesceSlots[CoalesceSlotCount];
+    };
+}
@@ -24,13 +24,125 @@
 #include <vector>
 #include <unordered_map>
 #include <queue>
+#include <algorithm>
 
 #include "Logger.hpp"
 #include "Platform.hpp"
 #include "Profiler.hpp"
+#include "Config.hpp"
 
 namespace Engine {
     static std::function<bool(Json::Value)> emptyFilter = [](Json::Value e) { return true; };
+    
+    EventSchema::EventSchema(const char* name, std::vector<EventField> fields) : _name(name), _fields(fields) {
+        
+    }
+    
+    Json::Value EventSchema::ToJson(const void* payload) {
+        ENGINE_PROFILER_SCOPE;
+        
+        Json::Value ret(Json::objectValue);
+        const char* base = static_cast<const char*>(payload);
+        
+        for (auto iter = this->_fields.begin(); iter != this->_fields.end(); iter++) {
+            const void* field = base + iter->Offset;
+            switch (iter->Type) {
+                case EventFieldType::Int:       ret[iter->Name] = *static_cast<const int*>(field); break;
+                case EventFieldType::Float:     ret[iter->Name] = *static_cast<const float*>(field); break;
+                case EventFieldType::Double:    ret[iter->Name] = *static_cast<const double*>(field); break;
+                case EventFieldType::Bool:      ret[iter->Name] = *static_cast<const bool*>(field); break;
+                case EventFieldType::String: {
+                    const char* str = *static_cast<const char* const*>(field);
+                    ret[iter->Name] = str != NULL ? Json::Value(str) : Json::Value(Json::nullValue);
+                    break;
+                }
+            }
+        }
+        
+        return ret;
+    }
+    
+    void EventSchema::FromJson(const Json::Value& val, void* payload) {
+        ENGINE_PROFILER_SCOPE;
+        
+        char* base = static_cast<char*>(payload);
+        
+        for (auto iter = this->_fields.begin(); iter != this->_fields.end(); iter++) {
+            void* field = base + iter->Offset;
+            if (!val.isObject() || !val.isMember(iter->Name)) {
+                // Listeners build std::strings from these so they are never left NULL, the same as asString() used to return
+                if (iter->Type == EventFieldType::String) {
+                    *static_cast<const char**>(field) = "";
+                }
+                continue;
+            }
+            const Json::Value& member = val[iter->Name];
+            switch (iter->Type) {
+                case EventFieldType::Int:       *static_cast<int*>(field) = member.isNumeric() ? member.asInt() : 0; break;
+                case EventFieldType::Float:     *static_cast<float*>(field) = member.isNumeric() ? member.asFloat() : 0.0f; break;
+                case EventFieldType::Double:    *static_cast<double*>(field) = member.isNumeric() ? member.asDouble() : 0.0; break;
+                case EventFieldType::Bool:      *static_cast<bool*>(field) = member.isConvertibleTo(Json::booleanValue) && member.asBool(); break;
+                case EventFieldType::String:
+                    *static_cast<const char**>(field) = member.isString() ? member.asCString() : "";
+                    break;
+            }
+        }
+    }
+    
+    v8::Local<v8::Object> EventSchema::ToObject(v8::Isolate* isolate, const void* payload) {
+        ENGINE_PROFILER_SCOPE;
+        
+        if (this->_isolate != isolate) {
+            this->_createTemplate(isolate);
+        }
+        
+        v8::Local<v8::ObjectTemplate> templ = v8::Local<v8::ObjectTemplate>::New(isolate, this->_template);
+        v8::Local<v8::Object> ret = templ->NewInstance();
+        
+        const char* base = static_cast<const char*>(payload);
+        
+        for (size_t i = 0; i < this->_fields.size(); i++) {
+            const EventField& fieldInfo = this->_fields[i];
+            const void* field = base + fieldInfo.Offset;
+            v8::Local<v8::String> name = v8::Local<v8::String>::New(isolate, this->_fieldNames[i]);
+            switch (fieldInfo.Type) {
+                case EventFieldType::Int:       ret->Set(name, v8::Integer::New(isolate, *static_cast<const int*>(field))); break;
+                case EventFieldType::Float:     ret->Set(name, v8::Number::New(isolate, *static_cast<const float*>(field))); break;
+                case EventFieldType::Double:    ret->Set(name, v8::Number::New(isolate, *static_cast<const double*>(field))); break;
+                case EventFieldType::Bool:      ret->Set(name, v8::Boolean::New(isolate, *static_cast<const bool*>(field))); break;
+                case EventFieldType::String: {
+                    const char* str = *static_cast<const char* const*>(field);
+                    if (str != NULL) {
+                        ret->Set(name, v8::String::NewFromUtf8(isolate, str));
+                    } else {
+                        ret->Set(name, v8::Null(isolate));
+                    }
+                    break;
+                }
+            }
+        }
+        
+        return ret;
+    }
+    
+    void EventSchema::_createTemplate(v8::Isolate* isolate) {
+        // Handles from an old isolate are gone with it so they are dropped instead of reset
+        delete [] this->_fieldNames;
+        this->_fieldNames = new v8::Persistent<v8::String>[this->_fields.size()];
+        
+        v8::HandleScope scope(isolate);
+        
+        v8::Local<v8::ObjectTemplate> templ = v8::ObjectTemplate::New(isolate);
+        
+        for (size_t i = 0; i < this->_fields.size(); i++) {
+            v8::Local<v8::String> name = v8::String::NewFromUtf8(isolate, this->_fields[i].Name, v8::String::kInternalizedString);
+            this->_fieldNames[i].Reset(isolate, name);
+            templ->Set(name, v8::Null(isolate));
+        }
+        
+        this->_template.Reset(isolate, templ);
+        this->_isolate = isolate;
+    }
         
     class CPPEventTarget : public EventTarget {
     public:
@@ -71,60 +183,79 @@ namespace Engine {
         }
         
         inline EventMagic Run(Json::Value& e, int jsArgC, v8::Handle<v8::Value> jsArgV[]) {
-            static EventMagic ret_magic = EM_BADTARGET; // Warning this could cause issues with threads.
-            
             v8::Isolate* currentIsolate = v8::Isolate::GetCurrent();
             v8::HandleScope scope(currentIsolate);
-            v8::Local<v8::Context> ctx = currentIsolate->GetCurrentContext();
-            if (ctx.IsEmpty() || ctx->Global().IsEmpty()) return EM_BADTARGET;
             
-            v8::TryCatch tryCatch;
-                
-            v8::Local<v8::Value>* args = new v8::Local<v8::Value>[1 + jsArgC];
-                
+            v8::Local<v8::Value> arg;
+            
             if ((e.isObject() || e.isArray()) &&
                 e.getMemberNames().size() == 0) {
-                args[0] = v8::Object::New(currentIsolate);
+                arg = v8::Object::New(currentIsolate);
             } else if (e.isNull()) {
-                args[0] = v8::Null(currentIsolate);
+                arg = v8::Null(currentIsolate);
             } else {
-                args[0] = ScriptingManager::GetObjectFromJson(e);
+                arg = ScriptingManager::GetObjectFromJson(e);
             }
-                
-            if (jsArgC > 0) {
-                for (int i = 0; i < jsArgC; i++) {
-                    args[i + 1] = jsArgV[i];
-                }
+            
+            return this->_call(currentIsolate, arg, jsArgC, jsArgV);
+        }
+        
+        inline EventMagic RunTyped(EventSchemaPtr schema, const void* payload, int jsArgC, v8::Handle<v8::Value> jsArgV[]) {
+            v8::Isolate* currentIsolate = v8::Isolate::GetCurrent();
+            v8::HandleScope scope(currentIsolate);
+            
+            return this->_call(currentIsolate, schema->ToObject(currentIsolate, payload), jsArgC, jsArgV);
+        }
+            
+        EventMagic Run(Json::Value& e) override {
+            return this->Run(e, 0, {});
+        }
+        
+        EventMagic RunTyped(EventSchemaPtr schema, const void* payload) override {
+            return this->RunTyped(schema, payload, 0, {});
+        }
+            
+        Type GetType() override { return Type::Javascript; }
+            
+    private:
+        EventMagic _call(v8::Isolate* currentIsolate, v8::Local<v8::Value> arg, int jsArgC, v8::Handle<v8::Value> jsArgV[]) {
+            static EventMagic ret_magic = EM_BADTARGET; // Warning this could cause issues with threads.
+            
+            // Most events pass one or two arguments so the array is only allocated for long lists
+            static const int stackArgCount = 4;
+            
+            v8::Local<v8::Context> ctx = currentIsolate->GetCurrentContext();
+            if (ctx.IsEmpty() || ctx->Global().IsEmpty()) return EM_BADTARGET;
+            
+            v8::TryCatch tryCatch;
+            
+            v8::Local<v8::Value> stackArgs[stackArgCount];
+            v8::Local<v8::Value>* args = 1 + jsArgC <= stackArgCount ? stackArgs : new v8::Local<v8::Value>[1 + jsArgC];
+            
+            args[0] = arg;
+            
+            for (int i = 0; i < jsArgC; i++) {
+                args[i + 1] = jsArgV[i];
             }
-                
+            
             v8::Local<v8::Function> func = v8::Local<v8::Function>::New(currentIsolate, _func);
-                
+            
             v8::Local<v8::Value> ret = func->Call(ctx->Global(), 1 + jsArgC, args);
             
+            if (args != stackArgs) {
+                delete [] args;
+            }
+            
             if (!tryCatch.StackTrace().IsEmpty()) {
                 ScriptingManager::ReportException(currentIsolate, &tryCatch);
-                ret.Clear();
-                func.Clear();
                 return EM_BADTARGET;
             }
             
             ret_magic = GetScriptingReturnType(ret);
             
-            ret.Clear();
-            func.Clear();
-            
-            delete [] args;
-            
             return ret_magic;
         }
-            
-        EventMagic Run(Json::Value& e) override {
-            return this->Run(e, 0, {});
-        }
-            
-        Type GetType() override { return Type::Javascript; }
-            
-    private:
+        
         v8::Persistent<v8::Function> _func;
     };
         
@@ -185,6 +316,34 @@ namespace Engine {
     EventMagic EventClass::Emit(Json::Value args) {
         return this->Emit(args, 0, {});
     }
+    
+    EventMagic EventClass::EmitTyped(EventSchemaPtr schema, const void* payload, int jsArgC, v8::Handle<v8::Value> jsArgV[]) {
+        ENGINE_PROFILER_SCOPE_EX(this->TargetName.c_str());
+        if (this->_alwaysDefered) {
+            // the payload doesn't outlive the call so it's queued as Json
+            this->_deferedMessages.push(schema->ToJson(payload));
+            return EM_DEFERED;
+        }
+        
+        for (auto iter = this->_events.begin(); iter != this->_events.end(); iter++) {
+            if (iter->second.Target == NULL || !iter->second.Active) continue;
+            if (this->Security.NoScript && iter->second.Target->IsScript()) continue;
+            
+            ENGINE_PROFILER_SCOPE_EX(iter->second.Label.c_str());
+            EventMagic ret = EM_BADTARGET;
+            if (jsArgC > 0 && iter->second.Target->GetType() == EventTarget::Type::Javascript) {
+                JSEventTarget* target = (JSEventTarget*) iter->second.Target;
+                ret = target->RunTyped(schema, payload, jsArgC, jsArgV);
+            } else {
+                ret = iter->second.Target->RunTyped(schema, payload);
+            }
+            if (ret == EM_CANCEL) {
+                return EM_CANCEL;
+            }
+        }
+        
+        return EM_OK;
+    }
         
     EventMagic EventClass::Emit() {
         return this->Emit(Json::nullValue);
@@ -228,14 +387,7 @@ namespace Engine {
     void EventClass::PollDeferedMessages() {
         ENGINE_PROFILER_SCOPE;
         while (this->_deferedMessages.size() > 0) {
-            for (auto iter2 = this->_events.begin(); iter2 != this->_events.end(); iter2++) {
-                if (iter2->second.Target == NULL) { throw "Invalid Target"; }
-                if (iter2->second.Active) {
-                    if (!(this->Security.NoScript && iter2->second.Target->IsScript())) {
-                        iter2->second.Target->Run(this->_deferedMessages.front());
-                    }
-                }
-            }
+            this->RunDefered(this->_deferedMessages.front());
             this->_deferedMessages.pop();
         }
     }
@@ -244,10 +396,45 @@ namespace Engine {
         this->_deferedMessages.push(e);
     }
     
+    void EventClass::RunDefered(Json::Value& e) {
+        for (auto iter2 = this->_events.begin(); iter2 != this->_events.end(); iter2++) {
+            if (iter2->second.Target == NULL) { throw "Invalid Target"; }
+            if (iter2->second.Active) {
+                if (!(this->Security.NoScript && iter2->second.Target->IsScript())) {
+                    iter2->second.Target->Run(e);
+                }
+            }
+        }
+    }
+    
     int EventClass::ListenerCount() {
         return this->_events.size();
     }
     
+    void EventClass::TrackQueueDelivery(double latency) {
+        this->_queueStats.Delivered++;
+        if (latency > this->_queueStats.MaxLatency) {
+            this->_queueStats.MaxLatency = latency;
+        }
+        
+        // Only the most recent deliveries are kept for percentiles
+        if (this->_latencySamples.size() < LatencySampleCount) {
+            this->_latencySamples.push_back(latency);
+        } else {
+            this->_latencySamples[this->_nextLatencySample] = latency;
+            this->_nextLatencySample = (this->_nextLatencySample + 1) % LatencySampleCount;
+        }
+    }
+    
+    double EventClass::GetQueueLatencyPercentile(double percentile) {
+        if (this->_latencySamples.empty()) return 0.0;
+        
+        std::vector<double> samples = this->_latencySamples;
+        size_t index = std::min(samples.size() - 1, (size_t) (percentile * (samples.size() - 1)));
+        std::nth_element(samples.begin(), samples.begin() + index, samples.end());
+        return samples[index];
+    }
+    
     EventMagic EventEmitter::_debug(Json::Value args, void* userPointer) {
         Logger::begin("Events", Logger::LogLevel_Log) << " == EVENT DEBUG ==" << Logger::end();
         
@@ -268,6 +455,14 @@ namespace Engine {
                     << "    Event Security: " << iter->second->Security.ToString()
                     << Logger::end();
                 Logger::begin("Events", Logger::LogLevel_Log) << "    Event Defered Messages: " << cls->GetDeferedMessageCount() << Logger::end();
+                EventQueueStats& stats = cls->GetQueueStats();
+                if (stats.Enqueued > 0) {
+                    Logger::begin("Events", Logger::LogLevel_Log)
+                        << "    Event Thread Queue: Depth=" << stats.Depth << " Enqueued=" << stats.Enqueued
+                        << " Delivered=" << stats.Delivered << " Dropped=" << stats.Dropped << " Coalesced=" << stats.Coalesced
+                        << " p99=" << cls->GetQueueLatencyPercentile(0.99) * 1000.0 << "ms Max=" << stats.MaxLatency * 1000.0 << "ms"
+                        << Logger::end();
+                }
                 Logger::begin("Events", Logger::LogLevel_Log)
                     << "    Event Members: "
                     << Logger::end();
@@ -278,18 +473,21 @@ namespace Engine {
         return EM_OK;
     }
     
-    EventEmitter::EventEmitter() {
+    EventEmitter::EventEmitter() : _threadQueue(ThreadQueueSize) {
         this->_eventMutex = Platform::CreateMutex();
         this->GetEvent("eventDebug")->AddListener("Events::_debug", MakeTarget(_debug, this));
     }
     
     EventClassPtrRef EventEmitter::GetEvent(std::string eventName) {
         std::string evnt_copy = std::string(eventName.c_str());
+        // Worker threads look up events in EmitThread so inserts are locked
+        this->_eventMutex->Enter();
         EventClassPtrRef cls = this->_events[evnt_copy];
         if (cls == NULL) {
             cls = new EventClass();
             cls->TargetName = evnt_copy;
         }
+        this->_eventMutex->Exit();
         return cls;
     }
     
@@ -315,20 +513,31 @@ namespace Engine {
     
     // Only called from the main thread
     void EventEmitter::PollDeferedMessages() {
-        this->_eventMutex->Enter();
+        ENGINE_PROFILER_SCOPE;
+        
+        static Config::ConfigVar<float> pollBudget("core.events.pollBudget");
+        
+        this->_pollThreadQueue(pollBudget);
+        
+        // Listeners can add events so the lock isn't held while they run
+        std::vector<EventClassPtr> classes;
         
+        this->_eventMutex->Enter();
         for (auto iter = this->_events.begin();
              iter != this->_events.end(); iter++) {
             if (iter->second == NULL) continue;
-            iter->second->PollDeferedMessages();
+            classes.push_back(iter->second);
         }
-        
         this->_eventMutex->Exit();
+        
+        for (auto iter = classes.begin(); iter != classes.end(); iter++) {
+            (*iter)->PollDeferedMessages();
+        }
     }
     
-    // Only called from main thread, does not interact with other threads right now
+    // Only called from main thread, messages from other threads are delivered by PollDeferedMessages()
     void EventEmitter::PollDeferedMessages(std::string eventName) {
-        EventClassPtrRef cls = this->_events[eventName];
+        EventClassPtr cls = this->_findEvent(eventName);
         if (cls == NULL) { return; }
         
         cls->PollDeferedMessages();
@@ -336,13 +545,64 @@ namespace Engine {
     
     // Called from any worker thread
     void EventEmitter::EmitThread(std::string threadID, std::string evnt, Json::Value e) {
-        this->_eventMutex->Enter();
-        
-        if (this->_events.count(evnt) > 0) {
-            this->_events[evnt]->AddDeferedMessage(e);
+        this->EmitThread(threadID, evnt, e, EventQueuePolicy::Block);
+    }
+    
+    void EventEmitter::EmitThread(std::string threadID, std::string evnt, Json::Value e, EventQueuePolicy policy, std::string coalesceKey) {
+        EventQueueMessage msg;
+        msg.Target = this->_findEvent(evnt);
+        if (msg.Target == NULL) {
+            return;
         }
+        msg.Args.swap(e);
         
+        this->_threadQueue.Push(msg, policy, coalesceKey);
+    }
+    
+    size_t EventEmitter::GetThreadQueueDepth() {
+        return this->_threadQueue.GetDepth();
+    }
+    
+    EventClassPtr EventEmitter::_findEvent(std::string eventName) {
+        EventClassPtr ret = NULL;
+        
+        // Only held for the lookup, the queue itself doesn't lock
+        this->_eventMutex->Enter();
+        auto iter = this->_events.find(eventName);
+        if (iter != this->_events.end()) {
+            ret = iter->second;
+        }
         this->_eventMutex->Exit();
+        
+        return ret;
+    }
+    
+    void EventEmitter::_pollThreadQueue(double budget) {
+        ENGINE_PROFILER_SCOPE;
+        
+        // The budget is only checked between batches
+        static const size_t batchSize = 64;
+        
+        double startTime = Platform::GetTime();
+        EventQueueMessage msg;
+        
+        while (true) {
+            size_t delivered = 0;
+            
+            while (delivered < batchSize && this->_threadQueue.Pop(msg)) {
+                msg.Target->TrackQueueDelivery(Platform::GetTime() - msg.EnqueueTime);
+                msg.Target->RunDefered(msg.Args);
+                delivered++;
+            }
+            
+            if (delivered < batchSize) {
+                break; // drained
+            }
+            
+            if (budget > 0 && Platform::GetTime() - startTime > budget) {
+                break; // the rest waits for next frame
+            }
+        }
     }
     
     EventEmitterPtr GetEventsSingilton() {
@@ -28,12 +28,14 @@
 #include <vector>
 #include <map>
 #include <queue>
+#include <cstddef>
 
 #include "vendor/json/json.h"
 
 #include "ScriptingManager.hpp"
 
 #include "RenderTypes.hpp"
+#include "EventQueue.hpp"
 
 namespace Engine {
     namespace Platform {
@@ -42,6 +44,49 @@ namespace Engine {
     
     typedef EventMagic (*EventTargetFunc)(Json::Value e, void* userPointer);
     
+    enum class EventFieldType {
+        Int,
+        Float,
+        Double,
+        Bool,
+        String      // const char*, only valid for the length of the emit
+    };
+    
+    struct EventField {
+        const char* Name;
+        EventFieldType Type;
+        size_t Offset;
+    };
+    
+#define ENGINE_EVENT_FIELD(payload, member, type) {#member, EventFieldType::type, offsetof(payload, member)}
+    
+    ENGINE_CLASS(EventSchema);
+    
+    // Describes a POD event payload so it can be handed to Json and Javascript listeners
+    class EventSchema {
+    public:
+        EventSchema(const char* name, std::vector<EventField> fields);
+        
+        const char* GetName() { return this->_name; }
+        
+        Json::Value ToJson(const void* payload);
+        // String fields point into val so payload is only valid while val is. Missing or mistyped
+        // fields are left as 0 or "" so script emits like sys.emit("rawInput", {}) are safe.
+        void FromJson(const Json::Value& val, void* payload);
+        // Instances share one cached ObjectTemplate so every payload object has the same hidden class
+        v8::Local<v8::Object> ToObject(v8::Isolate* isolate, const void* payload);
+        
+    private:
+        void _createTemplate(v8::Isolate* isolate);
+        
+        const char* _name;
+        std::vector<EventField> _fields;
+        
+        v8::Isolate* _isolate = NULL;
+        v8::Persistent<v8::ObjectTemplate> _template;
+        v8::Persistent<v8::String>* _fieldNames = NULL;
+    };
+    
     ENGINE_CLASS(EventTarget);
     
     class EventTarget {
@@ -56,6 +101,12 @@ namespace Engine {
         
         virtual EventMagic Run(Json::Value& e) = 0;
         
+        // Listeners that don't understand the payload get it converted to Json
+        virtual EventMagic RunTyped(EventSchemaPtr schema, const void* payload) {
+            Json::Value e = schema->ToJson(payload);
+            return this->Run(e);
+        }
+        
         virtual bool IsScript() { return true; }
         virtual Type GetType() { return Type::Invalid; }
     };
@@ -79,6 +130,34 @@ namespace Engine {
         }
     };
     
+    // Listeners made with EventEmitter::MakeTarget(EventMagic (*)(const T&, void*)) get typed payloads by reference
+    template<class T> class TypedEventTarget : public EventTarget {
+    public:
+        typedef EventMagic (*Func)(const T& e, void* userPointer);
+        
+        TypedEventTarget(Func func, void* userPointer) : _func(func), _userPointer(userPointer) { }
+        
+        EventMagic Run(Json::Value& e) override {
+            T payload = T();
+            T::GetSchema()->FromJson(e, &payload);
+            return this->_func(payload, this->_userPointer);
+        }
+        
+        EventMagic RunTyped(EventSchemaPtr schema, const void* payload) override {
+            if (schema == T::GetSchema()) {
+                return this->_func(*static_cast<const T*>(payload), this->_userPointer);
+            }
+            return EventTarget::RunTyped(schema, payload);
+        }
+        
+        bool IsScript() override { return false; }
+        Type GetType() override { return Type::CPlusPlus; }
+        
+    private:
+        Func _func;
+        void* _userPointer;
+    };
+    
     ENGINE_CLASS(EventClass);
     
     class EventClass {
@@ -89,6 +168,12 @@ namespace Engine {
         EventMagic Emit(Json::Value args);
         EventMagic Emit();
         
+        // Typed payloads skip Json for C++ listeners, defered events still queue them as Json
+        EventMagic EmitTyped(EventSchemaPtr schema, const void* payload, int jsArgC, v8::Handle<v8::Value> jsArgV[]);
+        template<class T> EventMagic EmitTyped(const T& payload) {
+            return this->EmitTyped(T::GetSchema(), &payload, 0, NULL);
+        }
+        
         EventClassPtr AddListener(size_t priority, std::string name, EventTarget* target);
         EventClassPtr AddListener(std::string name, EventTargetPtr target);
         
@@ -98,14 +183,27 @@ namespace Engine {
         void PollDeferedMessages();
         void AddDeferedMessage(Json::Value e);
         
+        // Runs every listener for a message that was queued by SetDefered or EventEmitter::EmitThread
+        void RunDefered(Json::Value& e);
+        
         int ListenerCount();
+        
+        EventQueueStats& GetQueueStats() { return this->_queueStats; }
+        void TrackQueueDelivery(double latency);
+        double GetQueueLatencyPercentile(double percentile);
             
         std::string TargetName;
         EventClassSecurity Security;
     private:
+        static const size_t LatencySampleCount = 1024;
+        
         bool _alwaysDefered = false;
         std::multimap<size_t, Event> _events;
         std::queue<Json::Value> _deferedMessages;
+        
+        EventQueueStats _queueStats;
+        std::vector<double> _latencySamples;
+        size_t _nextLatencySample = 0;
     };
     
     typedef EventClass*& EventClassPtrRef;
@@ -120,17 +218,34 @@ namespace Engine {
         
         void Clear(std::string eventID);
         
+        // Delivers messages from other threads for up to core.events.pollBudget seconds then runs defered events
         void PollDeferedMessages();
         void PollDeferedMessages(std::string eventName);
+        
+        // Can be called from any thread, the message is delivered by PollDeferedMessages on the main thread
         void EmitThread(std::string threadID, std::string evnt, Json::Value e);
+        void EmitThread(std::string threadID, std::string evnt, Json::Value e, EventQueuePolicy policy, std::string coalesceKey = "");
+        
+        size_t GetThreadQueueDepth();
         
         static EventTargetPtr MakeTarget(EventTargetFunc target);
         static EventTargetPtr MakeTarget(EventTargetFunc target, void* userPointer);
         static EventTargetPtr MakeTarget(v8::Handle<v8::Function> target);
         
+        template<class T> static EventTargetPtr MakeTarget(EventMagic (*target)(const T& e, void* userPointer), void* userPointer) {
+            return new TypedEventTarget<T>(target, userPointer);
+        }
+        
     private:
+        static const size_t ThreadQueueSize = 4096;
+        
         static EventMagic _debug(Json::Value args, void* userPointer);
         
+        EventClassPtr _findEvent(std::string eventName);
+        void _pollThreadQueue(double budget);
+        
+        EventQueue _threadQueue;
+        
         Platform::MutexPtr _eventMutex;
         std::unordered_map<std::string, EventClassPtr> _events;
         
@@ -24,18 +24,28 @@
 
 #include "GL3Buffer.hpp"
 
+#include <cstddef>
 #include <cstring>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
 
 #include "Logger.hpp"
 #include "Filesystem.hpp"
 #include "Profiler.hpp"
 #include "Application.hpp"
 #include "Config.hpp"
+#include "Package.hpp"
 
 #define GLM_FORCE_RADIANS
 #include "vendor/glm/glm.hpp"
 #include "vendor/glm/gtc/matrix_transform.hpp"
 
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define ENGINE_GL3BUFFER_SSE
+#include <xmmintrin.h>
+#endif
+
 namespace Engine {
     inline GLenum _polygonModeToGLMode(PolygonMode mode) {
         switch (mode) {
@@ -53,6 +63,39 @@ namespace Engine {
         }
     }
     
+    static_assert(sizeof(CompactBufferFormat) == 20, "CompactBufferFormat must stay packed");
+    
+    // Rounds to nearest even like F16C, anything past the half range becomes infinity
+    inline unsigned short _floatToHalf(float value) {
+        unsigned int bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        
+        unsigned int sign = (bits >> 16) & 0x8000;
+        int exponent = (int) ((bits >> 23) & 0xff) - 127 + 15;
+        unsigned int mantissa = bits & 0x7fffff;
+        
+        if (exponent >= 31) {
+            return (unsigned short) (sign | 0x7c00);
+        } else if (exponent <= 0) {
+            if (exponent < -10) return (unsigned short) sign;
+            mantissa |= 0x800000;
+            unsigned int shift = (unsigned int) (14 - exponent);
+            unsigned int half = mantissa >> shift;
+            unsigned int rest = mantissa & ((1u << shift) - 1), halfway = 1u << (shift - 1);
+            if (rest > halfway || (rest == halfway && (half & 1))) half++;
+            return (unsigned short) (sign | half);
+        }
+        
+        unsigned int half = sign | ((unsigned int) exponent << 10) | (mantissa >> 13);
+        unsigned int rest = mantissa & 0x1fff;
+        if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) half++; // a carry rolls into the exponent which is still correct
+        return (unsigned short) half;
+    }
+    
+    inline unsigned char _colorToByte(float value) {
+        return (unsigned char) (glm::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+    }
+    
 	VertexBuffer::VertexBuffer() : _shaderBound(false), _uuid(Platform::GenerateUUID()),
 		_vertexBuffer(128, BufferFormat(glm::vec3(), Color4f(0, 0, 0, 1), glm::vec3())) {
 
@@ -88,16 +131,30 @@ namespace Engine {
             glGenVertexArrays(1, &this->_vertexArrayPointer);
         }
         glGenBuffers(1, &this->_vertexBufferPointer);
+        glGenBuffers(1, &this->_indexBufferPointer);
+        glGenBuffers(1, &this->_normalBufferPointer);
+        this->_streamCapacity = 0;
+        this->_indexDirty = true;
+        this->_normalsDirty = true;
+        OpenGLVersion version = this->_renderGL->GetOpenGLVersion();
+        this->_hasBaseVertex = glDrawElementsBaseVertex != NULL && (version.major > 3 || (version.major == 3 && version.minor >= 2) ||
+                                                                    this->_renderGL->HasExtention("GL_ARB_draw_elements_base_vertex"));
+        // a layout picked with SetVertexLayout outlives shader reloads
+        this->_setVertexLayout(this->_hasLayoutOverride ? this->_layoutOverride : this->_currentEffect->GetShaderSettings().vertexLayout);
         this->_renderGL->CheckError("VertexBuffer::_init::Post");
     }
     
     void VertexBuffer::_shutdown() {
 		this->_renderGL->CheckError("VertexBuffer::_shutdown::Pre");
 		Logger::begin("VertexBuffer", Logger::LogLevel_Verbose) << "VertexBuffer[" << Platform::StringifyUUID(this->_uuid) << "] _shutdown" << Logger::end();
+        this->_releaseStream();
         glDeleteBuffers(1, &this->_vertexBufferPointer);
+        glDeleteBuffers(1, &this->_indexBufferPointer);
+        glDeleteBuffers(1, &this->_normalBufferPointer);
         if (this->_renderGL->GetOpenGLVersion().major >= 3) {
             glDeleteVertexArrays(1, &this->_vertexArrayPointer);
         }
+        this->_releaseMapping();
         this->_renderGL->CheckError("VertexBuffer::_shutdown::Post");
     }
     
@@ -123,12 +180,23 @@ namespace Engine {
         }
         ENGINE_PROFILER_SCOPE;
         
+        RenderDebugGroup debugGroup(this->_renderGL, "VertexBuffer::Update");
+        
         this->_renderGL->CheckError("VertexBuffer::Update::Pre");
         
         if (glIsBuffer(this->_vertexBufferPointer)) {
+            this->_releaseStream();
             glDeleteBuffers(1, &this->_vertexBufferPointer);
         }
         
+        if (glIsBuffer(this->_indexBufferPointer)) {
+            glDeleteBuffers(1, &this->_indexBufferPointer);
+        }
+        
+        if (glIsBuffer(this->_normalBufferPointer)) {
+            glDeleteBuffers(1, &this->_normalBufferPointer);
+        }
+        
         if (this->_renderGL->GetOpenGLVersion().major >= 3) {
             if (glIsVertexArray(this->_vertexArrayPointer)) {
                 glDeleteBuffers(1, &this->_vertexArrayPointer);
@@ -148,9 +216,97 @@ namespace Engine {
         return true;
     }
     
+    void VertexBuffer::_grow() {
+        // a mapped buffer is copied out the first time it's edited
+        if (this->_mappedRegion != NULL) {
+            this->_unmap();
+        }
+        
+        if (this->_vertexBuffer.size() <= this->_vertexCount) {
+            this->_vertexBuffer.resize(std::max<size_t>(128, this->_vertexCount * 2),
+                                       BufferFormat(glm::vec3(), Color4f(0, 0, 0, 1), glm::vec3()));
+        }
+    }
+    
+    void VertexBuffer::AddVerts(const BufferFormat* verts, size_t count) {
+        if (count == 0) return;
+        if (this->_mappedRegion != NULL) this->_unmap();
+        if (this->_vertexBuffer.size() < this->_vertexCount + count) {
+            this->_vertexBuffer.resize(this->_vertexCount + count, verts[0]);
+        }
+        std::memcpy(&this->_vertexBuffer[this->_vertexCount], verts, count * sizeof(BufferFormat));
+        this->_vertexCount += count;
+        this->_dirty = true;
+    }
+    
+    void VertexBuffer::TransformVerts(size_t start, const glm::mat4& model) {
+        if (start >= this->_vertexCount || model == glm::mat4()) return;
+        
+        ENGINE_PROFILER_SCOPE;
+        
+        if (this->_mappedRegion != NULL) this->_unmap();
+        
+        const float* m = &model[0][0];
+        
+        BufferFormat* vert = &this->_vertexBuffer[start];
+        BufferFormat* end = &this->_vertexBuffer[0] + this->_vertexCount;
+        
+#ifdef ENGINE_GL3BUFFER_SSE
+        __m128 col0 = _mm_loadu_ps(m), col1 = _mm_loadu_ps(m + 4), col2 = _mm_loadu_ps(m + 8), col3 = _mm_loadu_ps(m + 12);
+        
+        for (; vert != end; vert++) {
+            float* pos = &vert->pos.x;
+            
+            // the 4th lane reads the color that follows and is never written back
+            __m128 p = _mm_loadu_ps(pos);
+            __m128 r = _mm_add_ps(_mm_add_ps(_mm_mul_ps(col0, _mm_shuffle_ps(p, p, _MM_SHUFFLE(0, 0, 0, 0))),
+                                             _mm_mul_ps(col1, _mm_shuffle_ps(p, p, _MM_SHUFFLE(1, 1, 1, 1)))),
+                                  _mm_add_ps(_mm_mul_ps(col2, _mm_shuffle_ps(p, p, _MM_SHUFFLE(2, 2, 2, 2))), col3));
+            
+            _mm_storel_pi((__m64*) pos, r);
+            _mm_store_ss(pos + 2, _mm_movehl_ps(r, r));
+        }
+#else
+        for (; vert != end; vert++) {
+            float x = vert->pos.x, y = vert->pos.y, z = vert->pos.z;
+            
+            vert->pos.x = m[0] * x + m[4] * y + m[8] * z + m[12];
+            vert->pos.y = m[1] * x + m[5] * y + m[9] * z + m[13];
+            vert->pos.z = m[2] * x + m[6] * y + m[10] * z + m[14];
+        }
+#endif
+        
+        this->_dirty = true;
+    }
+    
+    void VertexBuffer::AddIndexes(const unsigned int* indexes, size_t count) {
+        if (this->_mappedRegion != NULL) this->_unmap();
+        this->_indexBuffer.insert(this->_indexBuffer.end(), indexes, indexes + count);
+        this->_indexDirty = true;
+    }
+    
+    void VertexBuffer::SetNormals(const glm::vec3* normals, size_t count) {
+        if (this->_mappedRegion != NULL) this->_unmap();
+        this->_normalBuffer.assign(normals, normals + count);
+        this->_normalsDirty = true;
+    }
+    
     void VertexBuffer::Reset() {
+        if (this->_mappedRegion != NULL) {
+            this->_releaseMapping();
+            this->_indexDirty = true;
+            this->_normalsDirty = true;
+        }
         this->_vertexCount = 0;
         this->_dirty = true;
+        if (!this->_indexBuffer.empty()) {
+            this->_indexBuffer.clear();
+            this->_indexDirty = true;
+        }
+        if (!this->_normalBuffer.empty()) {
+            this->_normalBuffer.clear();
+            this->_normalsDirty = true;
+        }
     }
     
     void VertexBuffer::_upload() {
@@ -158,7 +314,26 @@ namespace Engine {
         
         this->GetRender()->CheckError("VertexBuffer::Upload::PreUploadBufferData");
         
-        glBufferData(GL_ARRAY_BUFFER, sizeof(BufferFormat) * this->_vertexCount, &this->_vertexBuffer[0], GL_STATIC_DRAW);
+        if (this->_usageMode == UsageMode::Static) {
+            size_t size = this->GetVertexSize() * this->_vertexCount;
+            
+            if (this->_vertexLayout == VertexLayout::Compact2D) {
+                if (this->_compactBuffer.size() < this->_vertexCount) {
+                    this->_compactBuffer.resize(this->_vertexCount);
+                }
+                PackCompactVerts(this->_vertexData(), this->_vertexCount, this->_compactBuffer.data());
+                glBufferData(GL_ARRAY_BUFFER, size, this->_compactBuffer.data(), GL_STATIC_DRAW);
+            } else {
+                glBufferData(GL_ARRAY_BUFFER, size, this->_vertexData(), GL_STATIC_DRAW);
+            }
+            
+            this->_firstVertex = 0;
+            
+            this->_renderGL->TrackStat(RenderStatistic::BufferAlloc, 1);
+            this->_renderGL->TrackStat(RenderStatistic::BufferUpload, size);
+        } else {
+            this->_uploadStreaming();
+        }
         
         this->GetRender()->CheckError("VertexBuffer::Upload::PostUploadBufferData");
         
@@ -170,37 +345,261 @@ namespace Engine {
         this->GetRender()->CheckError("GL3Buffer::Upload::Post");
     }
     
+    void VertexBuffer::_uploadIndexes(unsigned int indexBase) {
+        ENGINE_PROFILER_SCOPE;
+        
+        size_t size = sizeof(unsigned int) * this->GetIndexCount();
+        const unsigned int* indexes = this->_indexData();
+        
+        if (indexBase != 0) {
+            this->_rebasedIndexes.resize(this->GetIndexCount());
+            for (size_t i = 0; i < this->_rebasedIndexes.size(); i++) {
+                this->_rebasedIndexes[i] = indexes[i] + indexBase;
+            }
+            indexes = this->_rebasedIndexes.data();
+        }
+        
+        // Indexes are written far less often than streamed vertexes so they always use plain buffer data,
+        // only rebased indexes are sent again whenever the stream moves
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indexes, GL_STATIC_DRAW);
+        this->_indexBase = indexBase;
+        
+        this->_renderGL->TrackStat(RenderStatistic::BufferAlloc, 1);
+        this->_renderGL->TrackStat(RenderStatistic::BufferUpload, size);
+        
+        this->GetRender()->CheckError("VertexBuffer::UploadIndexes::Post");
+    }
+    
+    void VertexBuffer::_uploadNormals() {
+        ENGINE_PROFILER_SCOPE;
+        
+        size_t size = sizeof(glm::vec3) * this->_vertexCount;
+        
+        glBindBuffer(GL_ARRAY_BUFFER, this->_normalBufferPointer);
+        glBufferData(GL_ARRAY_BUFFER, size, this->_normalData(), GL_STATIC_DRAW);
+        glBindBuffer(GL_ARRAY_BUFFER, this->_vertexBufferPointer);
+        
+        this->_renderGL->TrackStat(RenderStatistic::BufferAlloc, 1);
+        this->_renderGL->TrackStat(RenderStatistic::BufferUpload, size);
+        
+        this->GetRender()->CheckError("VertexBuffer::UploadNormals::Post");
+    }
+    
+    void VertexBuffer::_uploadStreaming() {
+        size_t size = this->GetVertexSize() * this->_vertexCount;
+        
+        // Keep every upload inside a single segment so a wrap never overwrites the current lap
+        if (size * StreamSegmentCount > this->_streamCapacity) {
+            this->_allocateStream(std::max(size * StreamSegmentCount,
+                                           (size_t) Config::GetInt("core.render.streamingBufferSize")));
+        }
+        
+        bool persistent = this->_usageMode == UsageMode::PersistentStreaming;
+        
+        if (this->_streamOffset + size > this->_streamCapacity) {
+            if (!persistent) {
+                // Orphan the old storage, the driver hands back a fresh block while the GPU finishes with the old one
+                glBufferData(GL_ARRAY_BUFFER, this->_streamCapacity, NULL, GL_STREAM_DRAW);
+                this->_renderGL->TrackStat(RenderStatistic::BufferOrphan, 1);
+            }
+            this->_streamOffset = 0;
+        }
+        
+        if (persistent) {
+            size_t segmentSize = this->_streamCapacity / StreamSegmentCount;
+            unsigned int lastSegment = (unsigned int) ((this->_streamOffset + size - 1) / segmentSize);
+            
+            while (this->_streamSegment != lastSegment) {
+                this->_streamFences[this->_streamSegment] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                this->_streamSegment = (this->_streamSegment + 1) % StreamSegmentCount;
+                this->_waitStreamSegment(this->_streamSegment);
+            }
+            
+            this->_writeVertexes((unsigned char*) this->_streamPointer + this->_streamOffset);
+        } else {
+            void* ptr = glMapBufferRange(GL_ARRAY_BUFFER, this->_streamOffset, size,
+                                         GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+            
+            if (ptr != NULL) {
+                this->_writeVertexes(ptr);
+                
+                glUnmapBuffer(GL_ARRAY_BUFFER);
+            } else {
+                this->GetRender()->CheckError("VertexBuffer::UploadStreaming::MapBufferRange");
+                
+                if (!this->_loggedMapFailure) {
+                    Logger::begin("VertexBuffer", Logger::LogLevel_Warning) << "glMapBufferRange failed, streaming with glBufferSubData" << Logger::end();
+                    this->_loggedMapFailure = true;
+                }
+                
+                this->_streamStaging.resize(size);
+                this->_writeVertexes(this->_streamStaging.data());
+                
+                glBufferSubData(GL_ARRAY_BUFFER, this->_streamOffset, size, this->_streamStaging.data());
+            }
+        }
+        
+        this->_firstVertex = (unsigned int) (this->_streamOffset / this->GetVertexSize());
+        this->_streamOffset += size;
+        
+        this->_renderGL->TrackStat(RenderStatistic::BufferUpload, size);
+    }
+    
+    void VertexBuffer::_writeVertexes(void* dest) {
+        if (this->_vertexLayout == VertexLayout::Compact2D) {
+            PackCompactVerts(this->_vertexData(), this->_vertexCount, (CompactBufferFormat*) dest);
+        } else {
+            std::memcpy(dest, this->_vertexData(), sizeof(BufferFormat) * this->_vertexCount);
+        }
+    }
+    
+    void VertexBuffer::PackCompactVerts(const BufferFormat* verts, size_t count, CompactBufferFormat* dest) {
+        ENGINE_PROFILER_SCOPE;
+        
+        for (size_t i = 0; i < count; i++) {
+            const BufferFormat& vert = verts[i];
+            CompactBufferFormat& packed = dest[i];
+            
+            packed.x = vert.pos.x;
+            packed.y = vert.pos.y;
+            packed.col[0] = _colorToByte(vert.col.r);
+            packed.col[1] = _colorToByte(vert.col.g);
+            packed.col[2] = _colorToByte(vert.col.b);
+            packed.col[3] = _colorToByte(vert.col.a);
+            packed.uv[0] = _floatToHalf(vert.uv.x);
+            packed.uv[1] = _floatToHalf(vert.uv.y);
+            packed.uv[2] = _floatToHalf(vert.uv.z);
+            packed.pad = 0;
+        }
+    }
+    
+    void VertexBuffer::_allocateStream(size_t capacity) {
+        ENGINE_PROFILER_SCOPE;
+        
+        if (this->_streamCapacity != 0) {
+            // Immutable storage can't be respecified so growing needs a new buffer object
+            this->_releaseStream();
+            glDeleteBuffers(1, &this->_vertexBufferPointer);
+            glGenBuffers(1, &this->_vertexBufferPointer);
+            glBindBuffer(GL_ARRAY_BUFFER, this->_vertexBufferPointer);
+            this->Invalidate();
+        }
+        
+        // Segments must hold a whole number of vertexes so offsets can be used as the first vertex
+        size_t segmentStride = this->GetVertexSize() * StreamSegmentCount;
+        capacity = ((capacity + segmentStride - 1) / segmentStride) * segmentStride;
+        
+        Logger::begin("VertexBuffer", Logger::LogLevel_Verbose) << "VertexBuffer[" << Platform::StringifyUUID(this->_uuid) << "] allocating "
+            << capacity << " byte stream" << Logger::end();
+        
+        if (this->_usageMode == UsageMode::PersistentStreaming) {
+            GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+            glBufferStorage(GL_ARRAY_BUFFER, capacity, NULL, flags);
+            this->_streamPointer = glMapBufferRange(GL_ARRAY_BUFFER, 0, capacity, flags);
+        } else {
+            glBufferData(GL_ARRAY_BUFFER, capacity, NULL, GL_STREAM_DRAW);
+        }
+        
+        this->_streamCapacity = capacity;
+        this->_streamOffset = 0;
+        this->_streamSegment = 0;
+        
+        this->_renderGL->TrackStat(RenderStatistic::BufferAlloc, 1);
+        
+        this->GetRender()->CheckError("VertexBuffer::AllocateStream::Post");
+    }
+    
+    void VertexBuffer::_releaseStream() {
+        for (unsigned int i = 0; i < StreamSegmentCount; i++) {
+            if (this->_streamFences[i] != NULL) {
+                glDeleteSync((GLsync) this->_streamFences[i]);
+                this->_streamFences[i] = NULL;
+            }
+        }
+        
+        if (this->_streamPointer != NULL) {
+            glBindBuffer(GL_ARRAY_BUFFER, this->_vertexBufferPointer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            this->_streamPointer = NULL;
+        }
+        
+        this->_streamCapacity = 0;
+        this->_streamOffset = 0;
+        this->_streamSegment = 0;
+    }
+    
+    void VertexBuffer::_waitStreamSegment(unsigned int segment) {
+        GLsync fence = (GLsync) this->_streamFences[segment];
+        
+        if (fence == NULL) {
+            return;
+        }
+        
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        
+        if (result == GL_TIMEOUT_EXPIRED) {
+            ENGINE_PROFILER_SCOPE_EX("StreamStall");
+            this->_renderGL->TrackStat(RenderStatistic::BufferStall, 1);
+            do {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            } while (result == GL_TIMEOUT_EXPIRED);
+        }
+        
+        glDeleteSync(fence);
+        this->_streamFences[segment] = NULL;
+    }
+    
     void VertexBuffer::Draw(PolygonMode mode, glm::mat4 model) {
         
         if (this->_vertexCount == 0) {
             return; // nothing to draw
         }
-#ifdef PROFILER
-		static char* addedData = NULL;
-        if (addedData == NULL) {
-            addedData = new char[128];
-        }
         
-        sprintf(addedData, "_vertexCount=%d", this->_vertexCount);
-
-		ENGINE_PROFILER_SCOPE_EX(addedData);
-#endif
+        RenderDebugGroup debugGroup(this->GetRender(), "VertexBuffer::Draw");
+        ENGINE_PROFILER_SCOPE; // the vertex count is tracked by RenderStatistic::Verts, labeling the zone with it would intern a new zone per count
         
         this->_renderGL->TrackStat(RenderStatistic::DrawCall, 1);
         this->_renderGL->TrackStat(RenderStatistic::Verts, this->_vertexCount);
         
         this->_begin();
         
-        if (this->_dirty) {
+        if (this->_normalsDirty) {
+            if (this->HasNormals()) {
+                this->_uploadNormals();
+            }
+            this->_normalsDirty = false;
+            this->_shaderBound = false; // the normal attribute is only bound when there are normals
+        }
+        
+        // Streaming storage gets recycled so the vertexes have to be resent every draw
+        if (this->_dirty || this->_usageMode != UsageMode::Static) {
             this->_upload();
             this->_dirty = false;
         }
         
+        if (!this->_shaderBound) {
+            this->bindShader();
+            this->_shaderBound = true;
+        }
+        
+        bool indexed = this->IsIndexed();
+        
+        if (indexed) {
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, this->_indexBufferPointer);
+            unsigned int indexBase = this->_hasBaseVertex ? 0 : this->_firstVertex;
+            if (this->_indexDirty || indexBase != this->_indexBase) {
+                this->_uploadIndexes(indexBase);
+                this->_indexDirty = false;
+            }
+        }
+        
         this->_getShader()->Begin();
         
         this->GetRender()->CheckError("VertexBuffer::Draw::PostBindShader");
         
-        ShaderSettings settings = this->_currentEffect->GetShaderSettings();
+        static Config::ConfigVar<float> fovy("core.render.fovy");
+        
+        ShaderPtr shader = this->_getShader();
         
         glm::mat4 proj;
         switch (this->_projectionType) {
@@ -209,13 +608,17 @@ namespace Engine {
                 break;
             case ProjectionType::Perspective:
                 glm::vec2 windowSize = GetAppSingilton()->GetWindow()->GetWindowSize();
-                proj = glm::perspective(glm::radians(Config::GetFloat("core.render.fovy")), GetAppSingilton()->GetWindow()->GetAspectRatio(), 1.0f, 1000.0f);
+                proj = glm::perspective(glm::radians(fovy.Get()), GetAppSingilton()->GetWindow()->GetAspectRatio(), 1.0f, 1000.0f);
                 break;
         }
         
-        this->_getShader()->UploadUniform(settings.modelMatrixParam, model);
-        this->_getShader()->UploadUniform(settings.viewMatrixParam, this->_view);
-        this->_getShader()->UploadUniform(settings.projectionMatrixParam, proj);
+        shader->UploadUniform(this->_modelUniform, model);
+        
+        // the view and projection are shared by every buffer drawn with the same camera
+        if (!shader->UsesCameraBlock() || !this->GetRender()->SetCameraBlock(this->_view, proj)) {
+            shader->UploadUniform(this->_viewUniform, this->_view);
+            shader->UploadUniform(this->_projectionUniform, proj);
+        }
         
         this->GetRender()->CheckError("VertexBuffer::Draw::PostUploadUniform");
         
@@ -225,9 +628,17 @@ namespace Engine {
             glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         }
         
-        {
+        if (indexed) {
             ENGINE_PROFILER_SCOPE_EX("glDrawElements");
-            glDrawArrays(_polygonModeToGLMode(mode), 0, this->_vertexCount);
+            if (this->_firstVertex == this->_indexBase) {
+                glDrawElements(_polygonModeToGLMode(mode), (GLsizei) this->GetIndexCount(), GL_UNSIGNED_INT, NULL);
+            } else {
+                // only streaming buffers move the first vertex, _init checked for OpenGL 3.2 or the extension
+                glDrawElementsBaseVertex(_polygonModeToGLMode(mode), (GLsizei) this->GetIndexCount(), GL_UNSIGNED_INT, NULL, this->_firstVertex);
+            }
+        } else {
+            ENGINE_PROFILER_SCOPE_EX("glDrawArrays");
+            glDrawArrays(_polygonModeToGLMode(mode), this->_firstVertex, (GLsizei) this->_vertexCount);
         }
         
         if (this->_wireframe) {
@@ -241,10 +652,13 @@ namespace Engine {
         this->_end();
     }
     
-    void VertexBuffer::Save(std::string filename) {
-        unsigned char* buff = NULL;
-        long fileLength = 0;
-        
+    size_t VertexBuffer::GetDiskSize(size_t vertexCount, size_t indexCount, bool hasNormals) {
+        return sizeof(VertexBufferDiskFormat) + vertexCount * sizeof(BufferFormat)
+            + (hasNormals ? vertexCount * sizeof(glm::vec3) : 0) + indexCount * sizeof(unsigned int);
+    }
+    
+    void VertexBuffer::WriteDiskFormat(unsigned char* dest, const BufferFormat* verts, size_t vertexCount,
+                                       const unsigned int* indexes, size_t indexCount, const glm::vec3* normals) {
 		// Anoying VS
         VertexBufferDiskFormat header;
 		header.magic[0] = 'E';
@@ -252,23 +666,40 @@ namespace Engine {
 		header.magic[2] = 'L';
 		header.magic[3] = 'B';
         
-        fileLength += sizeof(VertexBufferDiskFormat);
+        size_t offset = sizeof(VertexBufferDiskFormat);
         
-        header.vertexOffset = fileLength;
-        header.vertexCount = this->_vertexBuffer.size();
+        header.vertexOffset = offset;
+        header.vertexCount = vertexCount;
         
-        fileLength += this->_vertexBuffer.size() * sizeof(BufferFormat);
+        offset += vertexCount * sizeof(BufferFormat);
         
-        header.indexOffset = 0;
-        header.indexCount = 0;
+        header.normalOffset = normals != NULL ? offset : 0;
         
-        fileLength += 0 * sizeof(unsigned short);
+        offset += normals != NULL ? vertexCount * sizeof(glm::vec3) : 0;
         
-        buff = new unsigned char[fileLength];
+        header.indexOffset = offset;
+        header.indexCount = indexCount;
+        header.indexSize = sizeof(unsigned int);
         
-        std::memcpy(&buff[header.vertexOffset], &this->_vertexBuffer[0],
-                    this->_vertexBuffer.size() * sizeof(BufferFormat));
-        std::memcpy(&buff[0], &header, sizeof(VertexBufferDiskFormat));
+        std::memcpy(dest, &header, sizeof(VertexBufferDiskFormat));
+        if (vertexCount > 0) {
+            std::memcpy(&dest[header.vertexOffset], verts, vertexCount * sizeof(BufferFormat));
+        }
+        if (normals != NULL && vertexCount > 0) {
+            std::memcpy(&dest[header.normalOffset], normals, vertexCount * sizeof(glm::vec3));
+        }
+        if (indexCount > 0) {
+            std::memcpy(&dest[header.indexOffset], indexes, indexCount * sizeof(unsigned int));
+        }
+    }
+    
+    void VertexBuffer::Save(std::string filename) {
+        long fileLength = GetDiskSize(this->_vertexCount, this->GetIndexCount(), this->HasNormals());
+        
+        unsigned char* buff = new unsigned char[fileLength];
+        
+        WriteDiskFormat(buff, this->_vertexData(), this->_vertexCount, this->_indexData(), this->GetIndexCount(),
+                        this->HasNormals() ? this->_normalData() : NULL);
         
         Filesystem::WriteFile(filename, (const char*) buff, fileLength);
         
@@ -276,31 +707,268 @@ namespace Engine {
     }
     
     void VertexBuffer::Load(std::string filename) {
+        ENGINE_PROFILER_SCOPE;
+        
         this->Reset();
-
-		this->_vertexBuffer.clear();
         
-        long fileLength;
+        long fileLength = 0;
         unsigned char* buff = (unsigned char*) Filesystem::GetFileContent(filename, fileLength);
         
-        VertexBufferDiskFormat* header = (VertexBufferDiskFormat*) buff;
+        if (fileLength <= 0) {
+            Logger::begin("VertexBuffer", Logger::LogLevel_Error) << "Could not load " << filename << Logger::end();
+            return; // failed reads hand back a static empty string
+        }
+        
+        this->_loadFromMemory(buff, fileLength, filename, false);
+        
+        delete [] buff;
+    }
+    
+    bool VertexBuffer::LoadMapped(std::string filename) {
+        ENGINE_PROFILER_SCOPE;
+        
+        this->Reset();
+        
+        // only files in mounted directories have a real path that can be mapped
+        std::string realPath = Filesystem::GetRealPath(filename);
+        long fileLength = Filesystem::FileExists(filename) ? Filesystem::FileSize(filename) : 0;
+        
+        Platform::MemoryMappedFilePtr file = realPath.empty() || fileLength <= 0 ? NULL :
+            Platform::OpenMemoryMappedFile(realPath, Platform::FileMode::Read);
+        
+        Platform::MemoryMappedRegionPtr region = NULL;
+        
+        if (file != NULL) {
+            try {
+                region = file->MapRegion(0, fileLength);
+            } catch (int err) {
+                region = NULL;
+            }
+        }
+        
+        if (region == NULL || region->_data == NULL) {
+            if (file != NULL) {
+                if (region != NULL) file->UnmapRegion(region);
+                // ~MemoryMappedFile can't reach the platform Close so it's called here
+                file->Close();
+                delete file;
+            }
+            Logger::begin("VertexBuffer", Logger::LogLevel_Verbose) << filename << " can't be mapped, loading a copy instead" << Logger::end();
+            this->Load(filename);
+            return false;
+        }
+        
+        this->_mappedFile = file;
+        this->_mappedRegion = region;
+        
+        if (!this->_loadFromMemory(region->Data<unsigned char>(), fileLength, filename, true)) {
+            this->_releaseMapping();
+            return false;
+        }
+        
+        return true;
+    }
+    
+    bool VertexBuffer::LoadMapped(PackagePtr package, std::string filename) {
+        ENGINE_PROFILER_SCOPE;
+        
+        this->Reset();
+        
+        uint32_t fileLength = 0;
+        Platform::MemoryMappedRegionPtr region = NULL;
+        
+        try {
+            region = package->MapFile(filename, fileLength);
+            
+            if (region == NULL) {
+                // compressed entries have to be inflated into a copy
+                uint8_t* buff = package->ReadFile(filename, fileLength);
+                this->_loadFromMemory(buff, fileLength, filename, false);
+                delete [] buff;
+                return false;
+            }
+        } catch (const char* err) {
+            Logger::begin("VertexBuffer", Logger::LogLevel_Error) << "Could not load " << filename << " from package: " << err << Logger::end();
+            return false;
+        }
+        
+        this->_mappedRegion = region;
+        
+        if (!this->_loadFromMemory(region->Data<unsigned char>(), fileLength, filename, true)) {
+            this->_releaseMapping();
+            return false;
+        }
+        
+        return true;
+    }
+    
+    bool VertexBuffer::_loadFromMemory(const unsigned char* data, size_t length, std::string filename, bool keepMapped) {
+        const VertexBufferDiskFormat* header = (const VertexBufferDiskFormat*) data;
+        
+        // files from before normalOffset was added put their vertexes here
+        static const size_t oldHeaderSize = offsetof(VertexBufferDiskFormat, normalOffset);
+        static const size_t normalHeaderSize = offsetof(VertexBufferDiskFormat, indexSize);
+        
+        if (length < oldHeaderSize ||
+            header->magic[0] != 'E' || header->magic[1] != 'G' || header->magic[2] != 'L' || header->magic[3] != 'B' ||
+            header->vertexOffset < oldHeaderSize ||
+            header->vertexOffset + (size_t) header->vertexCount * sizeof(BufferFormat) > length) {
+            Logger::begin("VertexBuffer", Logger::LogLevel_Error) << filename << " is not a valid .eglb file" << Logger::end();
+            return false;
+        }
+        
+        size_t indexSize = header->vertexOffset >= sizeof(VertexBufferDiskFormat) ? header->indexSize :
+            header->vertexOffset >= normalHeaderSize ? sizeof(unsigned int) : sizeof(unsigned short);
+        
+        if ((indexSize != sizeof(unsigned int) && indexSize != sizeof(unsigned short)) ||
+            (header->indexCount > 0 && header->indexOffset + (size_t) header->indexCount * indexSize > length)) {
+            Logger::begin("VertexBuffer", Logger::LogLevel_Error) << filename << " is not a valid .eglb file" << Logger::end();
+            return false;
+        }
+        
+        const unsigned int* indexes = (const unsigned int*) &data[header->indexOffset];
+        const unsigned short* shortIndexes = (const unsigned short*) &data[header->indexOffset];
+        
+        // indexes past the end of the vertexes would be read by Draw and written by the mesh tools
+        for (size_t i = 0; i < header->indexCount; i++) {
+            size_t index = indexSize == sizeof(unsigned int) ? indexes[i] : shortIndexes[i];
+            if (index >= header->vertexCount) {
+                Logger::begin("VertexBuffer", Logger::LogLevel_Error) << filename << " has an index past its "
+                    << header->vertexCount << " vertexes" << Logger::end();
+                return false;
+            }
+        }
+        
+        size_t normalOffset = header->vertexOffset >= normalHeaderSize ? header->normalOffset : 0;
+        
+        if (normalOffset != 0 && normalOffset + (size_t) header->vertexCount * sizeof(glm::vec3) > length) {
+            normalOffset = 0;
+        }
+        
+        const BufferFormat* verts = (const BufferFormat*) &data[header->vertexOffset];
+        const glm::vec3* normals = normalOffset != 0 ? (const glm::vec3*) &data[normalOffset] : NULL;
+        
+        this->_vertexCount = header->vertexCount;
+        
+        if (keepMapped) {
+            this->_mappedVerts = verts;
+            this->_mappedNormals = normals;
+        } else {
+            this->_vertexBuffer.assign(verts, verts + header->vertexCount);
+            if (normals != NULL) {
+                this->_normalBuffer.assign(normals, normals + header->vertexCount);
+            }
+        }
+        
+        if (header->indexCount > 0) {
+            if (indexSize == sizeof(unsigned int) && keepMapped) {
+                this->_mappedIndexes = indexes;
+                this->_mappedIndexCount = header->indexCount;
+            } else if (indexSize == sizeof(unsigned int)) {
+                this->_indexBuffer.assign(indexes, indexes + header->indexCount);
+            } else {
+                this->_indexBuffer.assign(shortIndexes, shortIndexes + header->indexCount);
+            }
+        }
+        
+        this->_dirty = true;
+        this->_indexDirty = true;
+        this->_normalsDirty = true;
+        
+        return true;
+    }
+    
+    void VertexBuffer::_unmap() {
+        if (this->_mappedVerts != NULL) {
+            this->_vertexBuffer.assign(this->_mappedVerts, this->_mappedVerts + this->_vertexCount);
+        }
+        if (this->_mappedIndexes != NULL) {
+            this->_indexBuffer.assign(this->_mappedIndexes, this->_mappedIndexes + this->_mappedIndexCount);
+        }
+        if (this->_mappedNormals != NULL) {
+            this->_normalBuffer.assign(this->_mappedNormals, this->_mappedNormals + this->_vertexCount);
+        }
         
-        assert(header->magic[0] == 'E' &&
-               header->magic[1] == 'G' &&
-               header->magic[2] == 'L' &&
-               header->magic[3] == 'B');
+        this->_releaseMapping();
+    }
+    
+    void VertexBuffer::_releaseMapping() {
+        if (this->_mappedRegion != NULL) {
+            this->_mappedRegion->_parent->UnmapRegion(this->_mappedRegion);
+        }
         
-        this->_vertexBuffer.insert(this->_vertexBuffer.end(),
-            (BufferFormat*) &buff[header->vertexOffset],
-            (BufferFormat*) &buff[header->vertexOffset + (header->vertexCount * sizeof(BufferFormat))]);
+        // mappings from packages share the package's file
+        if (this->_mappedFile != NULL) {
+            this->_mappedFile->Close();
+            delete this->_mappedFile;
+        }
         
-        this->_vertexCount = header->indexCount;
+        this->_mappedFile = NULL;
+        this->_mappedRegion = NULL;
+        this->_mappedVerts = NULL;
+        this->_mappedIndexes = NULL;
+        this->_mappedNormals = NULL;
+        this->_mappedIndexCount = 0;
     }
     
     void VertexBuffer::SetProjectionType(ProjectionType t) {
         this->_projectionType = t;
     }
     
+    void VertexBuffer::SetUsageMode(UsageMode mode) {
+        if (mode != UsageMode::Static && this->_renderGL->GetOpenGLVersion().major < 3) {
+            mode = UsageMode::Static; // glMapBufferRange is core from OpenGL 3.0
+        }
+        
+        if (mode == UsageMode::PersistentStreaming && !this->_renderGL->HasExtention("GL_ARB_buffer_storage")) {
+            Logger::begin("VertexBuffer", Logger::LogLevel_Verbose) << "GL_ARB_buffer_storage not supported, falling back to orphaned streaming" << Logger::end();
+            mode = UsageMode::Streaming;
+        }
+        
+        if (mode == this->_usageMode) {
+            return;
+        }
+        
+        // Storage allocated for the last mode may be immutable so start from a fresh buffer object
+        this->_releaseStream();
+        glDeleteBuffers(1, &this->_vertexBufferPointer);
+        glGenBuffers(1, &this->_vertexBufferPointer);
+        this->Invalidate();
+        
+        this->_usageMode = mode;
+        this->_dirty = true;
+        
+        this->_renderGL->CheckError("VertexBuffer::SetUsageMode::Post");
+    }
+    
+    void VertexBuffer::SetVertexLayout(VertexLayout layout) {
+        this->_hasLayoutOverride = true;
+        this->_layoutOverride = layout;
+        
+        this->_setVertexLayout(layout);
+    }
+    
+    void VertexBuffer::_setVertexLayout(VertexLayout layout) {
+        if (layout == VertexLayout::Compact2D && this->_renderGL->GetOpenGLVersion().major < 3) {
+            layout = VertexLayout::Full3D; // GL_HALF_FLOAT attributes are core from OpenGL 3.0
+        }
+        
+        if (layout == this->_vertexLayout) {
+            return;
+        }
+        
+        // Stream offsets are counted in vertexes so a new stride needs fresh storage
+        this->_releaseStream();
+        glDeleteBuffers(1, &this->_vertexBufferPointer);
+        glGenBuffers(1, &this->_vertexBufferPointer);
+        this->Invalidate();
+        
+        this->_vertexLayout = layout;
+        this->_dirty = true;
+        
+        this->_renderGL->CheckError("VertexBuffer::SetVertexLayout::Post");
+    }
+    
     void VertexBuffer::SetLookAtView(glm::vec3 source, glm::vec3 target) {
         this->_view = glm::lookAt(source, target, glm::vec3(0.0f, 0.0f, 1.0f));
     }
@@ -311,28 +979,265 @@ namespace Engine {
     void VertexBuffer::ComputeNormals(PolygonMode polygonFormat) {
         ENGINE_PROFILER_SCOPE;
         
-        // TODO: Load them into the normal buffer insteed of the color buffer
         if (polygonFormat != PolygonMode::Triangles) return;
         
-        glm::vec3 *normals = new glm::vec3[this->_vertexCount];
+        if (this->_mappedRegion != NULL) this->_unmap();
+        
+        this->_normalBuffer.resize(this->_vertexCount);
+        
+        GenerateNormals(this->_vertexData(), this->_vertexCount,
+                        this->IsIndexed() ? this->_indexData() : NULL, this->GetIndexCount(), this->_normalBuffer.data());
+        
+        this->_normalsDirty = true;
+    }
+    
+    void VertexBuffer::GenerateNormals(const BufferFormat* verts, size_t vertexCount,
+                                       const unsigned int* indexes, size_t indexCount, glm::vec3* normals) {
+        ENGINE_PROFILER_SCOPE;
+        
+        std::fill(normals, normals + vertexCount, glm::vec3(0.0f));
+        
+        size_t triangleVerts = indexes != NULL ? indexCount : vertexCount;
+        
+        // calculate normals, shared vertexes in indexed buffers are smoothed
+        for (size_t i = 0; i + 2 < triangleVerts; i += 3) {
+            size_t a = indexes != NULL ? indexes[i + 0] : i + 0;
+            size_t b = indexes != NULL ? indexes[i + 1] : i + 1;
+            size_t c = indexes != NULL ? indexes[i + 2] : i + 2;
+            // weighted by area since the cross product isn't normalized
+            glm::vec3 faceNormal = glm::cross(
+                (verts[c].pos - verts[b].pos),
+                (verts[a].pos - verts[b].pos));
+            normals[a] += faceNormal;
+            normals[b] += faceNormal;
+            normals[c] += faceNormal;
+        }
+        
+        for (size_t i = 0; i < vertexCount; i++) {
+            float length = glm::length(normals[i]);
+            normals[i] = length > 0.0f ? normals[i] / length : glm::vec3(0.0f, 0.0f, 1.0f);
+        }
+    }
+    
+    void VertexBuffer::Optimize() {
+        ENGINE_PROFILER_SCOPE;
+        
+        if (this->_vertexCount == 0) return;
+        
+        if (this->_mappedRegion != NULL) this->_unmap();
+        
+        size_t oldVertexCount = this->_vertexCount;
+        
+        // without indexes every vertex is transformed once per triangle
+        float oldACMR = this->IsIndexed() ? GetACMR(this->_indexBuffer, this->_vertexCount) : 3.0f;
+        
+        this->_vertexCount = DeduplicateVerts(this->_vertexBuffer, this->_vertexCount, this->_indexBuffer);
+        OptimizeVertexCache(this->_indexBuffer, this->_vertexCount);
+        OptimizeVertexFetch(this->_vertexBuffer, this->_vertexCount, this->_indexBuffer);
+        this->_vertexCount = this->_vertexBuffer.size();
+        
+        // the old normals no longer line up with the vertexes
+        if (!this->_normalBuffer.empty()) {
+            this->_normalBuffer.resize(this->_vertexCount);
+            GenerateNormals(this->_vertexData(), this->_vertexCount, this->_indexData(), this->GetIndexCount(), this->_normalBuffer.data());
+            this->_normalsDirty = true;
+        }
+        
+        Logger::begin("VertexBuffer", Logger::LogLevel_Verbose) << "VertexBuffer[" << Platform::StringifyUUID(this->_uuid) << "] optimized "
+            << oldVertexCount << " -> " << this->_vertexCount << " vertexes | ACMR " << oldACMR << " -> "
+            << GetACMR(this->_indexBuffer, this->_vertexCount) << Logger::end();
+        
+        this->_dirty = true;
+        this->_indexDirty = true;
+    }
+    
+    struct _vertexHash {
+        size_t operator()(const BufferFormat* vert) const {
+            // FNV-1a over the raw bytes, vertexes are only merged when every byte matches
+            const unsigned char* bytes = (const unsigned char*) vert;
+            size_t hash = 2166136261u;
+            for (size_t i = 0; i < sizeof(BufferFormat); i++) {
+                hash = (hash ^ bytes[i]) * 16777619u;
+            }
+            return hash;
+        }
+    };
+    
+    struct _vertexEqual {
+        bool operator()(const BufferFormat* a, const BufferFormat* b) const {
+            return std::memcmp(a, b, sizeof(BufferFormat)) == 0;
+        }
+    };
+    
+    size_t VertexBuffer::DeduplicateVerts(VertexStoreRef verts, size_t vertexCount, IndexStoreRef indexes) {
+        ENGINE_PROFILER_SCOPE;
+        
+        if (indexes.empty()) {
+            indexes.resize(vertexCount);
+            for (size_t i = 0; i < vertexCount; i++) {
+                indexes[i] = (unsigned int) i;
+            }
+        }
+        
+        std::unordered_map<const BufferFormat*, unsigned int, _vertexHash, _vertexEqual> unique;
+        unique.reserve(vertexCount);
+        
+        std::vector<unsigned int> remap(vertexCount);
+        
+        VertexStore uniqueVerts;
+        uniqueVerts.reserve(vertexCount);
+        
+        for (size_t i = 0; i < vertexCount; i++) {
+            auto result = unique.insert(std::make_pair(&verts[i], (unsigned int) uniqueVerts.size()));
+            if (result.second) {
+                uniqueVerts.push_back(verts[i]);
+            }
+            remap[i] = result.first->second;
+        }
+        
+        for (auto iter = indexes.begin(); iter != indexes.end(); iter++) {
+            *iter = remap[*iter];
+        }
+        
+        verts.swap(uniqueVerts);
+        
+        return verts.size();
+    }
+    
+    void VertexBuffer::OptimizeVertexCache(IndexStoreRef indexes, size_t vertexCount, unsigned int cacheSize) {
+        ENGINE_PROFILER_SCOPE;
+        
+        size_t triangleCount = indexes.size() / 3;
+        
+        if (triangleCount == 0 || vertexCount == 0) return;
+        
+        // triangles using each vertex, packed with an offset table
+        std::vector<unsigned int> liveTriangles(vertexCount, 0);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            liveTriangles[indexes[i]]++;
+        }
+        
+        std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+        for (size_t i = 0; i < vertexCount; i++) {
+            adjacencyOffset[i + 1] = adjacencyOffset[i] + liveTriangles[i];
+        }
+        
+        std::vector<unsigned int> adjacency(triangleCount * 3);
+        std::vector<unsigned int> adjacencyFill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (size_t i = 0; i < triangleCount * 3; i++) {
+            adjacency[adjacencyFill[indexes[i]]++] = (unsigned int) (i / 3);
+        }
+        
+        std::vector<unsigned int> cacheTime(vertexCount, 0);
+        std::vector<bool> emitted(triangleCount, false);
+        std::vector<unsigned int> deadEnds;
+        std::vector<unsigned int> candidates;
+        
+        IndexStore output;
+        output.reserve(triangleCount * 3);
+        
+        unsigned int time = cacheSize + 1;
+        size_t cursor = 0;
+        long fanning = 0;
+        
+        while (fanning >= 0) {
+            candidates.clear();
+            
+            for (unsigned int i = adjacencyOffset[fanning]; i < adjacencyOffset[fanning + 1]; i++) {
+                unsigned int triangle = adjacency[i];
+                if (emitted[triangle]) continue;
+                
+                for (int x = 0; x < 3; x++) {
+                    unsigned int vert = indexes[triangle * 3 + x];
+                    output.push_back(vert);
+                    deadEnds.push_back(vert);
+                    candidates.push_back(vert);
+                    liveTriangles[vert]--;
+                    if (time - cacheTime[vert] > cacheSize) {
+                        cacheTime[vert] = time++;
+                    }
+                }
+                
+                emitted[triangle] = true;
+            }
+            
+            // pick the candidate that will still be in the cache after its remaining triangles are emitted
+            fanning = -1;
+            int bestPriority = -1;
+            for (auto iter = candidates.begin(); iter != candidates.end(); iter++) {
+                if (liveTriangles[*iter] == 0) continue;
+                
+                int priority = 0;
+                if (time - cacheTime[*iter] + 2 * liveTriangles[*iter] <= cacheSize) {
+                    priority = time - cacheTime[*iter];
+                }
+                
+                if (priority > bestPriority) {
+                    bestPriority = priority;
+                    fanning = *iter;
+                }
+            }
+            
+            // otherwise fall back to the most recently used vertex with triangles left, then to the next in order
+            while (fanning < 0 && !deadEnds.empty()) {
+                unsigned int vert = deadEnds.back();
+                deadEnds.pop_back();
+                if (liveTriangles[vert] > 0) {
+                    fanning = vert;
+                }
+            }
+            
+            while (fanning < 0 && cursor < vertexCount) {
+                if (liveTriangles[cursor] > 0) {
+                    fanning = cursor;
+                }
+                cursor++;
+            }
+        }
+        
+        // anything after the last whole triangle is kept as it was
+        output.insert(output.end(), indexes.begin() + triangleCount * 3, indexes.end());
+        
+        indexes.swap(output);
+    }
+    
+    void VertexBuffer::OptimizeVertexFetch(VertexStoreRef verts, size_t vertexCount, IndexStoreRef indexes) {
+        ENGINE_PROFILER_SCOPE;
+        
+        static const unsigned int unused = std::numeric_limits<unsigned int>::max();
         
-        // calculate normals
-        for (int i = 0; i < this->_vertexCount; i += 3) {
-            glm::vec3 faceNormal = glm::normalize(glm::cross(
-                (this->_vertexBuffer[i + 2].pos - this->_vertexBuffer[i + 1].pos),
-                (this->_vertexBuffer[i + 0].pos - this->_vertexBuffer[i + 1].pos)));
-            normals[i + 0] += faceNormal;
-            normals[i + 1] += faceNormal;
-            normals[i + 2] += faceNormal;
+        std::vector<unsigned int> remap(vertexCount, unused);
+        
+        VertexStore orderedVerts;
+        orderedVerts.reserve(vertexCount);
+        
+        for (auto iter = indexes.begin(); iter != indexes.end(); iter++) {
+            if (remap[*iter] == unused) {
+                remap[*iter] = (unsigned int) orderedVerts.size();
+                orderedVerts.push_back(verts[*iter]);
+            }
+            *iter = remap[*iter];
         }
         
-        // normalize the normals and load them into the buffer
-        for (int i = 0; i < this->_vertexCount; i++) {
-            normals[i] = glm::normalize(normals[i]);
-            this->_vertexBuffer[i].col = Color4f(normals[i].x, normals[i].y, normals[i].z, 1.0f);
+        // vertexes no index uses are dropped
+        verts.swap(orderedVerts);
+    }
+    
+    float VertexBuffer::GetACMR(IndexStoreRef indexes, size_t vertexCount, unsigned int cacheSize) {
+        if (indexes.size() < 3) return 0.0f;
+        
+        // FIFO cache, a vertex is in the cache if it was added in the last cacheSize misses
+        std::vector<size_t> addedAt(vertexCount, 0);
+        size_t misses = 0;
+        
+        for (auto iter = indexes.begin(); iter != indexes.end(); iter++) {
+            if (addedAt[*iter] == 0 || misses - addedAt[*iter] >= cacheSize) {
+                misses++;
+                addedAt[*iter] = misses;
+            }
         }
         
-        delete [] normals;
+        return (float) misses / (indexes.size() / 3);
     }
     
     void VertexBuffer::_begin() {
@@ -360,15 +1265,28 @@ namespace Engine {
         
         ShaderSettings settings = this->_currentEffect->GetShaderSettings();
         
-        this->_getShader()->BindUniform(settings.modelMatrixParam);
-        this->_getShader()->BindUniform(settings.viewMatrixParam);
-        this->_getShader()->BindUniform(settings.projectionMatrixParam);
+        this->_modelUniform = this->_getShader()->BindUniform(settings.modelMatrixParam);
+        this->_viewUniform = this->_getShader()->BindUniform(settings.viewMatrixParam);
+        this->_projectionUniform = this->_getShader()->BindUniform(settings.projectionMatrixParam);
         
         this->GetRender()->CheckError("VertexBuffer::Upload::PostBindViewpointSize");
         
-        this->_getShader()->BindVertexAttrib(settings.vertexParam, 3, 10, 0);
-        this->_getShader()->BindVertexAttrib(settings.colorParam, 4, 10, 3);
-        this->_getShader()->BindVertexAttrib(settings.texCoardParam, 3, 10, 7);
+        if (this->_vertexLayout == VertexLayout::Compact2D) {
+            size_t stride = sizeof(CompactBufferFormat);
+            this->_getShader()->BindVertexAttrib(settings.vertexParam, 2, GL_FLOAT, false, stride, offsetof(CompactBufferFormat, x));
+            this->_getShader()->BindVertexAttrib(settings.colorParam, 4, GL_UNSIGNED_BYTE, true, stride, offsetof(CompactBufferFormat, col));
+            this->_getShader()->BindVertexAttrib(settings.texCoardParam, 3, GL_HALF_FLOAT, false, stride, offsetof(CompactBufferFormat, uv));
+        } else {
+            this->_getShader()->BindVertexAttrib(settings.vertexParam, 3, 10, 0);
+            this->_getShader()->BindVertexAttrib(settings.colorParam, 4, 10, 3);
+            this->_getShader()->BindVertexAttrib(settings.texCoardParam, 3, 10, 7);
+        }
+        
+        if (!settings.normalParam.empty() && this->HasNormals()) {
+            glBindBuffer(GL_ARRAY_BUFFER, this->_normalBufferPointer);
+            this->_getShader()->BindVertexAttrib(settings.normalParam, 3, 3, 0);
+            glBindBuffer(GL_ARRAY_BUFFER, this->_vertexBufferPointer);
+        }
         
         this->GetRender()->CheckError("VertexBuffer::Upload::PostBindVertexAttributes");
         
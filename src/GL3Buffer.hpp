@@ -21,6 +21,8 @@
 
 #pragma once
 
+#include <algorithm>
+
 #include "Shader.hpp"
 #include "RenderDriver.hpp"
 
@@ -28,6 +30,8 @@ namespace Engine {
     class Shader;
     class RenderGL3;
     
+    ENGINE_CLASS(Package);
+    
     /*
      Buffer format
      (x, y, z)      Position
@@ -43,9 +47,21 @@ namespace Engine {
         Color4f col;
         glm::vec3 uv;
     };
+    
+    // GPU side format for VertexLayout::Compact2D. z is dropped, the color is clamped to
+    // 8 bits and the texcoord and texture id are half floats so tiling past 1 still works.
+    // Half floats step by 1/2048 just below 1, so atlas pages are kept to TextureAtlas::MaxCompactPageSize.
+    struct CompactBufferFormat {
+        float x, y;
+        unsigned char col[4];
+        unsigned short uv[3];
+        unsigned short pad;
+    };
 #pragma pack(pop)
     
-    // .eglb format
+    // .eglb format, indexes are written 32 bit. The header size is found from vertexOffset:
+    // files written before normalOffset was added have 16 bit indexes and files written
+    // before indexSize was added have 32 bit indexes.
     struct VertexBufferDiskFormat {
         unsigned char magic[4];
         
@@ -54,13 +70,19 @@ namespace Engine {
         
         unsigned int indexOffset;
         unsigned int indexCount;
+        
+        unsigned int normalOffset; // 0 when there are no normals, otherwise vertexCount normals
+        
+        unsigned int indexSize; // bytes per index, 2 or 4
     };
     
     typedef std::vector<BufferFormat> VertexStore;
-    typedef std::vector<unsigned short> IndexStore;
+    typedef std::vector<unsigned int> IndexStore;
+    typedef std::vector<glm::vec3> NormalStore;
     
     typedef VertexStore& VertexStoreRef;
     typedef IndexStore& IndexStoreRef;
+    typedef NormalStore& NormalStoreRef;
     
     // Very temporory until I have a better API to do it.
     struct Camera {
@@ -76,6 +98,12 @@ namespace Engine {
             Perspective
         };
         
+        enum class UsageMode {
+            Static,                 // Reallocated with glBufferData on every upload
+            Streaming,              // Ring buffer written with unsynchronized maps, orphaned on wrap
+            PersistentStreaming     // Ring buffer mapped once with GL_ARB_buffer_storage, fenced on reuse
+        };
+        
         VertexBuffer();
 		VertexBuffer(RenderDriverPtr render, EffectParametersPtr params);
 		~VertexBuffer();
@@ -84,8 +112,8 @@ namespace Engine {
         void Init(RenderDriverPtr render, EffectParametersPtr params);
 
 		inline void AddVert(glm::vec3 pos, Color4f col, glm::vec2 uv, int texId = 2) {
-			if (this->_vertexCount > 100 && this->_vertexBuffer.capacity() < this->_vertexCount + 1) {
-				this->_vertexBuffer.reserve(this->_vertexCount * 2);
+			if (this->_vertexBuffer.size() <= this->_vertexCount) {
+				this->_grow();
 			}
 			this->_vertexBuffer[this->_vertexCount].pos = pos;
 			this->_vertexBuffer[this->_vertexCount].col = col;
@@ -101,6 +129,41 @@ namespace Engine {
 			static Color4f colorWhite = Color4f(1.f, 1.f, 1.f, 1.f);
 			this->AddVert(pos, colorWhite, glm::vec2(0, 0));
 		}
+
+        void AddVerts(const BufferFormat* verts, size_t count);
+        
+        // Once a buffer has indexes Draw uses them instead of drawing every vertex in order
+        inline void AddIndex(unsigned int index) {
+            if (this->_mappedRegion != NULL) this->_unmap();
+            this->_indexBuffer.push_back(index);
+            this->_indexDirty = true;
+        }
+        
+        void AddIndexes(const unsigned int* indexes, size_t count);
+        
+        bool IsIndexed() {
+            return this->GetIndexCount() > 0;
+        }
+        
+        size_t GetIndexCount() {
+            return this->_mappedIndexes != NULL ? this->_mappedIndexCount : this->_indexBuffer.size();
+        }
+        
+        // Normals go in their own buffer and are bound to the effect's "normal" vertexBufferParam.
+        // They are only drawn from Static buffers.
+        void SetNormals(const glm::vec3* normals, size_t count);
+        
+        bool HasNormals() {
+            return this->_mappedNormals != NULL || !this->_normalBuffer.empty();
+        }
+        
+        // Multiplies the position of every vertex from start onwards by model. Lets the
+        // renderer bake the camera into vertexes instead of drawing before each change.
+        void TransformVerts(size_t start, const glm::mat4& model);
+        
+        size_t GetVertexCount() {
+            return this->_vertexCount;
+        }
         
         void Reset();
         
@@ -115,6 +178,12 @@ namespace Engine {
         
         void Save(std::string filename);
         void Load(std::string filename);
+        
+        // Memory maps the file from disk or from inside an uncompressed .epkg entry and uploads
+        // straight from the mapping. The mapping is kept for reuploads and copied into the buffer
+        // the first time it's edited. Falls back to Load if the file can't be mapped.
+        bool LoadMapped(std::string filename);
+        bool LoadMapped(PackagePtr package, std::string filename);
 
         void SetDepthTest(bool depthTest) {
             this->_depthTest = depthTest;
@@ -123,10 +192,60 @@ namespace Engine {
             this->_wireframe = wireframe;
         }
         void SetProjectionType(ProjectionType t);
+        
+        // Falls back to Streaming if GL_ARB_buffer_storage is not supported
+        void SetUsageMode(UsageMode mode);
+        UsageMode GetUsageMode() {
+            return this->_usageMode;
+        }
+        
+        // Vertexes are always stored as BufferFormat and packed on upload. Compact2D needs
+        // OpenGL 3.0 for half float attributes and falls back to Full3D without it.
+        void SetVertexLayout(VertexLayout layout);
+        VertexLayout GetVertexLayout() {
+            return this->_vertexLayout;
+        }
+        
+        // Bytes per vertex on the GPU
+        size_t GetVertexSize() {
+            return this->_vertexLayout == VertexLayout::Compact2D ? sizeof(CompactBufferFormat) : sizeof(BufferFormat);
+        }
         void SetLookAtView(glm::vec3 source, glm::vec3 target);
         
+        // Fills the normal channel, the vertex colors are left alone
         void ComputeNormals(PolygonMode polygonFormat);
         
+        // Merges identical vertexes into an indexed triangle list and orders it for the post
+        // transform cache. Buffers without indexes are treated as a triangle list.
+        void Optimize();
+        
+        // These work on plain arrays so they can be used without a GL context
+        
+        // Returns the new vertex count, indexes are created if there aren't any
+        static size_t DeduplicateVerts(VertexStoreRef verts, size_t vertexCount, IndexStoreRef indexes);
+        
+        // Tipsify from "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", Sander et al. 2007
+        static void OptimizeVertexCache(IndexStoreRef indexes, size_t vertexCount, unsigned int cacheSize = 16);
+        
+        // Orders vertexes by first use so they are fetched in order
+        static void OptimizeVertexFetch(VertexStoreRef verts, size_t vertexCount, IndexStoreRef indexes);
+        
+        // Average cache miss ratio, transformed vertexes per triangle with a FIFO cache. 0.5 is the best possible for large grids.
+        static float GetACMR(IndexStoreRef indexes, size_t vertexCount, unsigned int cacheSize = 16);
+        
+        // Converts to the Compact2D layout, dest must hold count vertexes
+        static void PackCompactVerts(const BufferFormat* verts, size_t count, CompactBufferFormat* dest);
+        
+        // Writes a .eglb file into dest which must hold GetDiskSize bytes, normals can be NULL
+        static size_t GetDiskSize(size_t vertexCount, size_t indexCount, bool hasNormals);
+        static void WriteDiskFormat(unsigned char* dest, const BufferFormat* verts, size_t vertexCount,
+                                    const unsigned int* indexes, size_t indexCount, const glm::vec3* normals);
+        
+        // Smooth normals from the face normals around each vertex. indexes can be NULL for a
+        // plain triangle list. normals must hold vertexCount entries.
+        static void GenerateNormals(const BufferFormat* verts, size_t vertexCount,
+                                    const unsigned int* indexes, size_t indexCount, glm::vec3* normals);
+        
         RenderDriverPtr GetRender() {
             return this->_renderGL;
         }
@@ -139,6 +258,7 @@ namespace Engine {
 		Platform::UUID _uuid;
 
         void _init();
+        void _setVertexLayout(VertexLayout layout);
         void _shutdown();
         ShaderPtr _getShader();
         
@@ -148,6 +268,31 @@ namespace Engine {
 		void bindShader();
         
 		void _upload();
+        void _uploadIndexes(unsigned int indexBase);
+        void _uploadNormals();
+        void _uploadStreaming();
+        void _writeVertexes(void* dest);
+        
+        void _grow();
+        bool _loadFromMemory(const unsigned char* data, size_t length, std::string filename, bool keepMapped);
+        void _unmap();
+        void _releaseMapping();
+        
+        const BufferFormat* _vertexData() {
+            return this->_mappedVerts != NULL ? this->_mappedVerts : this->_vertexBuffer.data();
+        }
+        
+        const unsigned int* _indexData() {
+            return this->_mappedIndexes != NULL ? this->_mappedIndexes : this->_indexBuffer.data();
+        }
+        
+        const glm::vec3* _normalData() {
+            return this->_mappedNormals != NULL ? this->_mappedNormals : this->_normalBuffer.data();
+        }
+        
+        void _allocateStream(size_t capacity);
+        void _releaseStream();
+        void _waitStreamSegment(unsigned int segment);
         
         glm::vec4 _getCameraView();
         
@@ -158,10 +303,26 @@ namespace Engine {
         glm::mat4 _view;
         
         VertexStore _vertexBuffer;
+        std::vector<CompactBufferFormat> _compactBuffer; // scratch space for packing Static uploads
+        IndexStore _indexBuffer;
+        NormalStore _normalBuffer;
         
-        unsigned short _vertexCount = 0;
+        size_t _vertexCount = 0;
+        
+        unsigned int _indexBufferPointer = 0;
+        unsigned int _normalBufferPointer = 0;
+        
+        // Set by LoadMapped, these point into _mappedRegion instead of the stores above
+        Platform::MemoryMappedFilePtr _mappedFile = NULL; // only owned when mapped from disk
+        Platform::MemoryMappedRegionPtr _mappedRegion = NULL;
+        const BufferFormat* _mappedVerts = NULL;
+        const unsigned int* _mappedIndexes = NULL;
+        const glm::vec3* _mappedNormals = NULL;
+        size_t _mappedIndexCount = 0;
         
         bool _dirty = false;
+        bool _indexDirty = false;
+        bool _normalsDirty = false;
         bool _depthTest = false;
         bool _wireframe = false;
         
@@ -170,5 +331,35 @@ namespace Engine {
         EffectParametersPtr _currentEffect = NULL;
         
         bool _shaderBound = false;
+        
+        UniformHandle _modelUniform = InvalidUniform;
+        UniformHandle _viewUniform = InvalidUniform;
+        UniformHandle _projectionUniform = InvalidUniform;
+        
+        static const unsigned int StreamSegmentCount = 3;
+        
+        UsageMode _usageMode = UsageMode::Static;
+        VertexLayout _vertexLayout = VertexLayout::Full3D;
+        
+        // Set by SetVertexLayout, otherwise _init uses the effect's layout
+        bool _hasLayoutOverride = false;
+        VertexLayout _layoutOverride = VertexLayout::Full3D;
+        
+        size_t _streamCapacity = 0;
+        size_t _streamOffset = 0;
+        unsigned int _streamSegment = 0;
+        unsigned int _firstVertex = 0;
+        
+        // Without glDrawElementsBaseVertex the uploaded indexes are offset by the first vertex instead
+        bool _hasBaseVertex = false;
+        unsigned int _indexBase = 0;
+        IndexStore _rebasedIndexes;
+        
+        void* _streamPointer = NULL;
+        void* _streamFences[StreamSegmentCount] = {NULL, NULL, NULL}; // GLsync
+        
+        // Used when glMapBufferRange fails, the vertexes go through glBufferSubData instead
+        std::vector<unsigned char> _streamStaging;
+        bool _loggedMapFailure = false;
 	};
 }
\ No newline at end of file
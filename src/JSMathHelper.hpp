@@ -32,6 +32,8 @@ namespace Engine {
             static glm::vec4 FromJSVector(ScriptingManager::Factory& fac, v8::Handle<v8::Value> thisValue);
             static v8::Handle<v8::Object> ToJSVector(ScriptingManager::Factory& fac, glm::vec4 vec);
             static bool IsJSVector(ScriptingManager::Factory& fac, v8::Handle<v8::Value> value);
+            // Writes vec into an existing Vector so in place operations don't allocate a new wrapper
+            static void SetJSVector(ScriptingManager::Factory& fac, v8::Handle<v8::Object> obj, glm::vec4 vec);
             
             static void New(const v8::FunctionCallbackInfo<v8::Value>& _args);
             static void Add(const v8::FunctionCallbackInfo<v8::Value>& _args);
@@ -40,9 +42,19 @@ namespace Engine {
             static void Dot(const v8::FunctionCallbackInfo<v8::Value>& _args);
             static void Cross(const v8::FunctionCallbackInfo<v8::Value>& _args);
             static void Rotate(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void Length(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void Set(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void AddSelf(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void SubSelf(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void MulSelf(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void NormalizeSelf(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void Release(const v8::FunctionCallbackInfo<v8::Value>& _args);
             static void ToString(const v8::FunctionCallbackInfo<v8::Value>& _args);
             
             static void CreateInterface(v8::Isolate* isolate, v8::Handle<v8::Object> math_table);
+            
+        private:
+            bool _pooled = false;
         };
         
         
@@ -59,6 +71,10 @@ namespace Engine {
             static void Translate(const v8::FunctionCallbackInfo<v8::Value>& _args);
             static void Scale(const v8::FunctionCallbackInfo<v8::Value>& _args);
             static void Rotate(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void MulSelf(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void MulMat4Into(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void TransformPoints(const v8::FunctionCallbackInfo<v8::Value>& _args);
+            static void MulMatrices(const v8::FunctionCallbackInfo<v8::Value>& _args);
             static void ToString(const v8::FunctionCallbackInfo<v8::Value>& _args);
             
             static void CreateInterface(v8::Isolate* isolate, v8::Handle<v8::Object>math_table);
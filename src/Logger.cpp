@@ -21,9 +21,17 @@
 
 #include "Logger.hpp"
 
+#include <atomic>
+#include <cassert>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
 #include "Config.hpp"
 #include "Platform.hpp"
 #include "Events.hpp"
+#include "EventPayloads.hpp"
 
 #ifdef _PLATFORM_WIN32
 #include <Windows.h>
@@ -32,14 +40,109 @@
 
 namespace Engine {
     namespace Logger {
-        std::vector<LogEvent> _logEvents;
+        // Each thread formats into its own stream so Logger::begin can be used from any thread
+        struct ThreadStream {
+            std::ostringstream Stream;
+            std::string Domain;
+            LogLevel Level = LogLevel_Error;
+        };
+        
+        static ENGINE_THREAD_LOCAL ThreadStream* _threadStream = NULL;
+        
+        // Every stream begin has created so Shutdown can free them, the main thread uses
+        // _shutdownStream for anything it logs after that
+        static std::mutex _threadStreamsMutex;
+        static std::vector<ThreadStream*> _threadStreams;
+        static bool _threadStreamsReleased = false;
+        static ThreadStream _shutdownStream;
+        
+        // Based on the same bounded queue as EventQueue, lines are moved in by any thread and out by the writer
+        class LogQueue {
+        public:
+            LogQueue(size_t capacity) : _cells(capacity), _mask(capacity - 1) {
+                assert((capacity & this->_mask) == 0);
+                for (size_t i = 0; i < capacity; i++) {
+                    this->_cells[i].sequence.store(i, std::memory_order_relaxed);
+                }
+                this->_enqueuePos.store(0, std::memory_order_relaxed);
+                this->_dequeuePos.store(0, std::memory_order_relaxed);
+            }
+            
+            bool TryPush(LogEvent& e) {
+                Cell* cell;
+                size_t pos = this->_enqueuePos.load(std::memory_order_relaxed);
+                while (true) {
+                    cell = &this->_cells[pos & this->_mask];
+                    intptr_t diff = (intptr_t) cell->sequence.load(std::memory_order_acquire) - (intptr_t) pos;
+                    if (diff == 0) {
+                        if (this->_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    } else if (diff < 0) {
+                        return false; // full
+                    } else {
+                        pos = this->_enqueuePos.load(std::memory_order_relaxed);
+                    }
+                }
+                cell->event = std::move(e);
+                cell->sequence.store(pos + 1, std::memory_order_release);
+                return true;
+            }
+            
+            bool TryPop(LogEvent& e) {
+                Cell* cell;
+                size_t pos = this->_dequeuePos.load(std::memory_order_relaxed);
+                while (true) {
+                    cell = &this->_cells[pos & this->_mask];
+                    intptr_t diff = (intptr_t) cell->sequence.load(std::memory_order_acquire) - (intptr_t) (pos + 1);
+                    if (diff == 0) {
+                        if (this->_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+                    } else if (diff < 0) {
+                        return false; // empty
+                    } else {
+                        pos = this->_dequeuePos.load(std::memory_order_relaxed);
+                    }
+                }
+                e = std::move(cell->event);
+                cell->sequence.store(pos + this->_mask + 1, std::memory_order_release);
+                return true;
+            }
+            
+        private:
+            struct Cell {
+                std::atomic<size_t> sequence;
+                LogEvent event;
+            };
+            
+            std::vector<Cell> _cells;
+            size_t _mask;
+            
+            char _pad0[64];
+            std::atomic<size_t> _enqueuePos;
+            char _pad1[64];
+            std::atomic<size_t> _dequeuePos;
+        };
+        
+        static const size_t LogQueueSize = 8192;
+        
+        LogQueue* _logQueue = NULL;
         
-        bool _enableColor = false;
+        // Lines that have been queued but not written yet
+        std::atomic<size_t> _pendingLines(0);
+        std::atomic<size_t> _droppedLines(0);
         
-        std::ostringstream _ss;
+        Platform::ThreadPtr _writerThread = NULL;
+        std::atomic<bool> _writerRunning(false);
+        std::atomic<bool> _writerStopped(true);
         
-        std::string _currentDomain;
-        LogLevel _currentLogLevel;
+        // Bounded history read by EngineUI and DumpAllEvents, guarded by _logMutex
+        std::deque<LogEvent> _logEvents;
+        
+        // Resolved from the config once when it changes instead of on every line
+        std::atomic<bool> _logConsole(true);
+        std::atomic<bool> _logVerbose(false);
+        std::atomic<bool> _onlyHighlight(false);
+        std::atomic<bool> _showColors(false);
+        std::atomic<bool> _asyncEnabled(false);
+        std::atomic<size_t> _historySize(10000);
         
         double _startTime = -1;
         
@@ -47,11 +150,18 @@ namespace Engine {
         
         bool _enableEvents = false;
         
+        void _startWriter();
+        void _stopWriter();
+        
         std::ostream& operator<<(std::ostream& os, const StreamFlusher& rhs) {
-			LogText(_currentDomain, _currentLogLevel, _ss.str());
-            _ss.str("");
-            _currentDomain = "";
-            _currentLogLevel = LogLevel_Error;
+            ThreadStream* stream = _threadStream;
+            if (stream == NULL) {
+                return os.flush();
+            }
+			LogText(stream->Domain, stream->Level, stream->Stream.str());
+            stream->Stream.str("");
+            stream->Domain = "";
+            stream->Level = LogLevel_Error;
             return os.flush();
         }
         
@@ -106,12 +216,71 @@ namespace Engine {
 #endif
         }
         
+        void _updateConfig() {
+            _logConsole = Config::GetBoolean("core.log.enableConsole");
+            _logVerbose = Config::GetBoolean("core.log.levels.verbose");
+            _onlyHighlight = Config::GetBoolean("core.log.levels.onlyHighlight");
+            _showColors = Config::GetBoolean("core.log.showColors");
+            _asyncEnabled = Config::GetBoolean("core.log.async");
+            if (Config::GetInt("core.log.historySize") > 0) {
+                _historySize = Config::GetInt("core.log.historySize");
+            }
+        }
+        
+        EventMagic _configChanged(Json::Value args, void* userPointer) {
+            _updateConfig();
+            if (_asyncEnabled && !_writerRunning) {
+                _startWriter();
+            } else if (!_asyncEnabled && _writerRunning) {
+                _stopWriter();
+            }
+            return EM_OK;
+        }
+        
         void Init() {
             _logMutex = Platform::CreateMutex();
+            _logQueue = new LogQueue(LogQueueSize);
         }
         
         void EnableLoggerEvents() {
             _enableEvents = true;
+            
+            const char* configKeys[] = {
+                "core.log.enableConsole", "core.log.levels.verbose", "core.log.levels.onlyHighlight",
+                "core.log.showColors", "core.log.async", "core.log.historySize"
+            };
+            
+            for (size_t i = 0; i < sizeof(configKeys) / sizeof(configKeys[0]); i++) {
+                GetEventsSingilton()->GetEvent(std::string("config:") + configKeys[i])->AddListener("Logger::_configChanged", EventEmitter::MakeTarget(_configChanged));
+            }
+            
+            _configChanged(Json::nullValue, NULL);
+        }
+        
+        void Shutdown() {
+            if (_writerRunning) {
+                _stopWriter();
+            }
+            
+            // the other threads have exited so nothing else points at their streams
+            std::lock_guard<std::mutex> lock(_threadStreamsMutex);
+            for (auto iter = _threadStreams.begin(); iter != _threadStreams.end(); iter++) {
+                delete *iter;
+            }
+            _threadStreams.clear();
+            _threadStreamsReleased = true;
+            _threadStream = NULL;
+        }
+        
+        void ReleaseThread() {
+            if (_threadStream == NULL || _threadStream == &_shutdownStream) {
+                return;
+            }
+            
+            std::lock_guard<std::mutex> lock(_threadStreamsMutex);
+            _threadStreams.erase(std::find(_threadStreams.begin(), _threadStreams.end(), _threadStream));
+            delete _threadStream;
+            _threadStream = NULL;
         }
         
         std::string GetLevelString(LogLevel level) {
@@ -151,6 +320,11 @@ namespace Engine {
             return str;
         }
         
+        LogEvent::LogEvent()
+        :   Level(LogLevel_Log), Type(LogType_Text), Hidden(false), time(0) {
+            
+        }
+        
         LogEvent::LogEvent(std::string domain, LogLevel level, std::string event)
         :   Domain(domain), Level(level), Type(LogType_Text), Event(event), Hidden(false) {
             this->time = Platform::GetTime();
@@ -162,124 +336,226 @@ namespace Engine {
             return ss.str();
         }
         
-        void LogText(std::string domain, LogLevel level, std::string str) {
-            bool logConsole = Config::GetBoolean("core.log.enableConsole")
-                && (level != LogLevel_Verbose || Config::GetBoolean("core.log.levels.verbose"));
-            if (logConsole && Config::GetBoolean("core.log.levels.onlyHighlight")) {
-                if (level == LogLevel_Highlight || level == LogLevel_Toast ||
-                    level == LogLevel_TestError || level == LogLevel_TestLog) {
-                    logConsole = true;
-                } else {
-                    logConsole = false;
+        bool _shouldLogConsole(LogLevel level) {
+            if (!_logConsole || (level == LogLevel_Verbose && !_logVerbose)) {
+                return false;
+            }
+            if (_onlyHighlight) {
+                return level == LogLevel_Highlight || level == LogLevel_Toast ||
+                    level == LogLevel_TestError || level == LogLevel_TestLog;
+            }
+            return true;
+        }
+        
+        // Called with _logMutex held
+        void _writeEvent(LogEvent& e) {
+            if (_shouldLogConsole(e.Level)) {
+                bool showColors = _showColors;
+                if (showColors) {
+                    SetConsoleColor(false, e.Level);
+                }
+                printf("%s", e.FormatConsole().c_str());
+                if (showColors) {
+                    SetConsoleColor(true, e.Level);
                 }
+                printf("\n");
             }
-
-            bool showColors = Config::GetBoolean("core.log.showColors");
             
-            _logMutex->Enter();
+            try {
+                _logEvents.push_back(std::move(e));
+            } catch (std::exception e) {
+                std::cout << "Could not log: " << e.what() << std::endl;
+            }
             
-            if (_enableEvents) {
-                Json::Value args(Json::objectValue);
-                args["domain"] = domain;
-                args["level"] = GetLevelString(level);
-                args["str"] = str;
-                args["isToast"] = (level == LogLevel_Toast);
-                GetEventsSingilton()->GetEvent("logEvent")->Emit(args);
+            while (_logEvents.size() > _historySize) {
+                _logEvents.pop_front();
             }
+        }
+        
+        void* _writerMain(void* args) {
+            LogEvent e;
+            size_t dropped = 0;
             
-            if (str.find('\n') == -1) {
-                std::string newStr = cleanString(str);
-                
-                LogEvent newEvent(domain, level, newStr);
+            while (true) {
+                bool wrote = false;
                 
-                try {
-                    _logEvents.push_back(newEvent);
-                } catch (std::exception e) {
-                    std::cout << "Could not log: " << e.what() << std::endl;
+                _logMutex->Enter();
+                for (int i = 0; i < 256 && _logQueue->TryPop(e); i++) {
+                    _writeEvent(e);
+                    _pendingLines--;
+                    wrote = true;
                 }
-
-                if (logConsole) {
-					if (showColors) {
-						SetConsoleColor(false, level);
-					}
-					printf("%s", newEvent.FormatConsole().c_str());
-					if (showColors) {
-						SetConsoleColor(true, level);
-					}
-                    printf("\n");
+                
+                if ((dropped = _droppedLines.exchange(0)) > 0) {
+                    std::stringstream ss;
+                    ss << "Dropped " << dropped << " verbose lines while the log queue was full";
+                    LogEvent droppedEvent("Logger", LogLevel_Warning, ss.str());
+                    _writeEvent(droppedEvent);
                 }
-            } else {
-                std::string strCopy = str;
-                std::size_t newLinePos = strCopy.find('\n');
+                _logMutex->Exit();
                 
-                while (newLinePos != std::string::npos) {
-                    std::string newStr = cleanString(strCopy.substr(0, newLinePos));
-                    
-                    LogEvent newEvent(domain, level, newStr);
-                    
-                    _logEvents.push_back(newEvent);
-                    
-                    if (logConsole) {
-						if (showColors) {
-							SetConsoleColor(false, level);
-						}
-                        printf("%s", newEvent.FormatConsole().c_str());
-                        if (showColors) {
-                            SetConsoleColor(true, level);
-                        }
-                        printf("\n");
+                if (!wrote) {
+                    if (!_writerRunning && _pendingLines == 0) {
+                        break;
                     }
-                    
-                    strCopy.erase(0, newLinePos + 1);
-                    newLinePos = strCopy.find('\n');
+                    Platform::NanoSleep(1000000);
+                }
+            }
+            
+            _writerStopped = true;
+            
+            return NULL;
+        }
+        
+        void _startWriter() {
+            _writerStopped = false;
+            _writerRunning = true;
+            _writerThread = Platform::CreateThread(_writerMain, NULL);
+        }
+        
+        void _stopWriter() {
+            _writerRunning = false;
+            while (!_writerStopped) {
+                Platform::NanoSleep(100000);
+            }
+            delete _writerThread;
+            _writerThread = NULL;
+            
+            // Anything that was pushed as the writer exited
+            LogEvent e;
+            _logMutex->Enter();
+            while (_logQueue->TryPop(e)) {
+                _writeEvent(e);
+                _pendingLines--;
+            }
+            _logMutex->Exit();
+        }
+        
+        void Flush() {
+            while (_writerRunning && _pendingLines > 0) {
+                Platform::NanoSleep(100000);
+            }
+        }
+        
+        // Returns false if the writer isn't running and the caller has to write the line itself
+        bool _queueEvent(LogEvent& e) {
+            if (!_writerRunning) {
+                return false;
+            }
+            
+            _pendingLines++;
+            while (!_logQueue->TryPush(e)) {
+                // Verbose bursts shouldn't hold up the frame, everything else waits for the writer to catch up
+                if (e.Level == LogLevel_Verbose) {
+                    _pendingLines--;
+                    _droppedLines++;
+                    return true;
+                }
+                if (!_writerRunning) {
+                    _pendingLines--;
+                    return false;
                 }
+                Platform::NanoSleep(100000);
+            }
+            
+            return true;
+        }
+        
+        void _submitEvent(LogEvent& e) {
+            if (_queueEvent(e)) {
+                return;
+            }
+            
+            _logMutex->Enter();
+            _writeEvent(e);
+            _logMutex->Exit();
+        }
+        
+        void LogText(std::string domain, LogLevel level, std::string str) {
+            if (!_enableEvents) {
+                _updateConfig(); // config events aren't hooked up until then, only a few lines are logged before that
+            }
+            
+            if (_enableEvents) {
+                std::string levelString = GetLevelString(level);
+                LogMessageEvent e = {domain.c_str(), levelString.c_str(), str.c_str(), level == LogLevel_Toast};
+                if (Platform::IsMainThread()) {
+                    GetEventsSingilton()->GetEvent("logEvent")->EmitTyped(e);
+                } else {
+                    GetEventsSingilton()->EmitThread("Logger", "logEvent", LogMessageEvent::GetSchema()->ToJson(&e), EventQueuePolicy::DropOldest);
+                }
+            }
+            
+            std::size_t lastPos = 0;
+            std::size_t newLinePos = str.find('\n');
+            
+            while (true) {
+                LogEvent newEvent(domain, level, cleanString(str.substr(lastPos, newLinePos == std::string::npos ? std::string::npos : newLinePos - lastPos)));
                 
-				LogEvent newEvent(domain, level, strCopy);
-
-				_logEvents.push_back(newEvent);
+                _submitEvent(newEvent);
                 
-                if (logConsole) {
-					if (showColors) {
-						SetConsoleColor(false, level);
-					}
-                    printf("%s", newEvent.FormatConsole().c_str());
-                    if (showColors) {
-                        SetConsoleColor(true, level);
-                    }
-                    printf("\n");
+                if (newLinePos == std::string::npos) {
+                    break;
                 }
+                
+                lastPos = newLinePos + 1;
+                newLinePos = str.find('\n', lastPos);
             }
             
-            _logMutex->Exit();
+            // Errors are often followed by a crash so make sure they're visible first
+            if (level == LogLevel_Error || level == LogLevel_TestError) {
+                Flush();
+            }
         }
         
         std::ostream& begin(std::string domain, LogLevel level) {
-            _ss.str("");
-            _currentDomain = domain;
-            _currentLogLevel = level;
-			return _ss;
+            if (_threadStream == NULL) {
+                std::lock_guard<std::mutex> lock(_threadStreamsMutex);
+                if (_threadStreamsReleased) {
+                    _threadStream = &_shutdownStream;
+                } else {
+                    _threadStream = new ThreadStream();
+                    _threadStreams.push_back(_threadStream);
+                }
+            }
+            _threadStream->Stream.str("");
+            _threadStream->Domain = domain;
+            _threadStream->Level = level;
+			return _threadStream->Stream;
         }
         
         StreamFlusher end() {
             return StreamFlusher();
         }
         
-        std::vector<LogEvent>* GetEvents() {
-            return &_logEvents;
+        std::vector<LogEvent> GetRecentEvents(size_t count) {
+            std::vector<LogEvent> ret;
+            _logMutex->Enter();
+            for (auto iter = _logEvents.rbegin(); iter != _logEvents.rend() && ret.size() < count; iter++) {
+                ret.push_back(*iter);
+            }
+            _logMutex->Exit();
+            return ret;
         }
         
         std::string DumpAllEvents() {
+            Flush();
             std::stringstream ss;
+            _logMutex->Enter();
             for (auto iter = _logEvents.begin(); iter != _logEvents.end(); iter++) {
                 ss << iter->FormatConsole() << std::endl;
             }
+            _logMutex->Exit();
             return ss.str();
         }
         
         void HideAllEvents() {
+            Flush();
+            _logMutex->Enter();
             for (auto iterator = _logEvents.begin(); iterator != _logEvents.end(); iterator++) {
                 iterator->Hidden = true;
             }
+            _logMutex->Exit();
         }
     }
 }
\ No newline at end of file
@@ -55,6 +55,7 @@ namespace Engine {
         
         class LogEvent {
         public:
+            LogEvent();
             LogEvent(std::string domain, LogLevel level, std::string event);
             
             std::string FormatConsole();
@@ -70,6 +71,16 @@ namespace Engine {
         void Init();
         void EnableLoggerEvents();
         
+        // Stops the writer thread once everything queued has been written and frees every thread's
+        // stream, later lines are written synchronously
+        void Shutdown();
+        
+        // Frees the calling thread's stream, threads that log and then exit call this before they return
+        void ReleaseThread();
+        
+        // Blocks until every line logged so far has been written to the console and the history
+        void Flush();
+        
         std::string GetLevelString(LogLevel level);
         
         void LogText(std::string domain, LogLevel level, std::string str);
@@ -81,6 +92,7 @@ namespace Engine {
         
         void HideAllEvents();
         
-        std::vector<LogEvent>* GetEvents();
+        // Copies up to count of the newest lines from the history, newest first
+        std::vector<LogEvent> GetRecentEvents(size_t count);
     }
 }
\ No newline at end of file
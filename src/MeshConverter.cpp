@@ -0,0 +1,533 @@
+/*
+ Filename: MeshConverter.cpp
+ Purpose:  Converts Wavefront .obj meshes into indexed .eglb files
+
+ Part of Engine2D
+
+ Copyright (C) 2014 Vbitz
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "MeshConverter.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <limits>
+
+#include "WorkerThreadPool.hpp"
+#include "Logger.hpp"
+#include "Profiler.hpp"
+#include "Platform.hpp"
+
+namespace Engine {
+    namespace MeshConverter {
+        static const unsigned int NoIndex = std::numeric_limits<unsigned int>::max();
+        
+        // Chunks are at least this big so small files don't pay for the job system
+        static const size_t MinChunkSize = 256 * 1024;
+        
+        enum ObjCornerFlags : uint8_t {
+            ObjCorner_RelativePosition = 1 << 0,
+            ObjCorner_RelativeTexcoord = 1 << 1,
+            ObjCorner_NoTexcoord = 1 << 2
+        };
+        
+        // Relative indexes are stored against the start of the chunk until the chunk's offset is known
+        struct ObjCorner {
+            int64_t position;
+            int64_t texcoord;
+            uint8_t flags;
+        };
+        
+        struct ObjChunk {
+            const char* begin;
+            const char* end;
+            
+            std::vector<glm::vec3> positions;
+            std::vector<glm::vec2> texcoords;
+            std::vector<ObjCorner> corners;
+            std::vector<unsigned int> faceSizes;
+            
+            size_t positionBase = 0, texcoordBase = 0, cornerBase = 0, indexBase = 0;
+            size_t indexCount = 0;
+            
+            bool failed = false;
+        };
+        
+        static inline bool _isSpace(char c) {
+            return c == ' ' || c == '\t' || c == '\r';
+        }
+        
+        static inline void _skipSpace(const char*& p, const char* end) {
+            while (p < end && _isSpace(*p)) p++;
+        }
+        
+        static inline bool _parseInt(const char*& p, const char* end, int64_t& value) {
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negative = *p == '-';
+                p++;
+            }
+            
+            if (p >= end || *p < '0' || *p > '9') return false;
+            
+            value = 0;
+            while (p < end && *p >= '0' && *p <= '9') {
+                value = value * 10 + (*p++ - '0');
+            }
+            
+            if (negative) value = -value;
+            return true;
+        }
+        
+        // strtof is locale dependent and much slower, this covers everything exporters write
+        static inline bool _parseFloat(const char*& p, const char* end, float& value) {
+            _skipSpace(p, end);
+            
+            bool negative = false;
+            if (p < end && (*p == '-' || *p == '+')) {
+                negative = *p == '-';
+                p++;
+            }
+            
+            double result = 0.0;
+            bool digits = false;
+            
+            while (p < end && *p >= '0' && *p <= '9') {
+                result = result * 10.0 + (*p++ - '0');
+                digits = true;
+            }
+            
+            if (p < end && *p == '.') {
+                p++;
+                double scale = 0.1;
+                while (p < end && *p >= '0' && *p <= '9') {
+                    result += (*p++ - '0') * scale;
+                    scale *= 0.1;
+                    digits = true;
+                }
+            }
+            
+            if (!digits) return false;
+            
+            if (p < end && (*p == 'e' || *p == 'E')) {
+                p++;
+                int64_t exponent = 0;
+                if (!_parseInt(p, end, exponent)) return false;
+                result *= std::pow(10.0, (double) exponent);
+            }
+            
+            value = (float) (negative ? -result : result);
+            return true;
+        }
+        
+        static void _parseChunk(ObjChunk& chunk) {
+            const char* p = chunk.begin;
+            const char* end = chunk.end;
+            
+            while (p < end && !chunk.failed) {
+                _skipSpace(p, end);
+                if (p >= end) break;
+                
+                const char* lineEnd = (const char*) std::memchr(p, '\n', end - p);
+                if (lineEnd == NULL) lineEnd = end;
+                
+                if (p[0] == 'v' && lineEnd - p > 1 && _isSpace(p[1])) {
+                    p += 1;
+                    glm::vec3 pos;
+                    if (!_parseFloat(p, lineEnd, pos.x) || !_parseFloat(p, lineEnd, pos.y) || !_parseFloat(p, lineEnd, pos.z)) {
+                        chunk.failed = true;
+                    }
+                    chunk.positions.push_back(pos);
+                } else if (p[0] == 'v' && lineEnd - p > 2 && p[1] == 't' && _isSpace(p[2])) {
+                    p += 2;
+                    glm::vec2 uv;
+                    if (!_parseFloat(p, lineEnd, uv.x)) {
+                        chunk.failed = true;
+                    }
+                    if (!_parseFloat(p, lineEnd, uv.y)) {
+                        uv.y = 0.0f; // 1D texcoords
+                    }
+                    chunk.texcoords.push_back(uv);
+                } else if (p[0] == 'f' && lineEnd - p > 1 && _isSpace(p[1])) {
+                    p += 1;
+                    unsigned int faceSize = 0;
+                    
+                    while (true) {
+                        _skipSpace(p, lineEnd);
+                        if (p >= lineEnd) break;
+                        
+                        ObjCorner corner;
+                        corner.flags = 0;
+                        
+                        // v, v/vt, v//vn or v/vt/vn
+                        if (!_parseInt(p, lineEnd, corner.position)) {
+                            chunk.failed = true;
+                            break;
+                        }
+                        
+                        if (corner.position < 0) {
+                            corner.position += (int64_t) chunk.positions.size();
+                            corner.flags |= ObjCorner_RelativePosition;
+                        } else {
+                            corner.position -= 1;
+                        }
+                        
+                        if (p < lineEnd && *p == '/' && p + 1 < lineEnd && p[1] != '/') {
+                            p++;
+                            if (!_parseInt(p, lineEnd, corner.texcoord)) {
+                                chunk.failed = true;
+                                break;
+                            }
+                            if (corner.texcoord < 0) {
+                                corner.texcoord += (int64_t) chunk.texcoords.size();
+                                corner.flags |= ObjCorner_RelativeTexcoord;
+                            } else {
+                                corner.texcoord -= 1;
+                            }
+                        } else {
+                            corner.texcoord = 0;
+                            corner.flags |= ObjCorner_NoTexcoord;
+                        }
+                        
+                        // skip the rest of the corner including the normal
+                        while (p < lineEnd && !_isSpace(*p)) p++;
+                        
+                        chunk.corners.push_back(corner);
+                        faceSize++;
+                    }
+                    
+                    if (faceSize < 3) {
+                        // points and lines have nothing to draw
+                        chunk.corners.resize(chunk.corners.size() - faceSize);
+                    } else {
+                        chunk.faceSizes.push_back(faceSize);
+                        chunk.indexCount += (faceSize - 2) * 3;
+                    }
+                }
+                // everything else (vn, o, g, s, usemtl, mtllib, comments) isn't used by .eglb
+                
+                p = lineEnd + 1;
+            }
+        }
+        
+        bool ParseObj(const char* source, size_t length, float scale, Mesh& mesh, ConvertStats& stats) {
+            ENGINE_PROFILER_SCOPE;
+            
+            double startTime = Platform::GetTime();
+            
+            stats.InputBytes = length;
+            
+            // split on line boundaries
+            size_t targetChunks = std::max<size_t>(1, std::min<size_t>(length / MinChunkSize,
+                (WorkerThreadPool::GetWorkerCount() + 1) * 8));
+            
+            std::vector<ObjChunk> chunks;
+            const char* sourceEnd = source + length;
+            const char* chunkStart = source;
+            
+            for (size_t i = 0; i < targetChunks && chunkStart < sourceEnd; i++) {
+                const char* chunkEnd = i == targetChunks - 1 ? sourceEnd : std::min(sourceEnd, source + (length / targetChunks) * (i + 1));
+                
+                const char* newline = (const char*) std::memchr(chunkEnd, '\n', sourceEnd - chunkEnd);
+                chunkEnd = newline == NULL ? sourceEnd : newline + 1;
+                
+                ObjChunk chunk;
+                chunk.begin = chunkStart;
+                chunk.end = chunkEnd;
+                chunks.push_back(chunk);
+                
+                chunkStart = chunkEnd;
+            }
+            
+            WorkerThreadPool::ParallelFor(chunks.size(), 1, [&chunks](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    _parseChunk(chunks[i]);
+                }
+            });
+            
+            // offsets of each chunk in the merged arrays
+            size_t positionCount = 0, texcoordCount = 0, cornerCount = 0, indexCount = 0;
+            
+            for (auto iter = chunks.begin(); iter != chunks.end(); iter++) {
+                if (iter->failed) {
+                    Logger::begin("MeshConverter", Logger::LogLevel_Error) << "Could not parse line in chunk at byte "
+                        << (iter->begin - source) << Logger::end();
+                    return false;
+                }
+                
+                iter->positionBase = positionCount;
+                iter->texcoordBase = texcoordCount;
+                iter->cornerBase = cornerCount;
+                iter->indexBase = indexCount;
+                
+                positionCount += iter->positions.size();
+                texcoordCount += iter->texcoords.size();
+                cornerCount += iter->corners.size();
+                indexCount += iter->indexCount;
+                stats.Faces += iter->faceSizes.size();
+            }
+            
+            stats.Positions = positionCount;
+            stats.Texcoords = texcoordCount;
+            
+            std::vector<glm::vec3> positions(positionCount);
+            std::vector<glm::vec2> texcoords(texcoordCount);
+            std::vector<unsigned int> cornerPositions(cornerCount);
+            std::vector<unsigned int> cornerTexcoords(cornerCount);
+            
+            std::atomic<bool> badIndex(false);
+            
+            // merge the chunks and resolve relative indexes
+            WorkerThreadPool::ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    ObjChunk& chunk = chunks[i];
+                    
+                    std::copy(chunk.positions.begin(), chunk.positions.end(), positions.begin() + chunk.positionBase);
+                    std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), texcoords.begin() + chunk.texcoordBase);
+                    
+                    for (size_t x = 0; x < chunk.corners.size(); x++) {
+                        ObjCorner& corner = chunk.corners[x];
+                        
+                        int64_t position = corner.position + ((corner.flags & ObjCorner_RelativePosition) ? chunk.positionBase : 0);
+                        int64_t texcoord = corner.texcoord + ((corner.flags & ObjCorner_RelativeTexcoord) ? chunk.texcoordBase : 0);
+                        
+                        if (position < 0 || position >= (int64_t) positionCount ||
+                            (!(corner.flags & ObjCorner_NoTexcoord) && (texcoord < 0 || texcoord >= (int64_t) texcoordCount))) {
+                            badIndex = true;
+                            return;
+                        }
+                        
+                        cornerPositions[chunk.cornerBase + x] = (unsigned int) position;
+                        cornerTexcoords[chunk.cornerBase + x] = (corner.flags & ObjCorner_NoTexcoord) ? NoIndex : (unsigned int) texcoord;
+                    }
+                }
+            });
+            
+            if (badIndex) {
+                Logger::begin("MeshConverter", Logger::LogLevel_Error) << "Face refers to a vertex that doesn't exist" << Logger::end();
+                return false;
+            }
+            
+            // Each worker dedupes the corners using its own range of positions so no locking is
+            // needed. The vertex order this gives is fixed by the fetch optimization afterwards.
+            size_t workerCount = std::max<size_t>(1, std::min<size_t>(chunks.size(), WorkerThreadPool::GetWorkerCount() + 1));
+            
+            auto owner = [positionCount, workerCount](unsigned int position) {
+                return (size_t) ((uint64_t) position * workerCount / positionCount);
+            };
+            
+            std::vector<unsigned int> firstVertex(positionCount, NoIndex);
+            std::vector<unsigned int> cornerVertex(cornerCount);
+            std::vector<std::vector<unsigned int>> uniquePositions(workerCount), uniqueTexcoords(workerCount), nextVertex(workerCount);
+            
+            WorkerThreadPool::ParallelFor(workerCount, 1, [&](size_t begin, size_t end) {
+                for (size_t worker = begin; worker < end; worker++) {
+                    std::vector<unsigned int>& workerPositions = uniquePositions[worker];
+                    std::vector<unsigned int>& workerTexcoords = uniqueTexcoords[worker];
+                    std::vector<unsigned int>& workerNext = nextVertex[worker];
+                    
+                    for (size_t i = 0; i < cornerCount; i++) {
+                        unsigned int position = cornerPositions[i];
+                        if (owner(position) != worker) continue;
+                        
+                        // most positions only have one or two texcoords so a list per position is enough
+                        unsigned int vert = firstVertex[position];
+                        while (vert != NoIndex && workerTexcoords[vert] != cornerTexcoords[i]) {
+                            vert = workerNext[vert];
+                        }
+                        
+                        if (vert == NoIndex) {
+                            vert = (unsigned int) workerPositions.size();
+                            workerPositions.push_back(position);
+                            workerTexcoords.push_back(cornerTexcoords[i]);
+                            workerNext.push_back(firstVertex[position]);
+                            firstVertex[position] = vert;
+                        }
+                        
+                        cornerVertex[i] = vert;
+                    }
+                }
+            });
+            
+            std::vector<size_t> vertexBase(workerCount, 0);
+            size_t vertexCount = 0;
+            for (size_t i = 0; i < workerCount; i++) {
+                vertexBase[i] = vertexCount;
+                vertexCount += uniquePositions[i].size();
+            }
+            
+            mesh.Verts.assign(vertexCount, BufferFormat(glm::vec3(), Color4f(1.0f, 1.0f, 1.0f, 1.0f), glm::vec3()));
+            mesh.Indexes.resize(indexCount);
+            mesh.Normals.clear();
+            
+            WorkerThreadPool::ParallelFor(workerCount, 1, [&](size_t begin, size_t end) {
+                for (size_t worker = begin; worker < end; worker++) {
+                    for (size_t i = 0; i < uniquePositions[worker].size(); i++) {
+                        BufferFormat& vert = mesh.Verts[vertexBase[worker] + i];
+                        unsigned int texcoord = uniqueTexcoords[worker][i];
+                        vert.pos = positions[uniquePositions[worker][i]] * scale;
+                        vert.uv = texcoord == NoIndex ? glm::vec3(0.0f) : glm::vec3(texcoords[texcoord], 0.0f);
+                    }
+                }
+            });
+            
+            // triangulate each polygon as a fan
+            WorkerThreadPool::ParallelFor(chunks.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    ObjChunk& chunk = chunks[i];
+                    
+                    size_t corner = chunk.cornerBase;
+                    unsigned int* index = &mesh.Indexes[0] + chunk.indexBase;
+                    
+                    auto vertexFor = [&](size_t c) {
+                        return (unsigned int) (vertexBase[owner(cornerPositions[c])] + cornerVertex[c]);
+                    };
+                    
+                    for (auto iter = chunk.faceSizes.begin(); iter != chunk.faceSizes.end(); iter++) {
+                        for (unsigned int x = 1; x + 1 < *iter; x++) {
+                            *index++ = vertexFor(corner);
+                            *index++ = vertexFor(corner + x);
+                            *index++ = vertexFor(corner + x + 1);
+                        }
+                        corner += *iter;
+                    }
+                }
+            });
+            
+            stats.Vertexes = vertexCount;
+            stats.Indexes = indexCount;
+            stats.ParseTime = Platform::GetTime() - startTime;
+            
+            return true;
+        }
+        
+        void PrepareMesh(Mesh& mesh, bool optimize, ConvertStats& stats) {
+            ENGINE_PROFILER_SCOPE;
+            
+            double startTime = Platform::GetTime();
+            
+            if (optimize) {
+                VertexBuffer::OptimizeVertexCache(mesh.Indexes, mesh.Verts.size());
+                VertexBuffer::OptimizeVertexFetch(mesh.Verts, mesh.Verts.size(), mesh.Indexes);
+            }
+            
+            mesh.Normals.resize(mesh.Verts.size());
+            VertexBuffer::GenerateNormals(mesh.Verts.data(), mesh.Verts.size(),
+                                          mesh.Indexes.data(), mesh.Indexes.size(), mesh.Normals.data());
+            
+            stats.Vertexes = mesh.Verts.size();
+            stats.Indexes = mesh.Indexes.size();
+            stats.ACMR = VertexBuffer::GetACMR(mesh.Indexes, mesh.Verts.size());
+            stats.OptimizeTime = Platform::GetTime() - startTime;
+        }
+        
+        bool ObjToEglb(std::string inputPath, std::string outputPath, float scale, bool optimize, ConvertStats& stats) {
+            std::ifstream input(inputPath, std::ios::in | std::ios::binary | std::ios::ate);
+            if (!input.good()) {
+                Logger::begin("MeshConverter", Logger::LogLevel_Error) << "Could not open " << inputPath << Logger::end();
+                return false;
+            }
+            
+            std::vector<char> source((size_t) input.tellg());
+            input.seekg(0);
+            input.read(source.data(), source.size());
+            input.close();
+            
+            Mesh mesh;
+            
+            if (!ParseObj(source.data(), source.size(), scale, mesh, stats)) {
+                return false;
+            }
+            
+            std::vector<char>().swap(source);
+            
+            PrepareMesh(mesh, optimize, stats);
+            
+            double startTime = Platform::GetTime();
+            
+            std::vector<unsigned char> output(VertexBuffer::GetDiskSize(mesh.Verts.size(), mesh.Indexes.size(), true));
+            
+            VertexBuffer::WriteDiskFormat(output.data(), mesh.Verts.data(), mesh.Verts.size(),
+                                          mesh.Indexes.data(), mesh.Indexes.size(), mesh.Normals.data());
+            
+            std::ofstream outputFile(outputPath, std::ios::out | std::ios::binary | std::ios::trunc);
+            outputFile.write((const char*) output.data(), output.size());
+            
+            if (!outputFile.good()) {
+                Logger::begin("MeshConverter", Logger::LogLevel_Error) << "Could not write " << outputPath << Logger::end();
+                return false;
+            }
+            
+            stats.WriteTime = Platform::GetTime() - startTime;
+            
+            return true;
+        }
+    }
+}
+
+#ifdef _PLATFORM_WIN32
+extern "C" _declspec(dllexport)
+#else
+extern "C"
+#endif
+int EngineObjToEglb(int argc, char const *argv[]) {
+    using namespace Engine;
+    
+    std::string input, output;
+    float scale = 1.0f;
+    bool optimize = true;
+    
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg.find("--scale=") == 0) {
+            scale = std::stof(arg.substr(8));
+        } else if (arg == "--no-optimize") {
+            optimize = false;
+        } else if (input.empty()) {
+            input = arg;
+        } else {
+            output = arg;
+        }
+    }
+    
+    if (input.empty() || output.empty()) {
+        std::cerr << "usage: objToEglb [--scale=1] [--no-optimize] input.obj output.eglb" << std::endl;
+        return 1;
+    }
+    
+    Logger::Init();
+    WorkerThreadPool::Init(0);
+    
+    MeshConverter::ConvertStats stats;
+    bool result = MeshConverter::ObjToEglb(input, output, scale, optimize, stats);
+    
+    WorkerThreadPool::Shutdown();
+    
+    if (!result) {
+        return 1;
+    }
+    
+    std::cout << input << ": " << stats.InputBytes << " bytes | " << stats.Positions << " positions | "
+        << stats.Faces << " faces -> " << stats.Vertexes << " vertexes | " << stats.Indexes / 3 << " triangles | ACMR "
+        << stats.ACMR << std::endl;
+    std::cout << "parse: " << stats.ParseTime << "s optimize: " << stats.OptimizeTime << "s write: " << stats.WriteTime << "s" << std::endl;
+    
+    return 0;
+}
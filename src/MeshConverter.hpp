@@ -0,0 +1,62 @@
+/*
+ Filename: MeshConverter.hpp
+ Purpose:  Converts Wavefront .obj meshes into indexed .eglb files
+
+ Part of Engine2D
+
+ Copyright (C) 2014 Vbitz
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "GL3Buffer.hpp"
+
+namespace Engine {
+    namespace MeshConverter {
+        struct Mesh {
+            VertexStore Verts;
+            IndexStore Indexes;
+            NormalStore Normals;
+        };
+        
+        struct ConvertStats {
+            size_t InputBytes = 0;
+            size_t Positions = 0;
+            size_t Texcoords = 0;
+            size_t Faces = 0;
+            size_t Vertexes = 0;
+            size_t Indexes = 0;
+            float ACMR = 0.0f;
+            
+            double ParseTime = 0.0;
+            double OptimizeTime = 0.0;
+            double WriteTime = 0.0;
+        };
+        
+        // Parses chunks of the file in parallel on the job system. Vertexes that share a position
+        // and texcoord are merged and polygons are triangulated as fans. Normals in the file are
+        // ignored since they are generated afterwards. Returns false on bad indexes.
+        bool ParseObj(const char* source, size_t length, float scale, Mesh& mesh, ConvertStats& stats);
+        
+        // Orders the mesh for the vertex cache then generates normals the same way as
+        // VertexBuffer::ComputeNormals.
+        void PrepareMesh(Mesh& mesh, bool optimize, ConvertStats& stats);
+        
+        // inputPath and outputPath are real paths rather than PhysFS paths
+        bool ObjToEglb(std::string inputPath, std::string outputPath, float scale, bool optimize, ConvertStats& stats);
+    }
+}
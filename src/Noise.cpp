@@ -0,0 +1,614 @@
+/*
+ Filename: Noise.cpp
+ Purpose:  Perlin, simplex and value noise filled in bulk
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "Noise.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "Profiler.hpp"
+#include "WorkerThreadPool.hpp"
+
+namespace Engine {
+    namespace Noise {
+        static const unsigned char _basePerm[256] = {
+            151, 160, 137, 91, 90, 15, 131, 13, 201, 95, 96, 53, 194, 233, 7, 225, 140, 36, 103, 30, 69, 142, 8, 99, 37, 240, 21, 10, 23,
+            190, 6, 148, 247, 120, 234, 75, 0, 26, 197, 62, 94, 252, 219, 203, 117, 35, 11, 32, 57, 177, 33,
+            88, 237, 149, 56, 87, 174, 20, 125, 136, 171, 168, 68, 175, 74, 165, 71, 134, 139, 48, 27, 166,
+            77, 146, 158, 231, 83, 111, 229, 122, 60, 211, 133, 230, 220, 105, 92, 41, 55, 46, 245, 40, 244,
+            102, 143, 54, 65, 25, 63, 161, 1, 216, 80, 73, 209, 76, 132, 187, 208, 89, 18, 169, 200, 196,
+            135, 130, 116, 188, 159, 86, 164, 100, 109, 198, 173, 186, 3, 64, 52, 217, 226, 250, 124, 123,
+            5, 202, 38, 147, 118, 126, 255, 82, 85, 212, 207, 206, 59, 227, 47, 16, 58, 17, 182, 189, 28, 42,
+            223, 183, 170, 213, 119, 248, 152, 2, 44, 154, 163, 70, 221, 153, 101, 155, 167, 43, 172, 9,
+            129, 22, 39, 253, 19, 98, 108, 110, 79, 113, 224, 232, 178, 185, 112, 104, 218, 246, 97, 228,
+            251, 34, 242, 193, 238, 210, 144, 12, 191, 179, 162, 241, 81, 51, 145, 235, 249, 14, 239, 107,
+            49, 192, 214, 31, 181, 199, 106, 157, 184, 84, 204, 176, 115, 121, 50, 45, 127, 4, 150, 254,
+            138, 236, 205, 93, 222, 114, 67, 29, 24, 72, 243, 141, 128, 195, 78, 66, 215, 61, 156, 180
+        };
+        
+        static const float _grad3[12][3] = {
+            {1, 1, 0}, {-1, 1, 0}, {1, -1, 0}, {-1, -1, 0},
+            {1, 0, 1}, {-1, 0, 1}, {1, 0, -1}, {-1, 0, -1},
+            {0, 1, 1}, {0, -1, 1}, {0, 1, -1}, {0, -1, -1}
+        };
+        
+        static const float _grad4[32][4] = {
+            {0, 1, 1, 1}, {0, 1, 1, -1}, {0, 1, -1, 1}, {0, 1, -1, -1},
+            {0, -1, 1, 1}, {0, -1, 1, -1}, {0, -1, -1, 1}, {0, -1, -1, -1},
+            {1, 0, 1, 1}, {1, 0, 1, -1}, {1, 0, -1, 1}, {1, 0, -1, -1},
+            {-1, 0, 1, 1}, {-1, 0, 1, -1}, {-1, 0, -1, 1}, {-1, 0, -1, -1},
+            {1, 1, 0, 1}, {1, 1, 0, -1}, {1, -1, 0, 1}, {1, -1, 0, -1},
+            {-1, 1, 0, 1}, {-1, 1, 0, -1}, {-1, -1, 0, 1}, {-1, -1, 0, -1},
+            {1, 1, 1, 0}, {1, 1, -1, 0}, {1, -1, 1, 0}, {1, -1, -1, 0},
+            {-1, 1, 1, 0}, {-1, 1, -1, 0}, {-1, -1, 1, 0}, {-1, -1, -1, 0}
+        };
+        
+        // Skewing and unskewing factors for 2, 3, and 4 dimensions
+        static const float F2 = 0.36602540378f; // 0.5 * (sqrt(3) - 1)
+        static const float G2 = 0.2113248654f;  // (3 - sqrt(3)) / 6
+        static const float F3 = 1.0f / 3.0f;
+        static const float G3 = 1.0f / 6.0f;
+        static const float F4 = 0.30901699437f; // (sqrt(5) - 1) / 4
+        static const float G4 = 0.13819660112f; // (5 - sqrt(5)) / 20
+        
+        static inline int _floor(float value) {
+            int i = (int) value;
+            return value < i ? i - 1 : i;
+        }
+        
+        static inline float _fade(float t) {
+            return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f);
+        }
+        
+        static inline float _lerp(float a, float b, float t) {
+            return (1.0f - t) * a + t * b;
+        }
+        
+        static inline float _dot3(int grad, float x, float y, float z) {
+            return _grad3[grad][0] * x + _grad3[grad][1] * y + _grad3[grad][2] * z;
+        }
+        
+        static inline float _dot4(int grad, float x, float y, float z, float w) {
+            return _grad4[grad][0] * x + _grad4[grad][1] * y + _grad4[grad][2] * z + _grad4[grad][3] * w;
+        }
+        
+        // t^4 * dot falloff shared by every simplex corner
+        static inline float _corner(float t, float dot) {
+            if (t < 0.0f) return 0.0f;
+            t *= t;
+            return t * t * dot;
+        }
+        
+        NoiseGenerator::NoiseGenerator() {
+            this->Seed(0);
+        }
+        
+        NoiseGenerator::NoiseGenerator(double seed) {
+            this->Seed(seed);
+        }
+        
+        void NoiseGenerator::Seed(double seed) {
+            if (seed > 0 && seed < 1) {
+                seed *= 65536;
+            }
+            
+            int intSeed = (int) std::floor(seed);
+            if (intSeed < 256) {
+                intSeed |= intSeed << 8;
+            }
+            
+            for (int i = 0; i < 256; i++) {
+                unsigned char v = _basePerm[i] ^ ((i & 1) ? (intSeed & 255) : ((intSeed >> 8) & 255));
+                this->_perm[i] = this->_perm[i + 256] = v;
+                this->_grad3Index[i] = this->_grad3Index[i + 256] = v % 12;
+                this->_grad4Index[i] = this->_grad4Index[i + 256] = v % 32;
+                this->_grad2X[i] = this->_grad2X[i + 256] = _grad3[v % 12][0];
+                this->_grad2Y[i] = this->_grad2Y[i + 256] = _grad3[v % 12][1];
+            }
+        }
+        
+        float NoiseGenerator::Perlin2(float x, float y) {
+            int X = _floor(x), Y = _floor(y);
+            x -= X; y -= Y;
+            X &= 255; Y &= 255;
+            
+            const unsigned char* perm = this->_perm;
+            const unsigned char* grad = this->_grad3Index;
+            
+            float n00 = _dot3(grad[X + perm[Y]], x, y, 0.0f);
+            float n01 = _dot3(grad[X + perm[Y + 1]], x, y - 1.0f, 0.0f);
+            float n10 = _dot3(grad[X + 1 + perm[Y]], x - 1.0f, y, 0.0f);
+            float n11 = _dot3(grad[X + 1 + perm[Y + 1]], x - 1.0f, y - 1.0f, 0.0f);
+            
+            float u = _fade(x);
+            
+            return _lerp(_lerp(n00, n10, u), _lerp(n01, n11, u), _fade(y));
+        }
+        
+        float NoiseGenerator::Perlin3(float x, float y, float z) {
+            int X = _floor(x), Y = _floor(y), Z = _floor(z);
+            x -= X; y -= Y; z -= Z;
+            X &= 255; Y &= 255; Z &= 255;
+            
+            const unsigned char* perm = this->_perm;
+            const unsigned char* grad = this->_grad3Index;
+            
+            float n000 = _dot3(grad[X + perm[Y + perm[Z]]], x, y, z);
+            float n001 = _dot3(grad[X + perm[Y + perm[Z + 1]]], x, y, z - 1.0f);
+            float n010 = _dot3(grad[X + perm[Y + 1 + perm[Z]]], x, y - 1.0f, z);
+            float n011 = _dot3(grad[X + perm[Y + 1 + perm[Z + 1]]], x, y - 1.0f, z - 1.0f);
+            float n100 = _dot3(grad[X + 1 + perm[Y + perm[Z]]], x - 1.0f, y, z);
+            float n101 = _dot3(grad[X + 1 + perm[Y + perm[Z + 1]]], x - 1.0f, y, z - 1.0f);
+            float n110 = _dot3(grad[X + 1 + perm[Y + 1 + perm[Z]]], x - 1.0f, y - 1.0f, z);
+            float n111 = _dot3(grad[X + 1 + perm[Y + 1 + perm[Z + 1]]], x - 1.0f, y - 1.0f, z - 1.0f);
+            
+            float u = _fade(x), v = _fade(y), w = _fade(z);
+            
+            return _lerp(_lerp(_lerp(n000, n100, u), _lerp(n001, n101, u), w),
+                         _lerp(_lerp(n010, n110, u), _lerp(n011, n111, u), w),
+                         v);
+        }
+        
+        float NoiseGenerator::Perlin4(float x, float y, float z, float w) {
+            int X = _floor(x), Y = _floor(y), Z = _floor(z), W = _floor(w);
+            x -= X; y -= Y; z -= Z; w -= W;
+            X &= 255; Y &= 255; Z &= 255; W &= 255;
+            
+            const unsigned char* perm = this->_perm;
+            
+            // corner bits are x, y, z, w from high to low
+            float corners[16];
+            for (int c = 0; c < 16; c++) {
+                int dx = (c >> 3) & 1, dy = (c >> 2) & 1, dz = (c >> 1) & 1, dw = c & 1;
+                int grad = this->_grad4Index[X + dx + perm[Y + dy + perm[Z + dz + perm[W + dw]]]];
+                corners[c] = _dot4(grad, x - dx, y - dy, z - dz, w - dw);
+            }
+            
+            float fades[4] = {_fade(w), _fade(z), _fade(y), _fade(x)};
+            for (int axis = 0, size = 16; axis < 4; axis++, size /= 2) {
+                for (int c = 0; c < size / 2; c++) {
+                    corners[c] = _lerp(corners[c * 2], corners[c * 2 + 1], fades[axis]);
+                }
+            }
+            
+            // the 4D gradients have 3 components so the raw range is a little over -1 to 1
+            return corners[0] * 0.8f;
+        }
+        
+        float NoiseGenerator::Simplex2(float xin, float yin) {
+            float s = (xin + yin) * F2;
+            int i = _floor(xin + s), j = _floor(yin + s);
+            float t = (i + j) * G2;
+            float x0 = xin - i + t, y0 = yin - j + t;
+            
+            int i1 = x0 > y0 ? 1 : 0, j1 = 1 - i1;
+            
+            float x1 = x0 - i1 + G2, y1 = y0 - j1 + G2;
+            float x2 = x0 - 1.0f + 2.0f * G2, y2 = y0 - 1.0f + 2.0f * G2;
+            
+            i &= 255; j &= 255;
+            
+            const unsigned char* perm = this->_perm;
+            const unsigned char* grad = this->_grad3Index;
+            
+            float n0 = _corner(0.5f - x0 * x0 - y0 * y0, _dot3(grad[i + perm[j]], x0, y0, 0.0f));
+            float n1 = _corner(0.5f - x1 * x1 - y1 * y1, _dot3(grad[i + i1 + perm[j + j1]], x1, y1, 0.0f));
+            float n2 = _corner(0.5f - x2 * x2 - y2 * y2, _dot3(grad[i + 1 + perm[j + 1]], x2, y2, 0.0f));
+            
+            return 70.0f * (n0 + n1 + n2);
+        }
+        
+        float NoiseGenerator::Simplex3(float xin, float yin, float zin) {
+            float s = (xin + yin + zin) * F3;
+            int i = _floor(xin + s), j = _floor(yin + s), k = _floor(zin + s);
+            float t = (i + j + k) * G3;
+            float x0 = xin - i + t, y0 = yin - j + t, z0 = zin - k + t;
+            
+            int i1, j1, k1, i2, j2, k2;
+            if (x0 >= y0) {
+                if (y0 >= z0)      { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+                else if (x0 >= z0) { i1 = 1; j1 = 0; k1 = 0; i2 = 1; j2 = 0; k2 = 1; }
+                else               { i1 = 0; j1 = 0; k1 = 1; i2 = 1; j2 = 0; k2 = 1; }
+            } else {
+                if (y0 < z0)       { i1 = 0; j1 = 0; k1 = 1; i2 = 0; j2 = 1; k2 = 1; }
+                else if (x0 < z0)  { i1 = 0; j1 = 1; k1 = 0; i2 = 0; j2 = 1; k2 = 1; }
+                else               { i1 = 0; j1 = 1; k1 = 0; i2 = 1; j2 = 1; k2 = 0; }
+            }
+            
+            float x1 = x0 - i1 + G3, y1 = y0 - j1 + G3, z1 = z0 - k1 + G3;
+            float x2 = x0 - i2 + 2.0f * G3, y2 = y0 - j2 + 2.0f * G3, z2 = z0 - k2 + 2.0f * G3;
+            float x3 = x0 - 1.0f + 3.0f * G3, y3 = y0 - 1.0f + 3.0f * G3, z3 = z0 - 1.0f + 3.0f * G3;
+            
+            i &= 255; j &= 255; k &= 255;
+            
+            const unsigned char* perm = this->_perm;
+            const unsigned char* grad = this->_grad3Index;
+            
+            float n0 = _corner(0.5f - x0 * x0 - y0 * y0 - z0 * z0, _dot3(grad[i + perm[j + perm[k]]], x0, y0, z0));
+            float n1 = _corner(0.5f - x1 * x1 - y1 * y1 - z1 * z1, _dot3(grad[i + i1 + perm[j + j1 + perm[k + k1]]], x1, y1, z1));
+            float n2 = _corner(0.5f - x2 * x2 - y2 * y2 - z2 * z2, _dot3(grad[i + i2 + perm[j + j2 + perm[k + k2]]], x2, y2, z2));
+            float n3 = _corner(0.5f - x3 * x3 - y3 * y3 - z3 * z3, _dot3(grad[i + 1 + perm[j + 1 + perm[k + 1]]], x3, y3, z3));
+            
+            return 32.0f * (n0 + n1 + n2 + n3);
+        }
+        
+        float NoiseGenerator::Simplex4(float x, float y, float z, float w) {
+            float s = (x + y + z + w) * F4;
+            int i = _floor(x + s), j = _floor(y + s), k = _floor(z + s), l = _floor(w + s);
+            float t = (i + j + k + l) * G4;
+            float x0 = x - i + t, y0 = y - j + t, z0 = z - k + t, w0 = w - l + t;
+            
+            // The magnitude ordering of x0..w0 picks which of the 24 simplices the point is in
+            int rankx = 0, ranky = 0, rankz = 0, rankw = 0;
+            if (x0 > y0) rankx++; else ranky++;
+            if (x0 > z0) rankx++; else rankz++;
+            if (x0 > w0) rankx++; else rankw++;
+            if (y0 > z0) ranky++; else rankz++;
+            if (y0 > w0) ranky++; else rankw++;
+            if (z0 > w0) rankz++; else rankw++;
+            
+            int i1 = rankx >= 3, j1 = ranky >= 3, k1 = rankz >= 3, l1 = rankw >= 3;
+            int i2 = rankx >= 2, j2 = ranky >= 2, k2 = rankz >= 2, l2 = rankw >= 2;
+            int i3 = rankx >= 1, j3 = ranky >= 1, k3 = rankz >= 1, l3 = rankw >= 1;
+            
+            float x1 = x0 - i1 + G4, y1 = y0 - j1 + G4, z1 = z0 - k1 + G4, w1 = w0 - l1 + G4;
+            float x2 = x0 - i2 + 2.0f * G4, y2 = y0 - j2 + 2.0f * G4, z2 = z0 - k2 + 2.0f * G4, w2 = w0 - l2 + 2.0f * G4;
+            float x3 = x0 - i3 + 3.0f * G4, y3 = y0 - j3 + 3.0f * G4, z3 = z0 - k3 + 3.0f * G4, w3 = w0 - l3 + 3.0f * G4;
+            float x4 = x0 - 1.0f + 4.0f * G4, y4 = y0 - 1.0f + 4.0f * G4, z4 = z0 - 1.0f + 4.0f * G4, w4 = w0 - 1.0f + 4.0f * G4;
+            
+            i &= 255; j &= 255; k &= 255; l &= 255;
+            
+            const unsigned char* perm = this->_perm;
+            const unsigned char* grad = this->_grad4Index;
+            
+            float n0 = _corner(0.6f - x0 * x0 - y0 * y0 - z0 * z0 - w0 * w0,
+                               _dot4(grad[i + perm[j + perm[k + perm[l]]]], x0, y0, z0, w0));
+            float n1 = _corner(0.6f - x1 * x1 - y1 * y1 - z1 * z1 - w1 * w1,
+                               _dot4(grad[i + i1 + perm[j + j1 + perm[k + k1 + perm[l + l1]]]], x1, y1, z1, w1));
+            float n2 = _corner(0.6f - x2 * x2 - y2 * y2 - z2 * z2 - w2 * w2,
+                               _dot4(grad[i + i2 + perm[j + j2 + perm[k + k2 + perm[l + l2]]]], x2, y2, z2, w2));
+            float n3 = _corner(0.6f - x3 * x3 - y3 * y3 - z3 * z3 - w3 * w3,
+                               _dot4(grad[i + i3 + perm[j + j3 + perm[k + k3 + perm[l + l3]]]], x3, y3, z3, w3));
+            float n4 = _corner(0.6f - x4 * x4 - y4 * y4 - z4 * z4 - w4 * w4,
+                               _dot4(grad[i + 1 + perm[j + 1 + perm[k + 1 + perm[l + 1]]]], x4, y4, z4, w4));
+            
+            return 27.0f * (n0 + n1 + n2 + n3 + n4);
+        }
+        
+        float NoiseGenerator::Value2(float x, float y) {
+            int X = _floor(x), Y = _floor(y);
+            x -= X; y -= Y;
+            X &= 255; Y &= 255;
+            
+            const unsigned char* perm = this->_perm;
+            
+            float u = _fade(x);
+            
+            return _lerp(_lerp(this->_hashValue(X + perm[Y]), this->_hashValue(X + 1 + perm[Y]), u),
+                         _lerp(this->_hashValue(X + perm[Y + 1]), this->_hashValue(X + 1 + perm[Y + 1]), u),
+                         _fade(y));
+        }
+        
+        float NoiseGenerator::Value3(float x, float y, float z) {
+            return this->Value4(x, y, z, 0.0f);
+        }
+        
+        float NoiseGenerator::Value4(float x, float y, float z, float w) {
+            int X = _floor(x), Y = _floor(y), Z = _floor(z), W = _floor(w);
+            x -= X; y -= Y; z -= Z; w -= W;
+            X &= 255; Y &= 255; Z &= 255; W &= 255;
+            
+            const unsigned char* perm = this->_perm;
+            
+            float corners[16];
+            for (int c = 0; c < 16; c++) {
+                int dx = (c >> 3) & 1, dy = (c >> 2) & 1, dz = (c >> 1) & 1, dw = c & 1;
+                corners[c] = this->_hashValue(X + dx + perm[Y + dy + perm[Z + dz + perm[W + dw]]]);
+            }
+            
+            float fades[4] = {_fade(w), _fade(z), _fade(y), _fade(x)};
+            for (int axis = 0, size = 16; axis < 4; axis++, size /= 2) {
+                for (int c = 0; c < size / 2; c++) {
+                    corners[c] = _lerp(corners[c * 2], corners[c * 2 + 1], fades[axis]);
+                }
+            }
+            
+            return corners[0];
+        }
+        
+#ifdef __SSE2__
+        static inline __m128 _floor4(__m128 value) {
+            __m128 truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(value));
+            return _mm_sub_ps(truncated, _mm_and_ps(_mm_cmplt_ps(value, truncated), _mm_set1_ps(1.0f)));
+        }
+        
+        static inline __m128 _fade4(__m128 t) {
+            __m128 inner = _mm_add_ps(_mm_mul_ps(t, _mm_sub_ps(_mm_mul_ps(t, _mm_set1_ps(6.0f)), _mm_set1_ps(15.0f))), _mm_set1_ps(10.0f));
+            return _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(t, t), t), inner);
+        }
+        
+        static inline __m128 _lerp4(__m128 a, __m128 b, __m128 t) {
+            return _mm_add_ps(_mm_mul_ps(_mm_sub_ps(_mm_set1_ps(1.0f), t), a), _mm_mul_ps(t, b));
+        }
+        
+        static inline __m128 _corner4(__m128 t, __m128 gx, __m128 gy, __m128 x, __m128 y) {
+            t = _mm_max_ps(t, _mm_setzero_ps());
+            t = _mm_mul_ps(t, t);
+            return _mm_mul_ps(_mm_mul_ps(t, t), _mm_add_ps(_mm_mul_ps(gx, x), _mm_mul_ps(gy, y)));
+        }
+        
+        static inline __m128 _gather(const float* table, const int* index) {
+            return _mm_setr_ps(table[index[0]], table[index[1]], table[index[2]], table[index[3]]);
+        }
+        
+        void NoiseGenerator::_simplex2x4(const float* xs, const float* ys, float* out) {
+            __m128 x = _mm_loadu_ps(xs), y = _mm_loadu_ps(ys);
+            const __m128 one = _mm_set1_ps(1.0f), g2 = _mm_set1_ps(G2), half = _mm_set1_ps(0.5f);
+            
+            __m128 s = _mm_mul_ps(_mm_add_ps(x, y), _mm_set1_ps(F2));
+            __m128 i = _floor4(_mm_add_ps(x, s)), j = _floor4(_mm_add_ps(y, s));
+            __m128 t = _mm_mul_ps(_mm_add_ps(i, j), g2);
+            __m128 x0 = _mm_add_ps(_mm_sub_ps(x, i), t), y0 = _mm_add_ps(_mm_sub_ps(y, j), t);
+            
+            __m128 lower = _mm_cmpgt_ps(x0, y0);
+            __m128 i1 = _mm_and_ps(lower, one), j1 = _mm_andnot_ps(lower, one);
+            
+            __m128 x1 = _mm_add_ps(_mm_sub_ps(x0, i1), g2), y1 = _mm_add_ps(_mm_sub_ps(y0, j1), g2);
+            __m128 x2 = _mm_add_ps(_mm_sub_ps(x0, one), _mm_set1_ps(2.0f * G2)), y2 = _mm_add_ps(_mm_sub_ps(y0, one), _mm_set1_ps(2.0f * G2));
+            
+            // the permutation lookups stay scalar since SSE2 has no gather
+            int ii[4], jj[4], ii1[4], index0[4], index1[4], index2[4];
+            const __m128i mask = _mm_set1_epi32(255);
+            _mm_storeu_si128((__m128i*) ii, _mm_and_si128(_mm_cvttps_epi32(i), mask));
+            _mm_storeu_si128((__m128i*) jj, _mm_and_si128(_mm_cvttps_epi32(j), mask));
+            _mm_storeu_si128((__m128i*) ii1, _mm_cvttps_epi32(i1));
+            
+            const unsigned char* perm = this->_perm;
+            for (int l = 0; l < 4; l++) {
+                index0[l] = ii[l] + perm[jj[l]];
+                index1[l] = ii[l] + ii1[l] + perm[jj[l] + 1 - ii1[l]];
+                index2[l] = ii[l] + 1 + perm[jj[l] + 1];
+            }
+            
+            const float* gradX = this->_grad2X;
+            const float* gradY = this->_grad2Y;
+            __m128 n0 = _corner4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x0, x0)), _mm_mul_ps(y0, y0)), _gather(gradX, index0), _gather(gradY, index0), x0, y0);
+            __m128 n1 = _corner4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x1, x1)), _mm_mul_ps(y1, y1)), _gather(gradX, index1), _gather(gradY, index1), x1, y1);
+            __m128 n2 = _corner4(_mm_sub_ps(_mm_sub_ps(half, _mm_mul_ps(x2, x2)), _mm_mul_ps(y2, y2)), _gather(gradX, index2), _gather(gradY, index2), x2, y2);
+            
+            _mm_storeu_ps(out, _mm_mul_ps(_mm_set1_ps(70.0f), _mm_add_ps(_mm_add_ps(n0, n1), n2)));
+        }
+        
+        void NoiseGenerator::_perlin2x4(const float* xs, const float* ys, float* out) {
+            __m128 x = _mm_loadu_ps(xs), y = _mm_loadu_ps(ys);
+            const __m128 one = _mm_set1_ps(1.0f);
+            
+            __m128 X = _floor4(x), Y = _floor4(y);
+            x = _mm_sub_ps(x, X);
+            y = _mm_sub_ps(y, Y);
+            
+            int xi[4], yi[4], index00[4], index01[4], index10[4], index11[4];
+            const __m128i mask = _mm_set1_epi32(255);
+            _mm_storeu_si128((__m128i*) xi, _mm_and_si128(_mm_cvttps_epi32(X), mask));
+            _mm_storeu_si128((__m128i*) yi, _mm_and_si128(_mm_cvttps_epi32(Y), mask));
+            
+            const unsigned char* perm = this->_perm;
+            for (int l = 0; l < 4; l++) {
+                index00[l] = xi[l] + perm[yi[l]];
+                index01[l] = xi[l] + perm[yi[l] + 1];
+                index10[l] = xi[l] + 1 + perm[yi[l]];
+                index11[l] = xi[l] + 1 + perm[yi[l] + 1];
+            }
+            
+            const float* gradX = this->_grad2X;
+            const float* gradY = this->_grad2Y;
+            __m128 x1 = _mm_sub_ps(x, one), y1 = _mm_sub_ps(y, one);
+            __m128 n00 = _mm_add_ps(_mm_mul_ps(_gather(gradX, index00), x), _mm_mul_ps(_gather(gradY, index00), y));
+            __m128 n01 = _mm_add_ps(_mm_mul_ps(_gather(gradX, index01), x), _mm_mul_ps(_gather(gradY, index01), y1));
+            __m128 n10 = _mm_add_ps(_mm_mul_ps(_gather(gradX, index10), x1), _mm_mul_ps(_gather(gradY, index10), y));
+            __m128 n11 = _mm_add_ps(_mm_mul_ps(_gather(gradX, index11), x1), _mm_mul_ps(_gather(gradY, index11), y1));
+            
+            __m128 u = _fade4(x);
+            
+            _mm_storeu_ps(out, _lerp4(_lerp4(n00, n10, u), _lerp4(n01, n11, u), _fade4(y)));
+        }
+        
+        void NoiseGenerator::_value2x4(const float* xs, const float* ys, float* out) {
+            __m128 x = _mm_loadu_ps(xs), y = _mm_loadu_ps(ys);
+            
+            __m128 X = _floor4(x), Y = _floor4(y);
+            x = _mm_sub_ps(x, X);
+            y = _mm_sub_ps(y, Y);
+            
+            int xi[4], yi[4];
+            const __m128i mask = _mm_set1_epi32(255);
+            _mm_storeu_si128((__m128i*) xi, _mm_and_si128(_mm_cvttps_epi32(X), mask));
+            _mm_storeu_si128((__m128i*) yi, _mm_and_si128(_mm_cvttps_epi32(Y), mask));
+            
+            float v00[4], v01[4], v10[4], v11[4];
+            const unsigned char* perm = this->_perm;
+            for (int l = 0; l < 4; l++) {
+                v00[l] = this->_hashValue(xi[l] + perm[yi[l]]);
+                v01[l] = this->_hashValue(xi[l] + perm[yi[l] + 1]);
+                v10[l] = this->_hashValue(xi[l] + 1 + perm[yi[l]]);
+                v11[l] = this->_hashValue(xi[l] + 1 + perm[yi[l] + 1]);
+            }
+            
+            __m128 u = _fade4(x);
+            
+            _mm_storeu_ps(out, _lerp4(_lerp4(_mm_loadu_ps(v00), _mm_loadu_ps(v10), u),
+                                      _lerp4(_mm_loadu_ps(v01), _mm_loadu_ps(v11), u),
+                                      _fade4(y)));
+        }
+#else
+        void NoiseGenerator::_simplex2x4(const float* x, const float* y, float* out) {
+            for (int l = 0; l < 4; l++) out[l] = this->Simplex2(x[l], y[l]);
+        }
+        
+        void NoiseGenerator::_perlin2x4(const float* x, const float* y, float* out) {
+            for (int l = 0; l < 4; l++) out[l] = this->Perlin2(x[l], y[l]);
+        }
+        
+        void NoiseGenerator::_value2x4(const float* x, const float* y, float* out) {
+            for (int l = 0; l < 4; l++) out[l] = this->Value2(x[l], y[l]);
+        }
+#endif
+        
+        void NoiseGenerator::_basis4(NoiseType type, int dimensions, const float* x, const float* y, const float* z, const float* w, float* out) {
+            if (dimensions == 2) {
+                switch (type) {
+                    case NoiseType::Perlin: this->_perlin2x4(x, y, out); return;
+                    case NoiseType::Simplex: this->_simplex2x4(x, y, out); return;
+                    case NoiseType::Value: this->_value2x4(x, y, out); return;
+                }
+            }
+            
+            for (int l = 0; l < 4; l++) {
+                if (dimensions == 3) {
+                    switch (type) {
+                        case NoiseType::Perlin: out[l] = this->Perlin3(x[l], y[l], z[l]); break;
+                        case NoiseType::Simplex: out[l] = this->Simplex3(x[l], y[l], z[l]); break;
+                        case NoiseType::Value: out[l] = this->Value3(x[l], y[l], z[l]); break;
+                    }
+                } else {
+                    switch (type) {
+                        case NoiseType::Perlin: out[l] = this->Perlin4(x[l], y[l], z[l], w[l]); break;
+                        case NoiseType::Simplex: out[l] = this->Simplex4(x[l], y[l], z[l], w[l]); break;
+                        case NoiseType::Value: out[l] = this->Value4(x[l], y[l], z[l], w[l]); break;
+                    }
+                }
+            }
+        }
+        
+        void NoiseGenerator::_sample4(const NoiseSettings& settings, const float* x, const float* y, const float* z, const float* w, float* out) {
+            if (settings.Fractal == FractalType::None && settings.Frequency == 1.0f) {
+                this->_basis4(settings.Type, settings.Dimensions, x, y, z, w, out);
+                return;
+            }
+            
+            int octaves = settings.Fractal == FractalType::None ? 1 : std::max(settings.Octaves, 1);
+            
+            float frequency = settings.Frequency, amplitude = 1.0f, totalAmplitude = 0.0f;
+            float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+            
+            for (int octave = 0; octave < octaves; octave++) {
+                float px[4], py[4], pz[4], pw[4], value[4];
+                for (int l = 0; l < 4; l++) {
+                    px[l] = x[l] * frequency;
+                    py[l] = y[l] * frequency;
+                    pz[l] = z[l] * frequency;
+                    pw[l] = w[l] * frequency;
+                }
+                
+                this->_basis4(settings.Type, settings.Dimensions, px, py, pz, pw, value);
+                
+                for (int l = 0; l < 4; l++) {
+                    if (settings.Fractal == FractalType::Ridged) {
+                        float ridge = 1.0f - std::abs(value[l]);
+                        value[l] = ridge * ridge * 2.0f - 1.0f;
+                    }
+                    sum[l] += value[l] * amplitude;
+                }
+                
+                totalAmplitude += amplitude;
+                amplitude *= settings.Gain;
+                frequency *= settings.Lacunarity;
+            }
+            
+            for (int l = 0; l < 4; l++) {
+                out[l] = sum[l] / totalAmplitude;
+            }
+        }
+        
+        float NoiseGenerator::Sample(const NoiseSettings& settings, const float* point) {
+            float x[4] = {0}, y[4] = {0}, z[4] = {0}, w[4] = {0}, out[4];
+            x[0] = point[0];
+            y[0] = point[1];
+            if (settings.Dimensions > 2) z[0] = point[2];
+            if (settings.Dimensions > 3) w[0] = point[3];
+            
+            this->_sample4(settings, x, y, z, w, out);
+            
+            return out[0];
+        }
+        
+        void NoiseGenerator::Fill(const NoiseSettings& settings, const float* points, float* out, size_t count) {
+            ENGINE_PROFILER_SCOPE;
+            
+            int dimensions = settings.Dimensions;
+            
+            auto fillRange = [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i += 4) {
+                    float x[4] = {0}, y[4] = {0}, z[4] = {0}, w[4] = {0}, result[4];
+                    size_t lanes = std::min<size_t>(4, end - i);
+                    for (size_t l = 0; l < lanes; l++) {
+                        const float* point = &points[(i + l) * dimensions];
+                        x[l] = point[0];
+                        y[l] = point[1];
+                        if (dimensions > 2) z[l] = point[2];
+                        if (dimensions > 3) w[l] = point[3];
+                    }
+                    this->_sample4(settings, x, y, z, w, result);
+                    std::copy(result, result + lanes, &out[i]);
+                }
+            };
+            
+            if (settings.Parallel) {
+                WorkerThreadPool::ParallelFor(count, 4096, fillRange);
+            } else {
+                fillRange(0, count);
+            }
+        }
+        
+        void NoiseGenerator::FillGrid(const NoiseSettings& settings, float* out, int width, int height, const float* origin, float step) {
+            ENGINE_PROFILER_SCOPE;
+            
+            float z = settings.Dimensions > 2 ? origin[2] : 0.0f;
+            float w = settings.Dimensions > 3 ? origin[3] : 0.0f;
+            
+            auto fillRows = [&](size_t begin, size_t end) {
+                float zs[4] = {z, z, z, z}, ws[4] = {w, w, w, w};
+                for (size_t row = begin; row < end; row++) {
+                    float y = origin[1] + row * step;
+                    float ys[4] = {y, y, y, y};
+                    for (int px = 0; px < width; px += 4) {
+                        float xs[4], result[4];
+                        for (int l = 0; l < 4; l++) {
+                            xs[l] = origin[0] + (px + l) * step;
+                        }
+                        this->_sample4(settings, xs, ys, zs, ws, result);
+                        std::copy(result, result + std::min(4, width - px), &out[row * width + px]);
+                    }
+                }
+            };
+            
+            if (settings.Parallel) {
+                WorkerThreadPool::ParallelFor(height, std::max(1, 16384 / std::max(width, 1)), fillRows);
+            } else {
+                fillRows(0, height);
+            }
+        }
+    }
+}
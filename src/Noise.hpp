@@ -0,0 +1,110 @@
+/*
+ Filename: Noise.hpp
+ Purpose:  Perlin, simplex and value noise filled in bulk
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#include "stdlib.hpp"
+
+namespace Engine {
+    namespace Noise {
+        enum class NoiseType {
+            Perlin,
+            Simplex,
+            Value
+        };
+        
+        enum class FractalType {
+            None,
+            FBm,    // octaves added together
+            Ridged  // 1 - |noise| squared for each octave, gives sharp ridges
+        };
+        
+        struct NoiseSettings {
+            NoiseType Type = NoiseType::Simplex;
+            FractalType Fractal = FractalType::None;
+            int Dimensions = 2;
+            int Octaves = 4;
+            float Frequency = 1.0f;
+            float Lacunarity = 2.0f;
+            float Gain = 0.5f;
+            bool Parallel = true; // splits large fills across the job system
+        };
+        
+        ENGINE_CLASS(NoiseGenerator);
+        
+        // Uses the permutation table and seeding from res/lib/perlin.js so Perlin2/3 and Simplex2/3
+        // give the same values as the script version. Every function stays inside -1.0f to 1.0f.
+        // Has no GL or V8 dependencys so it can be tested on it's own.
+        class NoiseGenerator {
+        public:
+            NoiseGenerator();
+            explicit NoiseGenerator(double seed);
+            
+            // Supports 2^16 different seeds, values from 0 to 1 are scaled up first
+            void Seed(double seed);
+            
+            float Perlin2(float x, float y);
+            float Perlin3(float x, float y, float z);
+            float Perlin4(float x, float y, float z, float w);
+            
+            float Simplex2(float x, float y);
+            float Simplex3(float x, float y, float z);
+            float Simplex4(float x, float y, float z, float w);
+            
+            float Value2(float x, float y);
+            float Value3(float x, float y, float z);
+            float Value4(float x, float y, float z, float w);
+            
+            // point has settings.Dimensions values, applies the frequency and fractal settings
+            float Sample(const NoiseSettings& settings, const float* point);
+            
+            // points holds count points of settings.Dimensions values each
+            void Fill(const NoiseSettings& settings, const float* points, float* out, size_t count);
+            
+            // Fills width * height values in row-major order, value (px, py) is sampled at
+            // origin + (px, py) * step. origin has settings.Dimensions values.
+            void FillGrid(const NoiseSettings& settings, float* out, int width, int height, const float* origin, float step);
+            
+        private:
+            // 4 points at a time, 2D uses SSE2 when the compiler targets it
+            void _basis4(NoiseType type, int dimensions, const float* x, const float* y, const float* z, const float* w, float* out);
+            void _sample4(const NoiseSettings& settings, const float* x, const float* y, const float* z, const float* w, float* out);
+            
+            void _simplex2x4(const float* x, const float* y, float* out);
+            void _perlin2x4(const float* x, const float* y, float* out);
+            void _value2x4(const float* x, const float* y, float* out);
+            
+            inline float _hashValue(int index) {
+                return this->_perm[index] * (2.0f / 255.0f) - 1.0f;
+            }
+            
+            unsigned char _perm[512];
+            unsigned char _grad3Index[512]; // _perm % 12
+            unsigned char _grad4Index[512]; // _perm % 32
+            
+            // x and y of the 3D gradient for each index so the 4 wide 2D paths only do one lookup
+            float _grad2X[512];
+            float _grad2Y[512];
+        };
+    }
+}
@@ -1,15 +1,24 @@
 #include "Package.hpp"
 
 #include <cstring>
+#include <algorithm>
+#include <unordered_set>
 
 #include "vendor/zlib123/zlib.h"
 
+#include "Logger.hpp"
+#include "Profiler.hpp"
+#include "WorkerThreadPool.hpp"
+
 namespace Engine {
     // For performance reasons right now Package does not use PHYSFS and insteed uses memory mapped io
     
     const PackageFileFlags Package::DefaultFileFlags = PackageFileFlags();
     const PackageFileFlags Package::CompressedFileFlags = PackageFileFlags(PackageFileCompressionType::DeflateCompression);
     
+    constexpr const char* Package::INDEX_FILENAME;
+    constexpr const char* Package::DICTIONARY_FILENAME;
+    
     uint32_t localOffsetToRegion(uint32_t localOffset) {
         uint32_t rem = abs((int) localOffset) % PACKAGE_REGION_SIZE;
         if (rem == 0) return localOffset;
@@ -26,6 +35,70 @@ namespace Engine {
         return dataSize + (PACKAGE_REGION_SIZE - rem);
     }
     
+    // Safe to call from several threads at once, each call gets its own stream
+    static bool compressContent(PackageFileCompressionType type, const uint8_t* content, uint32_t contentLength,
+                                const std::vector<uint8_t>& dictionary, std::vector<uint8_t>& dest) {
+        int level = Z_DEFAULT_COMPRESSION;
+        if (type == PackageFileCompressionType::DeflateFastCompression) {
+            level = Z_BEST_SPEED;
+        } else if (type == PackageFileCompressionType::DeflateDictionaryCompression) {
+            level = Z_BEST_COMPRESSION;
+        }
+        
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        if (deflateInit(&stream, level) != Z_OK) {
+            return false;
+        }
+        
+        if (type == PackageFileCompressionType::DeflateDictionaryCompression &&
+            deflateSetDictionary(&stream, dictionary.data(), (uInt) dictionary.size()) != Z_OK) {
+            deflateEnd(&stream);
+            return false;
+        }
+        
+        dest.resize(deflateBound(&stream, contentLength) + 4); // the bound leaves out the dictionary ID
+        
+        stream.next_in = (Bytef*) content;
+        stream.avail_in = contentLength;
+        stream.next_out = dest.data();
+        stream.avail_out = (uInt) dest.size();
+        
+        int err = deflate(&stream, Z_FINISH);
+        dest.resize(stream.total_out);
+        deflateEnd(&stream);
+        
+        return err == Z_STREAM_END;
+    }
+    
+    static bool decompressContent(const uint8_t* content, uint32_t contentLength, uint8_t* dest, uint32_t destLength,
+                                  const std::vector<uint8_t>& dictionary) {
+        z_stream stream;
+        std::memset(&stream, 0, sizeof(stream));
+        if (inflateInit(&stream) != Z_OK) {
+            return false;
+        }
+        
+        stream.next_in = (Bytef*) content;
+        stream.avail_in = contentLength;
+        stream.next_out = dest;
+        stream.avail_out = destLength;
+        
+        int err = inflate(&stream, Z_FINISH);
+        if (err == Z_NEED_DICT) {
+            if (dictionary.empty() || inflateSetDictionary(&stream, dictionary.data(), (uInt) dictionary.size()) != Z_OK) {
+                inflateEnd(&stream);
+                return false;
+            }
+            err = inflate(&stream, Z_FINISH);
+        }
+        
+        bool ok = err == Z_STREAM_END && stream.total_out == destLength;
+        inflateEnd(&stream);
+        
+        return ok;
+    }
+    
     Package::~Package() {
         this->Close();
     }
@@ -35,28 +108,32 @@ namespace Engine {
     }
     
     void Package::WriteFile(std::string filename, uint8_t *content, uint32_t contentLength, PackageFileFlags flags) {
+        if (flags.compression == PackageFileCompressionType::DeflateDictionaryCompression && this->_getDictionary().empty()) {
+            flags.compression = PackageFileCompressionType::DeflateCompression;
+        }
+        
+        if (flags.compression == PackageFileCompressionType::NoCompression) {
+            this->_appendFile(filename, content, contentLength, contentLength, flags);
+            return;
+        }
+        
+        std::vector<uint8_t> compressedContent;
+        if (!compressContent(flags.compression, content, contentLength, this->_getDictionary(), compressedContent)) {
+            // compress failed
+            throw "Compress Failed";
+        }
+        
+        this->_appendFile(filename, compressedContent.data(), (uint32_t) compressedContent.size(), contentLength, flags);
+    }
+    
+    void Package::_appendFile(std::string filename, const uint8_t* content, uint32_t contentLength, uint32_t decompressedLength, PackageFileFlags flags) {
         if (!this->_writenHeader) {
             this->_writeHeader();
         }
         assert(filename.length() < 96);
         
-        uint8_t *compressedContent = content;
-        uint32_t compressedContentLength = contentLength;
-        
-        // Compress the data if we need to
-        if (flags.compression == PackageFileCompressionType::DeflateCompression) {
-            size_t destLength = compressBound(contentLength);
-            uint8_t *dest = new uint8_t[destLength];
-            int err = compress(dest, (uLongf*) &destLength, compressedContent, compressedContentLength);
-            if (err != Z_OK) {
-                // compress failed
-                throw "Compress Failed";
-            }
-            compressedContent = dest;
-            compressedContentLength = destLength;
-        }
-        
         PackageDiskHeader* header = this->_headerRegion->Data<PackageDiskHeader>();
+        header->version = PACKAGE_FILE_VERSION; // flags may use compression an older version can't read
         
         uint32_t oldNextFileHeader = header->nextFileHeaderOffset;
         
@@ -74,8 +151,8 @@ namespace Engine {
         
         std::memcpy(&file->name, filename.c_str(), filename.length());
         file->offset = fileOffset;
-        file->size = compressedContentLength;
-        file->decompressedSize = contentLength;
+        file->size = contentLength;
+        file->decompressedSize = decompressedLength;
         file->flags = flags;
         
         file->nextFileOffset = header->nextFileHeaderOffset += sizeof(PackageDiskFile);
@@ -84,9 +161,9 @@ namespace Engine {
         Platform::MemoryMappedRegionPtr contentRegion = this->_file->MapRegion(header->nextRegionOffset, roundSizeToRegionSize(contentLength));
         char* contentData = contentRegion->Data<char>();
         
-        std::memcpy(contentData, compressedContent, compressedContentLength);
+        std::memcpy(contentData, content, contentLength);
         
-        header->nextRegionOffset += roundSizeToRegionSize(compressedContentLength);
+        header->nextRegionOffset += roundSizeToRegionSize(contentLength);
         header->numOfFiles++;
         
         // Check to see if we've exceaded the current file header region
@@ -112,11 +189,6 @@ namespace Engine {
         // Close regions
         this->_file->UnmapRegion(fileRegion);
         this->_file->UnmapRegion(contentRegion);
-        
-        // Free Compressed Data
-        if (flags.compression != PackageFileCompressionType::NoCompression) {
-            delete [] compressedContent;
-        }
     }
     
     uint8_t* Package::ReadFile(std::string filename, uint32_t& contentLength) {
@@ -143,10 +215,14 @@ namespace Engine {
         if (fileHeader->flags.compression == PackageFileCompressionType::NoCompression) {
             assert(fileHeader->size == fileHeader->decompressedSize);
         } else {
-            size_t decompressedFileSize = fileHeader->decompressedSize;
+            static const std::vector<uint8_t> noDictionary;
+            const std::vector<uint8_t>& dictionary = fileHeader->flags.compression == PackageFileCompressionType::DeflateDictionaryCompression ?
+                this->_getDictionary() : noDictionary;
+            
+            uint32_t decompressedFileSize = fileHeader->decompressedSize;
             uint8_t* decompressedFileData = new uint8_t[decompressedFileSize];
-            int err = uncompress(decompressedFileData, (uLongf*) &decompressedFileSize, fileData, fileHeader->size);
-            assert(decompressedFileSize == fileHeader->decompressedSize);
+            bool decompressed = decompressContent(fileData, fileHeader->size, decompressedFileData, decompressedFileSize, dictionary);
+            assert(decompressed);
             delete [] fileData;
             contentLength = decompressedFileSize;
             fileData = decompressedFileData;
@@ -166,6 +242,34 @@ namespace Engine {
         return fileData;
     }
     
+    Platform::MemoryMappedRegionPtr Package::MapFile(std::string filename, uint32_t& contentLength) {
+        uint32_t fileHeaderOffset = this->_getFileHeaderOffset(filename);
+        
+        if (fileHeaderOffset == 0) {
+            throw "File Not found";
+        }
+        
+        Platform::MemoryMappedRegionPtr headerPtr = this->_file->MapRegion(localOffsetToRegion(fileHeaderOffset), PACKAGE_REGION_SIZE);
+        PackageDiskFile* fileHeader = headerPtr->Data<PackageDiskFile>(localOffsetToRegionOffset(fileHeaderOffset));
+        
+        Platform::MemoryMappedRegionPtr dataPtr = NULL;
+        
+        // file content always starts on a region so it can be mapped directly
+        if (fileHeader->flags.compression == PackageFileCompressionType::NoCompression &&
+            fileHeader->flags.encryption == PackageFileEncryptionType::NoEncryption) {
+            dataPtr = this->_file->MapRegion(fileHeader->offset, roundSizeToRegionSize(fileHeader->size));
+            contentLength = fileHeader->size;
+        }
+        
+        this->_file->UnmapRegion(headerPtr);
+        
+        return dataPtr;
+    }
+    
+    void Package::UnmapFile(Platform::MemoryMappedRegionPtr region) {
+        this->_file->UnmapRegion(region);
+    }
+    
     Json::Value& Package::GetIndex() {
         return this->_index;
     }
@@ -190,6 +294,28 @@ namespace Engine {
         this->_savedIndex = true;
     }
     
+    void Package::SetDictionary(const uint8_t* content, uint32_t contentLength) {
+        assert(!this->FileExists(DICTIONARY_FILENAME));
+        
+        this->_appendFile(DICTIONARY_FILENAME, content, contentLength, contentLength, DefaultFileFlags);
+        
+        this->_dictionary.assign(content, content + contentLength);
+        this->_loadedDictionary = true;
+    }
+    
+    const std::vector<uint8_t>& Package::_getDictionary() {
+        if (!this->_loadedDictionary) {
+            this->_loadedDictionary = true;
+            if (this->FileExists(DICTIONARY_FILENAME)) {
+                uint32_t dictionaryLength = 0;
+                uint8_t* dictionary = this->ReadFile(DICTIONARY_FILENAME, dictionaryLength);
+                this->_dictionary.assign(dictionary, dictionary + dictionaryLength);
+                delete [] dictionary;
+            }
+        }
+        return this->_dictionary;
+    }
+    
     void Package::Defragment() {
         // TODO: Create a new Package and walk through the current one writing only the most recent revision to files
     }
@@ -213,32 +339,220 @@ namespace Engine {
         return Package::FromJsonSpec(Filesystem::LoadJsonFile(inputFile), outputFile);
     }
     
+    PackageFileCompressionType Package::ParseCompressionType(std::string name) {
+        if (name == "none") {
+            return PackageFileCompressionType::NoCompression;
+        } else if (name == "deflate") {
+            return PackageFileCompressionType::DeflateCompression;
+        } else if (name == "deflateFast") {
+            return PackageFileCompressionType::DeflateFastCompression;
+        } else if (name == "deflateDictionary") {
+            return PackageFileCompressionType::DeflateDictionaryCompression;
+        } else {
+            Logger::begin("Package", Logger::LogLevel_Warning) << "Unknown compression \"" << name << "\", using deflate" << Logger::end();
+            return PackageFileCompressionType::DeflateCompression;
+        }
+    }
+    
+    std::vector<uint8_t> Package::TrainDictionary(const std::vector<std::pair<const uint8_t*, size_t>>& samples, size_t maxSize) {
+        ENGINE_PROFILER_SCOPE;
+        
+        static const size_t SegmentSize = 32;
+        static const size_t MaxSampleBytes = 16 * 1024; // boilerplate shared between files is near the start
+        
+        maxSize = std::min<size_t>(maxSize, 32 * 1024); // the deflate window can't reach any further back
+        
+        // segments are kept in the order they were first seen so the same samples always train the same dictionary
+        std::unordered_map<std::string, size_t> segmentIndex;
+        std::vector<std::pair<std::string, unsigned int>> segments;
+        
+        for (auto sample = samples.begin(); sample != samples.end(); sample++) {
+            std::unordered_set<std::string> seen;
+            size_t length = std::min(sample->second, MaxSampleBytes);
+            
+            for (size_t offset = 0; offset + SegmentSize <= length; offset += SegmentSize) {
+                std::string segment((const char*) sample->first + offset, SegmentSize);
+                if (!seen.insert(segment).second) {
+                    continue;
+                }
+                
+                auto iter = segmentIndex.find(segment);
+                if (iter == segmentIndex.end()) {
+                    segmentIndex[segment] = segments.size();
+                    segments.push_back(std::make_pair(segment, 1));
+                } else {
+                    segments[iter->second].second++;
+                }
+            }
+        }
+        
+        std::stable_sort(segments.begin(), segments.end(), [](const std::pair<std::string, unsigned int>& a, const std::pair<std::string, unsigned int>& b) {
+            return a.second > b.second;
+        });
+        
+        size_t segmentCount = 0;
+        while (segmentCount < segments.size() && segments[segmentCount].second > 1 && (segmentCount + 1) * SegmentSize <= maxSize) {
+            segmentCount++;
+        }
+        
+        std::vector<uint8_t> dictionary;
+        dictionary.reserve(segmentCount * SegmentSize);
+        
+        for (size_t i = segmentCount; i > 0; i--) {
+            const std::string& segment = segments[i - 1].first;
+            dictionary.insert(dictionary.end(), segment.begin(), segment.end());
+        }
+        
+        return dictionary;
+    }
+    
+    struct PackageBuildEntry {
+        std::string Src, Dest;
+        PackageFileFlags Flags;
+        
+        char* Content = NULL;
+        long Length = 0;
+        
+        std::vector<uint8_t> Compressed;
+        bool Failed = false;
+    };
+    
     PackagePtr Package::FromJsonSpec(Json::Value inputFile, std::string outputFile) {
+        BuildStats stats;
+        return Package::FromJsonSpec(inputFile, outputFile, stats);
+    }
+    
+    PackagePtr Package::FromJsonSpec(Json::Value inputFile, std::string outputFile, BuildStats& stats) {
+        ENGINE_PROFILER_SCOPE;
+        
+        double startTime = Platform::GetTime();
+        
         assert(inputFile.isObject());
         Json::Value fileList = inputFile["files"];
         assert(fileList.isArray());
         
-        PackagePtr ret = Package::FromFile(outputFile);
+        PackageFileCompressionType defaultCompression = ParseCompressionType(inputFile.get("compression", "deflate").asString());
+        
+        std::vector<PackageBuildEntry> entries;
+        bool needsDictionary = false;
         
         for (auto iter = fileList.begin(); iter != fileList.end(); iter++) {
             Json::Value value = *iter;
             
-            std::string srcFilename, destFilename;
-            bool compress = true;
+            PackageBuildEntry entry;
+            PackageFileCompressionType compression = defaultCompression;
             
             if (value.isString()) {
                 assert(value.isString());
-                srcFilename = destFilename = value.asString();
+                entry.Src = entry.Dest = value.asString();
             } else {
                 assert(value.isObject());
-                srcFilename = value["src"].asString();
-                destFilename = value.get("dest", srcFilename).asString();
-                compress = value.get("compress", true).asBool();
+                entry.Src = value["src"].asString();
+                entry.Dest = value.get("dest", entry.Src).asString();
+                if (value.isMember("compression")) {
+                    compression = ParseCompressionType(value["compression"].asString());
+                } else if (!value.get("compress", true).asBool()) {
+                    compression = PackageFileCompressionType::NoCompression;
+                }
+            }
+            
+            if (!Filesystem::FileExists(entry.Src)) {
+                Logger::begin("Package", Logger::LogLevel_Error) << "Skipping " << entry.Src << ", the file does not exist" << Logger::end();
+                continue;
+            }
+            
+            entry.Flags = PackageFileFlags(compression);
+            needsDictionary = needsDictionary || compression == PackageFileCompressionType::DeflateDictionaryCompression;
+            
+            entries.push_back(entry);
+        }
+        
+        PackagePtr ret = Package::FromFile(outputFile);
+        
+        // a package being added to keeps the dictionary it was built with
+        if (needsDictionary && ret->_getDictionary().empty()) {
+            std::vector<size_t> dictionaryEntries;
+            for (size_t i = 0; i < entries.size(); i++) {
+                if (entries[i].Flags.compression == PackageFileCompressionType::DeflateDictionaryCompression) {
+                    dictionaryEntries.push_back(i);
+                }
+            }
+            
+            // the samples are kept for the build pass below instead of being read twice
+            WorkerThreadPool::ParallelFor(dictionaryEntries.size(), 1, [&](size_t begin, size_t end) {
+                for (size_t i = begin; i < end; i++) {
+                    PackageBuildEntry& entry = entries[dictionaryEntries[i]];
+                    entry.Content = Filesystem::GetFileContent(entry.Src, entry.Length);
+                }
+            });
+            
+            std::vector<std::pair<const uint8_t*, size_t>> samples;
+            for (auto iter = dictionaryEntries.begin(); iter != dictionaryEntries.end(); iter++) {
+                samples.push_back(std::make_pair((const uint8_t*) entries[*iter].Content, (size_t) entries[*iter].Length));
+            }
+            
+            std::vector<uint8_t> dictionary = TrainDictionary(samples, inputFile.get("dictionarySize", 32 * 1024).asUInt());
+            
+            if (!dictionary.empty()) {
+                ret->SetDictionary(dictionary.data(), (uint32_t) dictionary.size());
+                stats.DictionarySize = dictionary.size();
+            } else {
+                Logger::begin("Package", Logger::LogLevel_Warning) << "The dictionary samples have nothing in common, using deflate" << Logger::end();
+            }
+        }
+        
+        const std::vector<uint8_t>& dictionary = ret->_getDictionary();
+        
+        // only a window of files is held in memory, compressed files are appended in order as each window finishes
+        size_t windowSize = (WorkerThreadPool::GetWorkerCount() + 1) * 4;
+        
+        for (size_t windowStart = 0; windowStart < entries.size(); windowStart += windowSize) {
+            size_t windowEnd = std::min(windowStart + windowSize, entries.size());
+            
+            WorkerThreadPool::ParallelFor(windowEnd - windowStart, 1, [&](size_t begin, size_t end) {
+                for (size_t i = windowStart + begin; i < windowStart + end; i++) {
+                    PackageBuildEntry& entry = entries[i];
+                    
+                    if (entry.Content == NULL) {
+                        entry.Content = Filesystem::GetFileContent(entry.Src, entry.Length);
+                    }
+                    
+                    if (entry.Flags.compression == PackageFileCompressionType::DeflateDictionaryCompression && dictionary.empty()) {
+                        entry.Flags.compression = PackageFileCompressionType::DeflateCompression;
+                    }
+                    
+                    if (entry.Flags.compression != PackageFileCompressionType::NoCompression) {
+                        entry.Failed = !compressContent(entry.Flags.compression, (const uint8_t*) entry.Content, (uint32_t) entry.Length,
+                                                        dictionary, entry.Compressed);
+                    }
+                }
+            });
+            
+            for (size_t i = windowStart; i < windowEnd; i++) {
+                PackageBuildEntry& entry = entries[i];
+                
+                if (entry.Failed) {
+                    // compress failed
+                    throw "Compress Failed";
+                }
+                
+                assert(entry.Length < UINT32_MAX);
+                
+                if (entry.Flags.compression == PackageFileCompressionType::NoCompression) {
+                    ret->_appendFile(entry.Dest, (const uint8_t*) entry.Content, (uint32_t) entry.Length, (uint32_t) entry.Length, entry.Flags);
+                    stats.OutputBytes += entry.Length;
+                } else {
+                    ret->_appendFile(entry.Dest, entry.Compressed.data(), (uint32_t) entry.Compressed.size(), (uint32_t) entry.Length, entry.Flags);
+                    stats.OutputBytes += entry.Compressed.size();
+                }
+                
+                stats.Files++;
+                stats.InputBytes += entry.Length;
+                
+                delete [] entry.Content;
+                entry.Content = NULL;
+                std::vector<uint8_t>().swap(entry.Compressed);
             }
-            long fileLength = 0;
-            char* fileContent = Filesystem::GetFileContent(srcFilename, fileLength);
-            assert(fileLength < UINT32_MAX);
-            ret->WriteFile(destFilename, (uint8_t*) fileContent, (uint32_t) fileLength, compress ? CompressedFileFlags : DefaultFileFlags);
         }
         
         if (!inputFile.get("index", Json::nullValue).isNull()) {
@@ -246,6 +560,12 @@ namespace Engine {
             ret->SaveIndex();
         }
         
+        stats.TotalTime = Platform::GetTime() - startTime;
+        
+        Logger::begin("Package", Logger::LogLevel_Log) << "Built " << outputFile << " from " << stats.Files << " files: "
+            << stats.InputBytes / (1024.0 * 1024.0) << "MB -> " << stats.OutputBytes / (1024.0 * 1024.0) << "MB in " << stats.TotalTime << "s | "
+            << (stats.InputBytes / (1024.0 * 1024.0)) / stats.TotalTime << "MB/s" << Logger::end();
+        
         return ret;
     }
     
@@ -259,6 +579,16 @@ namespace Engine {
                                header->magic[2] == 'K' &&
                                header->magic[3] == 'G');
         
+        // older versions only lack compression types so they can still be read and added to
+        if (this->_writenHeader && header->version > PACKAGE_FILE_VERSION) {
+            Logger::begin("Package", Logger::LogLevel_Error) << "Package version " << header->version
+                << " is newer than the supported version " << PACKAGE_FILE_VERSION << Logger::end();
+            this->_file->UnmapRegion(this->_headerRegion);
+            this->_file->Close();
+            delete this->_file;
+            throw "Unsupported package version";
+        }
+        
         if (this->FileExists(INDEX_FILENAME)) {
             uint32_t indexLength = 0;
             uint8_t* indexContent = this->ReadFile(INDEX_FILENAME, indexLength);
@@ -272,6 +602,7 @@ namespace Engine {
         PackageDiskHeader* header = this->_headerRegion->Data<PackageDiskHeader>();
         PackageDiskHeader headerTemplate;
         std::memcpy(header, &headerTemplate, sizeof(headerTemplate));
+        std::memcpy(header->magic, "EPKG", 4);
         header->thisUUID = Platform::GenerateUUID();
         std::memset(&header->patchUUID, 0, sizeof(header->patchUUID));
         
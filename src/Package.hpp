@@ -3,6 +3,8 @@
 #include "vendor/json/json.h"
 
 #include <string.h>
+#include <vector>
+#include <utility>
 
 #include "stdlib.hpp"
 #include "Platform.hpp"
@@ -12,7 +14,7 @@
 #define PACKAGE_FILES_PER_CHUNK 32
 #define PACKAGE_REGION_SIZE 4096
 #define PACKAGE_FILE_MAGIC 0xDEADBEEF
-#define PACKAGE_FILE_VERSION 0x0003
+#define PACKAGE_FILE_VERSION 0x0004 // 0x0004 adds DeflateFastCompression and DeflateDictionaryCompression
 
 namespace Engine {
     
@@ -56,7 +58,9 @@ namespace Engine {
     
     enum class PackageFileCompressionType : uint8_t {
         NoCompression = 0x00,
-        DeflateCompression = 0x01
+        DeflateCompression = 0x01,
+        DeflateFastCompression = 0x02,          // zlib level 1, builds several times faster for a slightly larger package
+        DeflateDictionaryCompression = 0x03     // zlib level 9 primed with the package's __DICTIONARY__, for many small similar files
     };
     
     enum class PackageFileEncryptionType : uint8_t {
@@ -131,24 +135,54 @@ namespace Engine {
     
     class Package {
     public:
+        struct BuildStats {
+            size_t Files = 0;
+            uint64_t InputBytes = 0;
+            uint64_t OutputBytes = 0;
+            size_t DictionarySize = 0;
+            double TotalTime = 0.0;
+        };
+        
         ~Package();
         
         bool FileExists(std::string filename);
         void WriteFile(std::string filename, uint8_t* content, uint32_t contentLength, PackageFileFlags flags);
         uint8_t* ReadFile(std::string filename, uint32_t& contentLength);
         
+        // Maps an uncompressed file in place without copying it, returns NULL for compressed
+        // files. The region has to be unmapped with UnmapFile before the package is closed.
+        Platform::MemoryMappedRegionPtr MapFile(std::string filename, uint32_t& contentLength);
+        void UnmapFile(Platform::MemoryMappedRegionPtr region);
+        
         Json::Value& GetIndex();
         void SaveIndex();
         
+        // Stored uncompressed as __DICTIONARY__, it has to be set before any DeflateDictionaryCompression
+        // files are written. Those files fall back to DeflateCompression in a package without one.
+        void SetDictionary(const uint8_t* content, uint32_t contentLength);
+        
         void Defragment();
         
         void Close();
         
-        const char* INDEX_FILENAME = "__INDEX__";
+        static constexpr const char* INDEX_FILENAME = "__INDEX__";
+        static constexpr const char* DICTIONARY_FILENAME = "__DICTIONARY__";
         
+        // Throws "Unsupported package version" for packages written by a newer build
         static PackagePtr FromFile(std::string filename);
+        
+        // Files are read and compressed on the job system a few at a time and appended in the order
+        // the spec lists them, so the same spec always builds the same package
         static PackagePtr FromJsonSpec(std::string inputFile, std::string outputFile);
         static PackagePtr FromJsonSpec(Json::Value inputFile, std::string outputFile);
+        static PackagePtr FromJsonSpec(Json::Value inputFile, std::string outputFile, BuildStats& stats);
+        
+        // "none", "deflate", "deflateFast" or "deflateDictionary"
+        static PackageFileCompressionType ParseCompressionType(std::string name);
+        
+        // Keeps the 32 byte runs found in the most samples with the most common last, deflate
+        // reaches the end of the dictionary with the shortest distances. maxSize is at most 32kb.
+        static std::vector<uint8_t> TrainDictionary(const std::vector<std::pair<const uint8_t*, size_t>>& samples, size_t maxSize);
         
         static const PackageFileFlags DefaultFileFlags;
         static const PackageFileFlags CompressedFileFlags;
@@ -158,6 +192,11 @@ namespace Engine {
         void _writeHeader();
         uint32_t _getFileHeaderOffset(std::string filename);
         
+        // content is already compressed with flags
+        void _appendFile(std::string filename, const uint8_t* content, uint32_t contentLength, uint32_t decompressedLength, PackageFileFlags flags);
+        
+        const std::vector<uint8_t>& _getDictionary();
+        
         Platform::MemoryMappedFilePtr _file;
         
         std::unordered_map<std::string, uint32_t> _fastFileLookup;
@@ -167,5 +206,8 @@ namespace Engine {
         Platform::MemoryMappedRegionPtr _headerRegion;
         
         Json::Value _index = Json::Value(Json::objectValue);
+        
+        std::vector<uint8_t> _dictionary;
+        bool _loadedDictionary = false;
     };
 }
@@ -24,6 +24,10 @@
 
 #include <cstdlib>
 #include <cstring>
+#include <sstream>
+#include <vector>
+
+#include "Logger.hpp"
 
 namespace Engine {
     
@@ -71,13 +75,185 @@ namespace Engine {
             
             this->Assert("Check File Index Content", p2->GetIndex()["hello"].asString() == "World");
             
+            p2->Close();
+            
+            // pretend a newer build wrote the package
+            long packageLength = 0;
+            char* packageContent = Filesystem::GetFileContent("testing.epkg", packageLength);
+            ((PackageDiskHeader*) packageContent)->version = PACKAGE_FILE_VERSION + 1;
+            Filesystem::WriteFile("testing.epkg", packageContent, packageLength);
+            delete [] packageContent;
+            
+            bool rejected = false;
+            try {
+                Package::FromFile("testing.epkg");
+            } catch (const char*) {
+                rejected = true;
+            }
+            this->Assert("Newer package versions are rejected", rejected);
+            
             double endTime = Platform::GetTime();
             
             std::cout << "time = " << (endTime - startTime) << "s" << std::endl;
         }
     };
     
+    // Small similar files are where the codecs differ the most, a few large ones show the throughput
+    class PackageCodecTest : public Test {
+    public:
+        std::string GetName() override { return "PackageCodecTest"; }
+        
+        void Run() override {
+            for (int i = 0; i < SmallFileCount; i++) {
+                std::stringstream ss;
+                ss << "{\n\t\"name\": \"sprite_" << i << "\",\n\t\"texture\": \"texture/sprites/atlas_" << (i % 7)
+                   << ".png\",\n\t\"frames\": [" << i << ", " << i * 2 << ", " << i * 3 << "],\n\t\"loop\": true,\n\t\"speed\": 0.5\n}\n";
+                this->_files.push_back(ss.str());
+            }
+            
+            for (int i = 0; i < LargeFileCount; i++) {
+                std::string large;
+                while (large.length() < LargeFileSize) {
+                    large += this->_files[(large.length() / 7 + i) % SmallFileCount];
+                }
+                this->_files.push_back(large);
+            }
+            
+            size_t deflateSize = this->_runCodec(PackageFileCompressionType::DeflateCompression, "deflate");
+            size_t fastSize = this->_runCodec(PackageFileCompressionType::DeflateFastCompression, "deflateFast");
+            size_t dictionarySize = this->_runCodec(PackageFileCompressionType::DeflateDictionaryCompression, "deflateDictionary");
+            
+            this->Assert("Compressed packages are smaller", deflateSize < this->_inputSize && fastSize < this->_inputSize);
+            this->Assert("A dictionary shrinks small similar files", dictionarySize < deflateSize);
+            
+            this->_runSpecBuild();
+            
+            Filesystem::DeleteFile("codecTest.epkg");
+        }
+        
+    private:
+        static const int SmallFileCount = 500;
+        static const int LargeFileCount = 4;
+        static const size_t LargeFileSize = 4 * 1024 * 1024;
+        
+        std::vector<std::string> _files;
+        size_t _inputSize = 0;
+        
+        size_t _runCodec(PackageFileCompressionType type, const char* name) {
+            if (Filesystem::FileExists("codecTest.epkg")) {
+                Filesystem::DeleteFile("codecTest.epkg");
+            }
+            
+            double startTime = Platform::GetTime();
+            
+            PackagePtr p = Package::FromFile("codecTest.epkg");
+            
+            if (type == PackageFileCompressionType::DeflateDictionaryCompression) {
+                std::vector<std::pair<const uint8_t*, size_t>> samples;
+                for (int i = 0; i < SmallFileCount; i++) {
+                    samples.push_back(std::make_pair((const uint8_t*) this->_files[i].c_str(), this->_files[i].length()));
+                }
+                std::vector<uint8_t> dictionary = Package::TrainDictionary(samples, 32 * 1024);
+                p->SetDictionary(dictionary.data(), (uint32_t) dictionary.size());
+            }
+            
+            this->_inputSize = 0;
+            for (size_t i = 0; i < this->_files.size(); i++) {
+                p->WriteFile(std::to_string(i) + ".test", (uint8_t*) this->_files[i].c_str(), (uint32_t) this->_files[i].length(), PackageFileFlags(type));
+                this->_inputSize += this->_files[i].length();
+            }
+            
+            p->Close();
+            
+            double writeTime = Platform::GetTime() - startTime;
+            
+            size_t packageSize = Filesystem::FileSize("codecTest.epkg");
+            
+            PackagePtr p2 = Package::FromFile("codecTest.epkg");
+            
+            bool matches = true;
+            
+            startTime = Platform::GetTime();
+            
+            for (size_t i = 0; i < this->_files.size(); i++) {
+                uint32_t length = 0;
+                uint8_t* content = p2->ReadFile(std::to_string(i) + ".test", length);
+                matches = matches && length == this->_files[i].length() && std::memcmp(content, this->_files[i].c_str(), length) == 0;
+                delete [] content;
+            }
+            
+            double readTime = Platform::GetTime() - startTime;
+            
+            p2->Close();
+            
+            this->Assert(std::string("Files read back the same with ") + name, matches);
+            
+            double inputMB = this->_inputSize / (1024.0 * 1024.0);
+            
+            Logger::begin("PackageCodecTest", Logger::LogLevel_Log) << name << " x " << this->_files.size() << " files: "
+                << inputMB << "MB -> " << packageSize / (1024.0 * 1024.0) << "MB | write " << inputMB / writeTime << "MB/s | read "
+                << inputMB / readTime << "MB/s" << Logger::end();
+            
+            return packageSize;
+        }
+        
+        void _runSpecBuild() {
+            if (!Filesystem::FolderExists("/packageBuildTest")) {
+                Filesystem::Mkdir("/packageBuildTest");
+            }
+            
+            const char* codecs[] = {"none", "deflate", "deflateFast", "deflateDictionary"};
+            
+            Json::Value spec(Json::objectValue);
+            spec["files"] = Json::Value(Json::arrayValue);
+            
+            for (size_t i = 0; i < this->_files.size(); i++) {
+                std::string filename = "/packageBuildTest/" + std::to_string(i) + ".txt";
+                Filesystem::WriteFile(filename, this->_files[i].c_str(), this->_files[i].length());
+                
+                Json::Value file(Json::objectValue);
+                file["src"] = filename;
+                file["dest"] = std::to_string(i) + ".txt";
+                file["compression"] = codecs[i % 4];
+                spec["files"].append(file);
+            }
+            spec["index"]["built"] = true;
+            
+            if (Filesystem::FileExists("specTest.epkg")) {
+                Filesystem::DeleteFile("specTest.epkg");
+            }
+            
+            Package::BuildStats stats;
+            PackagePtr p = Package::FromJsonSpec(spec, "specTest.epkg", stats);
+            p->Close();
+            
+            PackagePtr p2 = Package::FromFile("specTest.epkg");
+            
+            bool matches = true;
+            for (size_t i = 0; i < this->_files.size(); i++) {
+                uint32_t length = 0;
+                uint8_t* content = p2->ReadFile(std::to_string(i) + ".txt", length);
+                matches = matches && length == this->_files[i].length() && std::memcmp(content, this->_files[i].c_str(), length) == 0;
+                delete [] content;
+            }
+            
+            this->Assert("Every file in the spec is built", stats.Files == this->_files.size() && stats.InputBytes == this->_inputSize);
+            this->Assert("Parallel builds keep the content of every file", matches);
+            this->Assert("Spec builds train a dictionary", stats.DictionarySize > 0);
+            this->Assert("Spec builds save the index", p2->GetIndex()["built"].asBool());
+            
+            p2->Close();
+            
+            for (size_t i = 0; i < this->_files.size(); i++) {
+                Filesystem::DeleteFile("/packageBuildTest/" + std::to_string(i) + ".txt");
+            }
+            Filesystem::DeleteFile("/packageBuildTest");
+            Filesystem::DeleteFile("specTest.epkg");
+        }
+    };
+    
     void LoadPackageTests() {
         TestSuite::RegisterTest(new BasicPackageTest());
+        TestSuite::RegisterTest(new PackageCodecTest());
     }
 }
@@ -63,6 +63,13 @@ typedef void* (*ENGINE_FARPROC)(void);
 #define ENGINE_stdcall
 #endif
 
+// Only usable on POD types, thread_local is not supported by every compiler we target
+#ifdef _PLATFORM_WIN32
+#define ENGINE_THREAD_LOCAL __declspec(thread)
+#else
+#define ENGINE_THREAD_LOCAL __thread
+#endif
+
 namespace Engine {
     namespace Platform {
         
@@ -188,6 +195,7 @@ namespace Engine {
         
         MutexPtr CreateMutex();
         
+        // Returns NULL if the file can't be opened, regions from Read files are read only
         MemoryMappedFilePtr OpenMemoryMappedFile(std::string filename, FileMode mode);
         
         UUID GenerateUUID();
@@ -177,7 +177,7 @@ namespace Engine {
         
         class OSXMemoryMappedFile : public MemoryMappedFile {
         public:
-            OSXMemoryMappedFile(int fd) : _fd(fd) { }
+            OSXMemoryMappedFile(int fd, FileMode mode) : _fd(fd), _mode(mode) { }
             
             MemoryMappedRegionPtr MapRegion(unsigned long offset, size_t size) override {
                 assert(offset % 4096 == 0);
@@ -187,13 +187,14 @@ namespace Engine {
                 if (fstat(this->_fd, &st) == 0) {
                     fileSize = st.st_size;
                 }
-                if (offset + size > fileSize) {
+                if (offset + size > fileSize && this->_mode == FileMode::Write) {
                     lseek(this->_fd, (offset + size) - 1, SEEK_SET);
                     write(this->_fd, "", 1);
                 }
                 
-                void* region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, this->_fd, offset);
-                if (errno == EINVAL) { throw errno; }
+                int protection = this->_mode == FileMode::Write ? PROT_READ | PROT_WRITE : PROT_READ;
+                void* region = mmap(NULL, size, protection, MAP_SHARED, this->_fd, offset);
+                if (region == MAP_FAILED) { throw errno; }
                 this->_mappedRegions++;
                 return new MemoryMappedRegion(this, region, size);
             }
@@ -215,6 +216,7 @@ namespace Engine {
             
         private:
             int _fd;
+            FileMode _mode;
             size_t _mappedRegions = 0;
         };
         
@@ -343,8 +345,10 @@ namespace Engine {
                 case FileMode::Write:   fmode = O_RDWR;   break;
             }
             int fd = open(filename.c_str(), fmode);
-            assert(fd != -1);
-            return new OSXMemoryMappedFile(fd);
+            if (fd == -1) {
+                return NULL;
+            }
+            return new OSXMemoryMappedFile(fd, mode);
         }
         
         UUID GenerateUUID() {
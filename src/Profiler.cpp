@@ -21,11 +21,13 @@
 
 #include "Profiler.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <deque>
 #include <functional>
 #include <unordered_map>
 #include <sstream>
-#include <map>
-#include <stack>
 
 #include <iomanip>
 #include <ctime>
@@ -37,128 +39,656 @@
 #include "Events.hpp"
 #include "FramePerfMonitor.hpp"
 #include "Application.hpp"
+#include "Filesystem.hpp"
 
 #include "Platform.hpp"
 
 namespace Engine {
     namespace Profiler {
         
-        ProfileZoneMetadata *lastRootZone, *rootZone, *currentZone;
+        static const size_t MaxThreads = 64;
+        static const uint64_t RingSize = 1 << 16; // events per thread, must be a power of 2
+        static const size_t InternCacheSize = 256;
+        
+        struct ZoneEvent {
+            std::atomic<uint64_t> Timestamp;
+            std::atomic<ZoneSitePtr> Site; // NULL marks the end of the innermost zone
+        };
+        
+        struct InternCacheEntry {
+            const char* Name = NULL;
+            const char* Label = NULL;
+            ZoneSitePtr Site = NULL;
+        };
+        
+        // Only the owning thread writes to Events and Head, the main thread reads them when building a frame.
+        // A released ring is reused by the next new thread, Head keeps counting so frames stay readable.
+        struct ThreadState {
+            size_t Index;
+            bool IsMainThread;
+            bool Released;
+            std::atomic<uint64_t> Head;
+            ZoneEvent Events[RingSize];
+            InternCacheEntry InternCache[InternCacheSize];
+        };
+        
+        struct FrameRange {
+            uint64_t Index = 0;
+            uint64_t StartTime = 0;
+            uint64_t EndTime = 0;
+            size_t ThreadCount = 0;
+            uint64_t Begin[MaxThreads];
+            uint64_t End[MaxThreads];
+            size_t ConfigLookups = 0;
+        };
+        
+        static ThreadState* threads[MaxThreads];
+        static std::atomic<size_t> threadCount(0);
+        static std::atomic<bool> shutDown(false);
+        
+        static ENGINE_THREAD_LOCAL ThreadState* currentThread = NULL;
+        static ENGINE_THREAD_LOCAL bool currentThreadRejected = false;
+        
+        static std::unordered_map<std::string, ZoneSite*> internedZones;
+        
+        static uint64_t frameStartTime = 0;
+        static size_t frameStartThreadCount = 0;
+        static uint64_t frameStartPositions[MaxThreads];
+        static FrameRange lastFrame;
+        
+        static Json::Value cachedFrame;
+        static uint64_t cachedFrameIndex = 0;
+        
+        static double captureWindow = 0.0;
+        
+        static const uint64_t originTimestamp = GetTimestamp();
+        static const std::chrono::steady_clock::time_point originTime = std::chrono::steady_clock::now();
+        static std::atomic<double> timestampsPerSecond(0.0);
         
         int currentLogCooldownFrames = 0;
         
-        void BeginProfile(ScopePtr scope) {
-            if (currentZone == NULL) return;
-            if (!Platform::IsMainThread()) return;
-            std::string scopeName = scope->GetName();
-            if (currentZone->children.count(scopeName) == 0) {
-                ProfileZoneMetadata* newZone = new ProfileZoneMetadata();
-                newZone->name = scopeName;
-                newZone->parent = currentZone;
-                currentZone->children[scopeName] = newZone;
-                currentZone = newZone;
-            } else {
-                currentZone = currentZone->children[scopeName];
+        // The ratio is taken over the whole run so it gets more accurate as the engine runs,
+        // the first call waits until 10ms have passed since startup
+        static double _calibrateTimestamps() {
+#ifdef ENGINE_PROFILER_RDTSC
+            uint64_t timestamp;
+            double seconds;
+            do {
+                timestamp = GetTimestamp();
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - originTime).count();
+            } while (seconds < 0.01);
+            double ret = (timestamp - originTimestamp) / seconds;
+#else
+            double ret = 1.0e9;
+#endif
+            timestampsPerSecond.store(ret, std::memory_order_relaxed);
+            return ret;
+        }
+        
+        double TimestampToSeconds(uint64_t timestamp) {
+            double perSecond = timestampsPerSecond.load(std::memory_order_relaxed);
+            if (perSecond == 0.0) {
+                perSecond = _calibrateTimestamps();
             }
+            return timestamp / perSecond;
         }
         
-        void SubmitProfile(ScopePtr scope) {
-            if (currentZone == NULL) return;
-            if (!Platform::IsMainThread()) return;
-            assert(currentZone->parent != NULL);
-            double time = scope->GetElapsedTime();
-            currentZone->callCount++;
-            currentZone->totalTime += time;
-            currentZone->totalSelfTime += time;
-            if (currentZone->avgTime == -1) {
-                currentZone->avgTime = time;
+        static Platform::MutexPtr _getMutex() {
+            static Platform::MutexPtr mutex = Platform::CreateMutex();
+            return mutex;
+        }
+        
+        static ThreadState* _getThreadState() {
+            if (shutDown.load(std::memory_order_relaxed)) {
+                return NULL;
+            }
+            
+            if (currentThread != NULL || currentThreadRejected) {
+                return currentThread;
+            }
+            
+            Platform::MutexPtr mutex = _getMutex();
+            mutex->Enter();
+            
+            // Released is only touched under the mutex, only threads that exit release their ring so it's never the main thread's
+            size_t index = threadCount.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < index && currentThread == NULL; i++) {
+                if (threads[i]->Released) {
+                    threads[i]->Released = false;
+                    currentThread = threads[i];
+                }
+            }
+            
+            if (currentThread != NULL) {
+                mutex->Exit();
+                return currentThread;
+            }
+            
+            if (index < MaxThreads) {
+                ThreadState* state = new ThreadState();
+                state->Index = index;
+                state->IsMainThread = Platform::IsMainThread();
+                state->Released = false;
+                state->Head.store(0, std::memory_order_relaxed);
+                threads[index] = state;
+                threadCount.store(index + 1, std::memory_order_release);
+                currentThread = state;
             } else {
-                currentZone->avgTime += (time - currentZone->avgTime) / currentZone->callCount;
+                currentThreadRejected = true;
             }
-            if (time > currentZone->maxTime) {
-                currentZone->maxTime = time;
+            
+            mutex->Exit();
+            
+            if (currentThreadRejected) {
+                Logger::begin("Profiler", Logger::LogLevel_Warning) << "Too many threads running at once, zones on this thread will not be recorded" << Logger::end();
             }
-            if (time < currentZone->minTime) {
-                currentZone->minTime = time;
+            
+            return currentThread;
+        }
+        
+        static inline void _record(ZoneSitePtr site, uint64_t timestamp) {
+            ThreadState* state = _getThreadState();
+            if (state == NULL) return;
+            uint64_t head = state->Head.load(std::memory_order_relaxed);
+            ZoneEvent& e = state->Events[head & (RingSize - 1)];
+            e.Timestamp.store(timestamp, std::memory_order_relaxed);
+            e.Site.store(site, std::memory_order_relaxed);
+            state->Head.store(head + 1, std::memory_order_release);
+        }
+        
+        void BeginZone(ZoneSitePtr site, uint64_t timestamp) {
+            _record(site, timestamp);
+        }
+        
+        void EndZone(uint64_t timestamp) {
+            _record(NULL, timestamp);
+        }
+        
+        static bool _siteMatches(ZoneSitePtr site, const char* name, const char* label) {
+            if (strcmp(site->Name, name) != 0) return false;
+            if (site->Label == NULL || label == NULL) return site->Label == label;
+            return strcmp(site->Label, label) == 0;
+        }
+        
+        static char* _copyString(const char* str) {
+            size_t length = strlen(str);
+            char* ret = new char[length + 1];
+            memcpy(ret, str, length + 1);
+            return ret;
+        }
+        
+        ZoneSitePtr InternZone(const char* name, const char* label) {
+            ThreadState* state = _getThreadState();
+            InternCacheEntry* entry = NULL;
+            
+            if (state != NULL) {
+                size_t index = (std::hash<const void*>()(name) ^ (std::hash<const void*>()(label) * 31)) & (InternCacheSize - 1);
+                entry = &state->InternCache[index];
+                // The strings could have been freed and their memory reused since they were cached so check the contents too
+                if (entry->Name == name && entry->Label == label && _siteMatches(entry->Site, name, label)) {
+                    return entry->Site;
+                }
+            }
+            
+            std::string key = name;
+            if (label != NULL) {
+                key.push_back('\0');
+                key += label;
+            }
+            
+            Platform::MutexPtr mutex = _getMutex();
+            mutex->Enter();
+            
+            ZoneSite*& site = internedZones[key];
+            if (site == NULL) {
+                site = new ZoneSite();
+                site->Name = _copyString(name);
+                site->Label = label == NULL ? NULL : _copyString(label);
             }
-            currentZone->parent->totalSelfTime -= time;
-            currentZone = currentZone->parent;
+            ZoneSitePtr ret = site;
+            
+            mutex->Exit();
+            
+            if (entry != NULL) {
+                entry->Name = name;
+                entry->Label = label;
+                entry->Site = ret;
+            }
+            
+            return ret;
+        }
+        
+        std::string GetZoneName(ZoneSitePtr site) {
+            if (site->Label == NULL) {
+                return site->Name;
+            }
+            std::stringstream ss;
+            ss << site->Name << " : " << site->Label;
+            return ss.str();
         }
         
         void BeginProfileFrame() {
             if (!Platform::IsMainThread()) return;
-            rootZone = currentZone = new ProfileZoneMetadata();
-            currentZone->name = "Root";
+            frameStartThreadCount = threadCount.load(std::memory_order_acquire);
+            for (size_t i = 0; i < frameStartThreadCount; i++) {
+                frameStartPositions[i] = threads[i]->Head.load(std::memory_order_acquire);
+            }
+            frameStartTime = GetTimestamp();
         }
         
-        void _freeZone(ProfileZoneMetadata* zone) {
-            if (!Platform::IsMainThread()) return;
-            for (auto iter = zone->children.begin(); iter != zone->children.end(); iter++) {
-                _freeZone(iter->second);
+        struct ZoneNode {
+            std::string Name;
+            ZoneSitePtr Site = NULL;
+            unsigned int CallCount = 0;
+            uint64_t TotalTime = 0;
+            uint64_t ChildTime = 0;
+            uint64_t MinTime = UINT64_MAX;
+            uint64_t MaxTime = 0;
+            std::vector<size_t> Children;
+        };
+        
+        static size_t _getChild(std::vector<ZoneNode>& nodes, size_t parent, ZoneSitePtr site) {
+            for (auto iter = nodes[parent].Children.begin(); iter != nodes[parent].Children.end(); iter++) {
+                if (nodes[*iter].Site == site) {
+                    return *iter;
+                }
             }
-            delete zone;
+            nodes.push_back(ZoneNode());
+            size_t index = nodes.size() - 1;
+            nodes[index].Site = site;
+            nodes[index].Name = GetZoneName(site);
+            nodes[parent].Children.push_back(index);
+            return index;
         }
         
-        void _buildJSONFromZone(ProfileZoneMetadata* zone, Json::Value& ret) {
-            ret["name"] = zone->name;
-            ret["count"] = zone->callCount;
-            ret["total"] = zone->totalTime;
-            ret["self"] = zone->totalSelfTime;
-            ret["avg"] = zone->avgTime;
-            ret["min"] = zone->minTime;
-            ret["max"] = zone->maxTime;
+        struct RecordedEvent {
+            uint64_t Timestamp;
+            ZoneSitePtr Site;
+        };
+        
+        // Copies the events between begin and end out of a thread's ring, returns the number of events
+        // that were overwritten before they could be read
+        static uint64_t _copyThreadEvents(ThreadState* state, uint64_t begin, uint64_t end, std::vector<RecordedEvent>& events) {
+            events.clear();
+            
+            uint64_t overwritten = 0;
+            if (end - begin > RingSize) {
+                overwritten = end - begin - RingSize;
+                begin = end - RingSize;
+            }
+            
+            for (uint64_t i = begin; i < end; i++) {
+                ZoneEvent& e = state->Events[i & (RingSize - 1)];
+                events.push_back({e.Timestamp.load(std::memory_order_relaxed), e.Site.load(std::memory_order_relaxed)});
+            }
+            
+            // The owner keeps writing while we copy, anything it could have started overwriting is thrown away
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t head = state->Head.load(std::memory_order_acquire);
+            uint64_t firstValid = head >= RingSize ? head - RingSize + 1 : 0;
+            if (firstValid > begin) {
+                size_t skip = (size_t) std::min(firstValid - begin, end - begin);
+                events.erase(events.begin(), events.begin() + skip);
+                overwritten += skip;
+            }
+            
+            return overwritten;
+        }
+        
+        // Replays one thread's events for the frame into the tree under root
+        static void _addThreadZones(std::vector<ZoneNode>& nodes, size_t root, const std::vector<RecordedEvent>& events) {
+            struct OpenZone {
+                size_t Node;
+                size_t Parent;
+                uint64_t StartTime;
+            };
+            
+            std::vector<OpenZone> stack;
+            for (auto iter = events.begin(); iter != events.end(); iter++) {
+                if (iter->Site != NULL) {
+                    size_t parent = stack.empty() ? root : stack.back().Node;
+                    stack.push_back({_getChild(nodes, parent, iter->Site), parent, iter->Timestamp});
+                } else if (!stack.empty()) { // ends without a begin are zones that started before the frame
+                    OpenZone zone = stack.back();
+                    stack.pop_back();
+                    uint64_t time = iter->Timestamp - zone.StartTime;
+                    ZoneNode& node = nodes[zone.Node];
+                    node.CallCount++;
+                    node.TotalTime += time;
+                    node.MinTime = std::min(node.MinTime, time);
+                    node.MaxTime = std::max(node.MaxTime, time);
+                    nodes[zone.Parent].ChildTime += time;
+                }
+            }
+            
+            // Zones still open at the end of the frame are dropped, they will be counted in the frame they close in
+        }
+        
+        static void _buildJSONFromZone(std::vector<ZoneNode>& nodes, size_t index, Json::Value& ret) {
+            ZoneNode& node = nodes[index];
+            ret["name"] = node.Name;
+            ret["count"] = node.CallCount;
+            ret["total"] = TimestampToSeconds(node.TotalTime);
+            ret["self"] = TimestampToSeconds(node.TotalTime - std::min(node.ChildTime, node.TotalTime));
+            ret["avg"] = node.CallCount > 0 ? TimestampToSeconds(node.TotalTime) / node.CallCount : 0.0;
+            ret["min"] = node.CallCount > 0 ? TimestampToSeconds(node.MinTime) : 0.0;
+            ret["max"] = TimestampToSeconds(node.MaxTime);
             Json::Value& children = ret["children"] = Json::objectValue;
-            for (auto iter = zone->children.begin(); iter != zone->children.end(); iter++) {
-                _buildJSONFromZone(iter->second, children[iter->first]);
+            for (auto iter = node.Children.begin(); iter != node.Children.end(); iter++) {
+                _buildJSONFromZone(nodes, *iter, children[nodes[*iter].Name]);
+            }
+        }
+        
+        static void _buildLastFrame() {
+            std::vector<ZoneNode> nodes;
+            nodes.push_back(ZoneNode());
+            nodes[0].Name = "Root";
+            nodes[0].CallCount = 1;
+            nodes[0].TotalTime = nodes[0].MinTime = nodes[0].MaxTime = lastFrame.EndTime - lastFrame.StartTime;
+            
+            uint64_t dropped = 0;
+            std::vector<RecordedEvent> events;
+            
+            for (size_t i = 0; i < lastFrame.ThreadCount; i++) {
+                if (lastFrame.End[i] == lastFrame.Begin[i]) continue;
+                
+                dropped += _copyThreadEvents(threads[i], lastFrame.Begin[i], lastFrame.End[i], events);
+                
+                if (threads[i]->IsMainThread) {
+                    _addThreadZones(nodes, 0, events);
+                } else {
+                    // Worker threads run alongside the main thread so they get their own node instead of adding to Root's child time
+                    std::stringstream ss;
+                    ss << "Thread " << i;
+                    nodes.push_back(ZoneNode());
+                    size_t threadNode = nodes.size() - 1;
+                    nodes[threadNode].Name = ss.str();
+                    nodes[0].Children.push_back(threadNode);
+                    
+                    _addThreadZones(nodes, threadNode, events);
+                    
+                    ZoneNode& node = nodes[threadNode];
+                    node.CallCount = 1;
+                    node.TotalTime = node.MinTime = node.MaxTime = node.ChildTime;
+                }
+            }
+            
+            cachedFrame = Json::Value(Json::objectValue);
+            _buildJSONFromZone(nodes, 0, cachedFrame);
+            cachedFrame["dropped"] = (Json::UInt64) dropped;
+            cachedFrame["configLookups"] = (Json::UInt64) lastFrame.ConfigLookups; // should be 0, use Config::ConfigVar in anything that runs each frame
+            cachedFrameIndex = lastFrame.Index;
+        }
+        
+        struct CapturedFrame {
+            uint64_t Index;
+            uint64_t StartTime;
+            uint64_t EndTime;
+            size_t ThreadCount;
+            std::vector<RecordedEvent> Threads[MaxThreads];
+        };
+        
+        static std::deque<CapturedFrame*> capturedFrames;
+        static std::vector<CapturedFrame*> freeCapturedFrames; // recycled so a full window doesn't allocate
+        static size_t capturedThreadCount = 0;
+        static uint64_t capturedUntil[MaxThreads];
+        
+        static void _releaseCapturedFrame(CapturedFrame* frame) {
+            for (size_t i = 0; i < frame->ThreadCount; i++) {
+                frame->Threads[i].clear();
+            }
+            freeCapturedFrames.push_back(frame);
+        }
+        
+        static void _captureLastFrame() {
+            CapturedFrame* frame;
+            if (freeCapturedFrames.empty()) {
+                frame = new CapturedFrame();
+            } else {
+                frame = freeCapturedFrames.back();
+                freeCapturedFrames.pop_back();
+            }
+            
+            frame->Index = lastFrame.Index;
+            frame->StartTime = lastFrame.StartTime;
+            frame->EndTime = lastFrame.EndTime;
+            frame->ThreadCount = lastFrame.ThreadCount;
+            
+            for (size_t i = 0; i < lastFrame.ThreadCount; i++) {
+                // Carry on from the last capture so worker events between frames are kept
+                uint64_t begin = lastFrame.Begin[i];
+                if (capturedThreadCount > 0) {
+                    begin = i < capturedThreadCount ? capturedUntil[i] : 0;
+                }
+                _copyThreadEvents(threads[i], begin, lastFrame.End[i], frame->Threads[i]);
+                capturedUntil[i] = lastFrame.End[i];
+            }
+            capturedThreadCount = lastFrame.ThreadCount;
+            
+            capturedFrames.push_back(frame);
+            
+            while (capturedFrames.size() > 1 &&
+                   TimestampToSeconds(frame->EndTime - capturedFrames.front()->EndTime) > captureWindow) {
+                _releaseCapturedFrame(capturedFrames.front());
+                capturedFrames.pop_front();
+            }
+        }
+        
+        void SetCaptureWindow(double seconds) {
+            captureWindow = seconds > 0.0 ? seconds : 0.0;
+            if (captureWindow == 0.0) {
+                while (!capturedFrames.empty()) {
+                    _releaseCapturedFrame(capturedFrames.front());
+                    capturedFrames.pop_front();
+                }
+                for (auto iter = freeCapturedFrames.begin(); iter != freeCapturedFrames.end(); iter++) {
+                    delete *iter;
+                }
+                freeCapturedFrames.clear();
+                capturedThreadCount = 0;
+            }
+        }
+        
+        double GetCaptureWindow() {
+            return captureWindow;
+        }
+        
+        static void _writeTraceEvent(std::stringstream& ss, const std::string& quotedName, const char* phase, size_t tid, double ts, double dur) {
+            ss << ",\n{\"name\":" << quotedName << ",\"ph\":\"" << phase << "\",\"pid\":1,\"tid\":" << tid
+                << ",\"ts\":" << ts;
+            if (dur >= 0.0) {
+                ss << ",\"dur\":" << dur;
+            }
+            ss << "}";
+        }
+        
+        bool WriteTrace(std::string filename) {
+            if (capturedFrames.empty()) {
+                return false;
+            }
+            
+            std::unordered_map<ZoneSitePtr, std::string> quotedNames;
+            std::stringstream ss;
+            ss << std::fixed << std::setprecision(3);
+            
+            // Timestamps are microseconds since the engine started
+            auto toMicroseconds = [](uint64_t timestamp) {
+                return TimestampToSeconds(timestamp - originTimestamp) * 1.0e6;
+            };
+            
+            size_t frameTrack = MaxThreads;
+            size_t threadCount = capturedFrames.back()->ThreadCount;
+            
+            ss << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+            ss << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Engine2D\"}}";
+            ss << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << frameTrack << ",\"args\":{\"name\":\"Frames\"}}";
+            for (size_t i = 0; i < threadCount; i++) {
+                std::stringstream threadName;
+                if (threads[i]->IsMainThread) {
+                    threadName << "Main";
+                } else {
+                    threadName << "Thread " << i;
+                }
+                ss << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << i
+                    << ",\"args\":{\"name\":\"" << threadName.str() << "\"}}";
+            }
+            
+            for (auto iter = capturedFrames.begin(); iter != capturedFrames.end(); iter++) {
+                std::stringstream frameName;
+                frameName << "\"Frame " << (*iter)->Index << "\"";
+                double start = toMicroseconds((*iter)->StartTime);
+                _writeTraceEvent(ss, frameName.str(), "X", frameTrack, start, toMicroseconds((*iter)->EndTime) - start);
+            }
+            
+            // Zones become complete events, a zone spanning several frames is still one event
+            std::vector<RecordedEvent> stack;
+            for (size_t i = 0; i < threadCount; i++) {
+                stack.clear();
+                for (auto frame = capturedFrames.begin(); frame != capturedFrames.end(); frame++) {
+                    if (i >= (*frame)->ThreadCount) continue;
+                    std::vector<RecordedEvent>& events = (*frame)->Threads[i];
+                    for (auto iter = events.begin(); iter != events.end(); iter++) {
+                        if (iter->Site != NULL) {
+                            stack.push_back(*iter);
+                        } else if (!stack.empty()) {
+                            RecordedEvent begin = stack.back();
+                            stack.pop_back();
+                            std::string& name = quotedNames[begin.Site];
+                            if (name.empty()) {
+                                name = Json::valueToQuotedString(GetZoneName(begin.Site).c_str());
+                            }
+                            double start = toMicroseconds(begin.Timestamp);
+                            _writeTraceEvent(ss, name, "X", i, start, toMicroseconds(iter->Timestamp) - start);
+                        }
+                    }
+                }
+            }
+            
+            ss << "\n]}\n";
+            
+            std::string trace = ss.str();
+            Filesystem::WriteFile(filename, trace.c_str(), trace.length());
+            
+            Logger::begin("Profiler", Logger::LogLevel_Log) << "Wrote " << capturedFrames.size() << " frames of trace events to "
+                << filename << Logger::end();
+            
+            return true;
+        }
+        
+        std::string GetDumpFilename(std::string prefix) {
+            if (!Filesystem::FolderExists("/profilerDumps")) {
+                Filesystem::Mkdir("/profilerDumps");
             }
+            char timeString[64];
+            std::time_t t = std::time(NULL);
+            std::strftime(timeString, sizeof(timeString), "%H_%M_%S_%Y_%m_%d", std::localtime(&t));
+            std::stringstream filename;
+            filename << "/profilerDumps/" << prefix << "_" << timeString << ".json";
+            return filename.str();
         }
         
         void EndProfileFrame() {
             if (!Platform::IsMainThread()) return;
-            assert(currentZone == rootZone);            
-            if (lastRootZone != NULL) {
-                _freeZone(lastRootZone);
+            
+            static Config::ConfigVar<float> maxFrameTime("core.debug.profiler.maxFrameTime");
+            static Config::ConfigVar<bool> dumpFrames("core.debug.profiler.dumpFrames");
+            
+            lastFrame.StartTime = frameStartTime;
+            lastFrame.EndTime = GetTimestamp();
+            lastFrame.ThreadCount = threadCount.load(std::memory_order_acquire);
+            for (size_t i = 0; i < lastFrame.ThreadCount; i++) {
+                lastFrame.Begin[i] = i < frameStartThreadCount ? frameStartPositions[i] : 0;
+                lastFrame.End[i] = threads[i]->Head.load(std::memory_order_acquire);
             }
-            lastRootZone = currentZone;
+            lastFrame.ConfigLookups = Config::TakeLookupCount();
+            lastFrame.Index++;
+            
+            _calibrateTimestamps();
+            
             if (GetEventsSingilton()->GetEvent("onProfileEnd")->ListenerCount() > 0) {
                 GetEventsSingilton()->GetEvent("onProfileEnd")->Emit(GetLastFrame());
             }
-#ifdef _PLATFORM_OSX
+            if (captureWindow > 0.0) {
+                _captureLastFrame();
+            }
+            
             if (currentLogCooldownFrames > 0) {
                 currentLogCooldownFrames--;
-            } else {
-                if ((FramePerfMonitor::GetFrameTime() > Config::GetFloat("core.debug.profiler.maxFrameTime")) &&
-                    GetAppSingilton()->GetWindow()->GetFullscreen()) {
-                    if (Config::GetBoolean("core.debug.profiler.dumpFrames") && Filesystem::HasSetUserDir()) {
-                        if (!Filesystem::FolderExists("/profilerDumps")) {
-                            Filesystem::Mkdir("/profilerDumps");
-                        }
+            } else if (FramePerfMonitor::GetFrameTime() > maxFrameTime &&
+                       dumpFrames && Filesystem::HasSetUserDir()) {
+                WindowPtr window = GetAppSingilton()->GetWindow();
+                if (window != NULL && window->GetFullscreen()) {
+                    std::string filename;
+                    if (captureWindow > 0.0) {
+                        filename = GetDumpFilename("trace");
+                        WriteTrace(filename);
+                    } else {
+                        filename = GetDumpFilename("profileDump");
                         std::stringstream ss;
                         ss << GetLastFrame();
-                        std::stringstream filename;
-                        filename << "/profilerDumps/" << "profileDump_";
-                        auto t = std::time(NULL);
-                        auto tm = *std::localtime(&t);
-                        filename << std::put_time(&tm, "%H_%M_%S_%Y_%m_%d");
-                        filename << ".json";
-                        Filesystem::WriteFile(filename.str(), ss.str().c_str(), ss.str().length());
-                        Logger::begin("Profiler", Logger::LogLevel_Warning) <<
-                            "FrameTime exceeded limit: frameTime=" <<
-                            FramePerfMonitor::GetFrameTime() << " maxFrameTime=" <<
-                            Config::GetFloat("core.debug.profiler.maxFrameTime") <<
-                            " wrote log to " << filename.str() << Logger::end();
-                        currentLogCooldownFrames = Config::GetInt("core.debug.profiler.dumpCooldown");
+                        Filesystem::WriteFile(filename, ss.str().c_str(), ss.str().length());
                     }
+                    Logger::begin("Profiler", Logger::LogLevel_Warning) <<
+                        "FrameTime exceeded limit: frameTime=" <<
+                        FramePerfMonitor::GetFrameTime() << " maxFrameTime=" <<
+                        maxFrameTime.Get() <<
+                        " wrote log to " << filename << Logger::end();
+                    currentLogCooldownFrames = Config::GetInt("core.debug.profiler.dumpCooldown");
                 }
             }
-#endif
-            currentZone = rootZone = NULL;
         }
         
         Json::Value GetLastFrame() {
-            Json::Value args(Json::objectValue);
-            _buildJSONFromZone(lastRootZone, args);
-            return args;
+            if (lastFrame.Index == 0) {
+                Json::Value args(Json::objectValue);
+                args["name"] = "Root";
+                args["children"] = Json::objectValue;
+                return args;
+            }
+            if (cachedFrameIndex != lastFrame.Index) {
+                _buildLastFrame();
+            }
+            return cachedFrame;
+        }
+        
+        void Shutdown() {
+            // each thread's currentThread points into the rings, every thread but this one has exited
+            shutDown.store(true, std::memory_order_relaxed);
+            currentThread = NULL;
+            currentThreadRejected = true;
+            
+            SetCaptureWindow(0.0);
+            
+            size_t count = threadCount.load(std::memory_order_acquire);
+            for (size_t i = 0; i < count; i++) {
+                delete threads[i];
+                threads[i] = NULL;
+            }
+            threadCount.store(0, std::memory_order_release);
+            
+            frameStartThreadCount = 0;
+            lastFrame.ThreadCount = 0;
+            cachedFrameIndex = lastFrame.Index; // GetLastFrame keeps returning the last built frame
+        }
+        
+        void ReleaseThread() {
+            if (currentThread == NULL) {
+                currentThreadRejected = false;
+                return;
+            }
+            
+            Platform::MutexPtr mutex = _getMutex();
+            mutex->Enter();
+            
+            // Shutdown may have freed the ring already
+            if (!shutDown.load(std::memory_order_relaxed)) {
+                currentThread->Released = true;
+            }
+            
+            mutex->Exit();
+            
+            currentThread = NULL;
+            currentThreadRejected = false;
         }
     }
 }
\ No newline at end of file
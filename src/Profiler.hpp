@@ -21,69 +21,100 @@
 
 #pragma once
 
+#include <chrono>
 #include <vector>
 #include <string>
 #include <sstream>
+#include <cstdint>
 
 #include "stdlib.hpp"
 #include "Platform.hpp"
 #include "vendor/json/json.h"
 
+#if defined(__i386__) || defined(__x86_64__) || defined(_M_IX86) || defined(_M_X64)
+#define ENGINE_PROFILER_RDTSC
+#ifdef _PLATFORM_WIN32
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
 #ifdef _PLATFORM_WIN32
 #define ENGINE_FUNC __FUNCSIG__
 #else
 #define ENGINE_FUNC __PRETTY_FUNCTION__
 #endif
 
+// Each call site gets a constant initialized ZoneSite so entering a zone never has to look up its name
 #ifdef PROFILER
-#define ENGINE_PROFILER_SCOPE Engine::Profiler::Scope __PROFILER_SCOPE__(ENGINE_FUNC)
-#define ENGINE_PROFILER_SCOPE_EX(str) Engine::Profiler::Scope __PROFILER_SCOPE__(ENGINE_FUNC, str)
+#define ENGINE_PROFILER_SCOPE \
+    static const Engine::Profiler::ZoneSite __PROFILER_SITE__ = {ENGINE_FUNC, NULL}; \
+    Engine::Profiler::Scope __PROFILER_SCOPE__(&__PROFILER_SITE__)
+#define ENGINE_PROFILER_SCOPE_EX(str) \
+    static const Engine::Profiler::ZoneSite __PROFILER_SITE__ = {ENGINE_FUNC, NULL}; \
+    Engine::Profiler::Scope __PROFILER_SCOPE__(&__PROFILER_SITE__, str)
 #else
 #define ENGINE_PROFILER_SCOPE
-#define ENGINE_PROFILER_SCOPE_EX
+#define ENGINE_PROFILER_SCOPE_EX(str)
 #endif
 
 namespace Engine {
     namespace Profiler {
-        struct ProfileZoneMetadata {
-            ProfileZoneMetadata *parent = NULL;
-            std::string name;
-            unsigned int callCount = 0;
-            double totalTime = 0;
-            double totalSelfTime = 0;
-            double avgTime = -1; // Using a CMA (Cumulative Moving Average)
-            double minTime = std::numeric_limits<double>::max();
-            double maxTime = std::numeric_limits<double>::min();
-            std::unordered_map<std::string, ProfileZoneMetadata*> children;
+        struct ZoneSite {
+            const char* Name;
+            const char* Label; // NULL unless the zone was created with ENGINE_PROFILER_SCOPE_EX
         };
         
-        typedef ProfileZoneMetadata* ProfileZoneMetadataPtr;
+        typedef const ZoneSite* ZoneSitePtr;
         
-        ENGINE_CLASS(Scope);
+        // Returns a site that lives for the rest of the program, both strings are copied
+        // the first time they are seen. Lookups are cached per thread so calling this
+        // with the same strings every frame does not allocate.
+        ZoneSitePtr InternZone(const char* name, const char* label);
+        
+        std::string GetZoneName(ZoneSitePtr site);
+        
+        // Uses the CPU's timestamp counter where there is one, it's calibrated against
+        // steady_clock every frame so convert with TimestampToSeconds
+        inline uint64_t GetTimestamp() {
+#ifdef ENGINE_PROFILER_RDTSC
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
         
-        void BeginProfile(ScopePtr scope);
-        void SubmitProfile(ScopePtr scope);
+        double TimestampToSeconds(uint64_t timestamp);
+        
+        // Record into the calling thread's event ring, any thread can call these
+        void BeginZone(ZoneSitePtr site, uint64_t timestamp);
+        void EndZone(uint64_t timestamp);
+        
+        ENGINE_CLASS(Scope);
         
         class Scope {
         public:
-            Scope(const char* functionName) {
-                this->_name = functionName;
-                BeginProfile(this);
-                this->_startTime = Platform::GetTime();
+            Scope(ZoneSitePtr site) : _site(site) {
+                this->_startTime = GetTimestamp();
+                BeginZone(this->_site, this->_startTime);
+            }
+            
+            Scope(ZoneSitePtr site, const char* label) : _site(InternZone(site->Name, label)) {
+                this->_startTime = GetTimestamp();
+                BeginZone(this->_site, this->_startTime);
             }
             
-            Scope(const char* functionName, const char* exName) {
-                std::stringstream ss;
-                ss << functionName << " : " << exName;
-                this->_name = ss.str().c_str();
-                BeginProfile(this);
-                this->_startTime = Platform::GetTime();
+            Scope(const char* name) : _site(InternZone(name, NULL)) {
+                this->_startTime = GetTimestamp();
+                BeginZone(this->_site, this->_startTime);
             }
             
             void Close() {
                 if (this->_running) {
-                    this->_endTime = Platform::GetTime();
-                    SubmitProfile(this);
+                    this->_endTime = GetTimestamp();
+                    EndZone(this->_endTime);
                     this->_running = false;
                 }
             }
@@ -93,22 +124,45 @@ namespace Engine {
             }
             
             std::string GetName() {
-                return std::string(this->_name);
+                return GetZoneName(this->_site);
             }
             
             double GetElapsedTime() {
-                return this->_endTime - this->_startTime;
+                return TimestampToSeconds(this->_endTime - this->_startTime);
             }
         private:
-            const char* _name;
-            double _startTime;
-            double _endTime;
+            ZoneSitePtr _site;
+            uint64_t _startTime;
+            uint64_t _endTime = 0;
             bool _running = true;
         };
         
+        // Only called from the main thread, marks the frame boundaries for every thread's events
         void BeginProfileFrame();
         void EndProfileFrame();
         
+        // The zone tree is only built when this is called. Worker threads that recorded
+        // zones during the frame show up as extra "Thread N" children of the root.
         Json::Value GetLastFrame();
+        
+        // Keeps every zone event from the last few seconds of frames so it can be written
+        // with WriteTrace, 0 turns capturing off and frees the buffered frames
+        void SetCaptureWindow(double seconds);
+        double GetCaptureWindow();
+        
+        // Writes the capture window in the Chrome Trace Event format which chrome://tracing
+        // and ui.perfetto.dev can open. Returns false if nothing has been captured.
+        bool WriteTrace(std::string filename);
+        
+        // Creates /profilerDumps if needed and returns a filename in it based on the current time
+        std::string GetDumpFilename(std::string prefix);
+        
+        // Frees every thread's event ring and the captured frames once the other threads have
+        // stopped, zones recorded afterwards are dropped
+        void Shutdown();
+        
+        // Hands the calling thread's event ring to the next thread that records a zone, threads
+        // that profile and then exit call this before they return
+        void ReleaseThread();
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,312 @@
+/*
+ Filename: RenderCommandList.cpp
+ Purpose:  Retained, sorted list of 2D primitives for batched submission
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "RenderCommandList.hpp"
+
+#include <algorithm>
+
+#include "Profiler.hpp"
+
+namespace Engine {
+    PolygonMode RenderCommandList::GetListMode(PolygonMode mode) {
+        switch (mode) {
+            case PolygonMode::Triangles:
+            case PolygonMode::TriangleStrip:
+            case PolygonMode::TriangleFan:
+                return PolygonMode::Triangles;
+            case PolygonMode::Lines:
+            case PolygonMode::LineStrip:
+            case PolygonMode::LineLoop:
+                return PolygonMode::Lines;
+            default:
+                return PolygonMode::Invalid;
+        }
+    }
+    
+    void RenderCommandList::Begin(RenderSortKey key) {
+        if (this->_recording) {
+            this->End();
+        }
+        
+        this->_currentMode = key.mode;
+        
+        key.mode = GetListMode(key.mode);
+        
+        this->_current.key = key;
+        this->_current.indexStart = this->_indexes.size();
+        this->_current.indexCount = 0;
+        this->_current.spriteDraw = NoSpriteDraw;
+        
+        this->_currentVertStart = this->_verts.size();
+        this->_recording = true;
+    }
+    
+    void RenderCommandList::AddVert(const BufferFormat& vert) {
+        assert(this->_recording);
+        this->_verts.push_back(vert);
+    }
+    
+    void RenderCommandList::End() {
+        if (!this->_recording) return;
+        
+        this->_recording = false;
+        
+        this->_buildIndexes(this->_currentMode, (unsigned int) this->_currentVertStart,
+                            (unsigned int) (this->_verts.size() - this->_currentVertStart));
+        
+        this->_current.indexCount = this->_indexes.size() - this->_current.indexStart;
+        
+        if (this->_current.indexCount == 0 || this->_current.key.mode == PolygonMode::Invalid) {
+            return;
+        }
+        
+        this->_current.bounds = this->_getBounds(this->_currentVertStart, this->_verts.size());
+        
+        // Consecutive primitives with the same state don't need their own command
+        if (!this->_commands.empty()) {
+            Command& last = this->_commands.back();
+            if (last.key == this->_current.key && last.spriteDraw == NoSpriteDraw &&
+                last.indexStart + last.indexCount == this->_current.indexStart) {
+                last.indexCount += this->_current.indexCount;
+                last.bounds.minX = std::min(last.bounds.minX, this->_current.bounds.minX);
+                last.bounds.minY = std::min(last.bounds.minY, this->_current.bounds.minY);
+                last.bounds.maxX = std::max(last.bounds.maxX, this->_current.bounds.maxX);
+                last.bounds.maxY = std::max(last.bounds.maxY, this->_current.bounds.maxY);
+                return;
+            }
+        }
+        
+        this->_commands.push_back(this->_current);
+    }
+    
+    void RenderCommandList::AddSprites(RenderSortKey key, const SpriteInstance* sprites, size_t count,
+                                       const glm::mat4& model, glm::vec2 uvOffset, glm::vec2 uvScale) {
+        if (this->_recording) {
+            this->End();
+        }
+        
+        if (count == 0) return;
+        
+        RenderSpriteDraw draw;
+        draw.start = this->_sprites.size();
+        draw.count = count;
+        draw.model = model;
+        draw.uvOffset = uvOffset;
+        draw.uvScale = uvScale;
+        
+        this->_sprites.insert(this->_sprites.end(), sprites, sprites + count);
+        this->_spriteDraws.push_back(draw);
+        
+        Command cmd;
+        cmd.key = key;
+        cmd.indexStart = this->_indexes.size();
+        cmd.indexCount = 0;
+        cmd.spriteDraw = this->_spriteDraws.size() - 1;
+        
+        // the bounds cover every rotation of each sprite so they don't depend on the shader
+        bool first = true;
+        for (size_t i = 0; i < count; i++) {
+            const SpriteInstance& sprite = sprites[i];
+            glm::vec2 extent = glm::vec2(sprite.rect.z, sprite.rect.w) * 0.5f;
+            glm::vec2 center = glm::vec2(sprite.rect.x, sprite.rect.y) + extent;
+            float radius = glm::length(extent);
+            
+            for (int corner = 0; corner < 4; corner++) {
+                glm::vec4 pos = model * glm::vec4(center.x + ((corner & 1) ? radius : -radius),
+                                                  center.y + ((corner & 2) ? radius : -radius), 0.0f, 1.0f);
+                if (first) {
+                    cmd.bounds.minX = cmd.bounds.maxX = pos.x;
+                    cmd.bounds.minY = cmd.bounds.maxY = pos.y;
+                    first = false;
+                } else {
+                    cmd.bounds.minX = std::min(cmd.bounds.minX, pos.x);
+                    cmd.bounds.minY = std::min(cmd.bounds.minY, pos.y);
+                    cmd.bounds.maxX = std::max(cmd.bounds.maxX, pos.x);
+                    cmd.bounds.maxY = std::max(cmd.bounds.maxY, pos.y);
+                }
+            }
+        }
+        
+        this->_commands.push_back(cmd);
+    }
+    
+    void RenderCommandList::_buildIndexes(PolygonMode mode, unsigned int first, unsigned int count) {
+        switch (mode) {
+            case PolygonMode::Triangles:
+                for (unsigned int i = 0; i + 2 < count; i += 3) {
+                    this->_indexes.push_back(first + i);
+                    this->_indexes.push_back(first + i + 1);
+                    this->_indexes.push_back(first + i + 2);
+                }
+                break;
+            case PolygonMode::TriangleStrip:
+                for (unsigned int i = 2; i < count; i++) {
+                    // every other triangle is flipped to keep the winding consistent
+                    this->_indexes.push_back(first + ((i % 2) == 0 ? i - 2 : i - 1));
+                    this->_indexes.push_back(first + ((i % 2) == 0 ? i - 1 : i - 2));
+                    this->_indexes.push_back(first + i);
+                }
+                break;
+            case PolygonMode::TriangleFan:
+                for (unsigned int i = 2; i < count; i++) {
+                    this->_indexes.push_back(first);
+                    this->_indexes.push_back(first + i - 1);
+                    this->_indexes.push_back(first + i);
+                }
+                break;
+            case PolygonMode::Lines:
+                for (unsigned int i = 0; i + 1 < count; i += 2) {
+                    this->_indexes.push_back(first + i);
+                    this->_indexes.push_back(first + i + 1);
+                }
+                break;
+            case PolygonMode::LineStrip:
+            case PolygonMode::LineLoop:
+                for (unsigned int i = 1; i < count; i++) {
+                    this->_indexes.push_back(first + i - 1);
+                    this->_indexes.push_back(first + i);
+                }
+                if (mode == PolygonMode::LineLoop && count > 2) {
+                    this->_indexes.push_back(first + count - 1);
+                    this->_indexes.push_back(first);
+                }
+                break;
+            default:
+                break;
+        }
+    }
+    
+    RenderCommandList::Bounds RenderCommandList::_getBounds(size_t vertStart, size_t vertEnd) {
+        Bounds ret = {0.0f, 0.0f, 0.0f, 0.0f};
+        
+        if (vertStart == vertEnd) return ret;
+        
+        ret.minX = ret.maxX = this->_verts[vertStart].pos.x;
+        ret.minY = ret.maxY = this->_verts[vertStart].pos.y;
+        
+        for (size_t i = vertStart + 1; i < vertEnd; i++) {
+            const glm::vec3& pos = this->_verts[i].pos;
+            ret.minX = std::min(ret.minX, pos.x);
+            ret.minY = std::min(ret.minY, pos.y);
+            ret.maxX = std::max(ret.maxX, pos.x);
+            ret.maxY = std::max(ret.maxY, pos.y);
+        }
+        
+        // Lines have no area but still cover pixels
+        if (ret.minX == ret.maxX) { ret.minX -= 0.5f; ret.maxX += 0.5f; }
+        if (ret.minY == ret.maxY) { ret.minY -= 0.5f; ret.maxY += 0.5f; }
+        
+        return ret;
+    }
+    
+    void RenderCommandList::Build() {
+        ENGINE_PROFILER_SCOPE;
+        
+        this->End();
+        
+        this->_batches.clear();
+        this->_batchVerts.clear();
+        this->_sortedCommands.clear();
+        this->_pendingBatches.clear();
+        
+        for (auto iter = this->_commands.begin(); iter != this->_commands.end(); iter++) {
+            this->_sortedCommands.push_back(&*iter);
+        }
+        
+        // Only layers reorder, everything inside a layer starts in submission order
+        std::stable_sort(this->_sortedCommands.begin(), this->_sortedCommands.end(),
+                         [](const Command* a, const Command* b) { return a->key.layer < b->key.layer; });
+        
+        for (auto iter = this->_sortedCommands.begin(); iter != this->_sortedCommands.end(); iter++) {
+            Command* cmd = *iter;
+            
+            // Walk back over the batches drawn after the one cmd could join, cmd moves in front of
+            // them so it can't overlap any of their commands
+            PendingBatch* target = NULL;
+            size_t checks = 0;
+            size_t lookback = 0;
+            
+            // sprite draws are never merged so they skip straight to a batch of their own
+            for (auto batch = this->_pendingBatches.rbegin(); cmd->spriteDraw == NoSpriteDraw &&
+                 batch != this->_pendingBatches.rend() && lookback < MaxLookback; batch++, lookback++) {
+                if (batch->key == cmd->key && !batch->sprites) {
+                    target = &*batch;
+                    break;
+                }
+                
+                if (batch->key.layer != cmd->key.layer) break;
+                
+                bool blocked = false;
+                for (auto other = batch->commands.begin(); other != batch->commands.end(); other++) {
+                    if (++checks > MaxOverlapChecks || (*other)->bounds.Overlaps(cmd->bounds)) {
+                        blocked = true;
+                        break;
+                    }
+                }
+                
+                if (blocked) break;
+            }
+            
+            if (target == NULL) {
+                PendingBatch batch;
+                batch.key = cmd->key;
+                batch.sprites = cmd->spriteDraw != NoSpriteDraw;
+                this->_pendingBatches.push_back(batch);
+                target = &this->_pendingBatches.back();
+            }
+            
+            target->commands.push_back(cmd);
+        }
+        
+        for (auto iter = this->_pendingBatches.begin(); iter != this->_pendingBatches.end(); iter++) {
+            RenderBatch batch;
+            batch.key = iter->key;
+            batch.start = this->_batchVerts.size();
+            batch.count = 0;
+            batch.sprites = NULL;
+            
+            if (iter->sprites) {
+                batch.sprites = &this->_spriteDraws[iter->commands.front()->spriteDraw];
+                this->_batches.push_back(batch);
+                continue;
+            }
+            
+            // The vertex buffer has no element buffer so the indexes are expanded here
+            for (auto cmd = iter->commands.begin(); cmd != iter->commands.end(); cmd++) {
+                for (size_t i = (*cmd)->indexStart; i < (*cmd)->indexStart + (*cmd)->indexCount; i++) {
+                    this->_batchVerts.push_back(this->_verts[this->_indexes[i]]);
+                }
+                batch.count += (*cmd)->indexCount;
+            }
+            
+            this->_batches.push_back(batch);
+        }
+    }
+    
+    void RenderCommandList::Clear() {
+        this->_recording = false;
+        this->_commands.clear();
+        this->_verts.clear();
+        this->_indexes.clear();
+        this->_sprites.clear();
+        this->_spriteDraws.clear();
+    }
+}
@@ -0,0 +1,165 @@
+/*
+ Filename: RenderCommandList.hpp
+ Purpose:  Retained, sorted list of 2D primitives for batched submission
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include <cstdint>
+
+#include "GL3Buffer.hpp"
+
+namespace Engine {
+    ENGINE_CLASS(Texture);
+    
+    // Everything that forces a separate draw call
+    struct RenderSortKey {
+        int layer;
+        uintptr_t shader;
+        TexturePtr texture;
+        PolygonMode mode;
+        
+        inline bool operator==(const RenderSortKey& other) const {
+            return this->layer == other.layer && this->shader == other.shader &&
+                this->texture == other.texture && this->mode == other.mode;
+        }
+        
+        inline bool operator!=(const RenderSortKey& other) const {
+            return !(*this == other);
+        }
+    };
+    
+    // A DrawSprites call, the instances are drawn with the model matrix and UV mapping it was recorded with
+    struct RenderSpriteDraw {
+        size_t start;
+        size_t count;
+        glm::mat4 model;
+        glm::vec2 uvOffset, uvScale;
+    };
+    
+    struct RenderBatch {
+        RenderSortKey key;
+        size_t start;
+        size_t count;
+        const RenderSpriteDraw* sprites; // NULL for vertex batches, otherwise start and count are unused
+    };
+    
+    ENGINE_CLASS(RenderCommandList);
+    
+    /*
+     Primitives are recorded between Begin and End. Strips, fans and loops are
+     turned into indexed triangle and line lists as they end so that everything
+     sharing a state can be merged. Build sorts by layer only and keeps the
+     submission order inside a layer. A primitive joins an earlier batch with
+     the same state only when its bounds don't overlap anything drawn between
+     them, so overlapping primitives keep painter's order. Sprite draws are
+     sorted the same way but always get a batch of their own.
+     */
+    class RenderCommandList {
+    public:
+        void Begin(RenderSortKey key);
+        void AddVert(const BufferFormat& vert);
+        void End();
+        
+        // Records a whole DrawSprites call as one command, model places the sprites in world space
+        void AddSprites(RenderSortKey key, const SpriteInstance* sprites, size_t count,
+                        const glm::mat4& model, glm::vec2 uvOffset, glm::vec2 uvScale);
+        
+        void Build();
+        void Clear();
+        
+        bool IsEmpty() {
+            return this->_commands.empty() && !this->_recording;
+        }
+        
+        size_t GetCommandCount() {
+            return this->_commands.size();
+        }
+        
+        // Valid after Build, batches index into GetBatchVerts
+        std::vector<RenderBatch>& GetBatches() {
+            return this->_batches;
+        }
+        
+        VertexStore& GetBatchVerts() {
+            return this->_batchVerts;
+        }
+        
+        // Valid after Build, RenderSpriteDraw::start indexes into this
+        std::vector<SpriteInstance>& GetSprites() {
+            return this->_sprites;
+        }
+        
+        // The list mode a primitive is converted into
+        static PolygonMode GetListMode(PolygonMode mode);
+        
+    private:
+        // Bounds are in the recorded (world) space, x and y only
+        struct Bounds {
+            float minX, minY, maxX, maxY;
+            
+            inline bool Overlaps(const Bounds& other) const {
+                return this->minX < other.maxX && other.minX < this->maxX &&
+                    this->minY < other.maxY && other.minY < this->maxY;
+            }
+        };
+        
+        static const size_t NoSpriteDraw = (size_t) -1;
+        
+        struct Command {
+            RenderSortKey key;
+            size_t indexStart;
+            size_t indexCount;
+            Bounds bounds;
+            size_t spriteDraw; // index into _spriteDraws or NoSpriteDraw
+        };
+        
+        struct PendingBatch {
+            RenderSortKey key;
+            std::vector<Command*> commands;
+            bool sprites;
+        };
+        
+        // Limits how far back Build looks for a batch to join so it stays linear, giving up
+        // only costs an extra draw call
+        static const size_t MaxLookback = 16;
+        static const size_t MaxOverlapChecks = 4096;
+        
+        void _buildIndexes(PolygonMode mode, unsigned int first, unsigned int count);
+        Bounds _getBounds(size_t vertStart, size_t vertEnd);
+        
+        std::vector<Command> _commands;
+        std::vector<Command*> _sortedCommands;
+        std::vector<PendingBatch> _pendingBatches;
+        
+        VertexStore _verts;
+        std::vector<unsigned int> _indexes;
+        
+        std::vector<SpriteInstance> _sprites;
+        std::vector<RenderSpriteDraw> _spriteDraws;
+        
+        std::vector<RenderBatch> _batches;
+        VertexStore _batchVerts;
+        
+        bool _recording = false;
+        Command _current;
+        PolygonMode _currentMode = PolygonMode::Invalid;
+        size_t _currentVertStart = 0;
+    };
+}
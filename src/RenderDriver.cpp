@@ -58,6 +58,19 @@ namespace Engine {
         return this->_sheets.count(name) > 0;
     }
     
+    RenderErrorPolicy RenderDriver::ParseErrorPolicy(std::string policy) {
+        if (policy == "off") {
+            return RenderErrorPolicy::Off;
+        } else if (policy == "frame") {
+            return RenderErrorPolicy::PerFrame;
+        } else if (policy == "call") {
+            return RenderErrorPolicy::PerCall;
+        } else {
+            Logger::begin("RenderDriver", Logger::LogLevel_Warning) << "Unknown error policy \"" << policy << "\", using frame" << Logger::end();
+            return RenderErrorPolicy::PerFrame;
+        }
+    }
+    
     void RenderDriver::ClearColor(Color4f col) {
         this->_clearColor(col);
     }
@@ -106,6 +119,46 @@ namespace Engine {
         this->_currentColor = Color4f(r, g, b, a);
     }
     
+    void RenderDriver::DrawSprites(TexturePtr tex, const SpriteInstance* sprites, size_t count) {
+        ENGINE_PROFILER_SCOPE;
+        
+        if (tex != NULL) {
+            this->EnableTexture(tex);
+        } else {
+            this->DisableTexture();
+        }
+        
+        this->BeginRendering(PolygonMode::Triangles);
+        
+        for (size_t i = 0; i < count; i++) {
+            const SpriteInstance& sprite = sprites[i];
+            
+            Color4f col(sprite.col[0] / 255.0f, sprite.col[1] / 255.0f, sprite.col[2] / 255.0f, sprite.col[3] / 255.0f);
+            
+            glm::vec2 extent = glm::vec2(sprite.rect.z, sprite.rect.w) * 0.5f;
+            glm::vec2 center = glm::vec2(sprite.rect.x, sprite.rect.y) + extent;
+            glm::vec2 axisX = glm::vec2(glm::cos(sprite.rotation), glm::sin(sprite.rotation)) * extent.x;
+            glm::vec2 axisY = glm::vec2(-glm::sin(sprite.rotation), glm::cos(sprite.rotation)) * extent.y;
+            
+            glm::vec2 topLeft = center - axisX - axisY, topRight = center + axisX - axisY,
+                bottomRight = center + axisX + axisY, bottomLeft = center - axisX + axisY;
+            
+            //            x               y               z  col  s            t
+            this->AddVert(topLeft.x,      topLeft.y,      0, col, sprite.uv.x, sprite.uv.y);
+            this->AddVert(topRight.x,     topRight.y,     0, col, sprite.uv.z, sprite.uv.y);
+            this->AddVert(bottomRight.x,  bottomRight.y,  0, col, sprite.uv.z, sprite.uv.w);
+            this->AddVert(topLeft.x,      topLeft.y,      0, col, sprite.uv.x, sprite.uv.y);
+            this->AddVert(bottomLeft.x,   bottomLeft.y,   0, col, sprite.uv.x, sprite.uv.w);
+            this->AddVert(bottomRight.x,  bottomRight.y,  0, col, sprite.uv.z, sprite.uv.w);
+        }
+        
+        this->EndRendering();
+        
+        if (tex != NULL) {
+            this->DisableTexture();
+        }
+    }
+    
     FontSheetPtr RenderDriver::_getSheet(std::string fontName) {
         if (!this->IsFontLoaded("basic")) {
             Logger::begin("RenderDriver", Logger::LogLevel_Verbose) << "Loading NeoFont: " << Config::GetString("core.content.fontPath") << Logger::end();
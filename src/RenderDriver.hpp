@@ -55,6 +55,30 @@ namespace Engine {
     };
     typedef Drawable* DrawablePtr;
     
+    // One quad for RenderDriver::DrawSprites, also the per instance vertex format so keep it packed
+#pragma pack(push, 1)
+    struct SpriteInstance {
+        SpriteInstance() {}
+        SpriteInstance(float x, float y, float w, float h, Color4f col = Color4f(1.0f, 1.0f, 1.0f, 1.0f),
+                       float rotation = 0.0f, glm::vec4 uv = glm::vec4(0.0f, 0.0f, 1.0f, 1.0f))
+            : rect(x, y, w, h), uv(uv), rotation(rotation) {
+            this->SetColor(col);
+        }
+        
+        inline void SetColor(Color4f col) {
+            this->col[0] = (unsigned char) (glm::clamp(col.r, 0.0f, 1.0f) * 255.0f + 0.5f);
+            this->col[1] = (unsigned char) (glm::clamp(col.g, 0.0f, 1.0f) * 255.0f + 0.5f);
+            this->col[2] = (unsigned char) (glm::clamp(col.b, 0.0f, 1.0f) * 255.0f + 0.5f);
+            this->col[3] = (unsigned char) (glm::clamp(col.a, 0.0f, 1.0f) * 255.0f + 0.5f);
+        }
+        
+        glm::vec4 rect;         // x, y, width, height
+        glm::vec4 uv;           // u1, v1, u2, v2 inside the texture
+        unsigned char col[4];   // RGBA
+        float rotation;         // radians around the center of rect
+    };
+#pragma pack(pop)
+    
     struct enum_hash
     {
         template <typename T>
@@ -78,6 +102,9 @@ namespace Engine {
             
             RenderDriverError(const char* source, int err, std::string errorString) : Source(source), Error(err), ErrorString(errorString) { }
         };
+        
+        // Deleted by the window while it's context is still current
+        virtual ~RenderDriver() { }
 
 		/**
 			Get the current RendererType for the RenderDriver
@@ -89,7 +116,24 @@ namespace Engine {
         virtual OpenGLVersion GetOpenGLVersion() = 0;
         virtual EffectShaderType GetBestEffectShaderType() = 0;
         
+        // Only queries the driver when the error policy is PerCall
         virtual bool CheckError(const char* source) = 0;
+        // Queries the driver unless the error policy is Off, called once at the end of each frame
+        virtual bool CheckFrameError(const char* source) = 0;
+        
+        void SetErrorPolicy(RenderErrorPolicy policy) {
+            this->_errorPolicy = policy;
+        }
+        
+        RenderErrorPolicy GetErrorPolicy() {
+            return this->_errorPolicy;
+        }
+        
+        static RenderErrorPolicy ParseErrorPolicy(std::string policy);
+        
+        // Debug groups name the GL calls made inside them so errors found by CheckFrameError can be traced back
+        virtual void PushDebugGroup(const char* name) = 0;
+        virtual void PopDebugGroup() = 0;
 
 		virtual void EnableDefaultTexture() = 0;
         
@@ -130,14 +174,30 @@ namespace Engine {
             this->_addVert(pos, col, uv, normal);
         }
         
+        // Draws count quads with tex, or with the sprite colors alone when tex is NULL. The base
+        // version adds 6 vertexes per sprite, RenderGL3 uses one instanced draw when it can.
+        virtual void DrawSprites(TexturePtr tex, const SpriteInstance* sprites, size_t count);
+        
         virtual void EnableTexture(TexturePtr texId) = 0;
         virtual void DisableTexture() = 0;
         
+        // Called before tex or an atlas page is deleted, draws anything still recorded with it and
+        // drops any cached pointer to it so the next flush doesn't bind a freed texture
+        virtual void ReleaseTexture(TexturePtr tex) {
+            this->FlushAll();
+        }
+        
         virtual void EnableSmooth() = 0;
         virtual void DisableSmooth() = 0;
         
         virtual void SetShader(ShaderPtr shader) = 0;
         
+        // Writes the matrices shaders read from the Camera uniform block. Returns false when uniform
+        // buffers aren't supported, the matrices have to be uploaded as plain uniforms then.
+        virtual bool SetCameraBlock(const glm::mat4& view, const glm::mat4& projection) {
+            return false;
+        }
+        
         virtual void SetLineWidth(float value) = 0;
         
         void Print(float x, float y, std::string string);
@@ -149,6 +209,25 @@ namespace Engine {
         
         virtual void FlushAll() = 0;
         
+        // Batching records primitives until End2d or FlushAll and draws them grouped by layer, shader, texture and mode.
+        // A primitive is only moved in front of primitives it doesn't overlap.
+        virtual void SetBatching(bool enable) {
+            this->_batching = enable;
+        }
+        
+        bool IsBatching() {
+            return this->_batching;
+        }
+        
+        // Lower layers draw first when batching, overlapping primitives inside a layer keep their draw order
+        void SetLayer(int layer) {
+            this->_layer = layer;
+        }
+        
+        int GetLayer() {
+            return this->_layer;
+        }
+        
         virtual void Init2d() = 0;
         
         virtual void Clear() = 0;
@@ -178,6 +257,11 @@ namespace Engine {
         virtual void CameraZoom(float f) = 0;
         virtual void CameraRotate(float r) = 0;
         
+        // How many pixels one unit covers with the current camera, used to pick tessellation detail
+        virtual float GetCameraScale() {
+            return 1.0f;
+        }
+        
         template<class T> inline auto CreateDrawable() -> T* {
             DrawablePtr drawable = new T(this);
             this->_managedDrawables.push_back(drawable);
@@ -198,6 +282,12 @@ namespace Engine {
         
         std::vector<DrawablePtr> _managedDrawables;
         
+        bool _batching = false;
+        int _layer = 0;
+        
+        // Init2d replaces this with core.render.errorPolicy, startup checks run before that
+        RenderErrorPolicy _errorPolicy = RenderErrorPolicy::PerCall;
+        
     private:
         std::unordered_map<std::string, FontSheetPtr> _sheets;
         FontSheetPtr _sheet = NULL;
@@ -207,4 +297,18 @@ namespace Engine {
         friend class Drawable;
         friend class RenderDriverDrawProfiler;
     };
+    
+    class RenderDebugGroup {
+    public:
+        RenderDebugGroup(RenderDriverPtr render, const char* name) : _render(render) {
+            this->_render->PushDebugGroup(name);
+        }
+        
+        ~RenderDebugGroup() {
+            this->_render->PopDebugGroup();
+        }
+        
+    private:
+        RenderDriverPtr _render;
+    };
 }
\ No newline at end of file
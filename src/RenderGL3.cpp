@@ -26,6 +26,9 @@
 #include "RenderGL3.hpp"
 
 #include "GL3Buffer.hpp"
+#include "RenderCommandList.hpp"
+#include "SpriteRenderer.hpp"
+#include "CameraBlock.hpp"
 #include "TextureLoader.hpp"
 
 #include "Config.hpp"
@@ -37,6 +40,8 @@
 #include "vendor/glm/glm.hpp"
 #include "vendor/glm/gtc/matrix_transform.hpp"
 
+#include <algorithm>
+
 namespace Engine {
     std::string GLErrorString(int error) {
         switch (error) {
@@ -66,7 +71,35 @@ namespace Engine {
         }
     }
     
+    // The callback may run on a driver thread so only the error path shares state with the render thread
+    static std::vector<std::string> _debugGroupStack;
+    static std::string _lastDebugErrorGroup = "";
+    static Platform::MutexPtr _debugErrorMutex = NULL;
+    
+    static std::string GetDebugGroupPath() {
+        std::string path = "";
+        for (auto iter = _debugGroupStack.begin(); iter != _debugGroupStack.end(); iter++) {
+            if (iter != _debugGroupStack.begin()) path += " > ";
+            path += *iter;
+        }
+        return path;
+    }
+    
 	void ENGINE_stdcall DebugMessageCallback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length, const GLchar* message, GLvoid* userParam) {
+        if (type == GL_DEBUG_TYPE_PUSH_GROUP) {
+            _debugGroupStack.push_back(length < 0 ? std::string(message) : std::string(message, length));
+            return;
+        } else if (type == GL_DEBUG_TYPE_POP_GROUP) {
+            if (!_debugGroupStack.empty()) _debugGroupStack.pop_back();
+            return;
+        } else if (type == GL_DEBUG_TYPE_ERROR) {
+            std::string groupPath = _debugGroupStack.empty() ? "[no debug group]" : GetDebugGroupPath();
+            _debugErrorMutex->Enter();
+            _lastDebugErrorGroup = groupPath;
+            _debugErrorMutex->Exit();
+            Logger::begin("OpenGLDebug", Logger::LogLevel_Error) << "Error in " << groupPath << " : " << id << " : " << message << Logger::end();
+            return;
+        }
 		std::string sourceStr = "[UNKNOWN source]";
 		switch (source) {
 			case GL_DEBUG_SOURCE_API: sourceStr = "OpenGL"; break;
@@ -104,6 +137,15 @@ namespace Engine {
     
     class RenderGL3 : public RenderDriver {
     public:
+        ~RenderGL3() {
+            if (this->_sprites != NULL) {
+                delete this->_sprites;
+            }
+            if (this->_camera != NULL) {
+                delete this->_camera;
+            }
+        }
+        
         RendererType GetRendererType() override {
             return RendererType::OpenGL3;
         }
@@ -142,14 +184,30 @@ namespace Engine {
         }
         
         bool CheckError(const char* source) override {
-            GLenum err;
-            bool oneError = false;
-            while ((err = glGetError()) != GL_NO_ERROR) {
-                Logger::begin("OpenGL", Logger::LogLevel_Error) << "GLError in " << source << " : " << GLErrorString(err) << Logger::end();
-                Platform::DumpStackTrace();
-                throw new RenderDriverError(source, err, GLErrorString(err));
+            if (this->GetErrorPolicy() != RenderErrorPolicy::PerCall) return false;
+            return this->_drainErrors(source);
+        }
+        
+        bool CheckFrameError(const char* source) override {
+            if (this->GetErrorPolicy() == RenderErrorPolicy::Off) return false;
+            return this->_drainErrors(source);
+        }
+        
+        void PushDebugGroup(const char* name) override {
+            bool push = this->_hasDebugGroups && this->GetErrorPolicy() != RenderErrorPolicy::Off;
+            if (push) {
+                glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
             }
-            return oneError;
+            // the policy can change inside a group so remember what each push did
+            this->_debugGroupPushed.push_back(push);
+        }
+        
+        void PopDebugGroup() override {
+            if (this->_debugGroupPushed.empty()) return;
+            if (this->_debugGroupPushed.back()) {
+                glPopDebugGroup();
+            }
+            this->_debugGroupPushed.pop_back();
         }
 
 		void EnableDefaultTexture() override {
@@ -199,8 +257,14 @@ namespace Engine {
         void ResetMatrix() override {
             ENGINE_PROFILER_SCOPE;
             
+            if (this->_cpuTransform) {
+                this->_applyPendingTransform();
+            }
+            
+            static Config::ConfigVar<bool> halfPix("core.render.halfPix");
+            
             this->_currentModelMatrix = glm::mat4();
-            if (Config::GetBoolean("core.render.halfPix")) {
+            if (halfPix) {
                 this->_currentModelMatrix = glm::translate(this->_currentModelMatrix, glm::vec3(0.5f, 0.5f, 0.0f));
             }
         }
@@ -208,6 +272,12 @@ namespace Engine {
         void BeginRendering(PolygonMode mode) override {
             ENGINE_PROFILER_SCOPE;
             
+            if (this->IsBatching()) {
+                RenderSortKey key = {this->GetLayer(), (uintptr_t) this->_currentEffect, this->_currentTexture, mode};
+                this->_commandList.Begin(key);
+                return;
+            }
+            
             if (this->_currentMode != mode ||
                 this->_currentMode == PolygonMode::LineStrip) {
                 // it's a hack, I really need to fix this
@@ -225,19 +295,99 @@ namespace Engine {
         
         void EndRendering() override {
             this->TrackStat(RenderStatistic::PrimitiveEnd, 1);
+            if (this->IsBatching()) {
+                this->_commandList.End();
+            }
+        }
+        
+        void DrawSprites(TexturePtr tex, const SpriteInstance* sprites, size_t count) override {
+            if (!this->_instancing) {
+                RenderDriver::DrawSprites(tex, sprites, count);
+                return;
+            }
+            
+            ENGINE_PROFILER_SCOPE;
+            
+            if (this->_sprites == NULL) {
+                this->_sprites = new SpriteRenderer(this, EffectReader::GetEffectFromFile(Config::GetString("core.render.spriteEffect")));
+            }
+            
+            glm::vec2 uvOffset(0.0f, 0.0f), uvScale(1.0f, 1.0f);
+            TexturePtr bindTexture = NULL;
+            
+            if (tex != NULL) {
+                bindTexture = tex->GetBindTexture();
+                
+                // atlas regions map UVs with a scale and offset inside their page
+                uvOffset = tex->MapUV(glm::vec2(0.0f, 0.0f));
+                uvScale = tex->MapUV(glm::vec2(1.0f, 1.0f)) - uvOffset;
+            }
+            
+            // batched vertexes are already in world space so the camera is applied in both modes
+            glm::mat4 model = glm::translate(this->_currentModelMatrix, -this->_center);
+            
+            if (this->IsBatching()) {
+                // recorded with the primitives so SetLayer orders sprites against them
+                RenderSortKey key = {this->GetLayer(), (uintptr_t) this->_sprites, bindTexture, PolygonMode::Triangles};
+                this->_commandList.AddSprites(key, sprites, count, model, uvOffset, uvScale);
+                return;
+            }
+            
+            // anything added before has to be drawn first to keep the order
+            this->FlushAll();
+            
+            this->_drawSprites(bindTexture, sprites, count, model, uvOffset, uvScale);
+        }
+        
+        bool SetCameraBlock(const glm::mat4& view, const glm::mat4& projection) override {
+            if (this->_camera == NULL) {
+                if (this->_cameraChecked) {
+                    return false;
+                }
+                this->_cameraChecked = true;
+                if (!CameraBlock::IsSupported(this)) {
+                    Logger::begin("RenderGL3", Logger::LogLevel_Verbose) << "Uniform buffers not supported, shaders get the camera as plain uniforms" << Logger::end();
+                    return false;
+                }
+                this->_camera = new CameraBlock(this);
+            }
+            
+            this->_camera->Set(view, projection);
+            
+            return true;
         }
         
         void EnableTexture(TexturePtr texId) override {
-            this->_currentTexture = texId;
+            // Atlased textures share their page so switching between them doesn't flush
+            this->_currentTexture = texId != NULL ? texId->GetBindTexture() : NULL;
+            this->_currentRegion = texId;
         }
         
         void DisableTexture() override {
             this->_currentTexture = NULL;
+            this->_currentRegion = NULL;
+        }
+        
+        void ReleaseTexture(TexturePtr tex) override {
+            if (this->_gl3Buffer == NULL) return; // nothing has been drawn yet
+            
+            this->FlushAll();
+            
+            if (this->_activeTexture == tex) {
+                this->_activeTexture = NULL;
+                this->EnableDefaultTexture();
+            }
+            if (this->_currentTexture == tex || this->_currentRegion == tex) {
+                this->_currentTexture = NULL;
+                this->_currentRegion = NULL;
+            }
         }
         
         void EnableSmooth() override {
             ENGINE_PROFILER_SCOPE;
             
+            this->_flushBatch();
+            
             glEnable(GL_LINE_SMOOTH);
             glEnable(GL_POLYGON_SMOOTH);
             glHint(GL_LINE_SMOOTH_HINT, GL_NICEST);
@@ -247,6 +397,8 @@ namespace Engine {
         void DisableSmooth() override {
             ENGINE_PROFILER_SCOPE;
             
+            this->_flushBatch();
+            
             glDisable(GL_LINE_SMOOTH);
             glDisable(GL_POLYGON_SMOOTH);
         }
@@ -263,23 +415,37 @@ namespace Engine {
         }
         
         void SetLineWidth(float value) override {
+            this->_flushBatch();
             glLineWidth(value);
         }
         
         void FlushAll() override {
             ENGINE_PROFILER_SCOPE;
             
+            if (this->IsBatching()) {
+                this->_submitCommandList();
+                return;
+            }
+            
+            RenderDebugGroup debugGroup(this, "RenderGL3::FlushAll");
+            
             this->CheckError("RenderGL3::FlushAll::Pre");
             
             if (this->_gl3Buffer->Update()) {
                 Logger::begin("RenderGL3", Logger::LogLevel_Log) << "Render Buffer Reloaded" << Logger::end();
             }
             
-            this->_gl3Buffer->Draw(this->_currentMode, this->_currentModelMatrix);
+            if (this->_cpuTransform) {
+                this->_applyPendingTransform();
+                this->_gl3Buffer->Draw(this->_currentMode, glm::mat4());
+            } else {
+                this->_gl3Buffer->Draw(this->_currentMode, this->_currentModelMatrix);
+            }
             
             this->CheckError("RenderGL3::FlushAll::PostDraw");
             
             this->_gl3Buffer->Reset();
+            this->_transformStart = 0;
             
             if (this->_activeTexture != this->_currentTexture) {
                 this->_switchTextures();
@@ -289,18 +455,37 @@ namespace Engine {
         void Init2d() override {
             ENGINE_PROFILER_SCOPE;
             
+            this->SetErrorPolicy(ParseErrorPolicy(Config::GetString("core.render.errorPolicy")));
+            
             // Never enabled on OSX due to lack of extention ARB_debug_output
 			if (Config::GetBoolean("core.debug.debugRenderer") && glDebugMessageCallback != NULL) {
+                if (_debugErrorMutex == NULL) {
+                    _debugErrorMutex = Platform::CreateMutex();
+                }
 				glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, 0, GL_TRUE);
                 glDebugMessageCallback((GLDEBUGPROC) DebugMessageCallback, NULL);
                 Logger::begin("RenderGL3", Logger::LogLevel_Verbose) << "glDebugMessageCallback Enabled" << Logger::end();
+                
+                // Groups are only useful when the callback is there to report errors inside them
+                this->_hasDebugGroups = glPushDebugGroup != NULL;
             }
             
             std::string gl3Effect = Config::GetString("core.render.basicEffect");
             this->_currentEffect = EffectReader::GetEffectFromFile(gl3Effect);
             this->_currentEffect->CreateShader();
             this->_gl3Buffer = new VertexBuffer(this, this->_currentEffect);
+            if (Config::GetBoolean("core.render.streamingBuffer")) {
+                this->_gl3Buffer->SetUsageMode(VertexBuffer::UsageMode::PersistentStreaming);
+            }
+            if (Config::GetBoolean("core.render.compactVertexes")) {
+                this->_gl3Buffer->SetVertexLayout(VertexLayout::Compact2D);
+            }
+            this->_instancing = Config::GetBoolean("core.render.instancing") && SpriteRenderer::IsSupported(this);
+            if (!this->_instancing) {
+                Logger::begin("RenderGL3", Logger::LogLevel_Verbose) << "Instanced sprites not supported, DrawSprites adds vertexes instead" << Logger::end();
+            }
 			this->_currentTexture = NULL;
+			this->_currentRegion = NULL;
 			this->EnableDefaultTexture();
             
             glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
@@ -310,12 +495,27 @@ namespace Engine {
             glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
         }
         
+        void SetBatching(bool enable) override {
+            if (enable == this->IsBatching()) return;
+            
+            // whatever was recorded in the old mode is drawn first
+            this->FlushAll();
+            
+            RenderDriver::SetBatching(enable);
+        }
+        
 		void Begin2d() override {
             ENGINE_PROFILER_SCOPE;
             
+            this->SetBatching(Config::GetBoolean("core.render.batching"));
+            this->SetLayer(0);
+            
+            this->_setCPUTransform(Config::GetBoolean("core.render.cpuTransform"));
+            
             EnableSmooth();
             
 			this->_currentTexture = NULL;
+			this->_currentRegion = NULL;
 			this->EnableDefaultTexture();
             
             glDisable(GL_DEPTH_TEST);
@@ -360,36 +560,173 @@ namespace Engine {
         }
         
         void CameraPan(float x, float y) override {
-            this->TrackStat(RenderStatistic::CameraFlush, 1);
-            FlushAll();
+            this->_cameraFlush();
             this->_currentModelMatrix = glm::translate(this->_currentModelMatrix, glm::vec3(x, y, 0.0f));
         }
         
         void CameraZoom(float f) override {
-            this->TrackStat(RenderStatistic::CameraFlush, 1);
-            FlushAll();
+            this->_cameraFlush();
             this->_currentModelMatrix =
             glm::scale(_currentModelMatrix, glm::vec3(f, f, 0.0f));
         }
         
         void CameraRotate(float r) override {
-            this->TrackStat(RenderStatistic::CameraFlush, 1);
-            FlushAll();
+            this->_cameraFlush();
             r = glm::radians(r);
             this->_currentModelMatrix =
             glm::rotate(this->_currentModelMatrix, r, glm::vec3(0, 0, 1));
         }
+        
+        float GetCameraScale() override {
+            const glm::mat4& m = this->_currentModelMatrix;
+            return glm::sqrt(glm::abs(m[0][0] * m[1][1] - m[0][1] * m[1][0]));
+        }
     protected:
         void _clearColor(Color4f col) override {
             glClearColor(col.r, col.g, col.b, col.a);
         }
         
         void _addVert(glm::vec3 pos, Color4f col, glm::vec2 uv, glm::vec3 normal) override {
+            if (this->_currentRegion != NULL) {
+                uv = this->_currentRegion->MapUV(uv);
+            }
+            
+            if (this->IsBatching()) {
+                // Batches are drawn with an identity model matrix so the camera is applied here
+                glm::vec4 worldPos = this->_currentModelMatrix * glm::vec4(pos - this->_center, 1.0f);
+                this->_commandList.AddVert(BufferFormat(glm::vec3(worldPos), col,
+                                                        glm::vec3(uv, this->_currentTexture != NULL ? 1 : 2)));
+                return;
+            }
             this->_gl3Buffer->AddVert(pos - this->_center,
                                       col, uv, this->_currentTexture != NULL ? 1 : 2);
         }
         
     private:
+        bool _drainErrors(const char* source) {
+            GLenum err;
+            bool oneError = false;
+            this->TrackStat(RenderStatistic::ErrorCheck, 1);
+            while ((err = glGetError()) != GL_NO_ERROR) {
+                Logger::begin("OpenGL", Logger::LogLevel_Error) << "GLError in " << source << " : " << GLErrorString(err) << Logger::end();
+                if (_debugErrorMutex != NULL) {
+                    _debugErrorMutex->Enter();
+                    if (_lastDebugErrorGroup != "") {
+                        Logger::begin("OpenGL", Logger::LogLevel_Error) << "Last error reported by the driver was in " << _lastDebugErrorGroup << Logger::end();
+                        _lastDebugErrorGroup = "";
+                    }
+                    _debugErrorMutex->Exit();
+                }
+                Platform::DumpStackTrace();
+                throw new RenderDriverError(source, err, GLErrorString(err));
+            }
+            return oneError;
+        }
+        
+        // Called before the model matrix changes
+        void _cameraFlush() {
+            if (this->IsBatching()) return; // vertexes are already transformed when they are recorded
+            if (this->_cpuTransform) {
+                this->_applyPendingTransform();
+                return;
+            }
+            this->TrackStat(RenderStatistic::CameraFlush, 1);
+            FlushAll();
+        }
+        
+        // Bakes the current model matrix into every vertex added since the last change
+        void _applyPendingTransform() {
+            if (this->_gl3Buffer == NULL || this->IsBatching()) return;
+            this->_gl3Buffer->TransformVerts(this->_transformStart, this->_currentModelMatrix);
+            this->_transformStart = this->_gl3Buffer->GetVertexCount();
+        }
+        
+        void _setCPUTransform(bool enable) {
+            if (enable == this->_cpuTransform) return;
+            
+            // pending vertexes were added expecting the old mode
+            if (this->_gl3Buffer != NULL && this->_gl3Buffer->GetVertexCount() > 0) {
+                FlushAll();
+            }
+            
+            this->_cpuTransform = enable;
+        }
+        
+        void _flushBatch() {
+            if (this->IsBatching()) {
+                this->_submitCommandList();
+            }
+        }
+        
+        void _submitCommandList() {
+            ENGINE_PROFILER_SCOPE;
+            
+            if (this->_commandList.IsEmpty()) return;
+            
+            RenderDebugGroup debugGroup(this, "RenderGL3::SubmitCommandList");
+            
+            this->CheckError("RenderGL3::SubmitCommandList::Pre");
+            
+            if (this->_gl3Buffer->Update()) {
+                Logger::begin("RenderGL3", Logger::LogLevel_Log) << "Render Buffer Reloaded" << Logger::end();
+            }
+            
+            this->_commandList.Build();
+            
+            // The buffer counts vertexes with an unsigned short, keep chunks to whole triangles and lines
+            static const size_t maxChunkSize = 65532;
+            
+            std::vector<RenderBatch>& batches = this->_commandList.GetBatches();
+            VertexStore& verts = this->_commandList.GetBatchVerts();
+            
+            TexturePtr userTexture = this->_currentTexture;
+            glm::mat4 identity;
+            
+            for (auto iter = batches.begin(); iter != batches.end(); iter++) {
+                if (iter->sprites != NULL) {
+                    this->_drawSprites(iter->key.texture, &this->_commandList.GetSprites()[iter->sprites->start], iter->sprites->count,
+                                       iter->sprites->model, iter->sprites->uvOffset, iter->sprites->uvScale);
+                    continue;
+                }
+                
+                if (iter->key.texture != NULL && iter->key.texture != this->_activeTexture) {
+                    this->_currentTexture = iter->key.texture;
+                    this->_switchTextures();
+                }
+                
+                for (size_t offset = 0; offset < iter->count; offset += maxChunkSize) {
+                    this->_gl3Buffer->AddVerts(&verts[iter->start + offset], std::min(maxChunkSize, iter->count - offset));
+                    this->_gl3Buffer->Draw(iter->key.mode, identity);
+                    this->_gl3Buffer->Reset();
+                }
+            }
+            
+            this->_currentTexture = userTexture;
+            
+            this->_commandList.Clear();
+            
+            this->CheckError("RenderGL3::SubmitCommandList::Post");
+        }
+        
+        void _drawSprites(TexturePtr bindTexture, const SpriteInstance* sprites, size_t count,
+                          const glm::mat4& model, glm::vec2 uvOffset, glm::vec2 uvScale) {
+            if (bindTexture != NULL) {
+                if (bindTexture != this->_activeTexture) {
+                    TexturePtr userTexture = this->_currentTexture;
+                    this->_currentTexture = bindTexture;
+                    this->_switchTextures();
+                    this->_currentTexture = userTexture;
+                }
+            } else {
+                this->EnableDefaultTexture();
+                this->_activeTexture = NULL;
+            }
+            
+            this->_sprites->Draw(sprites, count, model, uvOffset, uvScale);
+            
+            this->CheckError("RenderGL3::DrawSprites::Post");
+        }
+        
         void _switchTextures() {
             ENGINE_PROFILER_SCOPE;
             
@@ -414,10 +751,29 @@ namespace Engine {
 
         TexturePtr _activeTexture = NULL;
         TexturePtr _currentTexture = NULL;
+        TexturePtr _currentRegion = NULL;
         
         VertexBufferPtr _gl3Buffer = NULL;
         
+        // Created on the first DrawSprites so the sprite effect is only compiled when it's used
+        SpriteRendererPtr _sprites = NULL;
+        bool _instancing = false;
+        
+        // Shared by every shader that declares the Camera block, created by the first SetCameraBlock
+        CameraBlockPtr _camera = NULL;
+        bool _cameraChecked = false;
+        
+        RenderCommandList _commandList;
+        
         glm::mat4 _currentModelMatrix;
+        
+        // With core.render.cpuTransform camera changes transform the vertexes already in
+        // _gl3Buffer instead of drawing them, the shader gets an identity model matrix
+        bool _cpuTransform = false;
+        size_t _transformStart = 0;
+        
+        bool _hasDebugGroups = false;
+        std::vector<bool> _debugGroupPushed;
 
 		bool usingTexture = false;
         
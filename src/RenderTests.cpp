@@ -0,0 +1,1395 @@
+/*
+ Filename: RenderTests.cpp
+ Purpose:  Tests for the render module
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#define GLEW_STATIC
+#include "vendor/GL/glew.h"
+
+#include "TestSuiteAPI.hpp"
+
+#include "Application.hpp"
+#include "GL3Buffer.hpp"
+#include "Draw2D.hpp"
+#include "TextureLoader.hpp"
+#include "TextureAtlas.hpp"
+#include "Tessellator.hpp"
+#include "MeshConverter.hpp"
+#include "RenderCommandList.hpp"
+#include "Package.hpp"
+#include "Filesystem.hpp"
+#include "Config.hpp"
+#include "Logger.hpp"
+#include "Platform.hpp"
+
+#include <algorithm>
+#include <random>
+#include <cstring>
+#include <sstream>
+
+namespace Engine {
+    
+    // Logs that the test was skipped, render tests need a context to draw into and some also need a writable user directory
+    static bool _skipWithoutGL(const char* testName, bool needsUserDir = false) {
+        if (HasGLContext() && (!needsUserDir || Filesystem::HasSetUserDir())) {
+            return false;
+        }
+        Logger::begin(testName, Logger::LogLevel_Warning) << (needsUserDir ? "Skipped: no OpenGL context or user directory" : "Skipped: no OpenGL context") << Logger::end();
+        return true;
+    }
+    
+    // Runs on any context including Mesa's llvmpipe, start with -test under Xvfb for a headless run
+    class RenderStreamingBufferTest : public Test {
+    public:
+        std::string GetName() override { return "RenderStreamingBufferTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderStreamingBufferTest")) return;
+            
+            size_t staticAllocs = this->_runBenchmark(VertexBuffer::UsageMode::Static, "Static");
+            size_t streamingAllocs = this->_runBenchmark(VertexBuffer::UsageMode::Streaming, "Streaming");
+            size_t persistentAllocs = this->_runBenchmark(VertexBuffer::UsageMode::PersistentStreaming, "PersistentStreaming");
+            
+            this->Assert("Streaming allocates less than Static", streamingAllocs < staticAllocs);
+            this->Assert("PersistentStreaming allocates less than Static", persistentAllocs < staticAllocs);
+        }
+    
+    private:
+        static const int FrameCount = 60;
+        static const int FlushesPerFrame = 64;
+        static const int VertsPerFlush = 600;
+        
+        size_t _runBenchmark(VertexBuffer::UsageMode mode, const char* name) {
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            
+            EffectParametersPtr effect = EffectReader::GetEffectFromFile(Config::GetString("core.render.basicEffect"));
+            
+            VertexBufferPtr buffer = new VertexBuffer(render, effect);
+            buffer->SetUsageMode(mode);
+            
+            // the fallback is reported so llvmpipe results can be told apart from real persistent mapping
+            const char* actualName = buffer->GetUsageMode() == mode ? name : "Streaming (fallback)";
+            
+            render->EndFrame();
+            
+            size_t uploaded = 0, allocs = 0, orphans = 0, stalls = 0;
+            
+            double startTime = Platform::GetTime();
+            
+            for (int frame = 0; frame < FrameCount; frame++) {
+                for (int flush = 0; flush < FlushesPerFrame; flush++) {
+                    for (int i = 0; i < VertsPerFlush; i++) {
+                        buffer->AddVert(glm::vec3(i % 800, (i * 3) % 600, 0), Color4f(1.0f, 1.0f, 1.0f, 0.0f));
+                    }
+                    buffer->Draw(PolygonMode::Triangles, glm::mat4());
+                    buffer->Reset();
+                }
+                
+                glFinish();
+                
+                uploaded += render->GetStatistic(RenderStatistic::BufferUpload);
+                allocs += render->GetStatistic(RenderStatistic::BufferAlloc);
+                orphans += render->GetStatistic(RenderStatistic::BufferOrphan);
+                stalls += render->GetStatistic(RenderStatistic::BufferStall);
+                
+                render->EndFrame();
+            }
+            
+            double endTime = Platform::GetTime();
+            
+            delete buffer;
+            
+            render->CheckError("RenderStreamingBufferTest::Post");
+            
+            Logger::begin("RenderStreamingBufferTest", Logger::LogLevel_Log) << actualName << " VertexBuffer x " << FrameCount << " frames x "
+                << FlushesPerFrame << " flushes: " << (endTime - startTime) / FrameCount << "s/frame | "
+                << uploaded / FrameCount << " bytes/frame | " << (double) allocs / FrameCount << " allocs/frame | "
+                << (double) orphans / FrameCount << " orphans/frame | " << (double) stalls / FrameCount << " stalls/frame" << Logger::end();
+            
+            return allocs;
+        }
+    };
+    
+    // Interleaves primitives the way a typical Draw2D frame does
+    class RenderBatchTest : public Test {
+    public:
+        std::string GetName() override { return "RenderBatchTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderBatchTest")) return;
+            
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            
+            float red[4] = {1.0f, 0.0f, 0.0f, 1.0f};
+            float blue[4] = {0.0f, 0.0f, 1.0f, 1.0f};
+            TexturePtr texA = ImageReader::TextureFromBuffer(red, 1, 1);
+            TexturePtr texB = ImageReader::TextureFromBuffer(blue, 1, 1);
+            
+            size_t immediateDraws = this->_runFrame(render, texA, texB, false);
+            size_t batchedDraws = this->_runFrame(render, texA, texB, true);
+            
+            this->Assert("Batching reduces draw calls", batchedDraws < immediateDraws);
+            // untextured triangles, untextured lines and one batch for each texture
+            this->Assert("Batching submits one draw per state", batchedDraws <= 4);
+            
+            // Overlapping images keep painter's order whichever texture sorts first
+            this->Assert("The last overlapping image is on top", this->_topColor(render, texA, texB) == 0xFFFF0000);
+            this->Assert("The last overlapping image is on top", this->_topColor(render, texB, texA) == 0xFF0000FF);
+            
+            delete texA;
+            delete texB;
+        }
+    
+    private:
+        size_t _runFrame(RenderDriverPtr render, TexturePtr texA, TexturePtr texB, bool batching) {
+            Draw2D draw(render);
+            
+            render->EndFrame();
+            
+            double startTime = Platform::GetTime();
+            
+            render->Begin2d();
+            render->SetBatching(batching);
+            
+            for (int i = 0; i < 200; i++) {
+                float x = (i % 20) * 40, y = (i / 20) * 40;
+                draw.Rect(x, y, 10, 10);
+                draw.DrawImage(texA, x + 10, y, 10, 10);
+                draw.Line(x, y, x + 20, y + 20);
+                draw.DrawImage(texB, x + 20, y, 10, 10);
+                draw.Grid(x, y + 10, 10, 10);
+                draw.Circle(x + 30, y + 30, 5);
+            }
+            
+            render->End2d();
+            
+            glFinish();
+            
+            double endTime = Platform::GetTime();
+            
+            size_t draws = render->GetStatistic(RenderStatistic::DrawCall);
+            
+            Logger::begin("RenderBatchTest", Logger::LogLevel_Log) << (batching ? "Batched" : "Immediate") << " Draw2D frame x 1200 primitives: "
+                << (endTime - startTime) << "s | Draws: " << draws
+                << " | PrimitiveFlush: " << render->GetStatistic(RenderStatistic::PrimitiveFlush)
+                << " | TextureFlush: " << render->GetStatistic(RenderStatistic::TextureFlush)
+                << " | UserFlush: " << render->GetStatistic(RenderStatistic::UserFlush) << Logger::end();
+            
+            render->SetBatching(Config::GetBoolean("core.render.batching"));
+            render->EndFrame();
+            
+            return draws;
+        }
+        
+        // Returns the pixel under two overlapping images as 0xAABBGGRR
+        unsigned int _topColor(RenderDriverPtr render, TexturePtr first, TexturePtr second) {
+            Draw2D draw(render);
+            
+            render->EndFrame();
+            render->Clear();
+            render->Begin2d();
+            render->SetBatching(true);
+            
+            draw.DrawImage(first, 0, 0, 100, 100);
+            draw.DrawImage(second, 50, 50, 100, 100);
+            
+            render->End2d();
+            
+            glFinish();
+            
+            glm::vec2 windowSize = GetAppSingilton()->GetWindow()->GetWindowSize();
+            unsigned int pixel = 0;
+            glReadPixels(75, (GLint) windowSize.y - 75, 1, 1, GL_RGBA, GL_UNSIGNED_BYTE, &pixel);
+            
+            render->SetBatching(Config::GetBoolean("core.render.batching"));
+            render->EndFrame();
+            
+            return pixel;
+        }
+    };
+    
+    // Doesn't touch OpenGL so it runs in headless mode as well
+    class RenderCommandListTest : public Test {
+    public:
+        std::string GetName() override { return "RenderCommandListTest"; }
+        
+        void Run() override {
+            // Only compared, never bound. B sorts before A by address
+            TexturePtr texA = reinterpret_cast<TexturePtr>((uintptr_t) 0x2000);
+            TexturePtr texB = reinterpret_cast<TexturePtr>((uintptr_t) 0x1000);
+            
+            RenderCommandList list;
+            
+            this->_quad(list, 0, texA, 0, 0);
+            this->_quad(list, 0, texB, 5, 5);
+            this->_quad(list, 0, texA, 0, 0);
+            list.Build();
+            
+            std::vector<RenderBatch>& overlapping = list.GetBatches();
+            this->Assert("Overlapping primitives keep their order",
+                         overlapping.size() == 3 && overlapping[0].key.texture == texA && overlapping[1].key.texture == texB);
+            list.Clear();
+            
+            this->_quad(list, 0, texA, 0, 0);
+            this->_quad(list, 0, texB, 20, 0);
+            this->_quad(list, 0, texA, 40, 0);
+            list.Build();
+            
+            std::vector<RenderBatch>& separate = list.GetBatches();
+            this->Assert("Primitives that don't overlap share a batch",
+                         separate.size() == 2 && separate[0].key.texture == texA && separate[0].count == 12);
+            list.Clear();
+            
+            this->_quad(list, 1, texA, 0, 0);
+            this->_quad(list, 0, texB, 0, 0);
+            list.Build();
+            
+            std::vector<RenderBatch>& layered = list.GetBatches();
+            this->Assert("Lower layers draw first", layered.size() == 2 && layered[0].key.texture == texB);
+            list.Clear();
+            
+            // sprite draws are sorted with the primitives instead of flushing them
+            SpriteInstance sprite(0, 0, 10, 10);
+            RenderSortKey spriteKey = {0, 1, texA, PolygonMode::Triangles};
+            this->_quad(list, 1, texA, 0, 0);
+            list.AddSprites(spriteKey, &sprite, 1, glm::mat4(), glm::vec2(0, 0), glm::vec2(1, 1));
+            this->_quad(list, 0, texB, 0, 0);
+            list.Build();
+            
+            std::vector<RenderBatch>& sprites = list.GetBatches();
+            this->Assert("Sprites follow layers", sprites.size() == 3 && sprites[0].sprites != NULL && sprites[1].key.texture == texB);
+            list.Clear();
+            
+            this->_quad(list, 0, texA, 0, 0);
+            list.AddSprites(spriteKey, &sprite, 1, glm::mat4(), glm::vec2(0, 0), glm::vec2(1, 1));
+            this->_quad(list, 0, texA, 0, 0);
+            list.AddSprites(spriteKey, &sprite, 1, glm::mat4(), glm::vec2(0, 0), glm::vec2(1, 1));
+            list.Build();
+            
+            std::vector<RenderBatch>& overlappingSprites = list.GetBatches();
+            this->Assert("Primitives don't move past sprites they overlap and sprite draws aren't merged",
+                         overlappingSprites.size() == 4 && overlappingSprites[1].sprites != NULL && overlappingSprites[3].sprites != NULL);
+            list.Clear();
+        }
+        
+    private:
+        void _quad(RenderCommandList& list, int layer, TexturePtr tex, float x, float y) {
+            RenderSortKey key = {layer, 0, tex, PolygonMode::Triangles};
+            Color4f col(1.0f, 1.0f, 1.0f, 1.0f);
+            
+            list.Begin(key);
+            list.AddVert(BufferFormat(glm::vec3(x, y, 0), col, glm::vec3(0, 0, 1)));
+            list.AddVert(BufferFormat(glm::vec3(x + 10, y, 0), col, glm::vec3(1, 0, 1)));
+            list.AddVert(BufferFormat(glm::vec3(x, y + 10, 0), col, glm::vec3(0, 1, 1)));
+            list.AddVert(BufferFormat(glm::vec3(x + 10, y, 0), col, glm::vec3(1, 0, 1)));
+            list.AddVert(BufferFormat(glm::vec3(x + 10, y + 10, 0), col, glm::vec3(1, 1, 1)));
+            list.AddVert(BufferFormat(glm::vec3(x, y + 10, 0), col, glm::vec3(0, 1, 1)));
+            list.End();
+        }
+    };
+    
+    // Every object moves the camera to its own position the way scripts with many sprites do
+    class RenderCameraTest : public Test {
+    public:
+        std::string GetName() override { return "RenderCameraTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderCameraTest")) return;
+            
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            
+            bool oldCPUTransform = Config::GetBoolean("core.render.cpuTransform");
+            bool oldBatching = Config::GetBoolean("core.render.batching");
+            
+            Config::SetBoolean("core.render.batching", false);
+            
+            size_t uniformFlushes = 0, cpuFlushes = 0;
+            size_t uniformDraws = this->_runFrame(render, false, uniformFlushes);
+            size_t cpuDraws = this->_runFrame(render, true, cpuFlushes);
+            
+            Config::SetBoolean("core.render.cpuTransform", oldCPUTransform);
+            Config::SetBoolean("core.render.batching", oldBatching);
+            
+            this->Assert("Camera changes don't flush with cpuTransform", cpuFlushes == 0);
+            this->Assert("cpuTransform reduces draw calls", cpuDraws < uniformDraws);
+        }
+    
+    private:
+        static const int ObjectCount = 1000;
+        
+        size_t _runFrame(RenderDriverPtr render, bool cpuTransform, size_t& cameraFlushes) {
+            Draw2D draw(render);
+            
+            Config::SetBoolean("core.render.cpuTransform", cpuTransform);
+            
+            render->EndFrame();
+            
+            double startTime = Platform::GetTime();
+            
+            render->Begin2d();
+            
+            for (int i = 0; i < ObjectCount; i++) {
+                float x = (i % 40) * 20, y = (i / 40) * 20;
+                render->CameraPan(x, y);
+                render->CameraRotate(i);
+                draw.Rect(-5, -5, 10, 10);
+                render->CameraRotate(-i);
+                render->CameraPan(-x, -y);
+            }
+            
+            render->End2d();
+            
+            glFinish();
+            
+            double endTime = Platform::GetTime();
+            
+            size_t draws = render->GetStatistic(RenderStatistic::DrawCall);
+            cameraFlushes = render->GetStatistic(RenderStatistic::CameraFlush);
+            
+            Logger::begin("RenderCameraTest", Logger::LogLevel_Log) << (cpuTransform ? "CPU transform" : "Uniform transform") << " frame x "
+                << ObjectCount << " panned objects: " << (endTime - startTime) << "s | Draws: " << draws
+                << " | CameraFlush: " << cameraFlushes << Logger::end();
+            
+            render->EndFrame();
+            
+            return draws;
+        }
+    };
+    
+    // Doesn't touch OpenGL so it runs in headless mode as well
+    class TessellatorTest : public Test {
+    public:
+        std::string GetName() override { return "TessellatorTest"; }
+        
+        void Run() override {
+            Tessellator tess;
+            
+            // an L shape, concave at (10, 10)
+            glm::vec2 shape[] = {
+                glm::vec2(0, 0), glm::vec2(20, 0), glm::vec2(20, 10),
+                glm::vec2(10, 10), glm::vec2(10, 20), glm::vec2(0, 20)
+            };
+            
+            this->Assert("Concave polygons are tessellated", tess.Polygon(shape, 6));
+            this->Assert("Ear clipping makes n - 2 triangles", tess.GetIndices().size() == 4 * 3);
+            this->Assert("Triangles cover the polygon exactly", glm::abs(this->_area(tess) - 300.0f) < 0.01f);
+            
+            tess.Clear();
+            std::reverse(shape, shape + 6);
+            tess.Polygon(shape, 6);
+            this->Assert("Clockwise polygons are tessellated", glm::abs(this->_area(tess) - 300.0f) < 0.01f);
+            
+            tess.Clear();
+            glm::vec2 line[] = {glm::vec2(0, 0), glm::vec2(10, 0), glm::vec2(20, 0), glm::vec2(0, 0)};
+            this->Assert("Polygons without an area are skipped", !tess.Polygon(line, 4) && tess.GetPoints().empty());
+            
+            tess.Clear();
+            tess.Circle(glm::vec2(0, 0), 100.0f, 0.0f, 64, 0.0f, 1.0f);
+            this->Assert("Filled circles are a triangle per segment", tess.GetIndices().size() == 64 * 3);
+            this->Assert("Filled circles are close to pi r^2", glm::abs(this->_area(tess) / (3.14159265f * 100 * 100) - 1.0f) < 0.01f);
+            
+            tess.Clear();
+            tess.Circle(glm::vec2(0, 0), 100.0f, 50.0f, 64, 0.0f, 0.5f);
+            this->Assert("Half rings cover half the ring", glm::abs(this->_area(tess) / (3.14159265f * (100 * 100 - 50 * 50) / 2) - 1.0f) < 0.01f);
+            
+            this->Assert("Unit circle tables are cached", &Tessellator::GetUnitCircle(64) == &Tessellator::GetUnitCircle(64));
+            this->Assert("Larger circles get more segments", tess.GetCircleSegments(500.0f) > tess.GetCircleSegments(10.0f));
+            this->Assert("Zoomed circles get more segments", tess.GetCircleSegments(10.0f, 8.0f) > tess.GetCircleSegments(10.0f));
+            
+            double startTime = Platform::GetTime();
+            
+            size_t triangles = 0;
+            for (int i = 0; i < 10000; i++) {
+                tess.Clear();
+                tess.Circle(glm::vec2(0, 0), 50.0f, 0.0f, tess.GetCircleSegments(50.0f), 0.0f, 1.0f);
+                tess.Polygon(shape, 6);
+                triangles += tess.GetIndices().size() / 3;
+            }
+            
+            double endTime = Platform::GetTime();
+            
+            Logger::begin("TessellatorTest", Logger::LogLevel_Log) << "Circle + Polygon x 10000: " << (endTime - startTime) << "s | "
+                << triangles / (endTime - startTime) << " triangles/s" << Logger::end();
+        }
+    
+    private:
+        float _area(Tessellator& tess) {
+            std::vector<glm::vec2>& points = tess.GetPoints();
+            std::vector<unsigned int>& indices = tess.GetIndices();
+            
+            float area = 0.0f;
+            for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+                glm::vec2 a = points[indices[i]], b = points[indices[i + 1]], c = points[indices[i + 2]];
+                area += glm::abs((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x)) / 2.0f;
+            }
+            return area;
+        }
+    };
+    
+    // Mixed shapes used to flush around every circle and polygon
+    class RenderTessellationTest : public Test {
+    public:
+        std::string GetName() override { return "RenderTessellationTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderTessellationTest")) return;
+            
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            Draw2D draw(render);
+            
+            float star[20];
+            for (int i = 0; i < 10; i++) {
+                float radius = i % 2 == 0 ? 10.0f : 4.0f;
+                star[i * 2 + 0] = radius * glm::cos(i * 3.14159265f / 5);
+                star[i * 2 + 1] = radius * glm::sin(i * 3.14159265f / 5);
+            }
+            
+            render->EndFrame();
+            
+            double startTime = Platform::GetTime();
+            
+            render->Begin2d();
+            
+            for (int i = 0; i < ShapeCount; i++) {
+                float x = (i % 100) * 8, y = ((i / 100) % 75) * 8;
+                switch (i % 5) {
+                    case 0: draw.Circle(x, y, 4.0f + i % 20); break;
+                    case 1: draw.Circle(x, y, 10.0f, false); break;
+                    case 2: draw.Circle(x, y, 10.0f, 5.0f, 0, 0.0f, 0.75f, true); break;
+                    case 3: draw.Polygon(x, y, star, 10); break;
+                    case 4: draw.Rect(x, y, 6, 6); break;
+                }
+            }
+            
+            render->End2d();
+            
+            glFinish();
+            
+            double endTime = Platform::GetTime();
+            
+            size_t verts = render->GetStatistic(RenderStatistic::Verts);
+            size_t draws = render->GetStatistic(RenderStatistic::DrawCall);
+            size_t userFlushes = render->GetStatistic(RenderStatistic::UserFlush);
+            
+            Logger::begin("RenderTessellationTest", Logger::LogLevel_Log) << "Draw2D frame x " << ShapeCount << " mixed shapes: "
+                << (endTime - startTime) << "s | " << verts / (endTime - startTime) << " verts/s | Draws: " << draws
+                << " | UserFlush: " << userFlushes << " | PrimitiveFlush: " << render->GetStatistic(RenderStatistic::PrimitiveFlush) << Logger::end();
+            
+            this->Assert("Circles and polygons don't flush", userFlushes == 0);
+            
+            render->EndFrame();
+        }
+    
+    private:
+        static const int ShapeCount = 10000;
+    };
+    
+    // Doesn't touch OpenGL so it runs in headless mode as well
+    class VertexCacheTest : public Test {
+    public:
+        std::string GetName() override { return "VertexCacheTest"; }
+        
+        void Run() override {
+            // an unindexed grid with the triangles shuffled, the worst case for the vertex cache
+            std::vector<std::vector<glm::vec3>> triangles;
+            for (int y = 0; y < GridSize; y++) {
+                for (int x = 0; x < GridSize; x++) {
+                    triangles.push_back({glm::vec3(x, y, 0), glm::vec3(x + 1, y, 0), glm::vec3(x, y + 1, 0)});
+                    triangles.push_back({glm::vec3(x + 1, y, 0), glm::vec3(x + 1, y + 1, 0), glm::vec3(x, y + 1, 0)});
+                }
+            }
+            
+            std::shuffle(triangles.begin(), triangles.end(), std::mt19937(1));
+            
+            VertexStore verts;
+            for (auto iter = triangles.begin(); iter != triangles.end(); iter++) {
+                for (int i = 0; i < 3; i++) {
+                    verts.push_back(BufferFormat((*iter)[i], Color4f(1.0f, 1.0f, 1.0f, 1.0f), glm::vec3(0, 0, 2)));
+                }
+            }
+            
+            IndexStore indexes;
+            
+            double startTime = Platform::GetTime();
+            
+            size_t vertexCount = VertexBuffer::DeduplicateVerts(verts, verts.size(), indexes);
+            
+            double dedupeTime = Platform::GetTime();
+            
+            this->Assert("Shared vertexes are merged", vertexCount == (GridSize + 1) * (GridSize + 1));
+            this->Assert("Every triangle is kept", indexes.size() == triangles.size() * 3);
+            
+            float oldACMR = VertexBuffer::GetACMR(indexes, vertexCount);
+            
+            VertexBuffer::OptimizeVertexCache(indexes, vertexCount);
+            
+            double cacheTime = Platform::GetTime();
+            
+            float newACMR = VertexBuffer::GetACMR(indexes, vertexCount);
+            
+            this->Assert("Reordering improves vertex cache use", newACMR < oldACMR * 0.5f);
+            
+            VertexBuffer::OptimizeVertexFetch(verts, vertexCount, indexes);
+            
+            double endTime = Platform::GetTime();
+            
+            this->Assert("Indexes refer to valid vertexes", std::all_of(indexes.begin(), indexes.end(), [&](unsigned int index) {
+                return index < verts.size();
+            }));
+            
+            // the same triangles in the same winding, just in a different order
+            std::vector<std::vector<float>> before, after;
+            for (auto iter = triangles.begin(); iter != triangles.end(); iter++) {
+                before.push_back({(*iter)[0].x, (*iter)[0].y, (*iter)[1].x, (*iter)[1].y, (*iter)[2].x, (*iter)[2].y});
+            }
+            for (size_t i = 0; i < indexes.size(); i += 3) {
+                glm::vec3 a = verts[indexes[i]].pos, b = verts[indexes[i + 1]].pos, c = verts[indexes[i + 2]].pos;
+                after.push_back({a.x, a.y, b.x, b.y, c.x, c.y});
+            }
+            std::sort(before.begin(), before.end());
+            std::sort(after.begin(), after.end());
+            this->Assert("Triangles are unchanged by reordering", before == after);
+            
+            Logger::begin("VertexCacheTest", Logger::LogLevel_Log) << triangles.size() << " triangles | ACMR " << oldACMR << " -> " << newACMR
+                << " | dedupe: " << (dedupeTime - startTime) << "s cache: " << (cacheTime - dedupeTime)
+                << "s fetch: " << (endTime - cacheTime) << "s" << Logger::end();
+        }
+    
+    private:
+        static const int GridSize = 100;
+    };
+    
+    // Doesn't touch OpenGL so it runs in headless mode as well
+    class CompactVertexTest : public Test {
+    public:
+        std::string GetName() override { return "CompactVertexTest"; }
+        
+        void Run() override {
+            VertexStore verts = {
+                BufferFormat(glm::vec3(12.5f, -4.0f, 3.0f), Color4f(1.0f, 0.5f, 0.0f, 2.0f), glm::vec3(0.25f, 1.0f, 2.0f)),
+                BufferFormat(glm::vec3(800.0f, 600.0f, 0.0f), Color4f(0.0f, 1.0f, -1.0f, 1.0f), glm::vec3(3.5f, -0.5f, 1.0f)),
+                BufferFormat(glm::vec3(0.0f, 0.0f, 0.0f), Color4f(0.2f, 0.2f, 0.2f, 0.2f), glm::vec3(100000.0f, 0.0001f, 1.0f))
+            };
+            
+            CompactBufferFormat packed[3];
+            VertexBuffer::PackCompactVerts(verts.data(), verts.size(), packed);
+            
+            this->Assert("Compact vertexes are half the size", sizeof(CompactBufferFormat) * 2 == sizeof(BufferFormat));
+            this->Assert("Position keeps x and y", packed[0].x == 12.5f && packed[0].y == -4.0f && packed[1].x == 800.0f);
+            this->Assert("Colors are rounded to bytes", packed[0].col[0] == 255 && packed[0].col[1] == 128 && packed[0].col[2] == 0 && packed[2].col[0] == 51);
+            this->Assert("Colors are clamped", packed[0].col[3] == 255 && packed[1].col[2] == 0);
+            this->Assert("Texcoords are half floats", packed[0].uv[0] == 0x3400 && packed[0].uv[1] == 0x3c00 && packed[1].uv[0] == 0x4300 && packed[1].uv[1] == 0xb800);
+            this->Assert("Texture ids survive", packed[0].uv[2] == 0x4000 && packed[1].uv[2] == 0x3c00);
+            this->Assert("Out of range texcoords become infinity", packed[2].uv[0] == 0x7c00);
+            this->Assert("Tiny texcoords become denormals", packed[2].uv[1] == 0x068e);
+        }
+    };
+    
+    // Draws the same sprite heavy frame with both layouts
+    class RenderCompactVertexTest : public Test {
+    public:
+        std::string GetName() override { return "RenderCompactVertexTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderCompactVertexTest")) return;
+            
+            size_t fullBytes = this->_runBenchmark(VertexLayout::Full3D, "Full3D");
+            size_t compactBytes = this->_runBenchmark(VertexLayout::Compact2D, "Compact2D");
+            
+            if (GetAppSingilton()->GetRender()->GetOpenGLVersion().major >= 3) {
+                this->Assert("Compact2D uploads half the bytes", compactBytes * 2 == fullBytes);
+            }
+        }
+    
+    private:
+        static const int FrameCount = 60;
+        static const int SpriteCount = 10000;
+        
+        size_t _runBenchmark(VertexLayout layout, const char* name) {
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            
+            EffectParametersPtr effect = EffectReader::GetEffectFromFile(Config::GetString("core.render.basicEffect"));
+            
+            VertexBufferPtr buffer = new VertexBuffer(render, effect);
+            buffer->SetUsageMode(VertexBuffer::UsageMode::Streaming);
+            buffer->SetVertexLayout(layout);
+            
+            render->EndFrame();
+            
+            size_t uploaded = 0;
+            
+            double startTime = Platform::GetTime();
+            
+            for (int frame = 0; frame < FrameCount; frame++) {
+                for (int i = 0; i < SpriteCount; i++) {
+                    float x = (i * 7) % 800, y = (i * 13) % 600;
+                    Color4f col(1.0f, 1.0f, 1.0f, 0.5f);
+                    buffer->AddVert(glm::vec3(x, y, 0), col, glm::vec2(0, 0));
+                    buffer->AddVert(glm::vec3(x + 8, y, 0), col, glm::vec2(1, 0));
+                    buffer->AddVert(glm::vec3(x, y + 8, 0), col, glm::vec2(0, 1));
+                    buffer->AddVert(glm::vec3(x + 8, y, 0), col, glm::vec2(1, 0));
+                    buffer->AddVert(glm::vec3(x + 8, y + 8, 0), col, glm::vec2(1, 1));
+                    buffer->AddVert(glm::vec3(x, y + 8, 0), col, glm::vec2(0, 1));
+                }
+                buffer->Draw(PolygonMode::Triangles, glm::mat4());
+                buffer->Reset();
+                
+                glFinish();
+                
+                uploaded += render->GetStatistic(RenderStatistic::BufferUpload);
+                
+                render->EndFrame();
+            }
+            
+            double endTime = Platform::GetTime();
+            
+            // the layout falls back to Full3D before OpenGL 3.0
+            const char* actualName = buffer->GetVertexLayout() == layout ? name : "Full3D (fallback)";
+            
+            delete buffer;
+            
+            render->CheckError("RenderCompactVertexTest::Post");
+            
+            Logger::begin("RenderCompactVertexTest", Logger::LogLevel_Log) << actualName << " x " << SpriteCount << " sprites: "
+                << (endTime - startTime) / FrameCount << "s/frame | " << uploaded / FrameCount << " bytes/frame" << Logger::end();
+            
+            return uploaded;
+        }
+    };
+    
+    // Compares instanced sprites against the vertex path for speed and for the pixels they produce
+    class RenderSpriteInstancingTest : public Test {
+    public:
+        std::string GetName() override { return "RenderSpriteInstancingTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderSpriteInstancingTest")) return;
+            
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            
+            float texPixels[16] = {
+                1.0f, 0.0f, 0.0f, 1.0f,     0.0f, 1.0f, 0.0f, 1.0f,
+                0.0f, 0.0f, 1.0f, 1.0f,     1.0f, 1.0f, 1.0f, 1.0f
+            };
+            TexturePtr tex = ImageReader::TextureFromBuffer(texPixels, 2, 2);
+            
+            std::vector<SpriteInstance> sprites;
+            std::mt19937 rand(42);
+            std::uniform_real_distribution<float> pos(0.0f, 200.0f), size(4.0f, 24.0f), angle(0.0f, 6.28f), channel(0.2f, 1.0f);
+            for (int i = 0; i < SpriteCount; i++) {
+                sprites.push_back(SpriteInstance(pos(rand), pos(rand), size(rand), size(rand),
+                                                 Color4f(channel(rand), channel(rand), channel(rand), 1.0f), angle(rand)));
+            }
+            
+            std::vector<unsigned char> vertexPixels, instancedPixels;
+            
+            size_t vertexDraws = this->_runFrame(render, tex, sprites, false, vertexPixels);
+            size_t instancedDraws = this->_runFrame(render, tex, sprites, true, instancedPixels);
+            
+            size_t different = 0;
+            for (size_t i = 0; i < vertexPixels.size(); i += 4) {
+                for (size_t c = 0; c < 3; c++) {
+                    if (std::abs((int) vertexPixels[i + c] - (int) instancedPixels[i + c]) > 8) {
+                        different++;
+                        break;
+                    }
+                }
+            }
+            
+            this->Assert("Instanced sprites match the vertex path", different < vertexPixels.size() / 4 / 50);
+            
+            if (render->GetStatistic(RenderStatistic::Instances) > 0) {
+                this->Assert("Instanced sprites are one draw call", instancedDraws == 1);
+            } else {
+                Logger::begin("RenderSpriteInstancingTest", Logger::LogLevel_Warning) << "Instancing not supported, only the vertex path was tested" << Logger::end();
+            }
+            
+            this->_runBenchmark(render, tex, false);
+            this->_runBenchmark(render, tex, true);
+            
+            delete tex;
+        }
+    
+    private:
+        static const int SpriteCount = 200;
+        static const int BenchmarkSpriteCount = 100000;
+        static const int FrameCount = 10;
+        
+        void _draw(RenderDriverPtr render, TexturePtr tex, const std::vector<SpriteInstance>& sprites, bool instanced) {
+            if (instanced) {
+                render->DrawSprites(tex, sprites.data(), sprites.size());
+            } else {
+                render->RenderDriver::DrawSprites(tex, sprites.data(), sprites.size());
+            }
+        }
+        
+        size_t _runFrame(RenderDriverPtr render, TexturePtr tex, const std::vector<SpriteInstance>& sprites,
+                         bool instanced, std::vector<unsigned char>& pixels) {
+            render->EndFrame();
+            
+            render->Clear();
+            render->Begin2d();
+            this->_draw(render, tex, sprites, instanced);
+            render->End2d();
+            
+            glFinish();
+            
+            size_t draws = render->GetStatistic(RenderStatistic::DrawCall);
+            
+            glm::vec2 windowSize = GetAppSingilton()->GetWindow()->GetWindowSize();
+            pixels.resize(200 * 200 * 4);
+            glReadPixels(0, (GLint) windowSize.y - 200, 200, 200, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+            
+            return draws;
+        }
+        
+        void _runBenchmark(RenderDriverPtr render, TexturePtr tex, bool instanced) {
+            std::vector<SpriteInstance> sprites;
+            for (int i = 0; i < BenchmarkSpriteCount; i++) {
+                sprites.push_back(SpriteInstance((i * 7) % 800, (i * 13) % 600, 8, 8, Color4f(1.0f, 1.0f, 1.0f, 0.5f), i * 0.01f));
+            }
+            
+            render->EndFrame();
+            
+            double startTime = Platform::GetTime();
+            
+            for (int frame = 0; frame < FrameCount; frame++) {
+                render->Begin2d();
+                this->_draw(render, tex, sprites, instanced);
+                render->End2d();
+            }
+            
+            double cpuTime = Platform::GetTime() - startTime;
+            
+            glFinish();
+            
+            double endTime = Platform::GetTime();
+            
+            Logger::begin("RenderSpriteInstancingTest", Logger::LogLevel_Log) << (instanced ? "DrawSprites" : "Vertex path") << " x "
+                << BenchmarkSpriteCount << " sprites: " << cpuTime / FrameCount << "s/frame CPU | " << (endTime - startTime) / FrameCount
+                << "s/frame total | " << render->GetStatistic(RenderStatistic::DrawCall) / FrameCount << " draws/frame | "
+                << render->GetStatistic(RenderStatistic::BufferUpload) / FrameCount << " bytes/frame" << Logger::end();
+        }
+    };
+    
+    class RenderBatchArrayTest : public Test {
+    public:
+        std::string GetName() override { return "RenderBatchArrayTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderBatchArrayTest")) return;
+            
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            
+            std::vector<float> rects, lines;
+            std::vector<unsigned char> colors;
+            for (int i = 0; i < ShapeCount; i++) {
+                float x = (i * 7) % 800, y = (i * 13) % 600;
+                rects.insert(rects.end(), {x, y, 4.0f, 4.0f});
+                lines.insert(lines.end(), {x, y, x + 8.0f, y + 8.0f});
+                colors.insert(colors.end(), {(unsigned char) (i % 256), 128, 255, 255});
+            }
+            
+            size_t perCallVerts = this->_runFrames(render, rects, colors, lines, false);
+            size_t batchedVerts = this->_runFrames(render, rects, colors, lines, true);
+            
+            this->Assert("Batched arrays draw the same number of vertexes", perCallVerts == batchedVerts);
+        }
+    
+    private:
+        static const int ShapeCount = 20000;
+        static const int FrameCount = 10;
+        
+        size_t _runFrames(RenderDriverPtr render, const std::vector<float>& rects, const std::vector<unsigned char>& colors,
+                          const std::vector<float>& lines, bool batched) {
+            Draw2D draw(render);
+            
+            render->EndFrame();
+            
+            double startTime = Platform::GetTime();
+            
+            for (int frame = 0; frame < FrameCount; frame++) {
+                render->Begin2d();
+                if (batched) {
+                    draw.Rects(rects.data(), ShapeCount, colors.data());
+                    draw.LineSegments(lines.data(), ShapeCount);
+                } else {
+                    for (int i = 0; i < ShapeCount; i++) {
+                        render->SetColor(Color4f(colors[i * 4] / 255.0f, colors[i * 4 + 1] / 255.0f, colors[i * 4 + 2] / 255.0f, 1.0f));
+                        draw.Rect(rects[i * 4], rects[i * 4 + 1], rects[i * 4 + 2], rects[i * 4 + 3]);
+                    }
+                    for (int i = 0; i < ShapeCount; i++) {
+                        draw.Line(lines[i * 4], lines[i * 4 + 1], lines[i * 4 + 2], lines[i * 4 + 3]);
+                    }
+                }
+                render->End2d();
+            }
+            
+            glFinish();
+            
+            double endTime = Platform::GetTime();
+            
+            size_t verts = render->GetStatistic(RenderStatistic::Verts) / FrameCount;
+            
+            Logger::begin("RenderBatchArrayTest", Logger::LogLevel_Log) << (batched ? "Batched arrays" : "Per call") << " x "
+                << ShapeCount * 2 << " shapes: " << (endTime - startTime) / FrameCount << "s/frame | "
+                << render->GetStatistic(RenderStatistic::DrawCall) / FrameCount << " draws/frame" << Logger::end();
+            
+            return verts;
+        }
+    };
+    
+    // Doesn't touch OpenGL so it runs in headless mode as well
+    class PixelConvertTest : public Test {
+    public:
+        std::string GetName() override { return "PixelConvertTest"; }
+        
+        void Run() override {
+            size_t count = ImageSize * ImageSize * 4 + 7; // the tail skips the SIMD loop
+            
+            std::vector<unsigned char> bytes(count), roundTrip(count);
+            std::vector<float> floats(count);
+            for (size_t i = 0; i < count; i++) {
+                bytes[i] = (unsigned char) (i * 31);
+            }
+            
+            double startTime = Platform::GetTime();
+            ImageReader::BytesToFloats(bytes.data(), floats.data(), count);
+            double toFloatTime = Platform::GetTime() - startTime;
+            
+            startTime = Platform::GetTime();
+            ImageReader::FloatsToBytes(floats.data(), roundTrip.data(), count);
+            double toByteTime = Platform::GetTime() - startTime;
+            
+            this->Assert("Bytes are scaled to 0.0 - 1.0", floats[0] == 0.0f && floats[count - 1] == bytes[count - 1] * (1.0f / 255.0f));
+            this->Assert("Bytes survive a round trip", bytes == roundTrip);
+            
+            float outOfRange[20] = {-1.0f, 2.0f, 0.5f, 1.0f};
+            unsigned char clamped[20];
+            ImageReader::FloatsToBytes(outOfRange, clamped, 20);
+            this->Assert("Floats are clamped", clamped[0] == 0 && clamped[1] == 255 && clamped[2] == 128 && clamped[3] == 255);
+            
+            unsigned char pixels[24];
+            for (int i = 0; i < 24; i++) {
+                pixels[i] = (unsigned char) i;
+            }
+            const int bgra[4] = {2, 1, 0, 3};
+            ImageReader::SwizzleRGBA(pixels, 6, bgra);
+            bool swizzled = true;
+            for (int i = 0; i < 6; i++) {
+                swizzled &= pixels[i * 4] == i * 4 + 2 && pixels[i * 4 + 1] == i * 4 + 1 && pixels[i * 4 + 2] == i * 4 && pixels[i * 4 + 3] == i * 4 + 3;
+            }
+            this->Assert("Swizzle swaps red and blue", swizzled);
+            
+            Logger::begin("PixelConvertTest", Logger::LogLevel_Log) << ImageSize << "x" << ImageSize << " image: " << toFloatTime
+                << "s to float | " << toByteTime << "s to bytes" << Logger::end();
+        }
+    
+    private:
+        static const int ImageSize = 1024;
+    };
+    
+    class RenderTextureUpdateTest : public Test {
+    public:
+        std::string GetName() override { return "RenderTextureUpdateTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderTextureUpdateTest")) return;
+            
+            std::vector<unsigned char> pixels(ImageSize * ImageSize * 4, 0);
+            TexturePtr tex = ImageReader::TextureFromBuffer(pixels.data(), ImageSize, ImageSize);
+            
+            for (size_t i = 0; i < pixels.size(); i++) {
+                pixels[i] = (unsigned char) (i * 7);
+            }
+            
+            double startTime = Platform::GetTime();
+            for (int frame = 0; frame < FrameCount; frame++) {
+                tex->Update(pixels.data());
+            }
+            glFinish();
+            double updateTime = (Platform::GetTime() - startTime) / FrameCount;
+            
+            std::vector<unsigned char> readBack(pixels.size());
+            tex->Begin();
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, readBack.data());
+            tex->End();
+            
+            this->Assert("Update replaces every pixel", readBack == pixels);
+            
+            Logger::begin("RenderTextureUpdateTest", Logger::LogLevel_Log) << ImageSize << "x" << ImageSize << " Texture::Update: "
+                << updateTime << "s" << Logger::end();
+            
+            delete tex;
+        }
+    
+    private:
+        static const int ImageSize = 1024;
+        static const int FrameCount = 10;
+    };
+    
+    // Builds a grid of quads as .obj text, half the faces use relative indexes
+    static std::string _makeGridObj(int gridSize) {
+        std::stringstream ss;
+        
+        ss << "# grid\no grid\n";
+        for (int y = 0; y <= gridSize; y++) {
+            for (int x = 0; x <= gridSize; x++) {
+                ss << "v " << x << " " << y << " 0\nvt " << (float) x / gridSize << " " << (float) y / gridSize << "\n";
+            }
+        }
+        
+        int total = (gridSize + 1) * (gridSize + 1);
+        
+        for (int y = 0; y < gridSize; y++) {
+            for (int x = 0; x < gridSize; x++) {
+                int a = y * (gridSize + 1) + x + 1, b = a + 1, c = a + gridSize + 2, d = a + gridSize + 1;
+                if (y % 2 == 0) {
+                    ss << "f " << a << "/" << a << " " << b << "/" << b << " " << c << "/" << c << " " << d << "/" << d << "\n";
+                } else {
+                    a -= total + 1; b -= total + 1; c -= total + 1; d -= total + 1;
+                    ss << "f " << a << "/" << a << "/1 " << b << "/" << b << "/1 " << c << "/" << c << "/1 " << d << "/" << d << "/1\n";
+                }
+            }
+        }
+        
+        return ss.str();
+    }
+    
+    // Doesn't touch OpenGL so it runs in headless mode as well
+    class MeshConverterTest : public Test {
+    public:
+        std::string GetName() override { return "MeshConverterTest"; }
+        
+        void Run() override {
+            std::string source = _makeGridObj(GridSize);
+            
+            MeshConverter::Mesh mesh;
+            MeshConverter::ConvertStats stats;
+            
+            this->Assert("Grid parses", MeshConverter::ParseObj(source.c_str(), source.length(), 2.0f, mesh, stats));
+            this->Assert("Shared corners are merged", mesh.Verts.size() == (GridSize + 1) * (GridSize + 1));
+            this->Assert("Quads are split into 2 triangles", mesh.Indexes.size() == GridSize * GridSize * 6);
+            this->Assert("Positions are scaled", std::any_of(mesh.Verts.begin(), mesh.Verts.end(), [](const BufferFormat& vert) {
+                return vert.pos == glm::vec3(GridSize * 2, GridSize * 2, 0);
+            }));
+            
+            MeshConverter::PrepareMesh(mesh, true, stats);
+            
+            this->Assert("Every vertex has a normal", mesh.Normals.size() == mesh.Verts.size());
+            this->Assert("Counter clockwise faces point along +z", std::all_of(mesh.Normals.begin(), mesh.Normals.end(), [](const glm::vec3& normal) {
+                return glm::abs(normal.z - 1.0f) < 0.001f;
+            }));
+            this->Assert("Optimized for the vertex cache", stats.ACMR < 1.0f);
+            
+            const char* badSource = "v 0 0 0\nv 1 0 0\nf 1 2 3\n";
+            MeshConverter::Mesh badMesh;
+            this->Assert("Missing vertexes are an error", !MeshConverter::ParseObj(badSource, std::strlen(badSource), 1.0f, badMesh, stats));
+            
+            Logger::begin("MeshConverterTest", Logger::LogLevel_Log) << source.length() << " bytes: parse " << stats.ParseTime << "s | optimize "
+                << stats.OptimizeTime << "s | " << source.length() / stats.ParseTime / (1024 * 1024) << " MB/s" << Logger::end();
+        }
+    
+    private:
+        static const int GridSize = 300;
+    };
+    
+    class RenderMappedLoadTest : public Test {
+    public:
+        std::string GetName() override { return "RenderMappedLoadTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderMappedLoadTest", true)) return;
+            
+            std::string source = _makeGridObj(GridSize);
+            
+            MeshConverter::Mesh mesh;
+            MeshConverter::ConvertStats stats;
+            MeshConverter::ParseObj(source.c_str(), source.length(), 1.0f, mesh, stats);
+            MeshConverter::PrepareMesh(mesh, true, stats);
+            
+            size_t fileLength = VertexBuffer::GetDiskSize(mesh.Verts.size(), mesh.Indexes.size(), true);
+            unsigned char* file = new unsigned char[fileLength];
+            VertexBuffer::WriteDiskFormat(file, mesh.Verts.data(), mesh.Verts.size(), mesh.Indexes.data(), mesh.Indexes.size(), mesh.Normals.data());
+            Filesystem::WriteFile("/mappedLoadTest.eglb", (const char*) file, fileLength);
+            delete [] file;
+            
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            EffectParametersPtr effect = EffectReader::GetEffectFromFile(Config::GetString("core.render.basicEffect"));
+            
+            VertexBufferPtr buffer = new VertexBuffer(render, effect);
+            
+            double startTime = Platform::GetTime();
+            buffer->Load("/mappedLoadTest.eglb");
+            buffer->Draw(PolygonMode::Triangles, glm::mat4());
+            glFinish();
+            double loadTime = Platform::GetTime() - startTime;
+            
+            this->Assert("Load reads every vertex", buffer->GetVertexCount() == mesh.Verts.size());
+            this->Assert("Load reads every index", buffer->GetIndexCount() == mesh.Indexes.size());
+            this->Assert("Load reads the normals", buffer->HasNormals());
+            
+            startTime = Platform::GetTime();
+            bool mapped = buffer->LoadMapped("/mappedLoadTest.eglb");
+            buffer->Draw(PolygonMode::Triangles, glm::mat4());
+            glFinish();
+            double mappedTime = Platform::GetTime() - startTime;
+            
+            this->Assert("User directory files can be mapped", mapped);
+            this->Assert("LoadMapped reads every vertex", buffer->GetVertexCount() == mesh.Verts.size());
+            this->Assert("LoadMapped reads every index", buffer->GetIndexCount() == mesh.Indexes.size());
+            this->Assert("LoadMapped reads the normals", buffer->HasNormals());
+            
+            // editing copies the mapping into the buffer first
+            buffer->AddVert(glm::vec3(0, 0, 0));
+            this->Assert("Mapped buffers can be edited", buffer->GetVertexCount() == mesh.Verts.size() + 1);
+            
+            buffer->Draw(PolygonMode::Triangles, glm::mat4());
+            
+            // every mapping closes its file, more loads than the usual 1024 descriptor limit would fail otherwise
+            bool allMapped = true;
+            for (int i = 0; i < 1100 && allMapped; i++) {
+                allMapped = buffer->LoadMapped("/mappedLoadTest.eglb");
+            }
+            this->Assert("Mapped loads don't leak file descriptors", allMapped);
+            
+            PackagePtr package = Package::FromFile("mappedLoadTest.epkg");
+            this->Assert("Missing package files fail without throwing", !buffer->LoadMapped(package, "missing.eglb"));
+            package->Close();
+            
+            // an index past the vertexes would be read out of bounds by Draw and the mesh tools
+            file = new unsigned char[fileLength];
+            VertexBuffer::WriteDiskFormat(file, mesh.Verts.data(), mesh.Verts.size(), mesh.Indexes.data(), mesh.Indexes.size(), mesh.Normals.data());
+            ((unsigned int*) &file[((VertexBufferDiskFormat*) file)->indexOffset])[0] = (unsigned int) mesh.Verts.size();
+            Filesystem::WriteFile("/badIndexTest.eglb", (const char*) file, fileLength);
+            delete [] file;
+            
+            this->Assert("Files with out of range indexes are rejected",
+                         !buffer->LoadMapped("/badIndexTest.eglb") && buffer->GetVertexCount() == 0 && buffer->GetIndexCount() == 0);
+            
+            delete buffer;
+            
+            render->CheckError("RenderMappedLoadTest::Post");
+            
+            Filesystem::DeleteFile("/mappedLoadTest.eglb");
+            Filesystem::DeleteFile("/badIndexTest.eglb");
+            Filesystem::DeleteFile("mappedLoadTest.epkg");
+            
+            Logger::begin("RenderMappedLoadTest", Logger::LogLevel_Log) << fileLength << " bytes: Load + Draw " << loadTime
+                << "s | LoadMapped + Draw " << mappedTime << "s" << Logger::end();
+        }
+    
+    private:
+        static const int GridSize = 500;
+    };
+    
+    // Many buffers redrawn with the same transforms, the case the uniform shadow copies and the Camera block are for
+    class RenderUniformTest : public Test {
+    public:
+        std::string GetName() override { return "RenderUniformTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderUniformTest")) return;
+            
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            
+            EffectParametersPtr effect = EffectReader::GetEffectFromFile(Config::GetString("core.render.basicEffect"));
+            
+            std::vector<VertexBufferPtr> buffers;
+            for (int i = 0; i < BufferCount; i++) {
+                VertexBufferPtr buffer = new VertexBuffer(render, effect);
+                buffer->AddVert(glm::vec3(0, 0, 0), Color4f(1.0f, 1.0f, 1.0f, 0.0f));
+                buffer->AddVert(glm::vec3(10, 0, 0), Color4f(1.0f, 1.0f, 1.0f, 0.0f));
+                buffer->AddVert(glm::vec3(10, 10, 0), Color4f(1.0f, 1.0f, 1.0f, 0.0f));
+                buffers.push_back(buffer);
+            }
+            
+            render->EndFrame();
+            
+            this->_drawFrame(buffers);
+            size_t firstUploads = render->GetStatistic(RenderStatistic::UniformUpload);
+            
+            render->EndFrame();
+            
+            size_t uploads = 0, cameraUpdates = 0;
+            
+            double startTime = Platform::GetTime();
+            
+            for (int frame = 0; frame < FrameCount; frame++) {
+                this->_drawFrame(buffers);
+                
+                uploads += render->GetStatistic(RenderStatistic::UniformUpload);
+                cameraUpdates += render->GetStatistic(RenderStatistic::CameraUpdate);
+                
+                render->EndFrame();
+            }
+            
+            glFinish();
+            
+            double endTime = Platform::GetTime();
+            
+            for (auto iter = buffers.begin(); iter != buffers.end(); iter++) {
+                delete *iter;
+            }
+            
+            render->CheckError("RenderUniformTest::Post");
+            
+            // the model matrix always, the view and projection only without the Camera block
+            this->Assert("The first draw uploads every uniform", firstUploads >= BufferCount && firstUploads <= BufferCount * 3);
+            this->Assert("Unchanged uniforms are skipped", uploads == 0);
+            this->Assert("The Camera block is only written when the camera changes", cameraUpdates == 0);
+            
+            Logger::begin("RenderUniformTest", Logger::LogLevel_Log) << BufferCount << " VertexBuffers x " << FrameCount << " frames: "
+                << ((endTime - startTime) / (FrameCount * BufferCount)) * 1.0e6 << "us/draw | first frame glUniform calls: " << firstUploads
+                << " | later frames: " << (double) uploads / FrameCount << Logger::end();
+        }
+    
+    private:
+        static const int BufferCount = 200;
+        static const int FrameCount = 30;
+        
+        void _drawFrame(std::vector<VertexBufferPtr>& buffers) {
+            for (size_t i = 0; i < buffers.size(); i++) {
+                buffers[i]->Draw(PolygonMode::Triangles, glm::translate(glm::mat4(), glm::vec3((i % 20) * 40.0f, (i / 20) * 40.0f, 0.0f)));
+            }
+        }
+    };
+    
+    // Doesn't touch OpenGL so it runs in headless mode as well
+    class AtlasPackerTest : public Test {
+    public:
+        std::string GetName() override { return "AtlasPackerTest"; }
+        
+        void Run() override {
+            SkylinePacker packer(1024, 1024);
+            std::vector<AtlasRect> rects;
+            
+            std::mt19937 rand(1234);
+            std::uniform_int_distribution<int> sizes(4, 64);
+            
+            double startTime = Platform::GetTime();
+            
+            AtlasRect rect;
+            while (packer.Insert(sizes(rand), sizes(rand), rect)) {
+                rects.push_back(rect);
+            }
+            
+            double endTime = Platform::GetTime();
+            
+            float occupancy = (float) packer.GetUsedArea() / (1024 * 1024);
+            
+            Logger::begin("AtlasPackerTest", Logger::LogLevel_Log) << "SkylinePacker::Insert x " << rects.size() << ": "
+                << (endTime - startTime) << "s | occupancy: " << occupancy * 100 << "%" << Logger::end();
+            
+            bool inBounds = true, overlaps = false;
+            
+            for (size_t i = 0; i < rects.size(); i++) {
+                AtlasRect& a = rects[i];
+                if (a.x < 0 || a.y < 0 || a.x + a.w > 1024 || a.y + a.h > 1024) {
+                    inBounds = false;
+                }
+                for (size_t j = i + 1; j < rects.size(); j++) {
+                    AtlasRect& b = rects[j];
+                    if (a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h) {
+                        overlaps = true;
+                    }
+                }
+            }
+            
+            this->Assert("Packed rects are inside the page", inBounds);
+            this->Assert("Packed rects don't overlap", !overlaps);
+            this->Assert("Page is mostly filled", occupancy > 0.7f);
+            
+            this->Assert("Oversized rects are rejected", !packer.Insert(1025, 16, rect));
+            
+            packer.Reset();
+            this->Assert("Reset clears the page", packer.GetUsedArea() == 0 && packer.Insert(1024, 1024, rect));
+        }
+    };
+    
+    // Sprites from different images should share a page and draw together
+    class RenderAtlasTest : public Test {
+    public:
+        std::string GetName() override { return "RenderAtlasTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderAtlasTest")) return;
+            
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            TextureAtlas atlas(256, 1);
+            
+            unsigned char pixels[16 * 16 * 4];
+            std::memset(pixels, 0xFF, sizeof(pixels));
+            
+            std::vector<TexturePtr> textures;
+            for (int i = 0; i < 32; i++) {
+                textures.push_back(atlas.Add(pixels, 16, 16));
+            }
+            
+            this->Assert("Images share one page", atlas.GetPageCount() == 1);
+            this->Assert("Images are atlased", textures[0]->IsAtlased() && textures[0]->GetBindTexture() == textures[31]->GetBindTexture());
+            
+            Draw2D draw(render);
+            
+            render->EndFrame();
+            render->Begin2d();
+            
+            for (int i = 0; i < 256; i++) {
+                draw.DrawImage(textures[i % textures.size()], (i % 16) * 20, (i / 16) * 20, 16, 16);
+            }
+            
+            render->End2d();
+            
+            size_t draws = render->GetStatistic(RenderStatistic::DrawCall);
+            
+            Logger::begin("RenderAtlasTest", Logger::LogLevel_Log) << "Atlased DrawImage x 256 over 32 images | Draws: " << draws
+                << " | TextureFlush: " << render->GetStatistic(RenderStatistic::TextureFlush) << Logger::end();
+            
+            this->Assert("Atlased images don't flush between each other", render->GetStatistic(RenderStatistic::TextureFlush) <= 1);
+            
+            render->EndFrame();
+            
+            // Evicting every other image leaves space that a repack gives back
+            for (size_t i = 0; i < textures.size(); i += 2) {
+                textures[i]->Invalidate();
+            }
+            
+            atlas.Repack();
+            
+            this->Assert("Repacked images are still valid", textures[1]->IsValid() && textures[31]->IsValid());
+            
+            render->EndFrame();
+            render->Begin2d();
+            
+            draw.DrawImage(textures[1], 0, 0, 16, 16);
+            
+            // The page is freed mid frame while a vertex still samples it
+            for (size_t i = 0; i < textures.size(); i++) {
+                textures[i]->Invalidate();
+            }
+            
+            this->Assert("Freeing a page draws what was recorded with it first", render->GetStatistic(RenderStatistic::DrawCall) > 0);
+            
+            render->End2d();
+            render->EndFrame();
+            
+            this->Assert("Empty pages are evicted", atlas.GetPageCount() == 0);
+            
+            for (size_t i = 0; i < textures.size(); i++) {
+                delete textures[i];
+            }
+        }
+    };
+    
+    class RenderErrorPolicyTest : public Test {
+    public:
+        std::string GetName() override { return "RenderErrorPolicyTest"; }
+        
+        void Run() override {
+            if (_skipWithoutGL("RenderErrorPolicyTest")) return;
+            
+            RenderDriverPtr render = GetAppSingilton()->GetRender();
+            RenderErrorPolicy oldPolicy = render->GetErrorPolicy();
+            
+            size_t perCallChecks = this->_runFrame(render, RenderErrorPolicy::PerCall, "PerCall");
+            size_t perFrameChecks = this->_runFrame(render, RenderErrorPolicy::PerFrame, "PerFrame");
+            size_t offChecks = this->_runFrame(render, RenderErrorPolicy::Off, "Off");
+            
+            this->Assert("PerFrame checks once", perFrameChecks == 1);
+            this->Assert("PerCall checks more than PerFrame", perCallChecks > perFrameChecks);
+            this->Assert("Off never checks", offChecks == 0);
+            
+            // An error raised inside a frame has to be reported by the frame check instead of being lost
+            render->SetErrorPolicy(RenderErrorPolicy::PerFrame);
+            glEnable(0xFFFF); // GL_INVALID_ENUM
+            
+            this->Assert("CheckError is skipped in PerFrame", !render->CheckError("RenderErrorPolicyTest::CheckError"));
+            
+            bool caught = false;
+            try {
+                render->CheckFrameError("RenderErrorPolicyTest::CheckFrameError");
+            } catch (RenderDriver::RenderDriverError* err) {
+                caught = err->Error == GL_INVALID_ENUM;
+                delete err;
+            }
+            this->Assert("CheckFrameError reports the deferred error", caught);
+            
+            render->SetErrorPolicy(oldPolicy);
+            render->EndFrame();
+        }
+    
+    private:
+        size_t _runFrame(RenderDriverPtr render, RenderErrorPolicy policy, const char* name) {
+            Draw2D draw(render);
+            
+            render->SetErrorPolicy(policy);
+            render->EndFrame();
+            
+            double startTime = Platform::GetTime();
+            
+            render->Begin2d();
+            
+            for (int i = 0; i < 200; i++) {
+                float x = (i % 20) * 40, y = (i / 20) * 40;
+                draw.Rect(x, y, 10, 10);
+                draw.Line(x, y, x + 20, y + 20);
+                draw.Circle(x + 30, y + 30, 5);
+            }
+            
+            render->End2d();
+            render->CheckFrameError("RenderErrorPolicyTest::EndOfFrame");
+            
+            glFinish();
+            
+            double endTime = Platform::GetTime();
+            
+            size_t checks = render->GetStatistic(RenderStatistic::ErrorCheck);
+            
+            Logger::begin("RenderErrorPolicyTest", Logger::LogLevel_Log) << name << " Draw2D frame x 600 primitives: "
+                << (endTime - startTime) << "s | glGetError: " << checks
+                << " | Draws: " << render->GetStatistic(RenderStatistic::DrawCall) << Logger::end();
+            
+            render->EndFrame();
+            
+            return checks;
+        }
+    };
+    
+    void LoadRenderTests() {
+        TestSuite::RegisterTest(new RenderStreamingBufferTest());
+        TestSuite::RegisterTest(new RenderBatchTest());
+        TestSuite::RegisterTest(new RenderCommandListTest());
+        TestSuite::RegisterTest(new RenderCameraTest());
+        TestSuite::RegisterTest(new RenderUniformTest());
+        TestSuite::RegisterTest(new RenderErrorPolicyTest());
+        TestSuite::RegisterTest(new AtlasPackerTest());
+        TestSuite::RegisterTest(new TessellatorTest());
+        TestSuite::RegisterTest(new RenderTessellationTest());
+        TestSuite::RegisterTest(new VertexCacheTest());
+        TestSuite::RegisterTest(new CompactVertexTest());
+        TestSuite::RegisterTest(new RenderCompactVertexTest());
+        TestSuite::RegisterTest(new RenderSpriteInstancingTest());
+        TestSuite::RegisterTest(new RenderBatchArrayTest());
+        TestSuite::RegisterTest(new PixelConvertTest());
+        TestSuite::RegisterTest(new RenderTextureUpdateTest());
+        TestSuite::RegisterTest(new MeshConverterTest());
+        TestSuite::RegisterTest(new RenderMappedLoadTest());
+        TestSuite::RegisterTest(new RenderAtlasTest());
+    }
+}
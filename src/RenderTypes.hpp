@@ -106,6 +106,12 @@ namespace Engine {
         TriangleFan
     };
     
+    // How VertexBuffer lays out vertexes in GPU memory
+    enum class VertexLayout {
+        Full3D,     // 40 bytes, float position, color and texcoord
+        Compact2D   // 20 bytes, float2 position, RGBA8 color and half float texcoord
+    };
+    
     enum class EffectShaderType {
         GLSL_110, // OpenGL 2.0
         GLSL_120, // OpenGL 2.1
@@ -146,7 +152,21 @@ namespace Engine {
         CameraFlush,
         PrimitiveFlush,
         EndRenderFlush,
-        UserFlush
+        UserFlush,
+        BufferUpload,   // bytes copied into vertex buffers
+        BufferAlloc,    // buffer storage (re)allocations
+        BufferOrphan,   // streaming buffers orphaned on wrap
+        BufferStall,    // streaming segments waited on before reuse
+        Instances,      // quads drawn by instanced sprite draws
+        ErrorCheck,     // glGetError round trips
+        UniformUpload,  // glUniform* calls, values matching the shader's shadow copy are skipped
+        CameraUpdate    // writes to the shared Camera uniform block
+    };
+    
+    enum class RenderErrorPolicy {
+        Off,            // glGetError is never called
+        PerFrame,       // errors are collected once at the end of the frame, debug groups name the call site
+        PerCall         // every CheckError queries the driver, only meant for debug builds
     };
 }
 
@@ -257,7 +257,7 @@ namespace Engine {
                 
                 unsigned char* file = this->_source->GetData(fileSize);
                 
-                this->_texture = ImageReader::TextureFromFileBuffer(file, fileSize);
+                this->_texture = ImageReader::TextureFromFileBuffer(file, fileSize, true);
             } else {
                 Logger::begin("ResourceManager", Logger::LogLevel_Warning) << "Manual Texture's can't be loaded" << Logger::end();
             }
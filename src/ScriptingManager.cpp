@@ -744,7 +744,7 @@ namespace Engine {
             return _getValueFromV8Object(obj);
         }
         
-        v8::Local<v8::Value> _getValueFromJson(v8::Isolate* isolate, Json::Value val) {
+        v8::Local<v8::Value> _getValueFromJson(v8::Isolate* isolate, const Json::Value& val) {
             switch (val.type()) {
                 case Json::nullValue: return v8::Null(isolate);
                 case Json::intValue: return v8::Number::New(isolate, val.asInt());
@@ -754,15 +754,15 @@ namespace Engine {
                 case Json::booleanValue: return v8::Boolean::New(isolate, val.asBool());
                 case Json::arrayValue: {
                     v8::Local<v8::Array> ret = v8::Array::New(isolate);
-                    for (auto iter = val.begin(); iter != val.end(); iter++) {
-                        ret->Set(_getValueFromJson(isolate, iter.key()), _getValueFromJson(isolate, val[iter.key().asString()]));
+                    for (Json::ArrayIndex i = 0; i < val.size(); i++) {
+                        ret->Set(i, _getValueFromJson(isolate, val[i]));
                     }
                     return ret;
                 }
                 case Json::objectValue: {
                     v8::Local<v8::Object> ret = v8::Object::New(isolate);
                     for (auto iter = val.begin(); iter != val.end(); iter++) {
-                        ret->Set(v8::String::NewFromUtf8(isolate, iter.key().asCString()), _getValueFromJson(isolate, val[iter.key().asString()]));
+                        ret->Set(v8::String::NewFromUtf8(isolate, iter.key().asCString()), _getValueFromJson(isolate, *iter));
                     }
                     return ret;
                 }
@@ -771,7 +771,7 @@ namespace Engine {
             }
         }
         
-        v8::Local<v8::Object> GetObjectFromJson(Json::Value val) {
+        v8::Local<v8::Object> GetObjectFromJson(const Json::Value& val) {
             ENGINE_PROFILER_SCOPE;
             return _getValueFromJson(v8::Isolate::GetCurrent(), val).As<v8::Object>();
         }
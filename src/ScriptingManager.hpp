@@ -358,6 +358,6 @@ namespace Engine {
         };
         
         Json::Value ObjectToJson(v8::Local<v8::Object> obj);
-        v8::Local<v8::Object> GetObjectFromJson(Json::Value val);
+        v8::Local<v8::Object> GetObjectFromJson(const Json::Value& val);
     }
 }
\ No newline at end of file
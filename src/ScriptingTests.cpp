@@ -25,10 +25,202 @@
 
 #include "Logger.hpp"
 #include "ScriptingManager.hpp"
+#include "WorkerMessage.hpp"
+#include "ComputePool.hpp"
+#include "WorkerThreadPool.hpp"
+#include "Platform.hpp"
+
+#include <vector>
+#include <algorithm>
+#include <functional>
 
 namespace Engine {
+    // Round trips a message through the main isolate, the worker threads use the same path
+    class ScriptingWorkerMessageTest : public Test {
+    public:
+        std::string GetName() override { return "ScriptingWorkerMessageTest"; }
+        
+        void Run() override {
+            v8::Isolate* isolate = v8::Isolate::GetCurrent();
+            v8::HandleScope scope(isolate);
+            
+            v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(isolate, VertCount * sizeof(float));
+            v8::Local<v8::Float32Array> verts = v8::Float32Array::New(buffer, 0, VertCount);
+            for (int i = 0; i < VertCount; i++) {
+                verts->Set(i, v8::Number::New(isolate, i * 0.5));
+            }
+            
+            v8::Local<v8::Array> list = v8::Array::New(isolate, 4);
+            list->Set(0, v8::Integer::New(isolate, 1));
+            list->Set(1, v8::Number::New(isolate, 2.5));
+            list->Set(2, v8::String::NewFromUtf8(isolate, "three"));
+            list->Set(3, v8::Null(isolate));
+            
+            v8::Local<v8::Object> value = v8::Object::New(isolate);
+            value->Set(v8::String::NewFromUtf8(isolate, "verts"), verts);
+            value->Set(v8::String::NewFromUtf8(isolate, "list"), list);
+            value->Set(v8::String::NewFromUtf8(isolate, "copy"), v8::Uint8Array::New(v8::ArrayBuffer::New(isolate, 16), 4, 8));
+            
+            v8::Local<v8::Array> transfer = v8::Array::New(isolate, 1);
+            transfer->Set(0, buffer);
+            
+            std::string error;
+            WorkerMessagePtr message = WorkerMessage::Serialize(isolate, value, transfer, error);
+            
+            this->Assert("Message is created", message != NULL);
+            if (message == NULL) return;
+            
+            this->Assert("Transferred buffer is detached", buffer->ByteLength() == 0);
+            this->Assert("Only the transfer list moves", message->GetTransferredBytes() == VertCount * sizeof(float));
+            
+            v8::Local<v8::Object> result = message->Deserialize(isolate).As<v8::Object>();
+            delete message;
+            
+            v8::Local<v8::Value> resultVerts = result->Get(v8::String::NewFromUtf8(isolate, "verts"));
+            this->Assert("Typed arrays keep their type", resultVerts->IsFloat32Array());
+            this->Assert("Typed array contents arrive", resultVerts.As<v8::Float32Array>()->Length() == VertCount &&
+                         resultVerts.As<v8::Object>()->Get(VertCount - 1)->NumberValue() == (VertCount - 1) * 0.5);
+            
+            v8::Local<v8::Array> resultList = result->Get(v8::String::NewFromUtf8(isolate, "list")).As<v8::Array>();
+            this->Assert("Arrays round trip", resultList->Length() == 4 &&
+                         resultList->Get(0)->Int32Value() == 1 && resultList->Get(1)->NumberValue() == 2.5 &&
+                         std::string(*v8::String::Utf8Value(resultList->Get(2))) == "three" && resultList->Get(3)->IsNull());
+            
+            v8::Local<v8::Value> resultCopy = result->Get(v8::String::NewFromUtf8(isolate, "copy"));
+            this->Assert("Views keep their offset", resultCopy->IsUint8Array() && resultCopy.As<v8::Uint8Array>()->ByteOffset() == 4);
+            
+            // the received buffer is owned by the engine so it can move again without a copy
+            transfer->Set(0, resultVerts.As<v8::Float32Array>()->Buffer());
+            message = WorkerMessage::Serialize(isolate, resultVerts, transfer, error);
+            this->Assert("Received buffers can be transferred again", message != NULL && message->GetTransferredBytes() == VertCount * sizeof(float));
+            delete message;
+            
+            message = WorkerMessage::Serialize(isolate, v8::Function::New(isolate, NULL), v8::Undefined(isolate), error);
+            this->Assert("Functions can't be posted", message == NULL && error.length() > 0);
+        }
+        
+    private:
+        static const int VertCount = 4096;
+    };
     
-    void LoadScriptingTests() {
+    class ScriptingComputePoolTest : public Test {
+    public:
+        std::string GetName() override { return "ScriptingComputePoolTest"; }
         
+        void Run() override {
+            if (ComputePool::GetIsolateCount() == 0) {
+                Logger::begin("ScriptingComputePoolTest", Logger::LogLevel_Log) << "Skipped: no compute isolates" << Logger::end();
+                return;
+            }
+            
+            std::vector<float> input(ItemCount), output(ItemCount * 2, -1.0f);
+            for (int i = 0; i < ItemCount; i++) {
+                input[i] = (float) i;
+            }
+            
+            ComputePool::ComputeRequest map;
+            map.Source = "function (input, output, begin, args) {"
+                         "    for (var i = 0; i < input.length; i++) { output[i * 2] = input[i] * args.scale; output[i * 2 + 1] = begin + i; }"
+                         "}";
+            map.Input = input.data();
+            map.Output = output.data();
+            map.Items = ItemCount;
+            map.OutputComponents = 2;
+            
+            v8::Isolate* isolate = v8::Isolate::GetCurrent();
+            {
+                v8::HandleScope scope(isolate);
+                v8::Local<v8::Object> args = v8::Object::New(isolate);
+                args->Set(v8::String::NewFromUtf8(isolate, "scale"), v8::Number::New(isolate, 2.0));
+                
+                std::string error;
+                for (size_t i = 0; i < ComputePool::GetChunkCount(map.Items, map.ChunkItems); i++) {
+                    map.Args.push_back(WorkerMessage::Serialize(isolate, args, v8::Undefined(isolate), error));
+                }
+            }
+            
+            double startTime = Platform::GetTime();
+            ComputePool::ComputeResult result = this->_run(map);
+            double mapTime = Platform::GetTime() - startTime;
+            
+            this->Assert("Map succeeds", !result.Failed && result.Output.size() == output.size());
+            
+            bool matches = result.Output.size() == output.size();
+            for (int i = 0; matches && i < ItemCount; i++) {
+                matches = result.Output[i * 2] == i * 2.0f && result.Output[i * 2 + 1] == (float) i;
+            }
+            this->Assert("Every chunk writes its part of the output", matches);
+            this->Assert("The caller's output is only read by Submit", output[0] == -1.0f);
+            
+            ComputePool::ComputeRequest reduce;
+            reduce.Type = ComputePool::ComputeTaskType::Reduce;
+            reduce.Source = "function (input) { var sum = 0; for (var i = 0; i < input.length; i++) sum += input[i]; return sum; }";
+            reduce.Input = input.data();
+            reduce.Items = ItemCount;
+            reduce.ChunkItems = 1000;
+            
+            // Submit copies the input so clearing it straight after can't change the result
+            result = this->_run(reduce, [&]() { std::fill(input.begin(), input.end(), 0.0f); });
+            
+            double sum = 0.0;
+            for (auto iter = result.Values.begin(); iter != result.Values.end(); iter++) {
+                sum += *iter;
+            }
+            this->Assert("Reduce returns a value per chunk", !result.Failed && result.Values.size() == (ItemCount + 999) / 1000);
+            this->Assert("Reduce values add up", sum == (double) ItemCount * (ItemCount - 1) / 2);
+            
+            ComputePool::ComputeRequest forever;
+            forever.Type = ComputePool::ComputeTaskType::Reduce;
+            forever.Source = "function () { while (true) {} }";
+            forever.Input = input.data();
+            forever.Items = ItemCount;
+            forever.Deadline = Platform::GetTime() + 0.05;
+            
+            result = this->_run(forever);
+            this->Assert("Running chunks are stopped at the deadline", result.Failed && result.Error == "Deadline exceeded");
+            
+            // the isolates are reused after being terminated
+            result = this->_run(reduce);
+            this->Assert("Isolates recover from termination", !result.Failed);
+            
+            Logger::begin("ScriptingComputePoolTest", Logger::LogLevel_Log) << "parallelMap x " << ItemCount << " on "
+                << ComputePool::GetIsolateCount() << " isolates: " << mapTime << "s" << Logger::end();
+        }
+        
+    private:
+        static const int ItemCount = 1000000;
+        
+        ComputePool::ComputeResult _run(ComputePool::ComputeRequest& request, std::function<void()> afterSubmit = nullptr) {
+            bool done = false;
+            ComputePool::ComputeResult result;
+            
+            request.OnComplete = [&](ComputePool::ComputeResult& r) {
+                result = r;
+                done = true;
+            };
+            
+            int taskID = ComputePool::Submit(request);
+            
+            if (afterSubmit) {
+                afterSubmit();
+            }
+            
+            double timeout = Platform::GetTime() + 10.0;
+            while (!done) {
+                WorkerThreadPool::PollMainThread();
+                ComputePool::CheckDeadlines();
+                if (Platform::GetTime() > timeout) {
+                    ComputePool::Cancel(taskID, "Timed out");
+                }
+                Platform::NanoSleep(100000);
+            }
+            
+            return result;
+        }
+    };
+    
+    void LoadScriptingTests() {
+        TestSuite::RegisterTest(new ScriptingWorkerMessageTest());
+        TestSuite::RegisterTest(new ScriptingComputePoolTest());
     }
 }
\ No newline at end of file
@@ -32,6 +32,9 @@
 #include "Platform.hpp"
 
 #include "Application.hpp"
+#include "CameraBlock.hpp"
+
+#include <cstring>
 
 namespace Engine {
     #define EFFECT_SHADER_TYPE(str,enum) if (type == str) return enum;
@@ -103,6 +106,8 @@ namespace Engine {
         this->_shaderSettings.vertexParam = vertexBufferParams["vertex"].asString();
         this->_shaderSettings.colorParam = vertexBufferParams["color"].asString();
         this->_shaderSettings.texCoardParam = vertexBufferParams["texCoard"].asString();
+        this->_shaderSettings.normalParam = vertexBufferParams.get("normal", "").asString(); // optional
+        this->_shaderSettings.vertexLayout = root.get("vertexLayout", "full3D").asString() == "compact2D" ? VertexLayout::Compact2D : VertexLayout::Full3D;
         
         this->_shaderSettings.modelMatrixParam = cameraSettings["model"].asString();
         this->_shaderSettings.viewMatrixParam = cameraSettings["view"].asString();
@@ -172,6 +177,8 @@ namespace Engine {
         if (this->NeedsUpdate()) {
             ENGINE_PROFILER_SCOPE;
             
+            RenderDebugGroup debugGroup(this->_render, "Shader::Update");
+            
             this->_render->CheckError("Shader::Update::Pre");
             
             if (glIsShader(this->_vertPointer)) {
@@ -219,39 +226,121 @@ namespace Engine {
         return this->_programPointer != 0 && this->_loaded && glIsProgram(this->_programPointer);
     }
     
-    void Shader::BindUniform(std::string token) {
+    UniformHandle Shader::BindUniform(std::string token) {
+        auto iter = this->_uniformHandles.find(token);
+        if (iter != this->_uniformHandles.end()) {
+            return iter->second;
+        }
+        
+        UniformHandle handle = (UniformHandle) this->_uniformSlots.size();
+        this->_uniformSlots.push_back(UniformSlot());
+        this->_uniformSlots[handle].Name = token;
+        this->_uniformHandles[token] = handle;
+        
         if (this->checkProgramPointer()) {
-            this->Begin();
-            this->_uniforms[token] = glGetUniformLocation(this->_programPointer, token.c_str());
-            this->End();
+            this->_uniformSlots[handle].Location = glGetUniformLocation(this->_programPointer, token.c_str());
         }
+        
+        return handle;
     }
     
-    void Shader::UploadUniform(std::string token, float x, float y) {
-        if (this->checkProgramPointer()) {
-            ENGINE_PROFILER_SCOPE;
-            glUniform2f(this->_uniforms[token], x, y);
+    // Called after every link, the locations can move and the new program starts with no values
+    void Shader::_resolveUniforms() {
+        for (auto iter = this->_uniformSlots.begin(); iter != this->_uniformSlots.end(); iter++) {
+            iter->Location = glGetUniformLocation(this->_programPointer, iter->Name.c_str());
+            iter->HasValue = false;
+        }
+        
+        this->_usesCameraBlock = false;
+        if (glGetUniformBlockIndex != NULL) {
+            GLuint blockIndex = glGetUniformBlockIndex(this->_programPointer, CameraBlock::BlockName);
+            if (blockIndex != GL_INVALID_INDEX) {
+                glUniformBlockBinding(this->_programPointer, blockIndex, CameraBlock::Binding);
+                this->_usesCameraBlock = true;
+            }
         }
     }
     
-    void Shader::UploadUniform(std::string token, glm::mat4 matrix) {
-        if (this->checkProgramPointer()) {
-            if (this->_matrix_uniform_cache.count(token) == 0 || this->_matrix_uniform_cache[token] != matrix) {
-                ENGINE_PROFILER_SCOPE;
-                glUniformMatrix4fv(this->_uniforms[token], 1, GL_FALSE, &matrix[0][0]);
-                this->_matrix_uniform_cache[token] = matrix;
-            }
+    // glIsProgram is left to Update, uploads happen every draw
+    bool Shader::_canUpload(UniformHandle handle) {
+        return this->_loaded && this->_programPointer != 0 &&
+            handle >= 0 && handle < (UniformHandle) this->_uniformSlots.size() && this->_uniformSlots[handle].Location != -1;
+    }
+    
+    void Shader::UploadUniform(UniformHandle handle, const glm::mat4& matrix) {
+        if (!this->_canUpload(handle)) {
+            return;
+        }
+        
+        UniformSlot& slot = this->_uniformSlots[handle];
+        
+        if (slot.HasValue && std::memcmp(slot.Value, &matrix[0][0], sizeof(float) * 16) == 0) {
+            return;
         }
+        
+        ENGINE_PROFILER_SCOPE;
+        
+        glUniformMatrix4fv(slot.Location, 1, GL_FALSE, &matrix[0][0]);
+        std::memcpy(slot.Value, &matrix[0][0], sizeof(float) * 16);
+        slot.HasValue = true;
+        
+        this->_render->TrackStat(RenderStatistic::UniformUpload, 1);
     }
     
-    void Shader::UploadUniform(std::string token, float* data, int verts) {
-        if (this->checkProgramPointer()) {
-            ENGINE_PROFILER_SCOPE;
-            glUniform2fv(this->_uniforms[token], verts, data);
+    void Shader::UploadUniform(UniformHandle handle, float x, float y) {
+        if (!this->_canUpload(handle)) {
+            return;
         }
+        
+        UniformSlot& slot = this->_uniformSlots[handle];
+        
+        if (slot.HasValue && slot.Value[0] == x && slot.Value[1] == y) {
+            return;
+        }
+        
+        ENGINE_PROFILER_SCOPE;
+        
+        glUniform2f(slot.Location, x, y);
+        slot.Value[0] = x;
+        slot.Value[1] = y;
+        slot.HasValue = true;
+        
+        this->_render->TrackStat(RenderStatistic::UniformUpload, 1);
+    }
+    
+    void Shader::UploadUniform(UniformHandle handle, float* data, int verts) {
+        if (!this->_canUpload(handle)) {
+            return;
+        }
+        
+        ENGINE_PROFILER_SCOPE;
+        
+        UniformSlot& slot = this->_uniformSlots[handle];
+        
+        // arrays aren't shadowed, anything cached for the first element is stale now
+        glUniform2fv(slot.Location, verts, data);
+        slot.HasValue = false;
+        
+        this->_render->TrackStat(RenderStatistic::UniformUpload, 1);
+    }
+    
+    void Shader::UploadUniform(std::string token, float x, float y) {
+        this->UploadUniform(this->BindUniform(token), x, y);
+    }
+    
+    void Shader::UploadUniform(std::string token, glm::mat4 matrix) {
+        this->UploadUniform(this->BindUniform(token), matrix);
+    }
+    
+    void Shader::UploadUniform(std::string token, float* data, int verts) {
+        this->UploadUniform(this->BindUniform(token), data, verts);
     }
     
     void Shader::BindVertexAttrib(std::string token, int attribSize, int totalSize, int stride) {
+        this->BindVertexAttrib(token, attribSize, GL_FLOAT, false, totalSize * sizeof(float), stride * sizeof(float));
+    }
+    
+    void Shader::BindVertexAttrib(std::string token, int attribSize, unsigned int type, bool normalized, size_t stride, size_t offset, unsigned int divisor) {
         if (!this->checkProgramPointer()) {
             return;
         }
@@ -266,15 +355,24 @@ namespace Engine {
         
         this->_render->CheckError("Shader::BindVertexAttrib::PostGetAttribLocation");
         
-        glVertexAttribPointer(attribPos, attribSize, GL_FLOAT, GL_FALSE,
-                              totalSize * sizeof(float),
-                              stride == 0 ? NULL : (void*)(stride * sizeof(float)));
+        glVertexAttribPointer(attribPos, attribSize, type, normalized ? GL_TRUE : GL_FALSE,
+                              (GLsizei) stride, offset == 0 ? NULL : (void*) offset);
         
         this->_render->CheckError("Shader::BindVertexAttrib::PostVertexAttribPointer");
         
         glEnableVertexAttribArray(attribPos);
         
         this->_render->CheckError("Shader::BindVertexAttrib::PostEnable");
+        
+        if (divisor != 0) {
+            if (glVertexAttribDivisor != NULL) {
+                glVertexAttribDivisor(attribPos, divisor);
+            } else {
+                glVertexAttribDivisorARB(attribPos, divisor);
+            }
+            
+            this->_render->CheckError("Shader::BindVertexAttrib::PostDivisor");
+        }
     }
     
     void Shader::SetMacro(std::string name, ShaderType exposure) {
@@ -381,6 +479,9 @@ namespace Engine {
         
         glLinkProgram(this->_programPointer);
         glUseProgram(this->_programPointer);
+        
+        this->_resolveUniforms();
+        
         return true;
     }
     
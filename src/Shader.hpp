@@ -47,8 +47,9 @@ namespace Engine {
     } ShaderSpec;
     
     typedef struct {
-        std::string vertexParam, colorParam, texCoardParam,
+        std::string vertexParam, colorParam, texCoardParam, normalParam,
         modelMatrixParam, viewMatrixParam, projectionMatrixParam;
+        VertexLayout vertexLayout; // the default for buffers using this effect
     } ShaderSettings;
     
     ENGINE_CLASS(EffectParameters);
@@ -78,6 +79,11 @@ namespace Engine {
         EffectParametersPtr GetEffectFromFile(std::string filename);
     }
     
+    // Index into a Shader's uniform table, it stays valid when the program is reloaded
+    typedef int UniformHandle;
+    
+    static const UniformHandle InvalidUniform = -1;
+    
     class Shader {
     public:
         Shader();
@@ -96,12 +102,28 @@ namespace Engine {
         bool Update();
         bool NeedsUpdate();
         
-        void BindUniform(std::string token);
+        // Resolve the location once and keep the handle, uploading by name has to look it up each call
+        UniformHandle BindUniform(std::string token);
+        
+        // Uploads that match the last value sent for the handle are skipped
+        void UploadUniform(UniformHandle handle, const glm::mat4& matrix);
+        void UploadUniform(UniformHandle handle, float x, float y);
+        void UploadUniform(UniformHandle handle, float* data, int verts);
+        
         void UploadUniform(std::string token, float* data, int verts);
         void UploadUniform(std::string token, glm::mat4 matrix);
         void UploadUniform(std::string token, float x, float y);
         
+        // True when the program declares the Camera uniform block, the view and projection
+        // matrices come from RenderDriver::SetCameraBlock instead of uniforms then
+        bool UsesCameraBlock() {
+            return this->_usesCameraBlock;
+        }
+        
         void BindVertexAttrib(std::string token, int attribSize, int totalSize, int stride);
+        // stride and offset are in bytes, type is a GLenum such as GL_UNSIGNED_BYTE. A divisor of 1
+        // steps the attribute once per instance instead of once per vertex.
+        void BindVertexAttrib(std::string token, int attribSize, unsigned int type, bool normalized, size_t stride, size_t offset, unsigned int divisor = 0);
         
         bool IsLoaded() {
             return this->_loaded;
@@ -116,6 +138,9 @@ namespace Engine {
         
         bool checkProgramPointer();
         
+        void _resolveUniforms();
+        bool _canUpload(UniformHandle handle);
+        
         EffectShaderType _type;
         
         RenderDriverPtr _render;
@@ -123,8 +148,17 @@ namespace Engine {
         bool _loaded;
         
         std::vector<std::string> _vertexMacros, _fragMacros;
-        std::map<std::string, unsigned int> _uniforms;
-        std::unordered_map<std::string, glm::mat4> _matrix_uniform_cache;
+        struct UniformSlot {
+            std::string Name;
+            int Location = -1;
+            bool HasValue = false;
+            float Value[16]; // the last matrix or vec2 uploaded
+        };
+        
+        std::vector<UniformSlot> _uniformSlots;
+        std::unordered_map<std::string, UniformHandle> _uniformHandles;
+        
+        bool _usesCameraBlock = false;
         std::map<std::string, unsigned int> _attribs;
         
         unsigned int _programPointer, _vertPointer, _fragPointer;
@@ -0,0 +1,187 @@
+/*
+ Filename: SpriteRenderer.cpp
+ Purpose:  Draws many quads with one instanced draw call
+
+ Part of Engine2D
+
+ Copyright (C) 2014 Vbitz
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#define GLEW_STATIC
+#include "vendor/GL/glew.h"
+
+#include "SpriteRenderer.hpp"
+
+#include <cstddef>
+#include <algorithm>
+
+#include "Application.hpp"
+#include "Profiler.hpp"
+
+namespace Engine {
+    // Two triangles covering (0, 0) to (1, 1), the same winding Draw2D::DrawImage uses
+    static const float _unitQuad[12] = {
+        0.0f, 0.0f,
+        1.0f, 0.0f,
+        1.0f, 1.0f,
+        0.0f, 0.0f,
+        0.0f, 1.0f,
+        1.0f, 1.0f
+    };
+    
+    SpriteRenderer::SpriteRenderer(RenderDriverPtr render, EffectParametersPtr effect) : _render(render), _effect(effect) {
+        this->_render->CheckError("SpriteRenderer::SpriteRenderer::Pre");
+        
+        glGenVertexArrays(1, &this->_vertexArrayPointer);
+        glGenBuffers(1, &this->_quadBufferPointer);
+        glGenBuffers(1, &this->_instanceBufferPointer);
+        
+        glBindBuffer(GL_ARRAY_BUFFER, this->_quadBufferPointer);
+        glBufferData(GL_ARRAY_BUFFER, sizeof(_unitQuad), _unitQuad, GL_STATIC_DRAW);
+        
+        this->_shader = this->_effect->CreateShader();
+        
+        // compiling leaves the program bound behind RenderDriver::SetShader's back
+        this->_shader->Begin();
+        
+        this->_render->CheckError("SpriteRenderer::SpriteRenderer::Post");
+    }
+    
+    SpriteRenderer::~SpriteRenderer() {
+        glDeleteBuffers(1, &this->_quadBufferPointer);
+        glDeleteBuffers(1, &this->_instanceBufferPointer);
+        glDeleteVertexArrays(1, &this->_vertexArrayPointer);
+        
+        delete this->_shader;
+    }
+    
+    bool SpriteRenderer::IsSupported(RenderDriverPtr render) {
+        OpenGLVersion version = render->GetOpenGLVersion();
+        
+        // the sprite effect only ships a glsl_150 shader
+        if (version.major < 3 || (version.major == 3 && version.minor < 2) || glDrawArraysInstanced == NULL) {
+            return false;
+        }
+        
+        if (version.major > 3 || version.minor >= 3) {
+            return glVertexAttribDivisor != NULL;
+        }
+        
+        return render->HasExtention("GL_ARB_instanced_arrays") && glVertexAttribDivisorARB != NULL;
+    }
+    
+    void SpriteRenderer::Draw(const SpriteInstance* sprites, size_t count, glm::mat4 model, glm::vec2 uvOffset, glm::vec2 uvScale) {
+        if (count == 0) {
+            return;
+        }
+        
+        RenderDebugGroup debugGroup(this->_render, "SpriteRenderer::Draw");
+        ENGINE_PROFILER_SCOPE;
+        
+        this->_render->TrackStat(RenderStatistic::DrawCall, 1);
+        this->_render->TrackStat(RenderStatistic::Verts, count * 6);
+        this->_render->TrackStat(RenderStatistic::Instances, count);
+        
+        if (this->_shader->Update()) {
+            this->_shaderBound = false; // locations can move when the program is relinked
+        }
+        
+        glBindVertexArray(this->_vertexArrayPointer);
+        
+        this->_upload(sprites, count);
+        
+        if (!this->_shaderBound) {
+            this->_bindShader();
+            this->_shaderBound = true;
+        }
+        
+        this->_shader->Begin();
+        
+        glm::mat4 projection = GetAppSingilton()->GetWindow()->GetOrthoProjection();
+        
+        this->_shader->UploadUniform(this->_modelUniform, model);
+        if (!this->_shader->UsesCameraBlock() || !this->_render->SetCameraBlock(glm::mat4(), projection)) {
+            this->_shader->UploadUniform(this->_viewUniform, glm::mat4());
+            this->_shader->UploadUniform(this->_projectionUniform, projection);
+        }
+        this->_shader->UploadUniform(this->_uvOffsetUniform, uvOffset.x, uvOffset.y);
+        this->_shader->UploadUniform(this->_uvScaleUniform, uvScale.x, uvScale.y);
+        
+        this->_render->CheckError("SpriteRenderer::Draw::PostUploadUniform");
+        
+        {
+            ENGINE_PROFILER_SCOPE_EX("glDrawArraysInstanced");
+            glDrawArraysInstanced(GL_TRIANGLES, 0, 6, (GLsizei) count);
+        }
+        
+        this->_render->CheckError("SpriteRenderer::Draw::PostDraw");
+        
+        this->_shader->End();
+        
+        // the vertex buffer binds its own array, leaving this bound would let later calls change it
+        glBindVertexArray(0);
+    }
+    
+    void SpriteRenderer::_upload(const SpriteInstance* sprites, size_t count) {
+        size_t size = sizeof(SpriteInstance) * count;
+        
+        glBindBuffer(GL_ARRAY_BUFFER, this->_instanceBufferPointer);
+        
+        if (size > this->_instanceCapacity) {
+            this->_instanceCapacity = std::max(size, this->_instanceCapacity * 2);
+            glBufferData(GL_ARRAY_BUFFER, this->_instanceCapacity, NULL, GL_STREAM_DRAW);
+            this->_render->TrackStat(RenderStatistic::BufferAlloc, 1);
+        } else {
+            // Orphan the storage the last draw used so the driver never waits on it
+            glBufferData(GL_ARRAY_BUFFER, this->_instanceCapacity, NULL, GL_STREAM_DRAW);
+            this->_render->TrackStat(RenderStatistic::BufferOrphan, 1);
+        }
+        
+        glBufferSubData(GL_ARRAY_BUFFER, 0, size, sprites);
+        
+        this->_render->TrackStat(RenderStatistic::BufferUpload, size);
+        
+        this->_render->CheckError("SpriteRenderer::Upload::Post");
+    }
+    
+    void SpriteRenderer::_bindShader() {
+        ENGINE_PROFILER_SCOPE;
+        
+        this->_shader->Begin();
+        
+        ShaderSettings settings = this->_effect->GetShaderSettings();
+        
+        this->_modelUniform = this->_shader->BindUniform(settings.modelMatrixParam);
+        this->_viewUniform = this->_shader->BindUniform(settings.viewMatrixParam);
+        this->_projectionUniform = this->_shader->BindUniform(settings.projectionMatrixParam);
+        this->_uvOffsetUniform = this->_shader->BindUniform("uvOffset");
+        this->_uvScaleUniform = this->_shader->BindUniform("uvScale");
+        
+        glBindBuffer(GL_ARRAY_BUFFER, this->_quadBufferPointer);
+        this->_shader->BindVertexAttrib(settings.vertexParam, 2, 2, 0);
+        
+        // the instance buffer is respecified every draw but the buffer object stays the same
+        size_t stride = sizeof(SpriteInstance);
+        glBindBuffer(GL_ARRAY_BUFFER, this->_instanceBufferPointer);
+        this->_shader->BindVertexAttrib("spriteRect", 4, GL_FLOAT, false, stride, offsetof(SpriteInstance, rect), 1);
+        this->_shader->BindVertexAttrib(settings.texCoardParam, 4, GL_FLOAT, false, stride, offsetof(SpriteInstance, uv), 1);
+        this->_shader->BindVertexAttrib(settings.colorParam, 4, GL_UNSIGNED_BYTE, true, stride, offsetof(SpriteInstance, col), 1);
+        this->_shader->BindVertexAttrib("spriteRotation", 1, GL_FLOAT, false, stride, offsetof(SpriteInstance, rotation), 1);
+        
+        this->_render->CheckError("SpriteRenderer::BindShader::Post");
+        
+        this->_shader->End();
+    }
+}
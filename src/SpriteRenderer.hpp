@@ -0,0 +1,68 @@
+/*
+ Filename: SpriteRenderer.hpp
+ Purpose:  Draws many quads with one instanced draw call
+
+ Part of Engine2D
+
+ Copyright (C) 2014 Vbitz
+
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+
+ http://www.apache.org/licenses/LICENSE-2.0
+
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include "RenderDriver.hpp"
+#include "Shader.hpp"
+
+#define GLM_FORCE_RADIANS
+#include "vendor/glm/glm.hpp"
+
+namespace Engine {
+    ENGINE_CLASS(SpriteRenderer);
+    
+    // A static unit quad is drawn once per SpriteInstance, the vertex shader in
+    // core.render.spriteEffect places, rotates and colors each copy.
+    class SpriteRenderer {
+    public:
+        SpriteRenderer(RenderDriverPtr render, EffectParametersPtr effect);
+        ~SpriteRenderer();
+        
+        // The sprite shader needs OpenGL 3.2, attribute divisors need 3.3 or GL_ARB_instanced_arrays
+        static bool IsSupported(RenderDriverPtr render);
+        
+        // The texture is already bound, uvOffset and uvScale place the sprite UVs inside an atlas page
+        void Draw(const SpriteInstance* sprites, size_t count, glm::mat4 model, glm::vec2 uvOffset, glm::vec2 uvScale);
+    
+    private:
+        void _bindShader();
+        void _upload(const SpriteInstance* sprites, size_t count);
+        
+        RenderDriverPtr _render;
+        EffectParametersPtr _effect;
+        ShaderPtr _shader = NULL;
+        
+        unsigned int _vertexArrayPointer = 0;
+        unsigned int _quadBufferPointer = 0;
+        unsigned int _instanceBufferPointer = 0;
+        
+        size_t _instanceCapacity = 0; // in bytes
+        
+        bool _shaderBound = false;
+        
+        UniformHandle _modelUniform = InvalidUniform;
+        UniformHandle _viewUniform = InvalidUniform;
+        UniformHandle _projectionUniform = InvalidUniform;
+        UniformHandle _uvOffsetUniform = InvalidUniform;
+        UniformHandle _uvScaleUniform = InvalidUniform;
+    };
+}
@@ -0,0 +1,321 @@
+/*
+ Filename: Tessellator.cpp
+ Purpose:  Turns circles, polygons and curves into indexed triangle and line lists
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "Tessellator.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "Profiler.hpp"
+
+namespace Engine {
+    static const double pi = 3.14159265358979323846;
+    
+    // > 0 when a, b, c turn counter clockwise
+    static inline float _cross(const glm::vec2& a, const glm::vec2& b, const glm::vec2& c) {
+        return (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+    }
+    
+    void Tessellator::Clear() {
+        this->_points.clear();
+        this->_indices.clear();
+    }
+    
+    const std::vector<glm::vec2>& Tessellator::GetUnitCircle(int segments) {
+        static std::unordered_map<int, std::vector<glm::vec2>> tables;
+        
+        std::vector<glm::vec2>& table = tables[segments];
+        
+        if (table.empty()) {
+            table.reserve(segments + 1);
+            for (int i = 0; i < segments; i++) {
+                double angle = (2 * pi * i) / segments;
+                table.push_back(glm::vec2((float) std::cos(angle), (float) std::sin(angle)));
+            }
+            table.push_back(table[0]);
+        }
+        
+        return table;
+    }
+    
+    int Tessellator::GetCircleSegments(float radius, float scale) {
+        double pixelRadius = std::abs(radius * scale);
+        
+        if (pixelRadius <= this->_maxError) {
+            return MinSegments;
+        }
+        
+        // the middle of each chord is radius * (1 - cos(step / 2)) from the circle
+        double halfStep = std::acos(1.0 - this->_maxError / pixelRadius);
+        int segments = (int) std::ceil(pi / halfStep);
+        
+        segments = (segments + 7) & ~7; // keeps the number of cached tables down
+        
+        return std::min(std::max(segments, (int) MinSegments), (int) MaxSegments);
+    }
+    
+    int Tessellator::GetBezierSegments(const glm::vec2& p0, const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& p3, float scale) {
+        // Wang's formula, bounds the distance from the curve using its second differences
+        float bend = std::max(glm::length(p0 - p1 * 2.0f + p2), glm::length(p1 - p2 * 2.0f + p3)) * std::abs(scale);
+        
+        int segments = (int) std::ceil(std::sqrt(0.75f * bend / this->_maxError));
+        
+        return std::min(std::max(segments, 1), (int) MaxSegments);
+    }
+    
+    size_t Tessellator::_addArc(glm::vec2 center, float radius, int segments, float start, float end, bool closed) {
+        const std::vector<glm::vec2>& unit = GetUnitCircle(segments);
+        
+        size_t first = this->_points.size();
+        
+        if (closed) {
+            for (int i = 0; i < segments; i++) {
+                this->_points.push_back(center + unit[i] * radius);
+            }
+            return segments;
+        }
+        
+        float firstStep = start * segments, lastStep = end * segments;
+        int step = (int) std::ceil(firstStep), lastWholeStep = (int) std::floor(lastStep);
+        
+        // ends between two steps get their own point so the arc covers exactly start to end
+        if ((float) step != firstStep) {
+            this->_points.push_back(center + glm::vec2(std::cos(start * 2 * pi), std::sin(start * 2 * pi)) * radius);
+        }
+        
+        for (; step <= lastWholeStep; step++) {
+            this->_points.push_back(center + unit[step] * radius);
+        }
+        
+        if ((float) lastWholeStep != lastStep) {
+            this->_points.push_back(center + glm::vec2(std::cos(end * 2 * pi), std::sin(end * 2 * pi)) * radius);
+        }
+        
+        return this->_points.size() - first;
+    }
+    
+    void Tessellator::Circle(glm::vec2 center, float radius, float innerRadius, int segments, float start, float end) {
+        ENGINE_PROFILER_SCOPE;
+        
+        if (segments <= 0) {
+            segments = this->GetCircleSegments(radius);
+        }
+        segments = std::min(std::max(segments, 3), (int) MaxSegments);
+        
+        start = glm::clamp(start, 0.0f, 1.0f);
+        end = glm::clamp(end, start, 1.0f);
+        
+        bool closed = start == 0.0f && end == 1.0f;
+        
+        if (innerRadius <= 0.0f) {
+            unsigned int middle = this->_points.size();
+            this->_points.push_back(center);
+            
+            unsigned int edge = this->_points.size();
+            size_t count = this->_addArc(center, radius, segments, start, end, closed);
+            
+            for (size_t i = 0; i + 1 < count; i++) {
+                this->_indices.push_back(middle);
+                this->_indices.push_back(edge + i);
+                this->_indices.push_back(edge + i + 1);
+            }
+            
+            if (closed) {
+                this->_indices.push_back(middle);
+                this->_indices.push_back(edge + count - 1);
+                this->_indices.push_back(edge);
+            }
+        } else {
+            unsigned int outer = this->_points.size();
+            size_t count = this->_addArc(center, radius, segments, start, end, closed);
+            unsigned int inner = this->_points.size();
+            this->_addArc(center, innerRadius, segments, start, end, closed);
+            
+            for (size_t i = 0; i < count; i++) {
+                if (i + 1 == count && !closed) break;
+                
+                size_t next = (i + 1) % count;
+                
+                this->_indices.push_back(outer + i);
+                this->_indices.push_back(outer + next);
+                this->_indices.push_back(inner + i);
+                
+                this->_indices.push_back(inner + i);
+                this->_indices.push_back(outer + next);
+                this->_indices.push_back(inner + next);
+            }
+        }
+    }
+    
+    void Tessellator::CircleOutline(glm::vec2 center, float radius, int segments, float start, float end) {
+        ENGINE_PROFILER_SCOPE;
+        
+        if (segments <= 0) {
+            segments = this->GetCircleSegments(radius);
+        }
+        segments = std::min(std::max(segments, 3), (int) MaxSegments);
+        
+        start = glm::clamp(start, 0.0f, 1.0f);
+        end = glm::clamp(end, start, 1.0f);
+        
+        bool closed = start == 0.0f && end == 1.0f;
+        
+        unsigned int edge = this->_points.size();
+        size_t count = this->_addArc(center, radius, segments, start, end, closed);
+        
+        for (size_t i = 0; i < count; i++) {
+            if (i + 1 == count && !closed) break;
+            
+            this->_indices.push_back(edge + i);
+            this->_indices.push_back(edge + (i + 1) % count);
+        }
+    }
+    
+    bool Tessellator::_isEar(size_t index) {
+        size_t count = this->_remaining.size();
+        
+        unsigned int prev = this->_remaining[(index + count - 1) % count];
+        unsigned int current = this->_remaining[index];
+        unsigned int next = this->_remaining[(index + 1) % count];
+        
+        const glm::vec2& a = this->_points[prev];
+        const glm::vec2& b = this->_points[current];
+        const glm::vec2& c = this->_points[next];
+        
+        if (_cross(a, b, c) < 0.0f) {
+            return false; // reflex, _remaining is always counter clockwise
+        }
+        
+        for (size_t i = 0; i < count; i++) {
+            unsigned int other = this->_remaining[i];
+            if (other == prev || other == current || other == next) continue;
+            
+            const glm::vec2& p = this->_points[other];
+            if (p == a || p == b || p == c) continue; // polygons that touch themselves share points
+            
+            if (_cross(a, b, p) >= 0.0f && _cross(b, c, p) >= 0.0f && _cross(c, a, p) >= 0.0f) {
+                return false;
+            }
+        }
+        
+        return true;
+    }
+    
+    bool Tessellator::Polygon(const glm::vec2* points, size_t count) {
+        ENGINE_PROFILER_SCOPE;
+        
+        unsigned int base = this->_points.size();
+        
+        for (size_t i = 0; i < count; i++) {
+            if (this->_points.size() > base && this->_points.back() == points[i]) continue;
+            this->_points.push_back(points[i]);
+        }
+        
+        while (this->_points.size() - base > 1 && this->_points.back() == this->_points[base]) {
+            this->_points.pop_back();
+        }
+        
+        size_t pointCount = this->_points.size() - base;
+        
+        float area = 0.0f;
+        for (size_t i = 0; i < pointCount; i++) {
+            const glm::vec2& a = this->_points[base + i];
+            const glm::vec2& b = this->_points[base + (i + 1) % pointCount];
+            area += a.x * b.y - b.x * a.y;
+        }
+        
+        if (pointCount < 3 || area == 0.0f) {
+            this->_points.resize(base);
+            return false;
+        }
+        
+        this->_remaining.clear();
+        for (size_t i = 0; i < pointCount; i++) {
+            this->_remaining.push_back(base + (area > 0.0f ? i : pointCount - 1 - i));
+        }
+        
+        size_t index = 0, misses = 0;
+        
+        while (this->_remaining.size() > 3) {
+            size_t remaining = this->_remaining.size();
+            
+            index %= remaining;
+            
+            if (this->_isEar(index)) {
+                this->_indices.push_back(this->_remaining[(index + remaining - 1) % remaining]);
+                this->_indices.push_back(this->_remaining[index]);
+                this->_indices.push_back(this->_remaining[(index + 1) % remaining]);
+                
+                this->_remaining.erase(this->_remaining.begin() + index);
+                
+                // clipping can turn the previous vertex into an ear
+                index = index > 0 ? index - 1 : 0;
+                misses = 0;
+            } else if (++misses >= remaining) {
+                // only self intersecting polygons run out of ears, fan whatever is left
+                for (size_t i = 1; i + 1 < remaining; i++) {
+                    this->_indices.push_back(this->_remaining[0]);
+                    this->_indices.push_back(this->_remaining[i]);
+                    this->_indices.push_back(this->_remaining[i + 1]);
+                }
+                this->_remaining.clear();
+            } else {
+                index++;
+            }
+        }
+        
+        if (this->_remaining.size() == 3) {
+            this->_indices.insert(this->_indices.end(), this->_remaining.begin(), this->_remaining.end());
+        }
+        
+        return true;
+    }
+    
+    // from http://devmag.org.za/2011/04/05/bzier-curves-a-tutorial/
+    inline glm::vec2 _calculateBezierPoint(float t, const glm::vec2 &p0, const glm::vec2 &p1, const glm::vec2 &p2, const glm::vec2 &p3) {
+        const float u = 1.0f - t;
+        
+        return ((u * u * u) * p0) +        //first term
+                (3 * (u * u) * t * p1) +   //second term
+                (3 * u * (t * t) * p2) +   //third term
+                ((t * t * t) * p3);        //fourth term
+    }
+    
+    void Tessellator::BezierCurve(const glm::vec2& p0, const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& p3, int segments) {
+        ENGINE_PROFILER_SCOPE;
+        
+        if (segments <= 0) {
+            segments = this->GetBezierSegments(p0, p1, p2, p3);
+        }
+        
+        unsigned int first = this->_points.size();
+        
+        for (int i = 0; i <= segments; i++) {
+            this->_points.push_back(_calculateBezierPoint((1 / (float) segments) * i, p0, p1, p2, p3));
+        }
+        
+        for (int i = 0; i < segments; i++) {
+            this->_indices.push_back(first + i);
+            this->_indices.push_back(first + i + 1);
+        }
+    }
+}
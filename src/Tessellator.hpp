@@ -0,0 +1,93 @@
+/*
+ Filename: Tessellator.hpp
+ Purpose:  Turns circles, polygons and curves into indexed triangle and line lists
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include "vendor/glm/glm.hpp"
+
+#include "stdlib.hpp"
+
+namespace Engine {
+    ENGINE_CLASS(Tessellator);
+    
+    // Output is always a plain triangle list or line list so shapes can be appended to any other
+    // Triangles or Lines primitive without a flush. Has no GL dependencys so it can be tested on it's own.
+    class Tessellator {
+    public:
+        static const int MinSegments = 8;
+        static const int MaxSegments = 1024;
+        
+        // The furthest in pixels a curve can be from the segments drawn for it
+        void SetMaxError(float error) {
+            this->_maxError = error > 0.001f ? error : 0.001f;
+        }
+        
+        float GetMaxError() {
+            return this->_maxError;
+        }
+        
+        void Clear();
+        
+        // Filled circles, pies and rings. start and end are fractions of a turn, an innerRadius of 0 fills to the center
+        void Circle(glm::vec2 center, float radius, float innerRadius, int segments, float start, float end);
+        
+        // Line pairs around the edge, closed when the arc covers a whole turn
+        void CircleOutline(glm::vec2 center, float radius, int segments, float start, float end);
+        
+        // Ear clipping so concave polygons work in either winding. Repeated points are ignored,
+        // returns false if there is nothing with an area left to draw.
+        bool Polygon(const glm::vec2* points, size_t count);
+        
+        // Line pairs
+        void BezierCurve(const glm::vec2& p0, const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& p3, int segments);
+        
+        // Segment counts that keep the shape within the max error. scale is how many pixels one unit covers.
+        int GetCircleSegments(float radius, float scale = 1.0f);
+        int GetBezierSegments(const glm::vec2& p0, const glm::vec2& p1, const glm::vec2& p2, const glm::vec2& p3, float scale = 1.0f);
+        
+        // Cached (cos, sin) for every step of a turn. Has segments + 1 entries so the last closes the circle.
+        // Not thread safe, only used by the render thread.
+        static const std::vector<glm::vec2>& GetUnitCircle(int segments);
+        
+        std::vector<glm::vec2>& GetPoints() {
+            return this->_points;
+        }
+        
+        std::vector<unsigned int>& GetIndices() {
+            return this->_indices;
+        }
+        
+    private:
+        size_t _addArc(glm::vec2 center, float radius, int segments, float start, float end, bool closed);
+        
+        bool _isEar(size_t index);
+        
+        float _maxError = 0.25f;
+        
+        std::vector<glm::vec2> _points;
+        std::vector<unsigned int> _indices;
+        
+        std::vector<unsigned int> _remaining; // polygon vertexes not clipped yet
+    };
+}
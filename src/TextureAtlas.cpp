@@ -0,0 +1,387 @@
+/*
+ Filename: TextureAtlas.cpp
+ Purpose:  Packs small images into shared texture pages
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#define GLEW_STATIC
+#include "vendor/GL/glew.h"
+
+#include "TextureAtlas.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "TextureLoader.hpp"
+#include "Application.hpp"
+#include "Config.hpp"
+#include "Logger.hpp"
+#include "Profiler.hpp"
+
+namespace Engine {
+    
+    // SkylinePacker
+    
+    SkylinePacker::SkylinePacker(int width, int height) : _width(width), _height(height) {
+        this->Reset();
+    }
+    
+    void SkylinePacker::Reset() {
+        this->_skyline.clear();
+        SkylineNode node = {0, 0, this->_width};
+        this->_skyline.push_back(node);
+        this->_usedArea = 0;
+    }
+    
+    bool SkylinePacker::Insert(int w, int h, AtlasRect& out) {
+        int bestY = std::numeric_limits<int>::max();
+        int bestWidth = std::numeric_limits<int>::max();
+        size_t bestIndex = this->_skyline.size();
+        
+        for (size_t i = 0; i < this->_skyline.size(); i++) {
+            int y = this->_fit(i, w, h);
+            if (y < 0) continue;
+            // lowest top edge wins, the narrower level breaks ties
+            if (y + h < bestY || (y + h == bestY && this->_skyline[i].w < bestWidth)) {
+                bestY = y + h;
+                bestWidth = this->_skyline[i].w;
+                bestIndex = i;
+                out.x = this->_skyline[i].x;
+                out.y = y;
+            }
+        }
+        
+        if (bestIndex == this->_skyline.size()) {
+            return false;
+        }
+        
+        out.w = w;
+        out.h = h;
+        
+        this->_addLevel(bestIndex, out);
+        this->_usedArea += (long) w * h;
+        
+        return true;
+    }
+    
+    int SkylinePacker::_fit(size_t index, int w, int h) {
+        int x = this->_skyline[index].x;
+        if (x + w > this->_width) {
+            return -1;
+        }
+        
+        int widthLeft = w;
+        int y = this->_skyline[index].y;
+        
+        while (widthLeft > 0) {
+            if (index >= this->_skyline.size()) {
+                return -1;
+            }
+            y = std::max(y, this->_skyline[index].y);
+            if (y + h > this->_height) {
+                return -1;
+            }
+            widthLeft -= this->_skyline[index].w;
+            index++;
+        }
+        
+        return y;
+    }
+    
+    void SkylinePacker::_addLevel(size_t index, const AtlasRect& rect) {
+        SkylineNode newNode = {rect.x, rect.y + rect.h, rect.w};
+        this->_skyline.insert(this->_skyline.begin() + index, newNode);
+        
+        // Shrink or remove the levels now covered by the new one
+        for (size_t i = index + 1; i < this->_skyline.size(); i++) {
+            SkylineNode& prev = this->_skyline[i - 1];
+            SkylineNode& node = this->_skyline[i];
+            
+            if (node.x >= prev.x + prev.w) {
+                break;
+            }
+            
+            int shrink = prev.x + prev.w - node.x;
+            node.x += shrink;
+            node.w -= shrink;
+            
+            if (node.w > 0) {
+                break;
+            }
+            
+            this->_skyline.erase(this->_skyline.begin() + i);
+            i--;
+        }
+        
+        // Merge neighbouring levels at the same height
+        for (size_t i = 0; i + 1 < this->_skyline.size(); i++) {
+            if (this->_skyline[i].y == this->_skyline[i + 1].y) {
+                this->_skyline[i].w += this->_skyline[i + 1].w;
+                this->_skyline.erase(this->_skyline.begin() + i + 1);
+                i--;
+            }
+        }
+    }
+    
+    // TextureAtlas
+    
+    TextureAtlas::TextureAtlas(int pageSize, int padding) : _pageSize(pageSize), _padding(padding) {
+        
+    }
+    
+    TextureAtlas::~TextureAtlas() {
+        for (auto iter = this->_pages.begin(); iter != this->_pages.end(); iter++) {
+            Page* page = *iter;
+            for (auto entry = page->entries.begin(); entry != page->entries.end(); entry++) {
+                (*entry)->_atlasPage = NULL;
+                (*entry)->_atlas = NULL;
+            }
+            delete page->texture;
+            delete page;
+        }
+    }
+    
+    TexturePtr TextureAtlas::Add(unsigned char* pixels, int width, int height) {
+        ENGINE_PROFILER_SCOPE;
+        
+        int paddedWidth = width + this->_padding * 2;
+        int paddedHeight = height + this->_padding * 2;
+        
+        if (paddedWidth > this->_pageSize || paddedHeight > this->_pageSize) {
+            return NULL;
+        }
+        
+        TexturePtr tex = new Texture();
+        tex->_uuid = Platform::GenerateUUID();
+        tex->_render = GetAppSingilton()->GetRender();
+        
+        for (auto iter = this->_pages.begin(); iter != this->_pages.end(); iter++) {
+            if (this->_place(*iter, tex, pixels, width, height)) {
+                return tex;
+            }
+        }
+        
+        // Reclaim space left by removed images before adding another page
+        long paddedArea = (long) paddedWidth * paddedHeight;
+        for (auto iter = this->_pages.begin(); iter != this->_pages.end(); iter++) {
+            Page* page = *iter;
+            if (page->packer.GetUsedArea() - page->liveArea >= paddedArea) {
+                this->_repackPage(page);
+                if (this->_place(page, tex, pixels, width, height)) {
+                    return tex;
+                }
+            }
+        }
+        
+        if (this->_place(this->_createPage(), tex, pixels, width, height)) {
+            return tex;
+        }
+        
+        delete tex;
+        return NULL;
+    }
+    
+    void TextureAtlas::Remove(TexturePtr tex) {
+        tex->_render->ReleaseTexture(tex);
+        
+        for (auto iter = this->_pages.begin(); iter != this->_pages.end(); iter++) {
+            Page* page = *iter;
+            
+            if (page->texture != tex->_atlasPage) continue;
+            
+            auto entry = std::find(page->entries.begin(), page->entries.end(), tex);
+            if (entry != page->entries.end()) {
+                page->entries.erase(entry);
+                page->liveArea -= (long) (tex->_atlasRect.w + this->_padding * 2) * (tex->_atlasRect.h + this->_padding * 2);
+            }
+            
+            tex->_atlasPage = NULL;
+            tex->_atlas = NULL;
+            
+            // Evict the page once nothing is drawing from it
+            if (page->entries.empty()) {
+                Logger::begin("TextureAtlas", Logger::LogLevel_Verbose) << "Freeing empty atlas page" << Logger::end();
+                page->texture->_render->ReleaseTexture(page->texture);
+                delete page->texture;
+                delete page;
+                this->_pages.erase(iter);
+            }
+            
+            return;
+        }
+    }
+    
+    void TextureAtlas::Repack() {
+        ENGINE_PROFILER_SCOPE;
+        
+        for (auto iter = this->_pages.begin(); iter != this->_pages.end(); iter++) {
+            this->_repackPage(*iter);
+        }
+    }
+    
+    bool TextureAtlas::_place(Page* page, TexturePtr tex, unsigned char* pixels, int width, int height) {
+        AtlasRect rect;
+        
+        if (!page->packer.Insert(width + this->_padding * 2, height + this->_padding * 2, rect)) {
+            return false;
+        }
+        
+        tex->_atlasRect.x = rect.x + this->_padding;
+        tex->_atlasRect.y = rect.y + this->_padding;
+        tex->_atlasRect.w = width;
+        tex->_atlasRect.h = height;
+        tex->_width = width;
+        tex->_height = height;
+        tex->_atlasPage = page->texture;
+        tex->_atlas = this;
+        
+        RenderDebugGroup debugGroup(tex->_render, "TextureAtlas::Place");
+        
+        glBindTexture(GL_TEXTURE_2D, page->texture->_textureID);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, tex->_atlasRect.x, tex->_atlasRect.y, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        
+        tex->_render->CheckError("TextureAtlas::Place::PostUpload");
+        
+        this->_updateUV(page, tex);
+        
+        page->entries.push_back(tex);
+        page->liveArea += (long) rect.w * rect.h;
+        
+        return true;
+    }
+    
+    void TextureAtlas::_repackPage(Page* page) {
+        ENGINE_PROFILER_SCOPE;
+        
+        std::vector<TexturePtr> entries = page->entries;
+        
+        // Taller images first gives the skyline a flatter top
+        std::stable_sort(entries.begin(), entries.end(), [](TexturePtr a, TexturePtr b) {
+            return a->_atlasRect.h > b->_atlasRect.h;
+        });
+        
+        SkylinePacker packer(this->_pageSize, this->_pageSize);
+        std::vector<AtlasRect> newRects;
+        
+        for (auto iter = entries.begin(); iter != entries.end(); iter++) {
+            AtlasRect rect;
+            if (!packer.Insert((*iter)->_atlasRect.w + this->_padding * 2, (*iter)->_atlasRect.h + this->_padding * 2, rect)) {
+                Logger::begin("TextureAtlas", Logger::LogLevel_Verbose) << "Repacking failed, keeping the old layout" << Logger::end();
+                return;
+            }
+            rect.x += this->_padding;
+            rect.y += this->_padding;
+            rect.w = (*iter)->_atlasRect.w;
+            rect.h = (*iter)->_atlasRect.h;
+            newRects.push_back(rect);
+        }
+        
+        // Vertexes recorded this frame still carry the old UVs, draw them before anything moves
+        page->texture->_render->FlushAll();
+        
+        size_t pageBytes = (size_t) this->_pageSize * this->_pageSize * 4;
+        std::vector<unsigned char> oldPixels(pageBytes);
+        std::vector<unsigned char> newPixels(pageBytes, 0);
+        
+        glBindTexture(GL_TEXTURE_2D, page->texture->_textureID);
+        glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, &oldPixels[0]);
+        
+        for (size_t i = 0; i < entries.size(); i++) {
+            TexturePtr tex = entries[i];
+            AtlasRect& oldRect = tex->_atlasRect;
+            AtlasRect& newRect = newRects[i];
+            
+            for (int y = 0; y < oldRect.h; y++) {
+                std::memcpy(&newPixels[((newRect.y + y) * this->_pageSize + newRect.x) * 4],
+                            &oldPixels[((oldRect.y + y) * this->_pageSize + oldRect.x) * 4],
+                            oldRect.w * 4);
+            }
+            
+            tex->_atlasRect = newRect;
+            this->_updateUV(page, tex);
+        }
+        
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->_pageSize, this->_pageSize, GL_RGBA, GL_UNSIGNED_BYTE, &newPixels[0]);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        
+        page->packer = packer;
+        
+        page->texture->_render->CheckError("TextureAtlas::RepackPage::Post");
+    }
+    
+    void TextureAtlas::_updateUV(Page* page, TexturePtr tex) {
+        float size = (float) this->_pageSize;
+        tex->_atlasUV = glm::vec4(tex->_atlasRect.x / size, tex->_atlasRect.y / size,
+                                  (tex->_atlasRect.x + tex->_atlasRect.w) / size,
+                                  (tex->_atlasRect.y + tex->_atlasRect.h) / size);
+    }
+    
+    TextureAtlas::Page* TextureAtlas::_createPage() {
+        ENGINE_PROFILER_SCOPE;
+        
+        RenderDriverPtr render = GetAppSingilton()->GetRender();
+        
+        RenderDebugGroup debugGroup(render, "TextureAtlas::CreatePage");
+        
+        render->CheckError("TextureAtlas::CreatePage::Pre");
+        
+        Logger::begin("TextureAtlas", Logger::LogLevel_Verbose) << "Creating " << this->_pageSize << "x" << this->_pageSize
+            << " atlas page" << Logger::end();
+        
+        GLuint text = 0;
+        glGenTextures(1, &text);
+        
+        glBindTexture(GL_TEXTURE_2D, text);
+        
+        // No mipmaps, the lower levels would bleed neighbouring images together
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        
+        std::vector<unsigned char> blank((size_t) this->_pageSize * this->_pageSize * 4, 0);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, this->_pageSize, this->_pageSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, &blank[0]);
+        
+        glBindTexture(GL_TEXTURE_2D, 0);
+        
+        render->CheckError("TextureAtlas::CreatePage::Post");
+        
+        Page* page = new Page(this->_pageSize);
+        page->texture = new Texture(render, text);
+        
+        this->_pages.push_back(page);
+        
+        return page;
+    }
+    
+    TextureAtlasPtr GetTextureAtlasSingilton() {
+        static TextureAtlasPtr atlas = NULL;
+        if (atlas == NULL) {
+            int pageSize = Config::GetInt("core.render.atlas.pageSize");
+            if (Config::GetBoolean("core.render.compactVertexes") && pageSize > TextureAtlas::MaxCompactPageSize) {
+                Logger::begin("TextureAtlas", Logger::LogLevel_Warning) << "core.render.atlas.pageSize is clamped to "
+                    << TextureAtlas::MaxCompactPageSize << " while core.render.compactVertexes is enabled" << Logger::end();
+                pageSize = TextureAtlas::MaxCompactPageSize;
+            }
+            atlas = new TextureAtlas(pageSize, Config::GetInt("core.render.atlas.padding"));
+        }
+        return atlas;
+    }
+}
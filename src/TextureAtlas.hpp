@@ -0,0 +1,110 @@
+/*
+ Filename: TextureAtlas.hpp
+ Purpose:  Packs small images into shared texture pages
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include <vector>
+
+#include "stdlib.hpp"
+
+namespace Engine {
+    ENGINE_CLASS(Texture);
+    
+    struct AtlasRect {
+        int x, y, w, h;
+    };
+    
+    ENGINE_CLASS(SkylinePacker);
+    
+    // Bottom-left skyline packer, has no GL dependencys so it can be tested on it's own
+    class SkylinePacker {
+    public:
+        SkylinePacker(int width, int height);
+        
+        void Reset();
+        
+        bool Insert(int w, int h, AtlasRect& out);
+        
+        int GetWidth() { return this->_width; }
+        int GetHeight() { return this->_height; }
+        
+        long GetUsedArea() { return this->_usedArea; }
+        
+    private:
+        struct SkylineNode {
+            int x, y, w;
+        };
+        
+        int _fit(size_t index, int w, int h);
+        void _addLevel(size_t index, const AtlasRect& rect);
+        
+        std::vector<SkylineNode> _skyline;
+        
+        int _width, _height;
+        long _usedArea = 0;
+    };
+    
+    ENGINE_CLASS(TextureAtlas);
+    
+    class TextureAtlas {
+    public:
+        // Half float texcoords only land exactly on texel edges up to this size, see CompactBufferFormat
+        static const int MaxCompactPageSize = 2048;
+        
+        TextureAtlas(int pageSize, int padding);
+        ~TextureAtlas();
+        
+        // Returns NULL if the image can't be placed in a page
+        TexturePtr Add(unsigned char* pixels, int width, int height);
+        
+        // Called when a packed texture is invalidated, empty pages are freed
+        void Remove(TexturePtr tex);
+        
+        // Packs all live images again removing the space left by removed ones
+        void Repack();
+        
+        size_t GetPageCount() {
+            return this->_pages.size();
+        }
+        
+    private:
+        struct Page {
+            Page(int size) : packer(size, size) {}
+            
+            TexturePtr texture = NULL;
+            SkylinePacker packer;
+            std::vector<TexturePtr> entries;
+            long liveArea = 0;
+        };
+        
+        bool _place(Page* page, TexturePtr tex, unsigned char* pixels, int width, int height);
+        void _repackPage(Page* page);
+        void _updateUV(Page* page, TexturePtr tex);
+        Page* _createPage();
+        
+        std::vector<Page*> _pages;
+        
+        int _pageSize;
+        int _padding;
+    };
+    
+    TextureAtlasPtr GetTextureAtlasSingilton();
+}
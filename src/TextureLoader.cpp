@@ -26,9 +26,21 @@
 
 #include "Application.hpp"
 #include "Profiler.hpp"
+#include "Config.hpp"
 
 #include "vendor/soil/SOIL.h"
 
+#include <cstring>
+#include <cmath>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
 namespace Engine {
     Texture::Texture() {
         
@@ -45,6 +57,10 @@ namespace Engine {
     
     void Texture::Invalidate() {
         Logger::begin("Texture", Logger::LogLevel_Verbose) << "Invalidating Texture: " << this->_textureID << " [" << Platform::StringifyUUID(this->_uuid) << "]" << Logger::end();
+        if (this->_atlas != NULL) {
+            this->_atlas->Remove(this);
+            return;
+        }
         if (this->IsValid())
             glDeleteTextures(1, &this->_textureID);
         this->_textureID = std::numeric_limits<unsigned int>::max();
@@ -54,18 +70,74 @@ namespace Engine {
         this->Begin();
         
         unsigned char* pixels = new unsigned char[4 * this->_width * this->_height];
-        glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+        
+        if (this->IsAtlased()) {
+            int pageWidth = this->_atlasPage->GetWidth();
+            unsigned char* pagePixels = new unsigned char[4 * pageWidth * this->_atlasPage->GetHeight()];
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, pagePixels);
+            for (int y = 0; y < this->_height; y++) {
+                std::memcpy(&pixels[y * this->_width * 4],
+                            &pagePixels[((this->_atlasRect.y + y) * pageWidth + this->_atlasRect.x) * 4],
+                            this->_width * 4);
+            }
+            delete [] pagePixels;
+        } else {
+            glGetTexImage(GL_TEXTURE_2D, 0, GL_BGRA, GL_UNSIGNED_BYTE, pixels);
+        }
         
         this->End();
         
         ImageWriter::SaveBufferToFile(filename, pixels, this->_width, this->_height);
     }
     
+    void Texture::Update(const unsigned char* pixels) {
+        this->_update(pixels, GL_UNSIGNED_BYTE);
+    }
+    
+    void Texture::Update(const float* pixels) {
+        this->_update(pixels, GL_FLOAT);
+    }
+    
+    void Texture::_update(const void* pixels, GLenum type) {
+        RenderDebugGroup debugGroup(this->_render, "Texture::Update");
+        ENGINE_PROFILER_SCOPE;
+        
+        this->Begin();
+        
+        if (this->IsAtlased()) {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, this->_atlasRect.x, this->_atlasRect.y, this->_width, this->_height, GL_RGBA, type, pixels);
+        } else {
+            glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, this->_width, this->_height, GL_RGBA, type, pixels);
+            
+            // Rebuilding the mip chain costs more than the upload, textures that get updated are drawn
+            // at their own size so they drop to plain filtering and the mips made at creation go unused
+            GLint minFilter = GL_NEAREST;
+            glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &minFilter);
+            if (minFilter != GL_NEAREST && minFilter != GL_LINEAR) {
+                glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+            }
+        }
+        
+        this->End();
+        
+        this->_render->TrackStat(RenderStatistic::BufferUpload, this->_width * this->_height * 4 * (type == GL_FLOAT ? sizeof(float) : 1));
+        
+        this->_render->CheckError("Texture::Update::Post");
+    }
+    
     bool Texture::IsValid() {
+        if (this->IsAtlased()) {
+            return this->_atlasPage->IsValid();
+        }
         return glIsTexture(this->_textureID);
     }
     
     void Texture::Begin() {
+        if (this->IsAtlased()) {
+            this->_atlasPage->Begin();
+            return;
+        }
+        
         if (!this->IsValid()) {
             throw "Invalid Texture";
         }
@@ -112,10 +184,25 @@ namespace Engine {
     namespace ImageReader {
         
         TexturePtr TextureFromFileBuffer(unsigned char *buffer, long bufferLength) {
+            return TextureFromFileBuffer(buffer, bufferLength, false);
+        }
+        
+        TexturePtr TextureFromFileBuffer(unsigned char *buffer, long bufferLength, bool allowAtlas) {
             int width, height, chaneals;
             unsigned char* pixel = SOIL_load_image_from_memory(buffer, bufferLength, &width, &height, &chaneals, SOIL_LOAD_RGBA);
             
-            TexturePtr tex = TextureFromBuffer(pixel, width, height);
+            TexturePtr tex = NULL;
+            
+            int maxAtlasSize = Config::GetInt("core.render.atlas.maxImageSize");
+            
+            if (allowAtlas && Config::GetBoolean("core.render.atlas") &&
+                width <= maxAtlasSize && height <= maxAtlasSize) {
+                tex = GetTextureAtlasSingilton()->Add(pixel, width, height);
+            }
+            
+            if (tex == NULL) {
+                tex = TextureFromBuffer(pixel, width, height);
+            }
             
             SOIL_free_image_data(pixel);
             
@@ -129,6 +216,8 @@ namespace Engine {
         TexturePtr TextureFromBuffer(GLuint textureID, unsigned char *texture, int width, int height) {
             RenderDriverPtr render = GetAppSingilton()->GetRender();
             
+            RenderDebugGroup debugGroup(render, "ImageReader::TextureFromBuffer");
+            
             GLuint text = 0;
             
             render->CheckError("Pre Image Load");
@@ -165,6 +254,8 @@ namespace Engine {
         TexturePtr TextureFromBuffer(GLuint textureID, float* texture, int width, int height) {
             RenderDriverPtr render = GetAppSingilton()->GetRender();
             
+            RenderDebugGroup debugGroup(render, "ImageReader::TextureFromBuffer");
+            
             GLuint text = 0;
             
             render->CheckError("Pre Image Load");
@@ -196,6 +287,80 @@ namespace Engine {
             
             return new ResourceManager::ImageResource(filename);
         }
+        
+        void BytesToFloats(const unsigned char* src, float* dst, size_t count) {
+            ENGINE_PROFILER_SCOPE;
+            
+            size_t i = 0;
+            
+#ifdef __SSE2__
+            const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+            const __m128i zero = _mm_setzero_si128();
+            for (; i + 16 <= count; i += 16) {
+                __m128i bytes = _mm_loadu_si128((const __m128i*) &src[i]);
+                __m128i lo = _mm_unpacklo_epi8(bytes, zero), hi = _mm_unpackhi_epi8(bytes, zero);
+                _mm_storeu_ps(&dst[i],      _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)), scale));
+                _mm_storeu_ps(&dst[i + 4],  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)), scale));
+                _mm_storeu_ps(&dst[i + 8],  _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)), scale));
+                _mm_storeu_ps(&dst[i + 12], _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)), scale));
+            }
+#endif
+            
+            for (; i < count; i++) {
+                dst[i] = src[i] * (1.0f / 255.0f);
+            }
+        }
+        
+        void FloatsToBytes(const float* src, unsigned char* dst, size_t count) {
+            ENGINE_PROFILER_SCOPE;
+            
+            size_t i = 0;
+            
+#ifdef __SSE2__
+            const __m128 scale = _mm_set1_ps(255.0f), zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f);
+            for (; i + 16 <= count; i += 16) {
+                // _mm_cvtps_epi32 rounds to nearest even, max/min also turn NaN into 0
+                __m128i a = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[i]), zero), one), scale));
+                __m128i b = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[i + 4]), zero), one), scale));
+                __m128i c = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[i + 8]), zero), one), scale));
+                __m128i d = _mm_cvtps_epi32(_mm_mul_ps(_mm_min_ps(_mm_max_ps(_mm_loadu_ps(&src[i + 12]), zero), one), scale));
+                _mm_storeu_si128((__m128i*) &dst[i], _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d)));
+            }
+#endif
+            
+            for (; i < count; i++) {
+                float value = src[i] > 0.0f ? (src[i] < 1.0f ? src[i] : 1.0f) : 0.0f;
+                dst[i] = (unsigned char) std::nearbyint(value * 255.0f);
+            }
+        }
+        
+        void SwizzleRGBA(unsigned char* pixels, size_t pixelCount, const int order[4]) {
+            ENGINE_PROFILER_SCOPE;
+            
+            size_t i = 0;
+            
+#ifdef __SSSE3__
+            char mask[16];
+            for (int p = 0; p < 4; p++) {
+                for (int c = 0; c < 4; c++) {
+                    mask[p * 4 + c] = (char) (p * 4 + order[c]);
+                }
+            }
+            const __m128i shuffle = _mm_loadu_si128((const __m128i*) mask);
+            for (; i + 4 <= pixelCount; i += 4) {
+                __m128i value = _mm_loadu_si128((const __m128i*) &pixels[i * 4]);
+                _mm_storeu_si128((__m128i*) &pixels[i * 4], _mm_shuffle_epi8(value, shuffle));
+            }
+#endif
+            
+            for (; i < pixelCount; i++) {
+                unsigned char* pixel = &pixels[i * 4];
+                unsigned char old[4] = {pixel[0], pixel[1], pixel[2], pixel[3]};
+                for (int c = 0; c < 4; c++) {
+                    pixel[c] = old[order[c]];
+                }
+            }
+        }
     }
     
     namespace ImageWriter {
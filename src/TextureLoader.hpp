@@ -26,6 +26,10 @@
 #include "ResourceManager.hpp"
 #include "RenderDriver.hpp"
 #include "Platform.hpp"
+#include "TextureAtlas.hpp"
+
+#define GLM_FORCE_RADIANS
+#include "vendor/glm/glm.hpp"
 
 namespace Engine {
     ENGINE_CLASS(RenderDriver);
@@ -46,6 +50,11 @@ namespace Engine {
         
         void Save(std::string filename);
         
+        // Replaces every pixel with glTexSubImage2D, pixels is width * height RGBA values in
+        // row-major order. Atlased textures only touch their own rect of the page.
+        void Update(const unsigned char* pixels);
+        void Update(const float* pixels);
+        
         bool IsValid();
         
         void Begin();
@@ -54,11 +63,28 @@ namespace Engine {
         int GetWidth();
         int GetHeight();
         
+        // Textures packed into a TextureAtlas draw from the page texture with remapped UVs
+        bool IsAtlased() {
+            return this->_atlasPage != NULL;
+        }
+        
+        TexturePtr GetBindTexture() {
+            return this->IsAtlased() ? this->_atlasPage : this;
+        }
+        
+        inline glm::vec2 MapUV(glm::vec2 uv) {
+            if (!this->IsAtlased()) return uv;
+            return glm::vec2(this->_atlasUV.x + (this->_atlasUV.z - this->_atlasUV.x) * uv.x,
+                             this->_atlasUV.y + (this->_atlasUV.w - this->_atlasUV.y) * uv.y);
+        }
+        
         inline const Platform::UUID& GetUUID() {
             return this->_uuid;
         }
         
     private:
+        void _update(const void* pixels, unsigned int type);
+        
         void _setTextureID(unsigned int textureID);
         void _setTextureID(unsigned int textureID, bool deleteOld);
         
@@ -66,10 +92,18 @@ namespace Engine {
         RenderDriverPtr _render;
         unsigned int _textureID = std::numeric_limits<unsigned int>::max();
         int _width, _height;
+        
+        TexturePtr _atlasPage = NULL;
+        TextureAtlasPtr _atlas = NULL;
+        AtlasRect _atlasRect;
+        glm::vec4 _atlasUV;
+        
+        friend class TextureAtlas;
     };
     
     namespace ImageReader {
         TexturePtr TextureFromFileBuffer(unsigned char* texture, long bufferLength);
+        TexturePtr TextureFromFileBuffer(unsigned char* texture, long bufferLength, bool allowAtlas);
         
         TexturePtr TextureFromBuffer(unsigned char* texture, int width, int height);
         TexturePtr TextureFromBuffer(unsigned int textureID, unsigned char* texture, int width, int height);
@@ -78,6 +112,15 @@ namespace Engine {
         TexturePtr TextureFromBuffer(unsigned int textureID, float* texture, int width, int height);
         
         ResourceManager::ImageResourcePtr TextureFromFile(std::string filename);
+        
+        // Channel conversion for scripts that edit pixels directly, count is the number of
+        // channels rather than pixels. Uses SSE2/SSSE3 when the compiler targets them.
+        void BytesToFloats(const unsigned char* src, float* dst, size_t count);
+        void FloatsToBytes(const float* src, unsigned char* dst, size_t count); // clamps to 0.0f - 1.0f
+        
+        // Reorders the channels of every RGBA pixel in place, order[i] is the source channel
+        // for channel i so {2, 1, 0, 3} converts between RGBA and BGRA
+        void SwizzleRGBA(unsigned char* pixels, size_t pixelCount, const int order[4]);
     }
     
     namespace ImageWriter {
@@ -0,0 +1,141 @@
+/*
+ Filename: VectorMath.cpp
+ Purpose:  Bulk vector and matrix operations over packed float arrays
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "VectorMath.hpp"
+
+#include <cstring>
+
+#include "vendor/glm/gtc/type_ptr.hpp"
+
+#if (GLM_ARCH & GLM_ARCH_SSE2)
+#include "vendor/glm/gtx/simd_vec4.hpp"
+#include "vendor/glm/gtx/simd_mat4.hpp"
+#define ENGINE_VECTORMATH_SIMD
+#endif
+
+#include "Profiler.hpp"
+
+namespace Engine {
+    namespace VectorMath {
+        static inline glm::vec4 _load(const float* src, int components, float w) {
+            switch (components) {
+                case 2: return glm::vec4(src[0], src[1], 0.0f, w);
+                case 3: return glm::vec4(src[0], src[1], src[2], w);
+                default: return glm::make_vec4(src);
+            }
+        }
+        
+        static inline void _store(const glm::vec4& value, float* dst, int components) {
+            std::memcpy(dst, glm::value_ptr(value), components * sizeof(float));
+        }
+        
+        void TransformPointsScalar(const glm::mat4& matrix, const float* src, float* dst, size_t count, int components) {
+            for (size_t i = 0; i < count * components; i += components) {
+                _store(matrix * _load(&src[i], components, 1.0f), &dst[i], components);
+            }
+        }
+        
+        void NormalizeVectorsScalar(const float* src, float* dst, size_t count, int components) {
+            for (size_t i = 0; i < count * components; i += components) {
+                glm::vec4 value = _load(&src[i], components, 0.0f);
+                float length = glm::length(value);
+                _store(length > 0.0f ? value / length : value, &dst[i], components);
+            }
+        }
+        
+        void MultiplyMatricesScalar(const glm::mat4& matrix, const float* src, float* dst, size_t count) {
+            for (size_t i = 0; i < count * 16; i += 16) {
+                glm::mat4 result = matrix * glm::make_mat4(&src[i]);
+                std::memcpy(&dst[i], glm::value_ptr(result), sizeof(result));
+            }
+        }
+        
+#ifdef ENGINE_VECTORMATH_SIMD
+        static inline glm::simdVec4 _loadSIMD(const float* src, int components, float w) {
+            if (components == 4) {
+                return glm::simdVec4(_mm_loadu_ps(src));
+            }
+            return glm::simdVec4(src[0], src[1], components == 3 ? src[2] : 0.0f, w);
+        }
+        
+        static inline void _storeSIMD(const glm::simdVec4& value, float* dst, int components) {
+            if (components == 4) {
+                _mm_storeu_ps(dst, value.Data);
+                return;
+            }
+            GLM_ALIGN(16) float temp[4];
+            _mm_store_ps(temp, value.Data);
+            std::memcpy(dst, temp, components * sizeof(float));
+        }
+        
+        void TransformPoints(const glm::mat4& matrix, const float* src, float* dst, size_t count, int components) {
+            ENGINE_PROFILER_SCOPE;
+            
+            glm::simdMat4 simdMatrix(matrix);
+            
+            for (size_t i = 0; i < count * components; i += components) {
+                _storeSIMD(simdMatrix * _loadSIMD(&src[i], components, 1.0f), &dst[i], components);
+            }
+        }
+        
+        void NormalizeVectors(const float* src, float* dst, size_t count, int components) {
+            ENGINE_PROFILER_SCOPE;
+            
+            for (size_t i = 0; i < count * components; i += components) {
+                glm::simdVec4 value = _loadSIMD(&src[i], components, 0.0f);
+                float length = glm::length(value);
+                _storeSIMD(length > 0.0f ? value / length : value, &dst[i], components);
+            }
+        }
+        
+        void MultiplyMatrices(const glm::mat4& matrix, const float* src, float* dst, size_t count) {
+            ENGINE_PROFILER_SCOPE;
+            
+            glm::simdMat4 simdMatrix(matrix);
+            
+            for (size_t i = 0; i < count * 16; i += 16) {
+                __m128 columns[4] = {
+                    _mm_loadu_ps(&src[i]), _mm_loadu_ps(&src[i + 4]), _mm_loadu_ps(&src[i + 8]), _mm_loadu_ps(&src[i + 12])
+                };
+                glm::simdMat4 result = simdMatrix * glm::simdMat4(columns);
+                for (int c = 0; c < 4; c++) {
+                    _mm_storeu_ps(&dst[i + c * 4], result[c].Data);
+                }
+            }
+        }
+#else
+        void TransformPoints(const glm::mat4& matrix, const float* src, float* dst, size_t count, int components) {
+            ENGINE_PROFILER_SCOPE;
+            TransformPointsScalar(matrix, src, dst, count, components);
+        }
+        
+        void NormalizeVectors(const float* src, float* dst, size_t count, int components) {
+            ENGINE_PROFILER_SCOPE;
+            NormalizeVectorsScalar(src, dst, count, components);
+        }
+        
+        void MultiplyMatrices(const glm::mat4& matrix, const float* src, float* dst, size_t count) {
+            ENGINE_PROFILER_SCOPE;
+            MultiplyMatricesScalar(matrix, src, dst, count);
+        }
+#endif
+    }
+}
@@ -0,0 +1,48 @@
+/*
+ Filename: VectorMath.hpp
+ Purpose:  Bulk vector and matrix operations over packed float arrays
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+#define GLM_FORCE_RADIANS
+#include "vendor/glm/glm.hpp"
+
+namespace Engine {
+    // Operations over tightly packed arrays of vec2/vec3/vec4 or column-major mat4 values so scripts can
+    // work on a Float32Array in one call. src and dst can be the same array. Uses glm's SSE types when
+    // GLM_ARCH includes SSE2 and plain glm everywhere else.
+    namespace VectorMath {
+        // Missing z values are 0 and missing w values are 1, count is the number of points
+        void TransformPoints(const glm::mat4& matrix, const float* src, float* dst, size_t count, int components);
+        
+        // Vectors with a length of 0 stay 0
+        void NormalizeVectors(const float* src, float* dst, size_t count, int components);
+        
+        // dst[i] = matrix * src[i]
+        void MultiplyMatrices(const glm::mat4& matrix, const float* src, float* dst, size_t count);
+        
+        // Scalar versions of the above for platforms without SIMD and for comparing against
+        void TransformPointsScalar(const glm::mat4& matrix, const float* src, float* dst, size_t count, int components);
+        void NormalizeVectorsScalar(const float* src, float* dst, size_t count, int components);
+        void MultiplyMatricesScalar(const glm::mat4& matrix, const float* src, float* dst, size_t count);
+    }
+}
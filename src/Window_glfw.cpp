@@ -29,6 +29,7 @@
 #include "RenderGL3.hpp"
 
 #include "Events.hpp"
+#include "EventPayloads.hpp"
 #include "Logger.hpp"
 
 #include <cstdio>
@@ -362,6 +363,11 @@ namespace Engine {
         
         void _destroy() override {
             if (this->_window == NULL) return;
+            if (this->_render != NULL) {
+                glfwMakeContextCurrent(this->_window); // the renderer frees it's GL objects
+                delete this->_render;
+                this->_render = NULL;
+            }
             glfwDestroyWindow(this->_window);
             this->_window = NULL;
             GetEventsSingilton()->GetEvent("destroyWindow")->Emit();
@@ -370,14 +376,11 @@ namespace Engine {
         void _resizeCallback(int width, int height) {
             this->_size = glm::vec2(width, height);
             
-            Json::Value val(Json::objectValue);
-            
-            val["width"] = width;
-            val["height"] = height;
+            ResizeEvent e = {width, height};
 
 			glViewport(0, 0, width, height);
             
-            GetEventsSingilton()->GetEvent("rawResize")->Emit(val);
+            GetEventsSingilton()->GetEvent("rawResize")->EmitTyped(e);
         }
         
         void _keypressCallback(int rawKey, int scanCode, int state, int mods) {
@@ -391,32 +394,22 @@ namespace Engine {
                 return;
             }
             
-            Json::Value val(Json::objectValue);
+            std::string stateName = glfwGetKeyStateName(state);
             
-            val["rawKey"] = rawKey;
-            val["key"] = key;
-            val["rawPress"] = state;
-            val["state"] = glfwGetKeyStateName(state);
-            val["shift"] = (mods & GLFW_MOD_SHIFT);
+            InputEvent e = {rawKey, key.c_str(), state, stateName.c_str(), (mods & GLFW_MOD_SHIFT) != 0};
             
-            GetEventsSingilton()->GetEvent("rawInput")->Emit(val);
+            GetEventsSingilton()->GetEvent("rawInput")->EmitTyped(e);
         }
         
         void _mouseButtonCallback(int button, int action, int mods) {
-            Json::Value val(Json::objectValue);
-            
             std::string buttonName = glfwGetMouseButtonName(button);
             
-            val["button"] = buttonName;
-            val["action"] = action == GLFW_PRESS ? "press" : "release";
-            val["rawMods"] = mods;
-            
             glm::vec2 cursorPos = this->GetCursorPos();
             
-            val["x"] = std::floor(cursorPos.x);
-            val["y"] = std::floor(cursorPos.y);
+            MouseButtonEvent e = {buttonName.c_str(), action == GLFW_PRESS ? "press" : "release", mods,
+                std::floor(cursorPos.x), std::floor(cursorPos.y)};
             
-            GetEventsSingilton()->GetEvent("mouseButton")->Emit(val);
+            GetEventsSingilton()->GetEvent("mouseButton")->EmitTyped(e);
         }
         
         static void WindowResize(GLFWwindow* window, int width, int height) {
@@ -29,6 +29,7 @@
 #include "RenderGL3.hpp"
 
 #include "Events.hpp"
+#include "EventPayloads.hpp"
 #include "Logger.hpp"
 
 #define GLM_FORCE_RADIANS
@@ -257,6 +258,11 @@ namespace Engine {
         }
         
         void _destroy() override {
+            if (this->_render != NULL) {
+                SDL_GL_MakeCurrent(this->_window, this->_context); // the renderer frees it's GL objects
+                delete this->_render;
+                this->_render = NULL;
+            }
             SDL_GL_DeleteContext(this->_context);
             SDL_DestroyWindow(this->_window);
             GetEventsSingilton()->GetEvent("destroyWindow")->Emit();
@@ -265,45 +271,38 @@ namespace Engine {
         void _resizeCallback(int width, int height) {
             this->_size = glm::vec2(width, height);
             
-            Json::Value val(Json::objectValue);
-            
-            val["width"] = width;
-            val["height"] = height;
+            ResizeEvent e = {width, height};
             
             glViewport(0, 0, width, height);
             
-            GetEventsSingilton()->GetEvent("rawResize")->Emit(val);
+            GetEventsSingilton()->GetEvent("rawResize")->EmitTyped(e);
         }
         
         void _keypressCallback(SDL_KeyboardEvent k) {
-            Json::Value val(Json::objectValue);
+            InputEvent e;
             
-            val["rawKey"] = _translateKeyCodeToKeys(k.keysym.sym);
-            val["key"] = SDL_GetKeyName(k.keysym.sym);
+            e.rawKey = _translateKeyCodeToKeys(k.keysym.sym);
+            e.key = SDL_GetKeyName(k.keysym.sym);
             if (k.repeat > 0) {
-                val["rawPress"] = Key_Repeat;
-                val["state"] = "repeat";
+                e.rawPress = Key_Repeat;
+                e.state = "repeat";
             } else {
-                val["rawPress"] = k.state == SDL_PRESSED ? Key_Press : Key_Release;
-                val["state"] =  k.state == SDL_PRESSED ? "press" : "release";
+                e.rawPress = k.state == SDL_PRESSED ? Key_Press : Key_Release;
+                e.state =  k.state == SDL_PRESSED ? "press" : "release";
             }
             
-            val["shift"] = k.keysym.mod & (KMOD_LSHIFT | KMOD_RSHIFT);
+            e.shift = (k.keysym.mod & (KMOD_LSHIFT | KMOD_RSHIFT)) != 0;
             
-            GetEventsSingilton()->GetEvent("rawInput")->Emit(val);
+            GetEventsSingilton()->GetEvent("rawInput")->EmitTyped(e);
         }
         
         void _mouseButtonCallback(SDL_MouseButtonEvent b) {
-            Json::Value val(Json::objectValue);
-            
-            val["button"] = _getMouseButtonString(b.button);
-            val["action"] = b.state == SDL_PRESSED ? "press" : "release";
-            val["rawMods"] = 0;
+            std::string buttonName = _getMouseButtonString(b.button);
             
-            val["x"] = b.x;
-            val["y"] = b.y;
+            MouseButtonEvent e = {buttonName.c_str(), b.state == SDL_PRESSED ? "press" : "release", 0,
+                (double) b.x, (double) b.y};
             
-            GetEventsSingilton()->GetEvent("mouseButton")->Emit(val);
+            GetEventsSingilton()->GetEvent("mouseButton")->EmitTyped(e);
         }
         
         void _handleWindowEvent(SDL_WindowEvent e) {
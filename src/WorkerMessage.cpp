@@ -0,0 +1,508 @@
+/*
+ Filename: WorkerMessage.cpp
+ Purpose:  Moves values and ArrayBuffers between isolates
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#include "WorkerMessage.hpp"
+
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+#include "ScriptingManager.hpp"
+
+namespace Engine {
+    enum class MessageTag : unsigned char {
+        Undefined,
+        Null,
+        True,
+        False,
+        Int32,
+        Number,
+        String,
+        Array,
+        Object,
+        Date,
+        ArrayBuffer, // index into the buffer table
+        View         // ViewType, buffer index, byte offset, length
+    };
+    
+    enum class ViewType : unsigned char {
+        Int8,
+        Uint8,
+        Uint8Clamped,
+        Int16,
+        Uint16,
+        Int32,
+        Uint32,
+        Float32,
+        Float64,
+        DataView
+    };
+    
+    // Deep enough for any sensible message, cyclic objects hit this instead of recursing forever
+    static const int MaxDepth = 64;
+    
+    // ArrayBuffers created from a message are external so V8 won't Externalize them again,
+    // the engine keeps track of the memory itself so they can be transferred a second time
+    class MessageBufferStore {
+    public:
+        MessageBufferStore(v8::Isolate* isolate, v8::Local<v8::ArrayBuffer> buffer, void* data, size_t byteLength)
+                : _data(data), _byteLength(byteLength) {
+            this->_buffer.Reset(isolate, buffer);
+            this->_buffer.SetWeak(this, WeakCallback);
+            isolate->AdjustAmountOfExternalAllocatedMemory(byteLength);
+            
+            std::lock_guard<std::mutex> lock(_storesMutex);
+            _stores[data] = this;
+        }
+        
+        // Takes the memory back from a buffer this class created, returns false for other external buffers
+        static bool Release(v8::Isolate* isolate, void* data) {
+            std::lock_guard<std::mutex> lock(_storesMutex);
+            
+            auto iter = _stores.find(data);
+            if (iter == _stores.end()) {
+                return false;
+            }
+            
+            isolate->AdjustAmountOfExternalAllocatedMemory(-static_cast<intptr_t>(iter->second->_byteLength));
+            iter->second->_data = NULL;
+            _stores.erase(iter);
+            
+            return true;
+        }
+        
+        static void WeakCallback(const v8::WeakCallbackData<v8::ArrayBuffer, MessageBufferStore>& args) {
+            MessageBufferStore* store = args.GetParameter();
+            
+            {
+                std::lock_guard<std::mutex> lock(_storesMutex);
+                
+                if (store->_data != NULL) {
+                    args.GetIsolate()->AdjustAmountOfExternalAllocatedMemory(-static_cast<intptr_t>(store->_byteLength));
+                    _stores.erase(store->_data);
+                    free(store->_data);
+                }
+            }
+            
+            store->_buffer.Reset();
+            delete store;
+        }
+        
+    private:
+        v8::Persistent<v8::ArrayBuffer> _buffer;
+        void* _data;
+        size_t _byteLength;
+        
+        static std::mutex _storesMutex;
+        static std::unordered_map<void*, MessageBufferStore*> _stores;
+    };
+    
+    std::mutex MessageBufferStore::_storesMutex;
+    std::unordered_map<void*, MessageBufferStore*> MessageBufferStore::_stores;
+    
+    class MessageWriter {
+    public:
+        MessageWriter(v8::Isolate* isolate, WorkerMessagePtr message, std::string& error)
+            : _isolate(isolate), _message(message), _error(error) {}
+        
+        bool AddTransfer(v8::Handle<v8::Value> transferList) {
+            if (transferList.IsEmpty() || transferList->IsUndefined()) {
+                return true;
+            }
+            
+            if (!transferList->IsArray()) {
+                this->_error = "The transfer list needs to be a Array of ArrayBuffers";
+                return false;
+            }
+            
+            v8::Local<v8::Array> list = transferList.As<v8::Array>();
+            
+            for (uint32_t i = 0; i < list->Length(); i++) {
+                v8::Local<v8::Value> item = list->Get(i);
+                
+                if (item->IsArrayBufferView()) {
+                    item = item.As<v8::ArrayBufferView>()->Buffer();
+                } else if (!item->IsArrayBuffer()) {
+                    this->_error = "The transfer list can only hold ArrayBuffers and typed arrays";
+                    return false;
+                }
+                
+                this->_transfer.push_back(item.As<v8::ArrayBuffer>());
+            }
+            
+            return true;
+        }
+        
+        bool Write(v8::Handle<v8::Value> value, int depth) {
+            if (depth > MaxDepth) {
+                this->_error = "The message is nested too deeply or contains a cycle";
+                return false;
+            }
+            
+            if (value->IsUndefined()) {
+                this->_tag(MessageTag::Undefined);
+            } else if (value->IsNull()) {
+                this->_tag(MessageTag::Null);
+            } else if (value->IsTrue()) {
+                this->_tag(MessageTag::True);
+            } else if (value->IsFalse()) {
+                this->_tag(MessageTag::False);
+            } else if (value->IsInt32()) {
+                this->_tag(MessageTag::Int32);
+                this->_write<int32_t>(value->Int32Value());
+            } else if (value->IsNumber() || value->IsNumberObject()) {
+                this->_tag(MessageTag::Number);
+                this->_write<double>(value->NumberValue());
+            } else if (value->IsString() || value->IsStringObject()) {
+                this->_tag(MessageTag::String);
+                this->_writeString(value->ToString());
+            } else if (value->IsBooleanObject()) {
+                this->_tag(value->BooleanValue() ? MessageTag::True : MessageTag::False);
+            } else if (value->IsDate()) {
+                this->_tag(MessageTag::Date);
+                this->_write<double>(value.As<v8::Date>()->ValueOf());
+            } else if (value->IsArrayBuffer()) {
+                this->_tag(MessageTag::ArrayBuffer);
+                this->_write<uint32_t>(this->_bufferIndex(value.As<v8::ArrayBuffer>()));
+            } else if (value->IsArrayBufferView()) {
+                return this->_writeView(value.As<v8::ArrayBufferView>());
+            } else if (value->IsArray()) {
+                v8::Local<v8::Array> array = value.As<v8::Array>();
+                
+                this->_tag(MessageTag::Array);
+                this->_write<uint32_t>(array->Length());
+                
+                for (uint32_t i = 0; i < array->Length(); i++) {
+                    if (!this->Write(array->Get(i), depth + 1)) return false;
+                }
+            } else if (value->IsFunction()) {
+                this->_error = "Functions can't be posted to another thread";
+                return false;
+            } else if (value->IsObject()) {
+                v8::Local<v8::Object> obj = value.As<v8::Object>();
+                
+                if (obj->InternalFieldCount() > 0) {
+                    this->_error = "Native objects like textures can't be posted to another thread";
+                    return false;
+                }
+                
+                v8::Local<v8::Array> keys = obj->GetOwnPropertyNames();
+                
+                this->_tag(MessageTag::Object);
+                this->_write<uint32_t>(keys->Length());
+                
+                for (uint32_t i = 0; i < keys->Length(); i++) {
+                    v8::Local<v8::Value> key = keys->Get(i);
+                    this->_writeString(key->ToString());
+                    if (!this->Write(obj->Get(key), depth + 1)) return false;
+                }
+            } else {
+                this->_error = "Symbols can't be posted to another thread";
+                return false;
+            }
+            
+            return true;
+        }
+        
+        // Only runs once the whole value was written so a failed message doesn't detach anything
+        void Finish() {
+            for (size_t i = 0; i < this->_referenced.size(); i++) {
+                v8::Local<v8::ArrayBuffer> buffer = this->_referenced[i];
+                
+                WorkerMessage::Buffer entry;
+                entry.ByteLength = buffer->ByteLength();
+                entry.Transferred = this->_isTransferred(buffer);
+                
+                if (entry.Transferred && !buffer->IsExternal()) {
+                    // V8 allocated it with MallocArrayBufferAllocator so it's ours to free after this
+                    entry.Data = buffer->Externalize().Data();
+                    buffer->Neuter();
+                } else if (entry.Transferred && MessageBufferStore::Release(this->_isolate, buffer->GetContents().Data())) {
+                    entry.Data = buffer->GetContents().Data();
+                    buffer->Neuter();
+                } else {
+                    // Buffers owned by something else like draw.createImageArray are copied
+                    entry.Transferred = false;
+                    entry.Data = entry.ByteLength > 0 ? malloc(entry.ByteLength) : NULL;
+                    if (entry.ByteLength > 0) {
+                        std::memcpy(entry.Data, buffer->GetContents().Data(), entry.ByteLength);
+                    }
+                }
+                
+                this->_message->_buffers.push_back(entry);
+            }
+        }
+        
+    private:
+        void _tag(MessageTag tag) {
+            this->_message->_data.push_back((unsigned char) tag);
+        }
+        
+        template<typename T> void _write(T value) {
+            size_t offset = this->_message->_data.size();
+            this->_message->_data.resize(offset + sizeof(T));
+            std::memcpy(&this->_message->_data[offset], &value, sizeof(T));
+        }
+        
+        void _writeString(v8::Local<v8::String> str) {
+            int length = str->Utf8Length();
+            
+            this->_write<uint32_t>(length);
+            
+            size_t offset = this->_message->_data.size();
+            this->_message->_data.resize(offset + length);
+            if (length > 0) {
+                str->WriteUtf8((char*) &this->_message->_data[offset], length, NULL, v8::String::NO_NULL_TERMINATION);
+            }
+        }
+        
+        bool _writeView(v8::Local<v8::ArrayBufferView> view) {
+            ViewType type;
+            size_t length;
+            
+            if (view->IsDataView()) {
+                type = ViewType::DataView;
+                length = view->ByteLength();
+            } else {
+                v8::Local<v8::TypedArray> array = view.As<v8::TypedArray>();
+                length = array->Length();
+                
+                if (view->IsInt8Array()) type = ViewType::Int8;
+                else if (view->IsUint8Array()) type = ViewType::Uint8;
+                else if (view->IsUint8ClampedArray()) type = ViewType::Uint8Clamped;
+                else if (view->IsInt16Array()) type = ViewType::Int16;
+                else if (view->IsUint16Array()) type = ViewType::Uint16;
+                else if (view->IsInt32Array()) type = ViewType::Int32;
+                else if (view->IsUint32Array()) type = ViewType::Uint32;
+                else if (view->IsFloat32Array()) type = ViewType::Float32;
+                else if (view->IsFloat64Array()) type = ViewType::Float64;
+                else {
+                    this->_error = "Unknown typed array type";
+                    return false;
+                }
+            }
+            
+            this->_tag(MessageTag::View);
+            this->_write<unsigned char>((unsigned char) type);
+            this->_write<uint32_t>(this->_bufferIndex(view->Buffer()));
+            this->_write<uint32_t>((uint32_t) view->ByteOffset());
+            this->_write<uint32_t>((uint32_t) length);
+            
+            return true;
+        }
+        
+        // Views on the same buffer share one entry so they still alias after being posted
+        uint32_t _bufferIndex(v8::Local<v8::ArrayBuffer> buffer) {
+            for (size_t i = 0; i < this->_referenced.size(); i++) {
+                if (this->_referenced[i] == buffer) return (uint32_t) i;
+            }
+            this->_referenced.push_back(buffer);
+            return (uint32_t) (this->_referenced.size() - 1);
+        }
+        
+        bool _isTransferred(v8::Local<v8::ArrayBuffer> buffer) {
+            for (auto iter = this->_transfer.begin(); iter != this->_transfer.end(); iter++) {
+                if (*iter == buffer) return true;
+            }
+            return false;
+        }
+        
+        v8::Isolate* _isolate;
+        WorkerMessagePtr _message;
+        std::string& _error;
+        
+        std::vector<v8::Local<v8::ArrayBuffer>> _transfer;
+        std::vector<v8::Local<v8::ArrayBuffer>> _referenced;
+    };
+    
+    class MessageReader {
+    public:
+        MessageReader(v8::Isolate* isolate, const std::vector<unsigned char>& data, const std::vector<v8::Local<v8::ArrayBuffer>>& buffers)
+            : _isolate(isolate), _data(data), _buffers(buffers) {}
+        
+        v8::Local<v8::Value> Read() {
+            switch ((MessageTag) this->_read<unsigned char>()) {
+                case MessageTag::Undefined: return v8::Undefined(this->_isolate);
+                case MessageTag::Null: return v8::Null(this->_isolate);
+                case MessageTag::True: return v8::True(this->_isolate);
+                case MessageTag::False: return v8::False(this->_isolate);
+                case MessageTag::Int32: return v8::Integer::New(this->_isolate, this->_read<int32_t>());
+                case MessageTag::Number: return v8::Number::New(this->_isolate, this->_read<double>());
+                case MessageTag::String: return this->_readString();
+                case MessageTag::Date: return v8::Date::New(this->_isolate, this->_read<double>());
+                case MessageTag::ArrayBuffer: return this->_buffers[this->_read<uint32_t>()];
+                case MessageTag::View: return this->_readView();
+                case MessageTag::Array: {
+                    uint32_t length = this->_read<uint32_t>();
+                    v8::Local<v8::Array> array = v8::Array::New(this->_isolate, length);
+                    for (uint32_t i = 0; i < length; i++) {
+                        array->Set(i, this->Read());
+                    }
+                    return array;
+                }
+                case MessageTag::Object: {
+                    uint32_t count = this->_read<uint32_t>();
+                    v8::Local<v8::Object> obj = v8::Object::New(this->_isolate);
+                    for (uint32_t i = 0; i < count; i++) {
+                        v8::Local<v8::String> key = this->_readString();
+                        obj->Set(key, this->Read());
+                    }
+                    return obj;
+                }
+            }
+            
+            return v8::Undefined(this->_isolate);
+        }
+        
+    private:
+        template<typename T> T _read() {
+            T value;
+            std::memcpy(&value, &this->_data[this->_offset], sizeof(T));
+            this->_offset += sizeof(T);
+            return value;
+        }
+        
+        v8::Local<v8::String> _readString() {
+            uint32_t length = this->_read<uint32_t>();
+            const char* str = (const char*) (length > 0 ? &this->_data[this->_offset] : NULL);
+            this->_offset += length;
+            return v8::String::NewFromUtf8(this->_isolate, str == NULL ? "" : str, v8::String::kNormalString, length);
+        }
+        
+        v8::Local<v8::Value> _readView() {
+            ViewType type = (ViewType) this->_read<unsigned char>();
+            v8::Local<v8::ArrayBuffer> buffer = this->_buffers[this->_read<uint32_t>()];
+            size_t offset = this->_read<uint32_t>();
+            size_t length = this->_read<uint32_t>();
+            
+            switch (type) {
+                case ViewType::Int8: return v8::Int8Array::New(buffer, offset, length);
+                case ViewType::Uint8: return v8::Uint8Array::New(buffer, offset, length);
+                case ViewType::Uint8Clamped: return v8::Uint8ClampedArray::New(buffer, offset, length);
+                case ViewType::Int16: return v8::Int16Array::New(buffer, offset, length);
+                case ViewType::Uint16: return v8::Uint16Array::New(buffer, offset, length);
+                case ViewType::Int32: return v8::Int32Array::New(buffer, offset, length);
+                case ViewType::Uint32: return v8::Uint32Array::New(buffer, offset, length);
+                case ViewType::Float32: return v8::Float32Array::New(buffer, offset, length);
+                case ViewType::Float64: return v8::Float64Array::New(buffer, offset, length);
+                case ViewType::DataView: return v8::DataView::New(buffer, offset, length);
+            }
+            
+            return v8::Undefined(this->_isolate);
+        }
+        
+        v8::Isolate* _isolate;
+        const std::vector<unsigned char>& _data;
+        const std::vector<v8::Local<v8::ArrayBuffer>>& _buffers;
+        size_t _offset = 0;
+    };
+    
+    WorkerMessage::~WorkerMessage() {
+        if (this->_deserialized) {
+            return;
+        }
+        
+        // never delivered, the worker may have stopped first
+        for (auto iter = this->_buffers.begin(); iter != this->_buffers.end(); iter++) {
+            free(iter->Data);
+        }
+    }
+    
+    WorkerMessagePtr WorkerMessage::Serialize(v8::Isolate* isolate, v8::Handle<v8::Value> value, v8::Handle<v8::Value> transferList, std::string& error) {
+        v8::HandleScope scope(isolate);
+        
+        WorkerMessagePtr message = new WorkerMessage();
+        MessageWriter writer(isolate, message, error);
+        
+        if (!writer.AddTransfer(transferList) || !writer.Write(value, 0)) {
+            delete message;
+            return NULL;
+        }
+        
+        writer.Finish();
+        
+        return message;
+    }
+    
+    v8::Local<v8::Value> WorkerMessage::Deserialize(v8::Isolate* isolate) {
+        assert(!this->_deserialized);
+        
+        v8::EscapableHandleScope scope(isolate);
+        
+        std::vector<v8::Local<v8::ArrayBuffer>> buffers;
+        for (auto iter = this->_buffers.begin(); iter != this->_buffers.end(); iter++) {
+            buffers.push_back(NewArrayBuffer(isolate, iter->Data, iter->ByteLength));
+        }
+        
+        this->_deserialized = true;
+        
+        MessageReader reader(isolate, this->_data, buffers);
+        
+        return scope.Escape(reader.Read());
+    }
+    
+    void WorkerMessage::Dispatch(v8::Isolate* isolate, v8::Handle<v8::Object> target) {
+        v8::HandleScope scope(isolate);
+        
+        v8::Local<v8::Value> data = this->Deserialize(isolate);
+        
+        v8::Local<v8::Value> onMessage = target->Get(v8::String::NewFromUtf8(isolate, "onmessage"));
+        
+        if (!onMessage->IsFunction()) {
+            return;
+        }
+        
+        v8::Local<v8::Object> e = v8::Object::New(isolate);
+        e->Set(v8::String::NewFromUtf8(isolate, "data"), data);
+        
+        v8::TryCatch tryCatch;
+        
+        v8::Handle<v8::Value> args[1] = {e};
+        onMessage.As<v8::Function>()->Call(target, 1, args);
+        
+        if (tryCatch.HasCaught()) {
+            ScriptingManager::ReportException(isolate, &tryCatch);
+        }
+    }
+    
+    size_t WorkerMessage::GetTransferredBytes() {
+        size_t bytes = 0;
+        for (auto iter = this->_buffers.begin(); iter != this->_buffers.end(); iter++) {
+            if (iter->Transferred) bytes += iter->ByteLength;
+        }
+        return bytes;
+    }
+    
+    v8::Local<v8::ArrayBuffer> WorkerMessage::NewArrayBuffer(v8::Isolate* isolate, void* data, size_t byteLength) {
+        if (data == NULL) {
+            return v8::ArrayBuffer::New(isolate, 0);
+        }
+        
+        v8::Local<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(isolate, data, byteLength);
+        
+        new MessageBufferStore(isolate, buffer, data, byteLength);
+        
+        return buffer;
+    }
+}
@@ -0,0 +1,77 @@
+/*
+ Filename: WorkerMessage.hpp
+ Purpose:  Moves values and ArrayBuffers between isolates
+ 
+ Part of Engine2D
+ 
+ Copyright (C) 2014 Vbitz
+ 
+ Licensed under the Apache License, Version 2.0 (the "License");
+ you may not use this file except in compliance with the License.
+ You may obtain a copy of the License at
+ 
+ http://www.apache.org/licenses/LICENSE-2.0
+ 
+ Unless required by applicable law or agreed to in writing, software
+ distributed under the License is distributed on an "AS IS" BASIS,
+ WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ See the License for the specific language governing permissions and
+ limitations under the License.
+ */
+
+#pragma once
+
+#include <include/v8.h>
+
+#include <string>
+#include <vector>
+
+#include "stdlib.hpp"
+
+namespace Engine {
+    ENGINE_CLASS(WorkerMessage);
+    
+    // A value posted between the main isolate and a script worker. Everything apart from
+    // ArrayBuffers is written to a compact binary form. ArrayBuffers listed in the transfer list
+    // are detached from the sender and their memory is handed to the receiver without a copy,
+    // other ArrayBuffers are copied once when the message is created.
+    class WorkerMessage {
+    public:
+        ~WorkerMessage();
+        
+        // Returns NULL and sets error when value holds something that can't be posted like a
+        // function or a native object. Nothing is detached unless the message is created.
+        static WorkerMessagePtr Serialize(v8::Isolate* isolate, v8::Handle<v8::Value> value, v8::Handle<v8::Value> transferList, std::string& error);
+        
+        // Can only be called once, the buffers belong to isolate afterwards
+        v8::Local<v8::Value> Deserialize(v8::Isolate* isolate);
+        
+        // Calls target.onmessage({data: value}) if it's a function, exceptions are reported
+        // and don't propagate. The isolate needs a entered context.
+        void Dispatch(v8::Isolate* isolate, v8::Handle<v8::Object> target);
+        
+        size_t GetByteLength() { return this->_data.size(); }
+        size_t GetBufferCount() { return this->_buffers.size(); }
+        size_t GetTransferredBytes();
+        
+        // Wraps memory allocated with malloc in a ArrayBuffer that frees it once it's collected,
+        // the buffer can still be transferred again later without a copy
+        static v8::Local<v8::ArrayBuffer> NewArrayBuffer(v8::Isolate* isolate, void* data, size_t byteLength);
+        
+    private:
+        struct Buffer {
+            void* Data;
+            size_t ByteLength;
+            bool Transferred;
+        };
+        
+        WorkerMessage() {}
+        
+        std::vector<unsigned char> _data;
+        std::vector<Buffer> _buffers;
+        
+        bool _deserialized = false;
+        
+        friend class MessageWriter;
+    };
+}
@@ -22,10 +22,19 @@
 #include "WorkerThreadPool.hpp"
 
 #include <vector>
+#include <deque>
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
 
 #include "Logger.hpp"
+#include "Profiler.hpp"
 #include "Util.hpp"
 #include "Events.hpp"
+#include "WorkerMessage.hpp"
 
 #include "JSSys.hpp"
 
@@ -82,28 +91,47 @@ namespace Engine {
             ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
         }
         
-        ENGINE_CLASS(ScriptWorker);
+        ENGINE_JS_METHOD(ThreadPostMessage);
+        ENGINE_JS_METHOD(ThreadClose);
         
         class ScriptWorker {
         public:
-            void Start() { // Can be called anywhere
-                this->_running = true;
+            ScriptWorker(ScriptWorkerMessageFunc onMessage, ScriptWorkerExitFunc onExit) : _onMessage(onMessage), _onExit(onExit) { }
+            
+            ~ScriptWorker() {
+                delete this->_thread;
             }
             
-            void Stop() { // Can only be called from main thread
+            void Stop() { // Can be called anywhere
+                std::lock_guard<std::mutex> lock(this->_inboxMutex);
                 this->_running = false;
+                this->_inboxCondition.notify_all();
             }
             
-            bool IsRunning() {
-                // Can be called anywhere, _running get is a atomic op
-                return this->_running;
+            void Terminate() { // Only called from main thread
+                this->_terminated = true;
+                this->Stop();
+                
+                // a script that never returns would otherwise keep the thread alive
+                std::lock_guard<std::mutex> lock(this->_isolateMutex);
+                if (this->_isolate != NULL) {
+                    v8::V8::TerminateExecution(this->_isolate);
+                }
             }
             
 #define addItem(table, js_name, funct) table->Set(this->_isolate, js_name, v8::FunctionTemplate::New(this->_isolate, funct))
             
             void CreateScriptContext(std::string threadID) {
                 // ONLY called from Worker thread, this will kill scripting if called from the main thread
-                this->_isolate = v8::Isolate::New();
+                {
+                    std::lock_guard<std::mutex> lock(this->_isolateMutex);
+                    this->_isolate = v8::Isolate::New();
+                    
+                    // terminated before the isolate existed
+                    if (!this->_running) {
+                        v8::V8::TerminateExecution(this->_isolate);
+                    }
+                }
                 this->_isolate->Enter();
                 
                 v8::HandleScope scp(this->_isolate);
@@ -128,6 +156,11 @@ namespace Engine {
                 
                 globals->Set(this->_isolate, "emit", threadEventEmit);
                 
+                v8::Handle<v8::External> self = v8::External::New(this->_isolate, this);
+                
+                globals->Set(this->_isolate, "postMessage", v8::FunctionTemplate::New(this->_isolate, ThreadPostMessage, self));
+                globals->Set(this->_isolate, "close", v8::FunctionTemplate::New(this->_isolate, ThreadClose, self));
+                
                 this->_globalTemplate.Reset(this->_isolate, globals);
                 
                 v8::Handle<v8::Context> context = v8::Context::New(this->_isolate);
@@ -139,6 +172,27 @@ namespace Engine {
             
 #undef addItem
             
+            void DisposeScriptContext() {
+                // Only called from Worker thread once the loop has finished
+                {
+                    v8::HandleScope scp(this->_isolate);
+                    v8::Local<v8::Context>::New(this->_isolate, this->_context)->Exit();
+                }
+                
+                this->_threadObject.Reset();
+                this->_globalTemplate.Reset();
+                this->_context.Reset();
+                
+                v8::Isolate* isolate = this->_isolate;
+                {
+                    std::lock_guard<std::mutex> lock(this->_isolateMutex);
+                    this->_isolate = NULL;
+                }
+                
+                isolate->Exit();
+                isolate->Dispose();
+            }
+            
             bool RunScript(std::string src, std::string fileName) {
                 std::stringstream realSrc;
                 
@@ -155,13 +209,23 @@ namespace Engine {
                     return false;
                 } else {
                     v8::Handle<v8::Value> rawFunc = script->Run();
+                    
+                    // empty when the worker was terminated while compiling
+                    if (rawFunc.IsEmpty() || !rawFunc->IsFunction()) {
+                        return false;
+                    }
+                    
                     v8::Handle<v8::Function> func = rawFunc.As<v8::Function>();
                     
                     v8::Handle<v8::Value> args[1];
                     
                     v8::Handle<v8::ObjectTemplate> globalObject = v8::Local<v8::ObjectTemplate>::New(this->_isolate, this->_globalTemplate);
                     
-                    args[0] = globalObject->NewInstance();
+                    v8::Handle<v8::Object> threadObject = globalObject->NewInstance();
+                    
+                    this->_threadObject.Reset(this->_isolate, threadObject);
+                    
+                    args[0] = threadObject;
                     
                     func->Call(ctx->Global(), 1, args);
                     
@@ -169,13 +233,140 @@ namespace Engine {
                 }
             }
             
+            // Workers that never set thread.onmessage exit once their function returns
+            bool WantsMessages() {
+                v8::HandleScope scp(this->_isolate);
+                v8::Local<v8::Object> threadObject = v8::Local<v8::Object>::New(this->_isolate, this->_threadObject);
+                
+                if (threadObject.IsEmpty()) {
+                    return false;
+                }
+                
+                v8::Local<v8::Value> onMessage = threadObject->Get(v8::String::NewFromUtf8(this->_isolate, "onmessage"));
+                return !onMessage.IsEmpty() && onMessage->IsFunction();
+            }
+            
+            void Post(WorkerMessagePtr message) { // Can be called anywhere
+                std::lock_guard<std::mutex> lock(this->_inboxMutex);
+                
+                if (!this->_running) {
+                    delete message;
+                    return;
+                }
+                
+                this->_inbox.push_back(message);
+                this->_inboxCondition.notify_one();
+            }
+            
+            // Only called from Worker thread, returns NULL once the worker is stopped
+            WorkerMessagePtr WaitForMessage() {
+                std::unique_lock<std::mutex> lock(this->_inboxMutex);
+                
+                this->_inboxCondition.wait(lock, [this]() { return !this->_running || !this->_inbox.empty(); });
+                
+                if (!this->_running) {
+                    for (auto iter = this->_inbox.begin(); iter != this->_inbox.end(); iter++) {
+                        delete *iter;
+                    }
+                    this->_inbox.clear();
+                    return NULL;
+                }
+                
+                WorkerMessagePtr message = this->_inbox.front();
+                this->_inbox.pop_front();
+                return message;
+            }
+            
+            void Dispatch(WorkerMessagePtr message) {
+                // Only called from Worker thread
+                v8::HandleScope scp(this->_isolate);
+                
+                message->Dispatch(this->_isolate, v8::Local<v8::Object>::New(this->_isolate, this->_threadObject));
+                
+                delete message;
+            }
+            
+            void PostToMain(WorkerMessagePtr message) {
+                // Called from Worker thread, the main thread picks it up during PollMainThread
+                RunOnMainThread([this, message]() {
+                    // messages posted before thread.close() still arrive
+                    if (!this->_terminated) {
+                        this->_onMessage(message);
+                    }
+                    delete message;
+                });
+            }
+            
+            // Called from the Worker thread as it's last action, the main thread deletes the worker
+            void Exited() {
+                RunOnMainThread([this]() {
+                    _workers.erase(std::find(_workers.begin(), _workers.end(), this));
+                    
+                    this->_onExit();
+                    delete this;
+                });
+                
+                _runningScriptWorkers--;
+            }
+            
+            v8::Isolate* GetIsolate() { return this->_isolate; }
+            
+            void SetThread(Platform::ThreadPtr thread) { this->_thread = thread; }
+            
+            static std::vector<ScriptWorker*> _workers; // only touched on the main thread
+            static std::atomic<int> _runningScriptWorkers;
+            
         private:
-            bool _running = false;
-            v8::Isolate* _isolate;
+            std::atomic<bool> _running{true};
+            bool _terminated = false; // only touched on the main thread
+            Platform::ThreadPtr _thread = NULL;
+            
+            // the main thread reads _isolate to terminate scripts
+            std::mutex _isolateMutex;
+            v8::Isolate* _isolate = NULL;
             v8::Persistent<v8::ObjectTemplate> _globalTemplate;
             v8::Persistent<v8::Context> _context;
+            v8::Persistent<v8::Object> _threadObject;
+            
+            ScriptWorkerMessageFunc _onMessage;
+            ScriptWorkerExitFunc _onExit;
+            
+            std::deque<WorkerMessagePtr> _inbox;
+            std::mutex _inboxMutex;
+            std::condition_variable _inboxCondition;
         };
         
+        ENGINE_JS_METHOD(ThreadPostMessage) {
+            ENGINE_JS_SCOPE_OPEN;
+            
+            if (args.Length() != 1 && args.Length() != 2) {
+                ENGINE_THROW_ARGERROR("Wrong number of arguments");
+                ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+            }
+            
+            ScriptWorkerPtr worker = (ScriptWorkerPtr) args.Data().As<v8::External>()->Value();
+            
+            std::string error;
+            WorkerMessagePtr message = WorkerMessage::Serialize(args.GetIsolate(), args[0], args[1], error);
+            
+            if (message == NULL) {
+                ENGINE_THROW_ARGERROR(error.c_str());
+                ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+            }
+            
+            worker->PostToMain(message);
+            
+            ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+        }
+        
+        ENGINE_JS_METHOD(ThreadClose) {
+            ENGINE_JS_SCOPE_OPEN;
+            
+            ((ScriptWorkerPtr) args.Data().As<v8::External>()->Value())->Stop();
+            
+            ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+        }
+        
         struct ScriptWorkerArgs {
             std::string scriptSource;
             Platform::UUID threadID;
@@ -185,7 +376,8 @@ namespace Engine {
             Platform::MutexPtr threadIDMutex = NULL;
         };
         
-        std::vector<ScriptWorkerPtr> _workers;
+        std::vector<ScriptWorkerPtr> ScriptWorker::_workers;
+        std::atomic<int> ScriptWorker::_runningScriptWorkers{0};
         
         void* ScriptWorkerFunc(void* scriptWorkerArgs) {
             ScriptWorkerArgs* args = (ScriptWorkerArgs*) scriptWorkerArgs;
@@ -198,37 +390,546 @@ namespace Engine {
             
             std::string strThreadID = Platform::StringifyUUID(args->threadID);
             
-            args->worker->CreateScriptContext(strThreadID);
-            args->worker->RunScript(args->scriptSource, strThreadID);
-            args->worker->Start();
+            ScriptWorkerPtr worker = args->worker;
             
-            while (args->worker->IsRunning()) {
-                // TODO: Recieve events using Events::PollThreadWorker(threadID)
-                // TODO: Dispatch events
-                Platform::Sleep(1000);
+            worker->CreateScriptContext(strThreadID);
+            worker->RunScript(args->scriptSource, strThreadID);
+            
+            if (!worker->WantsMessages()) {
+                worker->Stop();
             }
             
+            while (WorkerMessagePtr message = worker->WaitForMessage()) {
+                worker->Dispatch(message);
+            }
+            
+            worker->DisposeScriptContext();
+            
+            delete args->threadIDMutex;
+            delete args;
+            
+            // workers come and go for the whole run so their log stream and profiler ring can't wait for shutdown
+            Logger::ReleaseThread();
+            Profiler::ReleaseThread();
+            
+            worker->Exited();
+            
             return NULL;
         }
         
-        void CreateScriptWorker(std::string scriptSource) {
+        ScriptWorkerPtr CreateScriptWorker(std::string scriptSource, ScriptWorkerMessageFunc onMessage, ScriptWorkerExitFunc onExit) {
             ScriptWorkerArgs* args = new ScriptWorkerArgs;
             
+            ScriptWorkerPtr worker = new ScriptWorker(onMessage, onExit);
+            
             args->scriptSource = scriptSource;
-            args->worker = new ScriptWorker();
+            args->worker = worker;
             
             args->threadIDMutex = Platform::CreateMutex();
             args->threadIDMutex->Enter();
             
+            ScriptWorker::_workers.push_back(worker);
+            ScriptWorker::_runningScriptWorkers++;
+            
             Platform::ThreadPtr thread =
                 Platform::CreateThread(ScriptWorkerFunc, args);
-            args->threadID = thread->GetThreadID();
+            Platform::UUID threadID = args->threadID = thread->GetThreadID();
+            worker->SetThread(thread);
             
+            // args belongs to the worker's thread after this
             args->threadIDMutex->Exit();
             
-            _workers.push_back(args->worker);
+            Logger::begin("WorkerThreadPool", Logger::LogLevel_Log) << "Created ScriptWorkerThread {" << Platform::StringifyUUID(threadID) << "}" << Logger::end();
+            
+            return worker;
+        }
+        
+        void PostToScriptWorker(ScriptWorkerPtr worker, WorkerMessagePtr message) {
+            worker->Post(message);
+        }
+        
+        void StopScriptWorker(ScriptWorkerPtr worker) {
+            worker->Terminate();
+        }
+        
+        void StopScriptWorkers() {
+            for (auto iter = ScriptWorker::_workers.begin(); iter != ScriptWorker::_workers.end(); iter++) {
+                (*iter)->Terminate();
+            }
+            
+            while (ScriptWorker::_runningScriptWorkers.load() > 0) {
+                Platform::NanoSleep(100000);
+            }
+            
+            // each worker queued it's exit as the last thing it did
+            PollMainThread();
+        }
+        
+        // Job system
+        
+        struct Job {
+            JobFunc Func;
+            JobCounterPtr Counter = NULL;
+            bool MainThread = false;
+        };
+        
+        // Chase-Lev work stealing deque. The owning worker pushes and pops at the bottom,
+        // other threads steal from the top.
+        class JobDeque {
+        public:
+            JobDeque() : _top(0), _bottom(0) {
+                for (size_t i = 0; i < Size; i++) {
+                    this->_jobs[i].store(NULL, std::memory_order_relaxed);
+                }
+            }
+            
+            // Owner only, returns false when full so the caller can queue the job elsewhere
+            bool Push(JobPtr job) {
+                long bottom = this->_bottom.load(std::memory_order_relaxed);
+                long top = this->_top.load(std::memory_order_acquire);
+                
+                if (bottom - top >= (long) Size) {
+                    return false;
+                }
+                
+                this->_jobs[bottom & Mask].store(job, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_release);
+                this->_bottom.store(bottom + 1, std::memory_order_relaxed);
+                
+                return true;
+            }
+            
+            // Owner only
+            JobPtr Pop() {
+                long bottom = this->_bottom.load(std::memory_order_relaxed) - 1;
+                this->_bottom.store(bottom, std::memory_order_relaxed);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                long top = this->_top.load(std::memory_order_relaxed);
+                
+                if (top > bottom) {
+                    this->_bottom.store(bottom + 1, std::memory_order_relaxed);
+                    return NULL;
+                }
+                
+                JobPtr job = this->_jobs[bottom & Mask].load(std::memory_order_relaxed);
+                
+                if (top == bottom) {
+                    // last job, race any thieves for it
+                    if (!this->_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                        job = NULL;
+                    }
+                    this->_bottom.store(bottom + 1, std::memory_order_relaxed);
+                }
+                
+                return job;
+            }
+            
+            // Any thread, can return NULL while jobs remain if another thread won the race
+            JobPtr Steal() {
+                long top = this->_top.load(std::memory_order_acquire);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                long bottom = this->_bottom.load(std::memory_order_acquire);
+                
+                if (top >= bottom) {
+                    return NULL;
+                }
+                
+                JobPtr job = this->_jobs[top & Mask].load(std::memory_order_relaxed);
+                
+                if (!this->_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    return NULL;
+                }
+                
+                return job;
+            }
+            
+        private:
+            static const size_t Size = 4096;
+            static const size_t Mask = Size - 1;
+            
+            char _pad0[64];
+            std::atomic<long> _top;
+            char _pad1[64];
+            std::atomic<long> _bottom;
+            char _pad2[64];
+            
+            std::atomic<JobPtr> _jobs[Size];
+        };
+        
+        struct JobWorker {
+            JobDeque Deque;
+            Platform::ThreadPtr Thread = NULL;
+            unsigned int Seed = 0;
+        };
+        
+        std::vector<JobWorker*> _jobWorkers;
+        
+        static ENGINE_THREAD_LOCAL int _currentWorker = -1;
+        
+        // Jobs submitted from outside the pool or when a worker's deque is full
+        Platform::MutexPtr _injectedMutex = NULL;
+        std::deque<JobPtr> _injectedJobs;
+        std::atomic<int> _injectedCount(0);
+        
+        Platform::MutexPtr _mainThreadMutex = NULL;
+        std::vector<JobPtr> _mainThreadJobs;
+        
+        std::atomic<bool> _jobsRunning(false);
+        std::atomic<int> _runningWorkers(0);
+        
+        // Workers with nothing to do sleep on _sleepCondition. _queuedJobs is raised before
+        // a job becomes visible and checked under _sleepMutex so a wakeup can't be lost.
+        std::atomic<int> _queuedJobs(0);
+        std::atomic<int> _sleepingWorkers(0);
+        std::mutex _sleepMutex;
+        std::condition_variable _sleepCondition;
+        
+        JobCounter::JobCounter() : Value(0), Mutex(Platform::CreateMutex()) {
+            
+        }
+        
+        JobCounter::~JobCounter() {
+            assert(this->IsDone());
+            delete this->Mutex;
+        }
+        
+        bool JobCounter::IsDone() {
+            if (this->Value.load(std::memory_order_acquire) > 0) {
+                return false;
+            }
+            
+            // the job that finished last may still be releasing waiting jobs
+            this->Mutex->Enter();
+            this->Mutex->Exit();
+            
+            return true;
+        }
+        
+        static void _runJob(JobPtr job);
+        
+        static void _pushReady(JobPtr job) {
+            if (job->MainThread) {
+                _mainThreadMutex->Enter();
+                _mainThreadJobs.push_back(job);
+                _mainThreadMutex->Exit();
+                return;
+            }
+            
+            if (_jobWorkers.empty()) {
+                _runJob(job); // no workers yet so run it inline
+                return;
+            }
+            
+            _queuedJobs++;
+            
+            if (_currentWorker < 0 || !_jobWorkers[_currentWorker]->Deque.Push(job)) {
+                _injectedMutex->Enter();
+                _injectedJobs.push_back(job);
+                _injectedCount++;
+                _injectedMutex->Exit();
+            }
+            
+            if (_sleepingWorkers.load() > 0) {
+                std::lock_guard<std::mutex> lock(_sleepMutex);
+                _sleepCondition.notify_one();
+            }
+        }
+        
+        static void _submitJob(JobPtr job, JobCounterPtr dependency) {
+            if (job->Counter != NULL) {
+                job->Counter->Value++;
+            }
+            
+            if (dependency != NULL) {
+                dependency->Mutex->Enter();
+                if (dependency->Value.load() > 0) {
+                    dependency->Waiting.push_back(job);
+                    dependency->Mutex->Exit();
+                    return;
+                }
+                dependency->Mutex->Exit();
+            }
+            
+            _pushReady(job);
+        }
+        
+        static void _finishJob(JobPtr job) {
+            JobCounterPtr counter = job->Counter;
+            
+            delete job;
+            
+            if (counter == NULL) {
+                return;
+            }
+            
+            std::vector<JobPtr> released;
+            
+            // decremented under the lock so a dependency can't be added after the jobs are released
+            counter->Mutex->Enter();
+            if (--counter->Value == 0) {
+                released.swap(counter->Waiting);
+            }
+            counter->Mutex->Exit();
+            
+            for (auto iter = released.begin(); iter != released.end(); iter++) {
+                _pushReady(*iter);
+            }
+        }
+        
+        static void _runJob(JobPtr job) {
+            {
+                ENGINE_PROFILER_SCOPE;
+                job->Func();
+            }
+            
+            _finishJob(job);
+        }
+        
+        static JobPtr _takeJob() {
+            JobPtr job = NULL;
+            
+            if (_currentWorker >= 0) {
+                job = _jobWorkers[_currentWorker]->Deque.Pop();
+            }
+            
+            if (job == NULL && _injectedCount.load() > 0) {
+                _injectedMutex->Enter();
+                if (!_injectedJobs.empty()) {
+                    job = _injectedJobs.front();
+                    _injectedJobs.pop_front();
+                    _injectedCount--;
+                }
+                _injectedMutex->Exit();
+            }
+            
+            if (job == NULL && !_jobWorkers.empty()) {
+                size_t workerCount = _jobWorkers.size();
+                size_t start = 0;
+                
+                if (_currentWorker >= 0) {
+                    // xorshift so workers don't all hammer the same victim
+                    unsigned int& seed = _jobWorkers[_currentWorker]->Seed;
+                    seed ^= seed << 13;
+                    seed ^= seed >> 17;
+                    seed ^= seed << 5;
+                    start = seed % workerCount;
+                }
+                
+                for (size_t i = 0; i < workerCount && job == NULL; i++) {
+                    size_t victim = (start + i) % workerCount;
+                    if ((int) victim != _currentWorker) {
+                        job = _jobWorkers[victim]->Deque.Steal();
+                    }
+                }
+            }
+            
+            if (job != NULL) {
+                _queuedJobs--;
+            }
+            
+            return job;
+        }
+        
+        // With a counter only the jobs counted by it are run, the rest stay queued in order
+        static bool _runMainThreadJobs(JobCounterPtr counter = NULL) {
+            std::vector<JobPtr> jobs;
+            
+            _mainThreadMutex->Enter();
+            if (counter == NULL) {
+                jobs.swap(_mainThreadJobs);
+            } else {
+                auto rest = std::stable_partition(_mainThreadJobs.begin(), _mainThreadJobs.end(), [counter](JobPtr job) {
+                    return job->Counter != counter;
+                });
+                jobs.assign(rest, _mainThreadJobs.end());
+                _mainThreadJobs.erase(rest, _mainThreadJobs.end());
+            }
+            _mainThreadMutex->Exit();
+            
+            for (auto iter = jobs.begin(); iter != jobs.end(); iter++) {
+                _runJob(*iter);
+            }
+            
+            return !jobs.empty();
+        }
+        
+        void* JobWorkerFunc(void* workerIndex) {
+            _currentWorker = (int) (intptr_t) workerIndex;
+            
+            int idleSpins = 0;
+            
+            while (_jobsRunning.load()) {
+                JobPtr job = _takeJob();
+                
+                if (job != NULL) {
+                    _runJob(job);
+                    idleSpins = 0;
+                    continue;
+                }
+                
+                if (++idleSpins < 64) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                
+                std::unique_lock<std::mutex> lock(_sleepMutex);
+                _sleepingWorkers++;
+                _sleepCondition.wait(lock, [] { return _queuedJobs.load() > 0 || !_jobsRunning.load(); });
+                _sleepingWorkers--;
+                idleSpins = 0;
+            }
+            
+            _runningWorkers--;
+            
+            return NULL;
+        }
+        
+        void Init(int workerCount) {
+            if (!_jobWorkers.empty()) {
+                return;
+            }
+            
+            if (workerCount <= 0) {
+                workerCount = std::max(1, Platform::GetProcesserCount() - 1);
+            }
+            
+            if (_injectedMutex == NULL) {
+                _injectedMutex = Platform::CreateMutex();
+                _mainThreadMutex = Platform::CreateMutex();
+            }
+            
+            // every deque has to exist before a worker starts stealing
+            for (int i = 0; i < workerCount; i++) {
+                JobWorker* worker = new JobWorker();
+                worker->Seed = 2463534242u + i * 7919;
+                _jobWorkers.push_back(worker);
+            }
+            
+            _jobsRunning = true;
+            _runningWorkers = workerCount;
+            
+            for (int i = 0; i < workerCount; i++) {
+                _jobWorkers[i]->Thread = Platform::CreateThread(JobWorkerFunc, (void*) (intptr_t) i);
+            }
+            
+            Logger::begin("WorkerThreadPool", Logger::LogLevel_Log) << "Started " << workerCount << " job workers" << Logger::end();
+        }
+        
+        void Shutdown() {
+            if (_jobWorkers.empty()) {
+                return;
+            }
+            
+            _jobsRunning = false;
+            
+            {
+                std::lock_guard<std::mutex> lock(_sleepMutex);
+                _sleepCondition.notify_all();
+            }
+            
+            while (_runningWorkers.load() > 0) {
+                Platform::NanoSleep(100000);
+            }
+            
+            // finish anything left behind so counters still reach 0
+            JobPtr job = NULL;
+            while ((job = _takeJob()) != NULL) {
+                _runJob(job);
+            }
+            
+            for (auto iter = _jobWorkers.begin(); iter != _jobWorkers.end(); iter++) {
+                delete (*iter)->Thread;
+                delete *iter;
+            }
+            
+            _jobWorkers.clear();
+            
+            _runMainThreadJobs();
+        }
+        
+        int GetWorkerCount() {
+            return (int) _jobWorkers.size();
+        }
+        
+        void Submit(JobFunc func, JobCounterPtr counter, JobCounterPtr dependency) {
+            JobPtr job = new Job();
+            job->Func = func;
+            job->Counter = counter;
+            
+            _submitJob(job, dependency);
+        }
+        
+        void RunOnMainThread(JobFunc func, JobCounterPtr counter, JobCounterPtr dependency) {
+            if (_mainThreadMutex == NULL) {
+                _mainThreadMutex = Platform::CreateMutex();
+                _injectedMutex = Platform::CreateMutex();
+            }
+            
+            JobPtr job = new Job();
+            job->Func = func;
+            job->Counter = counter;
+            job->MainThread = true;
+            
+            _submitJob(job, dependency);
+        }
+        
+        void PollMainThread() {
+            ENGINE_PROFILER_SCOPE;
+            
+            if (_mainThreadMutex == NULL) {
+                return;
+            }
+            
+            _runMainThreadJobs();
+        }
+        
+        void Wait(JobCounterRef counter) {
+            ENGINE_PROFILER_SCOPE;
+            
+            bool mainThread = Platform::IsMainThread();
+            
+            // Continuations counted by something else can run script which would re-enter the caller,
+            // they're left for PollMainThread
+            while (counter.Value.load(std::memory_order_acquire) > 0) {
+                JobPtr job = _takeJob();
+                
+                if (job != NULL) {
+                    _runJob(job);
+                } else if (!(mainThread && _mainThreadMutex != NULL && _runMainThreadJobs(&counter))) {
+                    std::this_thread::yield();
+                }
+            }
+            
+            // let the last job finish with the counter before the caller destroys it
+            counter.Mutex->Enter();
+            counter.Mutex->Exit();
+        }
+        
+        void ParallelFor(size_t count, size_t grainSize, std::function<void(size_t begin, size_t end)> func) {
+            if (count == 0) {
+                return;
+            }
+            
+            if (grainSize == 0) {
+                grainSize = std::max<size_t>(1, count / ((_jobWorkers.size() + 1) * 4));
+            }
+            
+            if (count <= grainSize || _jobWorkers.empty()) {
+                func(0, count);
+                return;
+            }
+            
+            JobCounter counter;
+            
+            // the first range runs on this thread while the others are picked up
+            for (size_t begin = grainSize; begin < count; begin += grainSize) {
+                size_t end = std::min(begin + grainSize, count);
+                Submit([&func, begin, end]() { func(begin, end); }, &counter);
+            }
+            
+            func(0, grainSize);
             
-            Logger::begin("WorkerThreadPool", Logger::LogLevel_Log) << "Created ScriptWorkerThread {" << Platform::StringifyUUID(args->threadID) << "}" << Logger::end();
+            Wait(counter);
         }
     }
 }
\ No newline at end of file
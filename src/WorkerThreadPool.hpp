@@ -24,9 +24,79 @@
 #include "Platform.hpp"
 
 #include <string>
+#include <atomic>
+#include <vector>
+#include <functional>
+
+#include "stdlib.hpp"
 
 namespace Engine {
+    ENGINE_CLASS(WorkerMessage);
+    
     namespace WorkerThreadPool {
-        void CreateScriptWorker(std::string scriptSource);
+        ENGINE_CLASS(ScriptWorker);
+        
+        typedef std::function<void(WorkerMessagePtr message)> ScriptWorkerMessageFunc;
+        typedef std::function<void()> ScriptWorkerExitFunc;
+        
+        // Runs scriptSource on a new thread in it's own isolate. onMessage is called on the main
+        // thread for every message the worker posts, the message is deleted once it returns.
+        // onExit is called on the main thread after the worker's thread finishes, the worker is
+        // deleted as soon as it returns.
+        ScriptWorkerPtr CreateScriptWorker(std::string scriptSource, ScriptWorkerMessageFunc onMessage, ScriptWorkerExitFunc onExit);
+        
+        // Queues message for the worker's thread.onmessage handler and takes ownership of it
+        void PostToScriptWorker(ScriptWorkerPtr worker, WorkerMessagePtr message);
+        
+        // Terminates any script the worker is running and lets it exit, messages it already posted are dropped
+        void StopScriptWorker(ScriptWorkerPtr worker);
+        
+        // Stops every worker and waits for their threads, has to run while the main isolate still exists
+        void StopScriptWorkers();
+        
+        typedef std::function<void()> JobFunc;
+        
+        ENGINE_CLASS(Job);
+        ENGINE_CLASS(JobCounter);
+        
+        // Counts outstanding jobs. Jobs submitted with a dependency on a counter are held
+        // back until it reaches 0, Wait runs other jobs on the calling thread until then.
+        class JobCounter {
+        public:
+            JobCounter();
+            ~JobCounter();
+            
+            bool IsDone();
+            
+            // Managed by the job system
+            std::atomic<int> Value;
+            Platform::MutexPtr Mutex;
+            std::vector<JobPtr> Waiting;
+        };
+        
+        // workerCount of 0 uses one worker per processor, leaving one for the main thread
+        void Init(int workerCount);
+        void Shutdown();
+        
+        int GetWorkerCount();
+        
+        // Can be called from any thread including from inside a job. counter is incremented
+        // now and decremented once func has run.
+        void Submit(JobFunc func, JobCounterPtr counter = NULL, JobCounterPtr dependency = NULL);
+        
+        // Runs func on the main thread during PollMainThread, used to hand results back to
+        // code that isn't thread safe like scripting and rendering
+        void RunOnMainThread(JobFunc func, JobCounterPtr counter = NULL, JobCounterPtr dependency = NULL);
+        
+        // Called by the main loop once per frame
+        void PollMainThread();
+        
+        // Helps run jobs until counter reaches 0. On the main thread it also runs the main thread
+        // jobs counted by counter, other continuations are left for PollMainThread.
+        void Wait(JobCounterRef counter);
+        
+        // Splits [0, count) into ranges of at least grainSize and runs them in parallel,
+        // returns once every range has run. grainSize of 0 picks a size based on the worker count.
+        void ParallelFor(size_t count, size_t grainSize, std::function<void(size_t begin, size_t end)> func);
     }
 }
\ No newline at end of file
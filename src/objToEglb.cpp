@@ -0,0 +1,32 @@
+/*
+   Filename: objToEglb.cpp
+   Purpose:  Command line converter from .obj to .eglb
+
+   Part of Engine2D
+
+   Copyright (C) 2014 Vbitz
+
+   Licensed under the Apache License, Version 2.0 (the "License");
+   you may not use this file except in compliance with the License.
+   You may obtain a copy of the License at
+
+     http://www.apache.org/licenses/LICENSE-2.0
+
+   Unless required by applicable law or agreed to in writing, software
+   distributed under the License is distributed on an "AS IS" BASIS,
+   WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+   See the License for the specific language governing permissions and
+   limitations under the License.
+*/
+
+#ifdef _WIN32
+extern "C" _declspec(dllimport)
+#else
+extern "C"
+#endif
+int EngineObjToEglb(int argc, char const *argv[]);
+
+int main(int argc, char const *argv[])
+{
+	return EngineObjToEglb(argc, argv);
+}
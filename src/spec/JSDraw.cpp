@@ -21,6 +21,8 @@
 
 #include "../JSDraw.hpp"
 
+#include <cstring>
+
 #include "../JSMathHelper.hpp"
 
 #include "../vendor/soil/SOIL.h"
@@ -42,15 +44,36 @@ namespace Engine {
     
 	namespace JsDraw {
         
-        static void ReadBufferWeakCallback(const v8::WeakCallbackData<v8::Object, float>& args) {
-            
-            size_t byte_length =
-            args.GetValue()->Get(v8::String::NewFromUtf8(args.GetIsolate(), "byteLength"))->Int32Value();
-            
-            args.GetIsolate()->AdjustAmountOfExternalAllocatedMemory(-static_cast<intptr_t>(byte_length));
+        // Frees the external backing store of an image array once V8 collects the ArrayBuffer
+        class ImageArrayStore {
+        public:
+            ImageArrayStore(v8::Isolate* isolate, v8::Handle<v8::ArrayBuffer> buffer, void* data, size_t byteLength, bool soilOwned)
+                        : _data(data), _byteLength(byteLength), _soilOwned(soilOwned) {
+                this->_buffer.Reset(isolate, buffer);
+                this->_buffer.SetWeak(this, WeakCallback);
+                isolate->AdjustAmountOfExternalAllocatedMemory(byteLength);
+            }
             
-            delete[] args.GetParameter();
-        }
+            static void WeakCallback(const v8::WeakCallbackData<v8::ArrayBuffer, ImageArrayStore>& args) {
+                ImageArrayStore* store = args.GetParameter();
+                
+                args.GetIsolate()->AdjustAmountOfExternalAllocatedMemory(-static_cast<intptr_t>(store->_byteLength));
+                
+                if (store->_soilOwned) {
+                    SOIL_free_image_data((unsigned char*) store->_data);
+                } else {
+                    delete [] (unsigned char*) store->_data;
+                }
+                
+                store->_buffer.Reset();
+                delete store;
+            }
+        private:
+            v8::Persistent<v8::ArrayBuffer> _buffer;
+            void* _data;
+            size_t _byteLength;
+            bool _soilOwned;
+        };
 
         class ArrayBufferContentsStore {
         public:
@@ -273,7 +296,8 @@ namespace Engine {
                 
                 if (args.Assert(args[0]->IsString(), "Arg0 is the filename to load from")) return;
                 
-                JS_VertexBuffer2D::Unwrap<JS_VertexBuffer2D>(args.This())->VertexBuffer::Load(args.StringValue(0));
+                // falls back to a copying load when the file can't be mapped
+                JS_VertexBuffer2D::Unwrap<JS_VertexBuffer2D>(args.This())->VertexBuffer::LoadMapped(args.StringValue(0));
             }
             
             static void SetProjectionPerspective(const v8::FunctionCallbackInfo<v8::Value>& _args) {
@@ -322,11 +346,53 @@ namespace Engine {
                 JS_VertexBuffer2D::Unwrap<JS_VertexBuffer2D>(args.This())->VertexBuffer::SetWireframe(args.BooleanValue(0));
             }
             
+            static void SetCompact(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+                ScriptingManager::Arguments args(_args);
+                
+                if (args.AssertCount(1)) return;
+                
+                if (args.Assert(args[0]->IsBoolean(), "Arg0 is set to upload 2D vertexes at half the size, z is ignored")) return;
+                
+                JS_VertexBuffer2D::Unwrap<JS_VertexBuffer2D>(args.This())->VertexBuffer::SetVertexLayout(args.BooleanValue(0) ? VertexLayout::Compact2D : VertexLayout::Full3D);
+            }
+            
             static void ComputeNormals(const v8::FunctionCallbackInfo<v8::Value>& _args) {
                 ScriptingManager::Arguments args(_args);
 
                 JS_VertexBuffer2D::Unwrap<JS_VertexBuffer2D>(args.This())->VertexBuffer::ComputeNormals(PolygonMode::Triangles);
             }
+            
+            static void AddIndex(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+                ScriptingManager::Arguments args(_args);
+                
+                JS_VertexBuffer2D* thisValue = Unwrap<JS_VertexBuffer2D>(args.This());
+                
+                std::vector<unsigned int> indexes;
+                
+                for (int i = 0; i < args.Length(); i++) {
+                    if (args[i]->IsArray()) { // (indexes)
+                        v8::Handle<v8::Array> arr = v8::Handle<v8::Array>::Cast(args[i]);
+                        for (unsigned int x = 0; x < arr->Length(); x++) {
+                            indexes.push_back(arr->Get(x)->Uint32Value());
+                        }
+                    } else { // (index, ...)
+                        if (args.Assert(args[i]->IsNumber(), "Each argument is a vertex index or an array of vertex indexes")) return;
+                        indexes.push_back(args[i]->Uint32Value());
+                    }
+                }
+                
+                for (auto iter = indexes.begin(); iter != indexes.end(); iter++) {
+                    if (args.Assert(*iter < thisValue->VertexBuffer::GetVertexCount(), "Vertex indexes must refer to a vertex already added")) return;
+                }
+                
+                thisValue->VertexBuffer::AddIndexes(indexes.data(), indexes.size());
+            }
+            
+            static void Optimize(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+                ScriptingManager::Arguments args(_args);
+                
+                JS_VertexBuffer2D::Unwrap<JS_VertexBuffer2D>(args.This())->VertexBuffer::Optimize();
+            }
 
             static void Init(v8::Handle<v8::ObjectTemplate> drawTable) {
                 ScriptingManager::Factory f(v8::Isolate::GetCurrent());
@@ -345,7 +411,10 @@ namespace Engine {
                     {FTT_Prototype, "setLookAtView", f.NewFunctionTemplate(SetLookAtView)},
                     {FTT_Prototype, "setDepthTest", f.NewFunctionTemplate(SetDepthTest)},
                     {FTT_Prototype, "setWireframe", f.NewFunctionTemplate(SetWireframe)},
-                    {FTT_Prototype, "computeNormals", f.NewFunctionTemplate(ComputeNormals)}
+                    {FTT_Prototype, "setCompact", f.NewFunctionTemplate(SetCompact)},
+                    {FTT_Prototype, "computeNormals", f.NewFunctionTemplate(ComputeNormals)},
+                    {FTT_Prototype, "addIndex", f.NewFunctionTemplate(AddIndex)},
+                    {FTT_Prototype, "optimize", f.NewFunctionTemplate(Optimize)}
                 });
                 
                 newVertexBuffer->InstanceTemplate()->SetInternalFieldCount(1);
@@ -933,6 +1002,139 @@ namespace Engine {
             }
         }
         
+        void DrawSprites(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.Assert(HasGLContext(), "No OpenGL Context")) return;
+            
+            if (args.Assert(args.Length() == 2 || args.Length() == 3, "Wrong number of arguments")) return;
+            
+            if (args.Assert(args[0]->IsNull() || JS_Texture::IsTexture(args, args[0]->ToObject()), "Arg0 is a valid texture or null to draw with colors alone") ||
+                args.Assert(args[1]->IsFloat32Array(), "Arg1 is a Float32Array with 9 values per sprite: x, y, w, h, u1, v1, u2, v2, rotation") ||
+                args.Assert(args.Length() < 3 || args[2]->IsUint8Array(), "Arg2 is a Uint8Array with a RGBA color per sprite")) return;
+            
+            TexturePtr tex = NULL;
+            if (!args[0]->IsNull()) {
+                tex = JS_Texture::GetValue(args, args[0]->ToObject());
+                if (!tex->IsValid()) {
+                    args.ThrowArgError("Arg0 is not a valid texture");
+                    return;
+                }
+            }
+            
+            // typed arrays keep their elements in external memory so this doesn't copy
+            v8::Handle<v8::Float32Array> values = v8::Handle<v8::Float32Array>::Cast(args[1]);
+            const float* data = (const float*) values->GetIndexedPropertiesExternalArrayData();
+            size_t count = values->Length() / 9;
+            
+            const unsigned char* colors = NULL;
+            if (args.Length() == 3) {
+                v8::Handle<v8::Uint8Array> colorValues = v8::Handle<v8::Uint8Array>::Cast(args[2]);
+                if (args.Assert(colorValues->Length() >= count * 4, "Arg2 needs 4 values for every sprite in Arg1")) return;
+                colors = (const unsigned char*) colorValues->GetIndexedPropertiesExternalArrayData();
+            }
+            
+            Draw2DPtr draw = GetDraw2D(args.This());
+            
+            static std::vector<SpriteInstance> sprites;
+            sprites.resize(count);
+            
+            SpriteInstance defaultSprite;
+            defaultSprite.SetColor(draw->GetRender()->GetColor());
+            
+            for (size_t i = 0; i < count; i++) {
+                const float* sprite = &data[i * 9];
+                SpriteInstance& instance = sprites[i];
+                instance.rect = glm::vec4(sprite[0], sprite[1], sprite[2], sprite[3]);
+                instance.uv = glm::vec4(sprite[4], sprite[5], sprite[6], sprite[7]);
+                instance.rotation = sprite[8];
+                std::memcpy(instance.col, colors != NULL ? &colors[i * 4] : defaultSprite.col, 4);
+            }
+            
+            draw->DrawSprites(tex, sprites.data(), count);
+        }
+        
+        // Reads the optional Uint8Array of RGBA colors that follows a batch of records, returns
+        // true after throwing when it's too short to cover every record
+        static bool GetBatchColors(ScriptingManager::Arguments& args, size_t index, size_t count, const unsigned char*& colors) {
+            colors = NULL;
+            if (args.Length() <= index) return false;
+            
+            v8::Handle<v8::Uint8Array> colorValues = v8::Handle<v8::Uint8Array>::Cast(args[index]);
+            if (args.Assert(colorValues->Length() >= count * 4, "The color array needs 4 values for every record")) return true;
+            colors = (const unsigned char*) colorValues->GetIndexedPropertiesExternalArrayData();
+            return false;
+        }
+        
+        void Rects(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.Assert(HasGLContext(), "No OpenGL Context")) return;
+            
+            if (args.Assert(args.Length() == 1 || args.Length() == 2, "Wrong number of arguments")) return;
+            
+            if (args.Assert(args[0]->IsFloat32Array(), "Arg0 is a Float32Array with 4 values per rect: x, y, w, h") ||
+                args.Assert(args.Length() < 2 || args[1]->IsUint8Array(), "Arg1 is a Uint8Array with a RGBA color per rect")) return;
+            
+            v8::Handle<v8::Float32Array> values = v8::Handle<v8::Float32Array>::Cast(args[0]);
+            size_t count = values->Length() / 4;
+            
+            const unsigned char* colors;
+            if (GetBatchColors(args, 1, count, colors)) return;
+            
+            GetDraw2D(args.This())->Rects((const float*) values->GetIndexedPropertiesExternalArrayData(), count, colors);
+        }
+        
+        void Sprites(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.Assert(HasGLContext(), "No OpenGL Context")) return;
+            
+            if (args.Assert(args.Length() == 3 || args.Length() == 4, "Wrong number of arguments")) return;
+            
+            if (args.Assert(args[0]->IsExternal(), "Arg0 is a valid spritesheet that's been loaded since the last context change") ||
+                args.Assert(args[1]->IsArray(), "Arg1 is an array of sprite or animation names") ||
+                args.Assert(args[2]->IsFloat32Array(), "Arg2 is a Float32Array with 5 values per sprite: x, y, w, h, name index") ||
+                args.Assert(args.Length() < 4 || args[3]->IsUint8Array(), "Arg3 is a Uint8Array with a RGBA color per sprite")) return;
+            
+            SpriteSheetPtr sheet = (SpriteSheetPtr) args.ExternalValue(0);
+            
+            if (!sheet->IsValid()) {
+                args.ThrowArgError("Arg0 is not a valid spritesheet");
+                return;
+            }
+            
+            v8::Handle<v8::Array> nameArray = v8::Handle<v8::Array>::Cast(args[1]);
+            if (args.Assert(nameArray->Length() > 0, "Arg1 needs at least one name")) return;
+            
+            std::vector<std::string> names;
+            for (unsigned int i = 0; i < nameArray->Length(); i++) {
+                names.push_back(*v8::String::Utf8Value(nameArray->Get(i)));
+            }
+            
+            v8::Handle<v8::Float32Array> values = v8::Handle<v8::Float32Array>::Cast(args[2]);
+            size_t count = values->Length() / 5;
+            
+            const unsigned char* colors;
+            if (GetBatchColors(args, 3, count, colors)) return;
+            
+            GetDraw2D(args.This())->Sprites(sheet, names, (const float*) values->GetIndexedPropertiesExternalArrayData(), count, colors);
+        }
+        
+        void Lines(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.Assert(HasGLContext(), "No OpenGL Context")) return;
+            
+            if (args.AssertCount(1)) return;
+            
+            if (args.Assert(args[0]->IsFloat32Array(), "Arg0 is a Float32Array with 4 values per line: x1, y1, x2, y2")) return;
+            
+            v8::Handle<v8::Float32Array> values = v8::Handle<v8::Float32Array>::Cast(args[0]);
+            
+            GetDraw2D(args.This())->LineSegments((const float*) values->GetIndexedPropertiesExternalArrayData(), values->Length() / 4);
+        }
+        
         void OpenImage(const v8::FunctionCallbackInfo<v8::Value>& _args) {
             ScriptingManager::Arguments args(_args);
             
@@ -980,14 +1182,60 @@ namespace Engine {
             args.SetReturnValue(args.NewExternal(SpriteSheetReader::LoadSpriteSheetFromFile(filename)));
         }
         
+        // Reads the optional format argument of the image array functions, returns true after throwing
+        static bool GetImageFormat(ScriptingManager::Arguments& args, size_t index, bool& isFloat) {
+            isFloat = true;
+            if (args.Length() <= index) return false;
+            
+            if (args.Assert(args[index]->IsString(), "The image format is \"float\" or \"rgba8\"")) return true;
+            
+            std::string format = args.StringValue(index);
+            if (format == "rgba8") {
+                isFloat = false;
+            } else if (format != "float") {
+                args.ThrowArgError("The image format is \"float\" or \"rgba8\"");
+                return true;
+            }
+            return false;
+        }
+        
+        // Wraps width * height RGBA pixels in a Float32Array or Uint8Array without copying them,
+        // data is freed once the ArrayBuffer is collected
+        static v8::Handle<v8::Object> NewImageArray(ScriptingManager::Arguments& args, void* data, int width, int height, bool isFloat, bool soilOwned) {
+            size_t length = width * height * 4;
+            size_t byteLength = length * (isFloat ? sizeof(float) : 1);
+            
+            v8::Handle<v8::ArrayBuffer> buffer = v8::ArrayBuffer::New(args.GetIsolate(), data, byteLength);
+            
+            new ImageArrayStore(args.GetIsolate(), buffer, data, byteLength, soilOwned);
+            
+            v8::Handle<v8::Object> array;
+            if (isFloat) {
+                array = v8::Float32Array::New(buffer, 0, length);
+            } else {
+                array = v8::Uint8Array::New(buffer, 0, length);
+            }
+            
+            array->Set(args.NewString("width"), args.NewNumber(width));
+            array->Set(args.NewString("height"), args.NewNumber(height));
+            
+            return array;
+        }
+        
         void GetImageArray(const v8::FunctionCallbackInfo<v8::Value>& _args) {
             ScriptingManager::Arguments args(_args);
             
-            if (args.AssertCount(1)) return;
+            if (args.Assert(args.Length() == 1 || args.Length() == 2, "Wrong number of arguments")) return;
             
             if (args.Assert(args[0]->IsString(), "Arg0 is the filename to load")) return;
             
-            v8::Handle<v8::Object> array = args.NewObject();
+            bool isFloat;
+            if (GetImageFormat(args, 1, isFloat)) return;
+            
+            if (!Filesystem::FileExists(args.StringValue(0))) {
+                args.ThrowArgError("File does not Exist");
+                return;
+            }
             
             long fileSize = 0;
             
@@ -997,50 +1245,86 @@ namespace Engine {
             
             unsigned char* pixel = SOIL_load_image_from_memory(file, fileSize, &imageWidth, &imageHeight, &chaneals, SOIL_LOAD_RGBA);
             
-            int imageSize = imageWidth * imageHeight * 4;
+            delete [] file;
             
-            float* rawArray = new float[imageSize];
+            if (pixel == NULL) {
+                args.ThrowError("Could not decode image");
+                return;
+            }
             
-            for (int i = 0; i < imageSize; i += 4) {
-                rawArray[i] = 1.0f;
-                rawArray[i + 1] = 1.0f;
-                rawArray[i + 2] = 1.0f;
-                rawArray[i + 3] = 1.0f;
+            if (isFloat) {
+                size_t length = imageWidth * imageHeight * 4;
+                float* rawArray = new float[length];
+                ImageReader::BytesToFloats(pixel, rawArray, length);
+                SOIL_free_image_data(pixel);
+                args.SetReturnValue(NewImageArray(args, rawArray, imageWidth, imageHeight, true, false));
+            } else {
+                // SOIL already decoded into RGBA8 so the array uses it's buffer directly
+                args.SetReturnValue(NewImageArray(args, pixel, imageWidth, imageHeight, false, true));
             }
+        }
+        
+        void CreateImageArray(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.Assert(args.Length() == 2 || args.Length() == 3, "Wrong number of arguments")) return;
+            
+            if (args.Assert(args[0]->IsInt32(), "Arg0 is the width of the new image") ||
+                args.Assert(args[1]->IsInt32(), "Arg1 is the height of the new image")) return;
+            
+            bool isFloat;
+            if (GetImageFormat(args, 2, isFloat)) return;
             
-            v8::Persistent<v8::Object> arr;
+            int width = args.Int32Value(0),
+                height = args.Int32Value(1);
             
-            arr.Reset(args.GetIsolate(), array);
+            if (args.Assert(width > 0 && height > 0, "The new image needs a width and height of at least 1")) return;
             
-            arr.MarkIndependent();
-            arr.SetWeak(rawArray, ReadBufferWeakCallback);
+            size_t pixelCount = width * height;
             
-            args.GetIsolate()->AdjustAmountOfExternalAllocatedMemory(imageSize * sizeof(float));
+            // starts as opaque black
+            if (isFloat) {
+                float* pixels = new float[pixelCount * 4];
+                for (size_t i = 0; i < pixelCount * 4; i += 4) {
+                    pixels[i] = pixels[i + 1] = pixels[i + 2] = 0.0f;
+                    pixels[i + 3] = 1.0f;
+                }
+                args.SetReturnValue(NewImageArray(args, pixels, width, height, true, false));
+            } else {
+                unsigned char* pixels = new unsigned char[pixelCount * 4];
+                for (size_t i = 0; i < pixelCount * 4; i += 4) {
+                    pixels[i] = pixels[i + 1] = pixels[i + 2] = 0;
+                    pixels[i + 3] = 255;
+                }
+                args.SetReturnValue(NewImageArray(args, pixels, width, height, false, false));
+            }
+        }
+        
+        void SwizzleImage(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(2)) return;
             
-            array->SetIndexedPropertiesToExternalArrayData(rawArray, v8::kExternalFloatArray, imageSize * sizeof(float));
+            if (args.Assert(args[0]->IsUint8Array(), "Arg0 is a Uint8Array of RGBA pixels") ||
+                args.Assert(args[1]->IsString(), "Arg1 is the new channel order like \"bgra\"")) return;
             
-            array->Set(args.NewString("length"), args.NewNumber(imageSize));
-            array->Set(args.NewString("width"), args.NewNumber(imageWidth));
-            array->Set(args.NewString("height"), args.NewNumber(imageHeight));
-            array->Set(args.NewString("byteLength"), args.NewNumber(static_cast<int32_t>(imageSize)));
+            std::string orderString = args.StringValue(1);
             
-            int pos = 0;
-            int i = 0;
+            if (args.Assert(orderString.length() == 4, "Arg1 needs 4 channels")) return;
             
-            for (int x = 0; x < imageWidth; x++) {
-                for (int y = 0; y < imageHeight; y++) {
-                    array->Set(i + 0, args.NewNumber((float) pixel[pos + 2] / 256.f));
-                    array->Set(i + 1, args.NewNumber((float) pixel[pos + 1] / 256.f));
-                    array->Set(i + 2, args.NewNumber((float) pixel[pos + 0] / 256.f));
-                    array->Set(i + 3, args.NewNumber(1.0f));
-                    pos += 4;
-                    i += 4;
+            int order[4];
+            for (int i = 0; i < 4; i++) {
+                const char* channel = std::strchr("rgba", orderString[i]);
+                if (channel == NULL || orderString[i] == '\0') {
+                    args.ThrowArgError("Arg1 can only contain r, g, b or a");
+                    return;
                 }
+                order[i] = (int) (channel - "rgba");
             }
             
-            SOIL_free_image_data(pixel);
+            v8::Handle<v8::Uint8Array> pixels = v8::Handle<v8::Uint8Array>::Cast(args[0]);
             
-            args.SetReturnValue(array);
+            ImageReader::SwizzleRGBA((unsigned char*) pixels->GetIndexedPropertiesExternalArrayData(), pixels->Length() / 4, order);
         }
         
         void CreateImage(const v8::FunctionCallbackInfo<v8::Value>& _args) {
@@ -1057,17 +1341,46 @@ namespace Engine {
                 args.Assert(args[1]->IsInt32(), "Arg1 is the width of the new image") ||
                 args.Assert(args[2]->IsInt32(), "Arg2 is the height of the new image")) return;
             
-            unsigned int texID = 0;
+            int width = args.Int32Value(1),
+                height = args.Int32Value(2);
             
-            if (args.Length() == 4) {
-                if (args.Assert(args[3]->IsInt32(), "Arg3 is the texture ID to reuse")) return;
-                texID = args.Int32Value(3);
+            // a texture with the same size is updated in place rather than creating a new one each frame
+            TexturePtr reuse = NULL;
+            
+            if (args.Length() == 4 && !args[3]->IsUndefined() && !args[3]->IsNull()) {
+                // this used to be a texture ID which was never used
+                if (args.Assert(args[3]->IsObject() && JS_Texture::IsTexture(args, args[3]->ToObject()),
+                                "Arg3 is the texture to update, texture IDs are no longer accepted")) return;
+                
+                reuse = JS_Texture::GetValue(args, args[3]);
+                if (!reuse->IsValid() || reuse->GetWidth() != width || reuse->GetHeight() != height) {
+                    reuse = NULL;
+                }
             }
             
             v8::Handle<v8::Object> arr = v8::Handle<v8::Object>::Cast(args[0]);
             
-            int width = args.Int32Value(1),
-                height = args.Int32Value(2);
+            if (args[0]->IsUint8Array() || args[0]->IsUint8ClampedArray() || args[0]->IsFloat32Array()) {
+                v8::Handle<v8::TypedArray> typedArr = v8::Handle<v8::TypedArray>::Cast(args[0]);
+                
+                if (args.Assert(typedArr->Length() >= (size_t) width * height * 4, "Arg0 needs width * height * 4 values")) return;
+                
+                void* data = arr->GetIndexedPropertiesExternalArrayData();
+                
+                if (reuse != NULL) {
+                    if (args[0]->IsFloat32Array()) {
+                        reuse->Update((const float*) data);
+                    } else {
+                        reuse->Update((const unsigned char*) data);
+                    }
+                    args.SetReturnValue(args[3]);
+                } else if (args[0]->IsFloat32Array()) {
+                    args.SetReturnValue(JS_Texture::NewInstance(args, ImageReader::TextureFromBuffer((float*) data, width, height)));
+                } else {
+                    args.SetReturnValue(JS_Texture::NewInstance(args, ImageReader::TextureFromBuffer((unsigned char*) data, width, height)));
+                }
+                return;
+            }
             
             float* pixels = NULL;
             
@@ -1103,13 +1416,23 @@ namespace Engine {
                 }
             }
             
-            TexturePtr t = ImageReader::TextureFromBuffer(texID, pixels, width, height);
+            TexturePtr t;
+            if (reuse != NULL) {
+                reuse->Update(pixels);
+                t = reuse;
+            } else {
+                t = ImageReader::TextureFromBuffer(pixels, width, height);
+            }
             
             if (!arr->HasIndexedPropertiesInExternalArrayData()) {
                 delete [] pixels;
             }
             
-            args.SetReturnValue(JS_Texture::NewInstance(args, t));
+            if (reuse != NULL) {
+                args.SetReturnValue(args[3]);
+            } else {
+                args.SetReturnValue(JS_Texture::NewInstance(args, t));
+            }
         }
         
         void SaveImage(const v8::FunctionCallbackInfo<v8::Value>& _args) {
@@ -1220,6 +1543,22 @@ namespace Engine {
             GetDraw2D(args.This())->GetRender()->SetCenter(args.Int32Value(0), args.Int32Value(1));
         }
         
+        void SetLayer(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(1)) return;
+            
+            if (args.Assert(args[0]->IsInt32(), "Arg0 is the layer to draw on, lower layers are drawn first when batching")) return;
+            
+            GetDraw2D(args.This())->GetRender()->SetLayer(args.Int32Value(0));
+        }
+        
+        void GetLayer(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            args.SetReturnValue(args.NewInt32(GetDraw2D(args.This())->GetRender()->GetLayer()));
+        }
+        
         void DrawColorGetter(v8::Local<v8::String> prop, const v8::PropertyCallbackInfo<v8::Value>& info) {
             info.GetReturnValue().Set(_getColor(info.GetIsolate(), GetDraw2D(info.Holder())));
         }
@@ -1257,9 +1596,15 @@ namespace Engine {
                 {FTT_Static, "draw", f.NewFunctionTemplate(Draw)},
                 {FTT_Static, "drawSub", f.NewFunctionTemplate(DrawSub)},
                 {FTT_Static, "drawSprite", f.NewFunctionTemplate(DrawSprite)},
+                {FTT_Static, "drawSprites", f.NewFunctionTemplate(DrawSprites)},
+                {FTT_Static, "rects", f.NewFunctionTemplate(Rects)},
+                {FTT_Static, "sprites", f.NewFunctionTemplate(Sprites)},
+                {FTT_Static, "lines", f.NewFunctionTemplate(Lines)},
                 {FTT_Static, "openImage", f.NewFunctionTemplate(OpenImage)},
                 {FTT_Static, "openSpriteSheet", f.NewFunctionTemplate(OpenSpriteSheet)},
                 {FTT_Static, "getImageArray", f.NewFunctionTemplate(GetImageArray)},
+                {FTT_Static, "createImageArray", f.NewFunctionTemplate(CreateImageArray)},
+                {FTT_Static, "swizzleImage", f.NewFunctionTemplate(SwizzleImage)},
                 {FTT_Static, "createImage", f.NewFunctionTemplate(CreateImage)},
                 {FTT_Static, "saveImage", f.NewFunctionTemplate(SaveImage)},
                 {FTT_Static, "isTexture", f.NewFunctionTemplate(IsTexture)},
@@ -1275,6 +1620,8 @@ namespace Engine {
                 {FTT_Static, "isFontLoaded", f.NewFunctionTemplate(IsFontLoaded)},
                 
                 {FTT_Static, "setCenter", f.NewFunctionTemplate(SetCenter)},
+                {FTT_Static, "setLayer", f.NewFunctionTemplate(SetLayer)},
+                {FTT_Static, "getLayer", f.NewFunctionTemplate(GetLayer)},
             });
             
             drawTable->SetAccessor(f.NewString("drawColor"), DrawColorGetter, DrawColorSetter);
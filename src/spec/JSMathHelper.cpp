@@ -26,6 +26,8 @@
 #include "../Util.hpp"
 #include "../ScriptingManager.hpp"
 #include "../stdlib.hpp"
+#include "../VectorMath.hpp"
+#include "../Noise.hpp"
 
 #define GLM_FORCE_RADIANS
 #include "../vendor/glm/glm.hpp"
@@ -33,6 +35,8 @@
 #include "../vendor/glm/gtx/rotate_vector.hpp"
 
 #include <random>
+#include <vector>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -107,42 +111,303 @@ namespace Engine {
             }
         };
         
+        class JS_Noise : public Noise::NoiseGenerator, public ScriptingManager::ObjectWrap {
+        public:
+            
+            static void New(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+                ScriptingManager::Arguments args(_args);
+                
+                if (args.RecallAsConstructor()) return;
+                
+                JS_Noise* noise = Wrap<JS_Noise>(args.GetIsolate(), args.This());
+                
+                if (args.Length() == 1 && args[0]->IsNumber()) {
+                    noise->NoiseGenerator::Seed(args.NumberValue(0));
+                }
+            }
+            
+            static void Seed(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+                ScriptingManager::Arguments args(_args);
+                
+                if (args.AssertCount(1)) return;
+                
+                if (args.Assert(args[0]->IsNumber(), "Arg0 is the seed, either 0 to 1 or 0 to 65535")) return;
+                
+                Unwrap<JS_Noise>(args.This())->NoiseGenerator::Seed(args.NumberValue(0));
+            }
+            
+            // perlin2(x, y) through value4(x, y, z, w)
+            template<Noise::NoiseType type, int dimensions>
+            static void Point(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+                ScriptingManager::Arguments args(_args);
+                
+                if (args.AssertCount(dimensions)) return;
+                
+                float point[4];
+                for (int i = 0; i < dimensions; i++) {
+                    point[i] = args.NumberValue(i);
+                }
+                
+                Noise::NoiseSettings settings;
+                settings.Type = type;
+                settings.Dimensions = dimensions;
+                
+                args.SetReturnValue(args.NewNumber(Unwrap<JS_Noise>(args.This())->Sample(settings, point)));
+            }
+            
+            static void Fill(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+                ScriptingManager::Arguments args(_args);
+                
+                if (args.Assert(args.Length() == 3 || args.Length() == 4, "Wrong number of arguments")) return;
+                
+                if (args.Assert(args[0]->IsFloat32Array(), "Arg0 is a Float32Array of points to sample") ||
+                    args.Assert(args[1]->IsInt32() && args.Int32Value(1) >= 2 && args.Int32Value(1) <= 4, "Arg1 is the number of components in each point, 2, 3 or 4") ||
+                    args.Assert(args[2]->IsFloat32Array(), "Arg2 is a Float32Array to write one value per point to")) return;
+                
+                Noise::NoiseSettings settings;
+                float origin[4];
+                float step;
+                if (GetSettings(args, 3, settings, origin, step)) return;
+                
+                settings.Dimensions = args.Int32Value(1);
+                
+                v8::Handle<v8::Float32Array> points = v8::Handle<v8::Float32Array>::Cast(args[0]);
+                v8::Handle<v8::Float32Array> out = v8::Handle<v8::Float32Array>::Cast(args[2]);
+                
+                size_t count = points->Length() / settings.Dimensions;
+                
+                if (args.Assert(out->Length() >= count, "Arg2 needs one value for every point in Arg0")) return;
+                
+                Unwrap<JS_Noise>(args.This())->NoiseGenerator::Fill(settings,
+                    (const float*) points->GetIndexedPropertiesExternalArrayData(),
+                    (float*) out->GetIndexedPropertiesExternalArrayData(), count);
+                
+                args.SetReturnValue(args[2]);
+            }
+            
+            static void FillGrid(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+                ScriptingManager::Arguments args(_args);
+                
+                if (args.Assert(args.Length() == 3 || args.Length() == 4, "Wrong number of arguments")) return;
+                
+                if (args.Assert(args[0]->IsFloat32Array(), "Arg0 is a Float32Array to write width * height values to") ||
+                    args.Assert(args[1]->IsInt32() && args.Int32Value(1) > 0, "Arg1 is the width of the grid") ||
+                    args.Assert(args[2]->IsInt32() && args.Int32Value(2) > 0, "Arg2 is the height of the grid")) return;
+                
+                Noise::NoiseSettings settings;
+                float origin[4];
+                float step;
+                if (GetSettings(args, 3, settings, origin, step)) return;
+                
+                int width = args.Int32Value(1), height = args.Int32Value(2);
+                
+                v8::Handle<v8::Float32Array> out = v8::Handle<v8::Float32Array>::Cast(args[0]);
+                
+                if (args.Assert(out->Length() >= (size_t) width * height, "Arg0 needs to hold width * height values")) return;
+                
+                Unwrap<JS_Noise>(args.This())->NoiseGenerator::FillGrid(settings, (float*) out->GetIndexedPropertiesExternalArrayData(),
+                                                                         width, height, origin, step);
+                
+                args.SetReturnValue(args[0]);
+            }
+            
+            // Writes greyscale noise into an array from draw.createImageArray, noise is mapped from -1 to 1 into 0 to 1
+            static void FillImage(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+                ScriptingManager::Arguments args(_args);
+                
+                if (args.Assert(args.Length() == 1 || args.Length() == 2, "Wrong number of arguments")) return;
+                
+                if (args.Assert(args[0]->IsFloat32Array() || args[0]->IsUint8Array(), "Arg0 is a image array from draw.createImageArray")) return;
+                
+                Noise::NoiseSettings settings;
+                float origin[4];
+                float step;
+                if (GetSettings(args, 1, settings, origin, step)) return;
+                
+                v8::Handle<v8::Object> image = args[0].As<v8::Object>();
+                
+                int width = image->Get(args.NewString("width"))->Int32Value();
+                int height = image->Get(args.NewString("height"))->Int32Value();
+                
+                size_t length = image->GetIndexedPropertiesExternalArrayDataLength();
+                
+                if (args.Assert(width > 0 && height > 0 && length >= (size_t) width * height * 4, "Arg0 needs a width and height that matches it's length")) return;
+                
+                size_t pixels = (size_t) width * height;
+                
+                std::vector<float> values(pixels);
+                
+                Unwrap<JS_Noise>(args.This())->NoiseGenerator::FillGrid(settings, &values[0], width, height, origin, step);
+                
+                if (args[0]->IsFloat32Array()) {
+                    float* data = (float*) image->GetIndexedPropertiesExternalArrayData();
+                    for (size_t i = 0; i < pixels; i++) {
+                        float value = values[i] * 0.5f + 0.5f;
+                        data[i * 4] = data[i * 4 + 1] = data[i * 4 + 2] = value;
+                        data[i * 4 + 3] = 1.0f;
+                    }
+                } else {
+                    unsigned char* data = (unsigned char*) image->GetIndexedPropertiesExternalArrayData();
+                    for (size_t i = 0; i < pixels; i++) {
+                        float value = std::min(std::max(values[i] * 0.5f + 0.5f, 0.0f), 1.0f);
+                        data[i * 4] = data[i * 4 + 1] = data[i * 4 + 2] = (unsigned char) (value * 255.0f + 0.5f);
+                        data[i * 4 + 3] = 255;
+                    }
+                }
+                
+                args.SetReturnValue(args[0]);
+            }
+            
+            static void CreateInterface(v8::Isolate* isolate, v8::Handle<v8::Object> math_table) {
+                ScriptingManager::Factory f(isolate);
+                
+                v8::Handle<v8::FunctionTemplate> noise_template = v8::FunctionTemplate::New(f.GetIsolate());
+                
+                noise_template->SetCallHandler(JS_Noise::New);
+                
+                f.FillTemplate(noise_template, {
+                    {FTT_Prototype, "seed", f.NewFunctionTemplate(JS_Noise::Seed)},
+                    {FTT_Prototype, "perlin2", f.NewFunctionTemplate(JS_Noise::Point<Noise::NoiseType::Perlin, 2>)},
+                    {FTT_Prototype, "perlin3", f.NewFunctionTemplate(JS_Noise::Point<Noise::NoiseType::Perlin, 3>)},
+                    {FTT_Prototype, "perlin4", f.NewFunctionTemplate(JS_Noise::Point<Noise::NoiseType::Perlin, 4>)},
+                    {FTT_Prototype, "simplex2", f.NewFunctionTemplate(JS_Noise::Point<Noise::NoiseType::Simplex, 2>)},
+                    {FTT_Prototype, "simplex3", f.NewFunctionTemplate(JS_Noise::Point<Noise::NoiseType::Simplex, 3>)},
+                    {FTT_Prototype, "simplex4", f.NewFunctionTemplate(JS_Noise::Point<Noise::NoiseType::Simplex, 4>)},
+                    {FTT_Prototype, "value2", f.NewFunctionTemplate(JS_Noise::Point<Noise::NoiseType::Value, 2>)},
+                    {FTT_Prototype, "value3", f.NewFunctionTemplate(JS_Noise::Point<Noise::NoiseType::Value, 3>)},
+                    {FTT_Prototype, "value4", f.NewFunctionTemplate(JS_Noise::Point<Noise::NoiseType::Value, 4>)},
+                    {FTT_Prototype, "fill", f.NewFunctionTemplate(JS_Noise::Fill)},
+                    {FTT_Prototype, "fillGrid", f.NewFunctionTemplate(JS_Noise::FillGrid)},
+                    {FTT_Prototype, "fillImage", f.NewFunctionTemplate(JS_Noise::FillImage)},
+                });
+                
+                noise_template->InstanceTemplate()->SetInternalFieldCount(1);
+                
+                math_table->Set(f.NewString("Noise"), noise_template->GetFunction());
+            }
+            
+        private:
+            static float GetNumberOption(ScriptingManager::Arguments& args, v8::Handle<v8::Object> options, const char* name, float defaultValue) {
+                v8::Handle<v8::Value> value = options->Get(args.NewString(name));
+                return value->IsNumber() ? (float) value->NumberValue() : defaultValue;
+            }
+            
+            // Reads {type, fractal, octaves, frequency, lacunarity, gain, dims, x, y, z, w, step} from args[index]
+            static bool GetSettings(ScriptingManager::Arguments& args, size_t index, Noise::NoiseSettings& settings, float* origin, float& step) {
+                origin[0] = origin[1] = origin[2] = origin[3] = 0.0f;
+                step = 1.0f;
+                
+                if (args.Length() <= index) return false;
+                
+                if (args.Assert(args[index]->IsObject(), "The options argument needs to be a Object")) return true;
+                
+                v8::Handle<v8::Object> options = args[index].As<v8::Object>();
+                
+                v8::Handle<v8::Value> type = options->Get(args.NewString("type"));
+                if (type->IsString()) {
+                    std::string typeName = *v8::String::Utf8Value(type);
+                    if (typeName == "perlin") settings.Type = Noise::NoiseType::Perlin;
+                    else if (typeName == "simplex") settings.Type = Noise::NoiseType::Simplex;
+                    else if (typeName == "value") settings.Type = Noise::NoiseType::Value;
+                    else {
+                        args.ThrowArgError("type is \"perlin\", \"simplex\" or \"value\"");
+                        return true;
+                    }
+                }
+                
+                v8::Handle<v8::Value> fractal = options->Get(args.NewString("fractal"));
+                if (fractal->IsString()) {
+                    std::string fractalName = *v8::String::Utf8Value(fractal);
+                    if (fractalName == "none") settings.Fractal = Noise::FractalType::None;
+                    else if (fractalName == "fbm") settings.Fractal = Noise::FractalType::FBm;
+                    else if (fractalName == "ridged") settings.Fractal = Noise::FractalType::Ridged;
+                    else {
+                        args.ThrowArgError("fractal is \"none\", \"fbm\" or \"ridged\"");
+                        return true;
+                    }
+                }
+                
+                settings.Octaves = (int) GetNumberOption(args, options, "octaves", settings.Octaves);
+                settings.Frequency = GetNumberOption(args, options, "frequency", settings.Frequency);
+                settings.Lacunarity = GetNumberOption(args, options, "lacunarity", settings.Lacunarity);
+                settings.Gain = GetNumberOption(args, options, "gain", settings.Gain);
+                settings.Dimensions = (int) GetNumberOption(args, options, "dims", settings.Dimensions);
+                
+                if (args.Assert(settings.Octaves >= 1 && settings.Octaves <= 16, "octaves needs to be between 1 and 16") ||
+                    args.Assert(settings.Dimensions >= 2 && settings.Dimensions <= 4, "dims needs to be 2, 3 or 4")) return true;
+                
+                origin[0] = GetNumberOption(args, options, "x", 0.0f);
+                origin[1] = GetNumberOption(args, options, "y", 0.0f);
+                origin[2] = GetNumberOption(args, options, "z", 0.0f);
+                origin[3] = GetNumberOption(args, options, "w", 0.0f);
+                step = GetNumberOption(args, options, "step", 1.0f);
+                
+                return false;
+            }
+        };
+        
         static v8::Persistent<v8::FunctionTemplate> _vectorInstance;
         
+        // Internalized once in CreateInterface so vector math doesn't create the key strings on every call
+        static v8::Persistent<v8::String> _vectorKeys[4];
+        
+        static inline v8::Local<v8::String> VectorKey(ScriptingManager::Factory& fac, int i) {
+            return v8::Local<v8::String>::New(fac.GetIsolate(), _vectorKeys[i]);
+        }
+        
+        // Vectors handed back with vector.release() are reused by the next add, sub, mul, cross or rotate
+        // instead of wrapping a new object. Slots above the count are left set, so at most
+        // VectorPoolCapacity released vectors stay alive.
+        static const uint32_t VectorPoolCapacity = 1024;
+        static v8::Persistent<v8::Array> _vectorPool;
+        static uint32_t _vectorPoolCount = 0;
+        
         glm::vec4 JS_Vector::FromJSVector(ScriptingManager::Factory& fac, v8::Handle<v8::Value> thisValue) {
             v8::Handle<v8::Object> obj = v8::Handle<v8::Object>::Cast(thisValue);
             return glm::vec4(
-                             obj->Get(fac.NewString("x"))->NumberValue(),
-                             obj->Get(fac.NewString("y"))->NumberValue(),
-                             obj->Get(fac.NewString("z"))->NumberValue(),
-                             obj->Get(fac.NewString("a"))->NumberValue()
+                             obj->Get(VectorKey(fac, 0))->NumberValue(),
+                             obj->Get(VectorKey(fac, 1))->NumberValue(),
+                             obj->Get(VectorKey(fac, 2))->NumberValue(),
+                             obj->Get(VectorKey(fac, 3))->NumberValue()
                              );
         }
         
         v8::Handle<v8::Object> JS_Vector::ToJSVector(ScriptingManager::Factory& fac,
                                           glm::vec4 vec) {
+            if (_vectorPoolCount > 0) {
+                v8::Local<v8::Array> pool = v8::Local<v8::Array>::New(fac.GetIsolate(), _vectorPool);
+                v8::Handle<v8::Object> pooled = pool->Get(--_vectorPoolCount).As<v8::Object>();
+                Unwrap<JS_Vector>(pooled)->_pooled = false;
+                SetJSVector(fac, pooled, vec);
+                return pooled;
+            }
+            
             v8::Local<v8::FunctionTemplate> ctor = v8::Local<v8::FunctionTemplate>::New(fac.GetIsolate(), _vectorInstance);
             v8::Handle<v8::Function> ctorFunc = ctor->GetFunction();
             v8::Handle<v8::Value> instance = ctorFunc->NewInstance(0, NULL);
             assert(instance->IsObject());
             v8::Handle<v8::Object> instanceValue = instance->ToObject();
             
-            instanceValue->Set(fac.NewString("x"), fac.NewNumber(vec.x));
-            instanceValue->Set(fac.NewString("y"), fac.NewNumber(vec.y));
-            instanceValue->Set(fac.NewString("z"), fac.NewNumber(vec.z));
-            instanceValue->Set(fac.NewString("a"), fac.NewNumber(vec.a));
+            SetJSVector(fac, instanceValue, vec);
             
             return instanceValue;
         }
         
+        void JS_Vector::SetJSVector(ScriptingManager::Factory& fac, v8::Handle<v8::Object> obj, glm::vec4 vec) {
+            obj->Set(VectorKey(fac, 0), fac.NewNumber(vec.x));
+            obj->Set(VectorKey(fac, 1), fac.NewNumber(vec.y));
+            obj->Set(VectorKey(fac, 2), fac.NewNumber(vec.z));
+            obj->Set(VectorKey(fac, 3), fac.NewNumber(vec.a));
+        }
+        
         bool JS_Vector::IsJSVector(ScriptingManager::Factory& fac, v8::Handle<v8::Value> value){
             if (!value->IsObject()) return false;
             v8::Handle<v8::Object> obj = value->ToObject();
             
-            return obj->Get(fac.NewString("x"))->IsNumber() &&
-            obj->Get(fac.NewString("y"))->IsNumber() &&
-            obj->Get(fac.NewString("z"))->IsNumber() &&
-            obj->Get(fac.NewString("a"))->IsNumber();
+            return obj->Get(VectorKey(fac, 0))->IsNumber() &&
+            obj->Get(VectorKey(fac, 1))->IsNumber() &&
+            obj->Get(VectorKey(fac, 2))->IsNumber() &&
+            obj->Get(VectorKey(fac, 3))->IsNumber();
         }
         
         void JS_Vector::New(const v8::FunctionCallbackInfo<v8::Value>& _args) {
@@ -250,6 +515,97 @@ namespace Engine {
             args.SetReturnValue(ToJSVector(args, glm::vec4(ret, 0.0)));
         }
         
+        void JS_Vector::Length(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            args.SetReturnValue(args.NewNumber(glm::length(FromJSVector(args, args.This()))));
+        }
+        
+        void JS_Vector::Set(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            glm::vec4 value;
+            for (int i = 0; i < 4 && i < (int) args.Length(); i++) {
+                value[i] = args[i]->NumberValue();
+            }
+            
+            SetJSVector(args, args.This(), value);
+            
+            args.SetReturnValue(args.This());
+        }
+        
+        void JS_Vector::AddSelf(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(1)) return;
+            
+            if (args.Assert(IsJSVector(args, args[0]), "Arg1 is a Vector4")) return;
+            
+            SetJSVector(args, args.This(), FromJSVector(args, args.This()) + FromJSVector(args, args[0]));
+            
+            args.SetReturnValue(args.This());
+        }
+        
+        void JS_Vector::SubSelf(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(1)) return;
+            
+            if (args.Assert(IsJSVector(args, args[0]), "Arg1 is a Vector4")) return;
+            
+            SetJSVector(args, args.This(), FromJSVector(args, args.This()) - FromJSVector(args, args[0]));
+            
+            args.SetReturnValue(args.This());
+        }
+        
+        void JS_Vector::MulSelf(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(1)) return;
+            
+            if (args[0]->IsNumber()) {
+                SetJSVector(args, args.This(), FromJSVector(args, args.This()) * (float) args.NumberValue(0));
+            } else if (IsJSVector(args, args[0])) {
+                SetJSVector(args, args.This(), FromJSVector(args, args.This()) * FromJSVector(args, args[0]));
+            } else if (args[0]->IsObject() && JS_Matrix::IsJSMatrix(args, args[0]->ToObject())) {
+                SetJSVector(args, args.This(), FromJSVector(args, args.This()) * JS_Matrix::GetValue(args, args[0]->ToObject()));
+            } else {
+                args.ThrowArgError("Arg0 is a Number, Vector4 or a Matrix");
+                return;
+            }
+            
+            args.SetReturnValue(args.This());
+        }
+        
+        void JS_Vector::NormalizeSelf(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            glm::vec4 value = FromJSVector(args, args.This());
+            float length = glm::length(value);
+            
+            if (length > 0.0f) {
+                SetJSVector(args, args.This(), value / length);
+            }
+            
+            args.SetReturnValue(args.This());
+        }
+        
+        void JS_Vector::Release(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.Assert(args.This()->InternalFieldCount() > 0, "release is only for Math.Vector objects")) return;
+            
+            JS_Vector* vec = Unwrap<JS_Vector>(args.This());
+            
+            // releasing twice would hand the same object out twice
+            if (vec->_pooled || _vectorPoolCount >= VectorPoolCapacity) return;
+            
+            vec->_pooled = true;
+            
+            v8::Local<v8::Array> pool = v8::Local<v8::Array>::New(args.GetIsolate(), _vectorPool);
+            pool->Set(_vectorPoolCount++, args.This());
+        }
+        
         void JS_Vector::ToString(const v8::FunctionCallbackInfo<v8::Value>& _args) {
             ScriptingManager::Arguments args(_args);
             std::stringstream ss;
@@ -280,12 +636,25 @@ namespace Engine {
                 {FTT_Prototype, "mul", f.NewFunctionTemplate(Mul)},
                 {FTT_Prototype, "dot", f.NewFunctionTemplate(Dot)},
                 {FTT_Prototype, "cross", f.NewFunctionTemplate(Cross)},
-                {FTT_Prototype, "rotate", f.NewFunctionTemplate(Rotate)}
+                {FTT_Prototype, "rotate", f.NewFunctionTemplate(Rotate)},
+                {FTT_Prototype, "length", f.NewFunctionTemplate(Length)},
+                {FTT_Prototype, "set", f.NewFunctionTemplate(Set)},
+                {FTT_Prototype, "addSelf", f.NewFunctionTemplate(AddSelf)},
+                {FTT_Prototype, "subSelf", f.NewFunctionTemplate(SubSelf)},
+                {FTT_Prototype, "mulSelf", f.NewFunctionTemplate(MulSelf)},
+                {FTT_Prototype, "normalizeSelf", f.NewFunctionTemplate(NormalizeSelf)},
+                {FTT_Prototype, "release", f.NewFunctionTemplate(Release)}
                 // TOOD: distince
-                // TODO: length
-                // TODO: normalize
             });
             
+            _vectorPool.Reset(f.GetIsolate(), v8::Array::New(f.GetIsolate(), VectorPoolCapacity));
+            _vectorPoolCount = 0;
+            
+            const char* keyNames[4] = {"x", "y", "z", "a"};
+            for (int i = 0; i < 4; i++) {
+                _vectorKeys[i].Reset(f.GetIsolate(), v8::String::NewFromUtf8(f.GetIsolate(), keyNames[i], v8::String::kInternalizedString));
+            }
+            
             vector_template->InstanceTemplate()->SetInternalFieldCount(1);
             
             vector_template->SetClassName(f.NewString("Vector"));
@@ -425,6 +794,85 @@ namespace Engine {
             args.SetReturnValue(args.This());
         }
         
+        void JS_Matrix::MulSelf(const v8::FunctionCallbackInfo<v8::Value> &_args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(1)) return;
+            
+            if (args.Assert(args[0]->IsObject() && IsJSMatrix(args, args[0]->ToObject()), "Arg0 is the matrix to multiply by")) return;
+            
+            JS_Matrix* jsMat = Unwrap<JS_Matrix>(args.This());
+            
+            jsMat->_value = jsMat->_value * GetValue(args, args[0]);
+            
+            args.SetReturnValue(args.This());
+        }
+        
+        void JS_Matrix::MulMat4Into(const v8::FunctionCallbackInfo<v8::Value> &_args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(2)) return;
+            
+            if (args.Assert(args[0]->IsObject() && IsJSMatrix(args, args[0]->ToObject()), "Arg0 is the matrix to multiply by") ||
+                args.Assert(args[1]->IsObject() && IsJSMatrix(args, args[1]->ToObject()), "Arg1 is the matrix to write the result to")) return;
+            
+            Unwrap<JS_Matrix>(args[1]->ToObject())->_value = Unwrap<JS_Matrix>(args.This())->_value * GetValue(args, args[0]);
+            
+            args.SetReturnValue(args[1]);
+        }
+        
+        // Checks the src and dst Float32Arrays of a bulk operation, returns true after throwing
+        static bool GetBulkArrays(ScriptingManager::Arguments& args, size_t components, const float*& src, float*& dst, size_t& count) {
+            if (args.Assert(args[0]->IsFloat32Array(), "Arg0 is the Float32Array to read from") ||
+                args.Assert(args[1]->IsFloat32Array(), "Arg1 is the Float32Array to write to, it can be the same as Arg0")) return true;
+            
+            v8::Handle<v8::Float32Array> srcArray = v8::Handle<v8::Float32Array>::Cast(args[0]);
+            v8::Handle<v8::Float32Array> dstArray = v8::Handle<v8::Float32Array>::Cast(args[1]);
+            
+            count = srcArray->Length() / components;
+            
+            if (args.Assert(dstArray->Length() >= count * components, "Arg1 needs to be at least as large as Arg0")) return true;
+            
+            src = (const float*) srcArray->GetIndexedPropertiesExternalArrayData();
+            dst = (float*) dstArray->GetIndexedPropertiesExternalArrayData();
+            
+            return false;
+        }
+        
+        void JS_Matrix::TransformPoints(const v8::FunctionCallbackInfo<v8::Value> &_args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(3)) return;
+            
+            if (args.Assert(args[2]->IsInt32() && args.Int32Value(2) >= 2 && args.Int32Value(2) <= 4, "Arg2 is the number of components in each point, 2, 3 or 4")) return;
+            
+            int components = args.Int32Value(2);
+            
+            const float* src;
+            float* dst;
+            size_t count;
+            if (GetBulkArrays(args, components, src, dst, count)) return;
+            
+            VectorMath::TransformPoints(Unwrap<JS_Matrix>(args.This())->_value, src, dst, count, components);
+            
+            args.SetReturnValue(args[1]);
+        }
+        
+        void JS_Matrix::MulMatrices(const v8::FunctionCallbackInfo<v8::Value> &_args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(2)) return;
+            
+            const float* src;
+            float* dst;
+            size_t count;
+            if (GetBulkArrays(args, 16, src, dst, count)) return;
+            
+            VectorMath::MultiplyMatrices(Unwrap<JS_Matrix>(args.This())->_value, src, dst, count);
+            
+            args.SetReturnValue(args[1]);
+        }
+        
         void JS_Matrix::ToString(const v8::FunctionCallbackInfo<v8::Value> &_args) {
             ScriptingManager::Arguments args(_args);
             
@@ -455,12 +903,15 @@ namespace Engine {
                 {FTT_Prototype, "reset", f.NewFunctionTemplate(Reset)},
                 // TODO: add
                 // TODO: sub
-                // TODO: mul
                 // TODO: div
                 // TODO: inverse
                 {FTT_Prototype, "translate", f.NewFunctionTemplate(Translate)},
                 {FTT_Prototype, "scale", f.NewFunctionTemplate(Scale)},
                 {FTT_Prototype, "rotate", f.NewFunctionTemplate(Rotate)},
+                {FTT_Prototype, "mulSelf", f.NewFunctionTemplate(MulSelf)},
+                {FTT_Prototype, "mulMat4Into", f.NewFunctionTemplate(MulMat4Into)},
+                {FTT_Prototype, "transformPoints", f.NewFunctionTemplate(TransformPoints)},
+                {FTT_Prototype, "mulMatrices", f.NewFunctionTemplate(MulMatrices)},
                 {FTT_Prototype, "toString", f.NewFunctionTemplate(ToString)}
             });
             
@@ -493,6 +944,25 @@ namespace Engine {
             args.SetReturnValue(args.NewNumber(glm::degrees(args.NumberValue(0))));
         }
         
+        void NormalizeVectors(const v8::FunctionCallbackInfo<v8::Value>& _args) {
+            ScriptingManager::Arguments args(_args);
+            
+            if (args.AssertCount(3)) return;
+            
+            if (args.Assert(args[2]->IsInt32() && args.Int32Value(2) >= 2 && args.Int32Value(2) <= 4, "Arg2 is the number of components in each vector, 2, 3 or 4")) return;
+            
+            int components = args.Int32Value(2);
+            
+            const float* src;
+            float* dst;
+            size_t count;
+            if (GetBulkArrays(args, components, src, dst, count)) return;
+            
+            VectorMath::NormalizeVectors(src, dst, count, components);
+            
+            args.SetReturnValue(args[1]);
+        }
+        
         void InitMathHelper() {
             ScriptingManager::Factory f(v8::Isolate::GetCurrent());
             v8::Local<v8::Context> ctx = f.GetIsolate()->GetCurrentContext();
@@ -507,12 +977,12 @@ namespace Engine {
                 {FTT_Static, "PI_2", f.NewNumber(M_PI_2)},
                 {FTT_Static, "PI_4", f.NewNumber(M_PI_4)},
                 {FTT_Static, "degToRad", f.NewFunctionTemplate(DegToRad)->GetFunction()},
-                {FTT_Static, "radToDeg", f.NewFunctionTemplate(RadToDeg)->GetFunction()}
-                // TODO: noise(glm_noise, perlin, periodicPerlin, simplex)
-                // TODO: noiseArray(glm_noise, perlin, periodicPerlin, simplex)
+                {FTT_Static, "radToDeg", f.NewFunctionTemplate(RadToDeg)->GetFunction()},
+                {FTT_Static, "normalizeVectors", f.NewFunctionTemplate(NormalizeVectors)->GetFunction()}
             });
             
             JS_BasicRandom::CreateInterface(f.GetIsolate(), math_table);
+            JS_Noise::CreateInterface(f.GetIsolate(), math_table);
             JS_Vector::CreateInterface(f.GetIsolate(), math_table);
             JS_Matrix::CreateInterface(f.GetIsolate(), math_table);
         }
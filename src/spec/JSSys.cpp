@@ -25,6 +25,8 @@
 #include "../EngineUI.hpp"
 #include "../Timer.hpp"
 #include "../WorkerThreadPool.hpp"
+#include "../WorkerMessage.hpp"
+#include "../ComputePool.hpp"
 #include "../Package.hpp"
 
 #include "../RenderDriver.hpp"
@@ -32,6 +34,8 @@
 #include "../Config.hpp"
 #include "../Profiler.hpp"
 
+#include <cstring>
+
 namespace Engine {
 
 	namespace JsSys {
@@ -65,7 +69,11 @@ namespace Engine {
                 
                 JS_Package* jsPkg = Wrap<JS_Package>(args.GetIsolate(), args.This());
 
-                jsPkg->_pkg = Package::FromFile(args.StringValue(0));
+                try {
+                    jsPkg->_pkg = Package::FromFile(args.StringValue(0));
+                } catch (const char* err) {
+                    args.ThrowError(err);
+                }
             }
 
             static void ReadFile(const v8::FunctionCallbackInfo<v8::Value>& _args) {
@@ -604,14 +612,300 @@ namespace Engine {
             ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
         }
         
+        // Stored in the script's worker object so it outlives the ScriptWorker, freed once the object is collected
+        struct WorkerHandle {
+            WorkerThreadPool::ScriptWorkerPtr Worker = NULL; // NULL once the worker has exited
+            v8::Persistent<v8::Object> Target;
+            
+            static WorkerHandle* FromArgs(const v8::FunctionCallbackInfo<v8::Value>& args) {
+                return (WorkerHandle*) args.Data().As<v8::Object>()->GetAlignedPointerFromInternalField(0);
+            }
+            
+            static void WeakCallback(const v8::WeakCallbackData<v8::Object, WorkerHandle>& args) {
+                WorkerHandle* handle = args.GetParameter();
+                handle->Target.Reset();
+                delete handle;
+            }
+        };
+        
+        ENGINE_JS_METHOD(WorkerPostMessage) {
+            ENGINE_JS_SCOPE_OPEN;
+            
+            if (args.Length() != 1 && args.Length() != 2) {
+                ENGINE_THROW_ARGERROR("Wrong number of arguments");
+                ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+            }
+            
+            WorkerHandle* handle = WorkerHandle::FromArgs(args);
+            
+            // messages to a worker that has exited are dropped
+            if (handle->Worker == NULL) {
+                ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+            }
+            
+            std::string error;
+            WorkerMessagePtr message = WorkerMessage::Serialize(args.GetIsolate(), args[0], args[1], error);
+            
+            if (message == NULL) {
+                ENGINE_THROW_ARGERROR(error.c_str());
+                ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+            }
+            
+            WorkerThreadPool::PostToScriptWorker(handle->Worker, message);
+            
+            ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+        }
+        
+        ENGINE_JS_METHOD(WorkerTerminate) {
+            ENGINE_JS_SCOPE_OPEN;
+            
+            WorkerHandle* handle = WorkerHandle::FromArgs(args);
+            
+            if (handle->Worker != NULL) {
+                WorkerThreadPool::StopScriptWorker(handle->Worker);
+            }
+            
+            ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+        }
+        
         ENGINE_JS_METHOD(CreateWorker) {
             ENGINE_JS_SCOPE_OPEN;
             
             ENGINE_CHECK_ARGS_LENGTH(1);
             
-            WorkerThreadPool::CreateScriptWorker(std::string(*v8::String::Utf8Value(args[0]->ToString())));
+            v8::Isolate* isolate = args.GetIsolate();
             
-            ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+            v8::Local<v8::ObjectTemplate> workerTemplate = v8::ObjectTemplate::New(isolate);
+            workerTemplate->SetInternalFieldCount(1);
+            
+            v8::Local<v8::Object> workerObject = workerTemplate->NewInstance();
+            
+            // The worker keeps it's object alive so onmessage still runs if the script drops it,
+            // once the worker exits the object is only kept by the script
+            WorkerHandle* handle = new WorkerHandle();
+            handle->Target.Reset(isolate, workerObject);
+            workerObject->SetAlignedPointerInInternalField(0, handle);
+            
+            handle->Worker = WorkerThreadPool::CreateScriptWorker(std::string(*v8::String::Utf8Value(args[0]->ToString())),
+                [handle](WorkerMessagePtr message) {
+                    v8::Isolate* isolate = v8::Isolate::GetCurrent();
+                    v8::HandleScope scope(isolate);
+                    
+                    message->Dispatch(isolate, v8::Local<v8::Object>::New(isolate, handle->Target));
+                }, [handle]() {
+                    handle->Worker = NULL;
+                    handle->Target.SetWeak(handle, WorkerHandle::WeakCallback);
+                });
+            
+            workerObject->Set(v8::String::NewFromUtf8(isolate, "postMessage"), v8::Function::New(isolate, WorkerPostMessage, workerObject));
+            workerObject->Set(v8::String::NewFromUtf8(isolate, "terminate"), v8::Function::New(isolate, WorkerTerminate, workerObject));
+            workerObject->Set(v8::String::NewFromUtf8(isolate, "onmessage"), v8::Null(isolate));
+            
+            ENGINE_JS_SCOPE_CLOSE(workerObject);
+        }
+        
+        struct ComputeCallbackState {
+            v8::Persistent<v8::Function> Callback;
+            v8::Persistent<v8::Object> Output;
+        };
+        
+        ENGINE_JS_METHOD(CancelCompute) {
+            ENGINE_JS_SCOPE_OPEN;
+            
+            bool cancelled = ComputePool::Cancel(args.Data()->Int32Value());
+            
+            ENGINE_JS_SCOPE_CLOSE(v8::Boolean::New(args.GetIsolate(), cancelled));
+        }
+        
+        // Shared by parallelMap and parallelReduce, output is empty for reduce
+        void SubmitCompute(const v8::FunctionCallbackInfo<v8::Value>& args, ComputePool::ComputeTaskType type,
+                           v8::Local<v8::Value> output, v8::Local<v8::Value> options, v8::Local<v8::Value> callback) {
+            v8::Isolate* isolate = args.GetIsolate();
+            
+            ENGINE_CHECK_ARG_FUNCTION(0, "Arg0 is the function to run on each chunk");
+            
+            if (!args[1]->IsFloat32Array()) {
+                ENGINE_THROW_ARGERROR("Arg1 is the Float32Array to split into chunks");
+                return;
+            }
+            
+            if (!callback->IsFunction()) {
+                ENGINE_THROW_ARGERROR("The last argument is the callback to run once every chunk is done");
+                return;
+            }
+            
+            if (!options->IsUndefined() && !options->IsObject()) {
+                ENGINE_THROW_ARGERROR("The options argument needs to be a Object");
+                return;
+            }
+            
+            ComputePool::ComputeRequest request;
+            request.Type = type;
+            request.Source = std::string(*v8::String::Utf8Value(args[0]->ToString()));
+            
+            v8::Local<v8::Value> argsValue = v8::Undefined(isolate);
+            
+            if (options->IsObject()) {
+                v8::Local<v8::Object> opts = options.As<v8::Object>();
+                
+                v8::Local<v8::Value> components = opts->Get(v8::String::NewFromUtf8(isolate, "components"));
+                v8::Local<v8::Value> outComponents = opts->Get(v8::String::NewFromUtf8(isolate, "outComponents"));
+                v8::Local<v8::Value> chunkSize = opts->Get(v8::String::NewFromUtf8(isolate, "chunkSize"));
+                v8::Local<v8::Value> deadline = opts->Get(v8::String::NewFromUtf8(isolate, "deadline"));
+                
+                if (components->IsNumber()) request.InputComponents = components->Int32Value();
+                if (outComponents->IsNumber()) request.OutputComponents = outComponents->Int32Value();
+                if (chunkSize->IsNumber()) request.ChunkItems = (size_t) std::max(0, chunkSize->Int32Value());
+                if (deadline->IsNumber()) request.Deadline = Platform::GetTime() + deadline->NumberValue();
+                
+                argsValue = opts->Get(v8::String::NewFromUtf8(isolate, "args"));
+            }
+            
+            if (request.InputComponents < 1 || request.OutputComponents < 1) {
+                ENGINE_THROW_ARGERROR("components and outComponents need to be at least 1");
+                return;
+            }
+            
+            v8::Local<v8::Float32Array> input = args[1].As<v8::Float32Array>();
+            
+            request.Items = input->Length() / request.InputComponents;
+            request.Input = (const float*) input->GetIndexedPropertiesExternalArrayData();
+            
+            if (type == ComputePool::ComputeTaskType::Map) {
+                v8::Local<v8::Float32Array> outputArray = output.As<v8::Float32Array>();
+                
+                if (outputArray->Length() < request.Items * request.OutputComponents) {
+                    ENGINE_THROW_ARGERROR("The output array needs outComponents floats for every item in the input");
+                    return;
+                }
+                
+                request.Output = (const float*) outputArray->GetIndexedPropertiesExternalArrayData();
+            }
+            
+            // every chunk gets it's own copy of args since each isolate keeps what it's given
+            if (!argsValue->IsUndefined()) {
+                size_t chunkCount = ComputePool::GetChunkCount(request.Items, request.ChunkItems);
+                
+                for (size_t i = 0; i < chunkCount; i++) {
+                    std::string error;
+                    WorkerMessagePtr message = WorkerMessage::Serialize(isolate, argsValue, v8::Undefined(isolate), error);
+                    
+                    if (message == NULL) {
+                        for (auto iter = request.Args.begin(); iter != request.Args.end(); iter++) {
+                            delete *iter;
+                        }
+                        ENGINE_THROW_ARGERROR(error.c_str());
+                        return;
+                    }
+                    
+                    request.Args.push_back(message);
+                }
+            }
+            
+            // ComputePool copies both arrays, output is only kept to write the results back into
+            ComputeCallbackState* state = new ComputeCallbackState();
+            state->Callback.Reset(isolate, callback.As<v8::Function>());
+            if (type == ComputePool::ComputeTaskType::Map) {
+                state->Output.Reset(isolate, output.As<v8::Object>());
+            }
+            
+            request.OnComplete = [state, type](ComputePool::ComputeResult& result) {
+                v8::Isolate* isolate = v8::Isolate::GetCurrent();
+                v8::HandleScope scope(isolate);
+                
+                if (result.Discarded) {
+                    state->Callback.Reset();
+                    state->Output.Reset();
+                    delete state;
+                    return;
+                }
+                
+                if (type == ComputePool::ComputeTaskType::Map && !result.Failed) {
+                    v8::Local<v8::Float32Array> outputArray = v8::Local<v8::Object>::New(isolate, state->Output).As<v8::Float32Array>();
+                    
+                    // the script may have transferred or neutered the array while the task ran
+                    if (outputArray->Length() >= result.Output.size()) {
+                        memcpy(outputArray->GetIndexedPropertiesExternalArrayData(), result.Output.data(), result.Output.size() * sizeof(float));
+                    } else {
+                        result.Failed = true;
+                        result.Error = "The output array was detached while the task ran";
+                    }
+                }
+                
+                v8::Local<v8::Value> callArgs[2];
+                if (result.Failed) {
+                    callArgs[0] = v8::String::NewFromUtf8(isolate, result.Error.c_str());
+                } else {
+                    callArgs[0] = v8::Null(isolate);
+                }
+                
+                if (type == ComputePool::ComputeTaskType::Map) {
+                    callArgs[1] = v8::Local<v8::Object>::New(isolate, state->Output);
+                } else {
+                    v8::Local<v8::Array> values = v8::Array::New(isolate, (int) result.Values.size());
+                    for (size_t i = 0; i < result.Values.size(); i++) {
+                        values->Set((uint32_t) i, v8::Number::New(isolate, result.Values[i]));
+                    }
+                    callArgs[1] = values;
+                }
+                
+                v8::Local<v8::Function> callback = v8::Local<v8::Function>::New(isolate, state->Callback);
+                
+                v8::TryCatch tryCatch;
+                
+                callback->Call(isolate->GetCurrentContext()->Global(), 2, callArgs);
+                
+                if (tryCatch.HasCaught()) {
+                    ScriptingManager::ReportException(isolate, &tryCatch);
+                }
+                
+                state->Callback.Reset();
+                state->Output.Reset();
+                delete state;
+            };
+            
+            int taskID = ComputePool::Submit(request);
+            
+            v8::Local<v8::Object> task = v8::Object::New(isolate);
+            task->Set(v8::String::NewFromUtf8(isolate, "id"), v8::Integer::New(isolate, taskID));
+            task->Set(v8::String::NewFromUtf8(isolate, "cancel"), v8::Function::New(isolate, CancelCompute, v8::Integer::New(isolate, taskID)));
+            
+            args.GetReturnValue().Set(task);
+        }
+        
+        ENGINE_JS_METHOD(ParallelMap) {
+            ENGINE_JS_SCOPE_OPEN;
+            
+            if (args.Length() != 4 && args.Length() != 5) {
+                ENGINE_THROW_ARGERROR("Wrong number of arguments");
+                ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+            }
+            
+            if (!args[2]->IsFloat32Array()) {
+                ENGINE_THROW_ARGERROR("Arg2 is the Float32Array each chunk writes it's results to");
+                ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+            }
+            
+            if (args.Length() == 5) {
+                SubmitCompute(args, ComputePool::ComputeTaskType::Map, args[2], args[3], args[4]);
+            } else {
+                SubmitCompute(args, ComputePool::ComputeTaskType::Map, args[2], v8::Undefined(args.GetIsolate()), args[3]);
+            }
+        }
+        
+        ENGINE_JS_METHOD(ParallelReduce) {
+            ENGINE_JS_SCOPE_OPEN;
+            
+            if (args.Length() != 3 && args.Length() != 4) {
+                ENGINE_THROW_ARGERROR("Wrong number of arguments");
+                ENGINE_JS_SCOPE_CLOSE_UNDEFINED;
+            }
+            
+            if (args.Length() == 4) {
+                SubmitCompute(args, ComputePool::ComputeTaskType::Reduce, v8::Local<v8::Value>(), args[2], args[3]);
+            } else {
+                SubmitCompute(args, ComputePool::ComputeTaskType::Reduce, v8::Local<v8::Value>(), v8::Undefined(args.GetIsolate()), args[2]);
+            }
         }
         
         ENGINE_JS_METHOD(Assert) {
@@ -682,6 +976,8 @@ namespace Engine {
             addItem(sysTable, "dumpLog", DumpLog);
             
             addItem(sysTable, "createWorker", CreateWorker);
+            addItem(sysTable, "parallelMap", ParallelMap);
+            addItem(sysTable, "parallelReduce", ParallelReduce);
 
             JS_Package::Init(isolate, sysTable);
         }
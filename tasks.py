@@ -58,6 +58,7 @@ DEVENV_PATH = r"C:\Program Files (x86)\Microsoft Visual Studio 12.0\Common7\IDE\
 WINDOW_SYSTEM = os.getenv("ENGINE_WINDOW_SYSTEM", "glfw")
 ENABLE_GPROFTOOLS = os.getenv("ENGINE_GPROFTOOLS", "off")
 PROFILER = os.getenv("ENGINE_PROFILER", "off")
+COUNT_ALLOCATIONS = os.getenv("ENGINE_COUNT_ALLOCATIONS", "off")
 NO_BUILD_DEPS = os.getenv("ENGINE_NO_BUILD_DEPS", "off")
 BUILD_DEBUG_SYMBOLS = os.getenv("ENGINE_BUILD_DEBUG_SYMBOLS", "off")
 
@@ -537,6 +538,7 @@ def gyp(args):
 			"-DWINDOW=" + WINDOW_SYSTEM,
 			"-DGPERFTOOLS=" + ENABLE_GPROFTOOLS,
 			"-DPROFILER=" + PROFILER,
+			"-DCOUNT_ALLOCATIONS=" + COUNT_ALLOCATIONS,
 			"-DBUILD_DEBUG_SYMBOLS=" + BUILD_DEBUG_SYMBOLS,
 			"-Dtarget_arch=" + get_arch(),
 			resolve_path(PROJECT_ROOT, "engine2D.gyp")
@@ -10,7 +10,8 @@ def doConvert(inputFilename, outputFilename, scale):
 	vertexs = []
 	texcoords = []
 	normals = []
-	faces = []
+	uniqueVertexs = []
+	vertexIndexes = {}
 	indexes = []
 	# parse input file
 	with open(inputFilename, "r") as fInput:
@@ -30,56 +31,47 @@ def doConvert(inputFilename, outputFilename, scale):
 			elif tokens[0] == "f":
 				newFace = []
 				for t in tokens[1:]:
-					newVertex = []
 					faceTokens = t.split("/")
-					if len(faceTokens) == 1:
-						# vertex
-						newVertex += [vertexs[int(faceTokens[0]) - 1]]
-						newVertex += [[0, 0]]
-					elif len(faceTokens) == 2:
-						# vertex + texcoord
-						newVertex += [vertexs[int(faceTokens[0]) - 1]]
-						newVertex += [texcoords[int(faceTokens[1]) - 1]]
-					elif len(faceTokens) == 3:
-						# vertex + texcoord? + normal
-						newVertex += [vertexs[int(faceTokens[0]) - 1]]
-						if len(faceTokens[0]) > 0:
-							newVertex += [texcoords[int(faceTokens[1]) - 1]]
-						else:
-							newVertex += [[0, 0]]
-					else:
+					if len(faceTokens) > 3:
 						raise Exception("Unknown count of faceTokens on line %s" % (line))
-					newFace += [newVertex]
-				faces += [newFace]
+					# vertex + texcoord? + normal?, normals are recomputed by the engine
+					vertexKey = (int(faceTokens[0]) - 1,
+						int(faceTokens[1]) - 1 if len(faceTokens) > 1 and len(faceTokens[1]) > 0 else -1)
+					# share vertexes between faces that use the same position and texcoord
+					if vertexKey not in vertexIndexes:
+						vertexIndexes[vertexKey] = len(uniqueVertexs)
+						uniqueVertexs += [[vertexs[vertexKey[0]],
+							texcoords[vertexKey[1]] if vertexKey[1] >= 0 else [0, 0]]]
+					newFace += [vertexIndexes[vertexKey]]
+				# triangulate polygons as a fan
+				for i in range(1, len(newFace) - 1):
+					indexes += [newFace[0], newFace[i], newFace[i + 1]]
 			else:
 				raise Exception("Unknown type in .obj file %s on line %s" % (tokens[0], line))
 
-	vertexCount = 0
-	with open(outputFilename, "w") as fOutput:
+	with open(outputFilename, "wb") as fOutput:
 		# write header
-		fOutput.write("EGLB")
+		fOutput.write(b"EGLB")
 		# jump foward 4 ints
 		fOutput.seek(16, 1)
 		# write vertexs
-		for f in faces:
-			for vertex in f:
-				fOutput.write(struct.pack("<ffffffffff",
-					vertex[0][0], vertex[0][1], vertex[0][2],				# position	
-					random.random(), random.random(), random.random(), 1,	# color (hardcoded to random)
-					vertex[1][0], vertex[1][1], 0							# uv
-					))
-				vertexCount += 1
+		for vertex in uniqueVertexs:
+			fOutput.write(struct.pack("<ffffffffff",
+				vertex[0][0], vertex[0][1], vertex[0][2],				# position
+				random.random(), random.random(), random.random(), 1,	# color (hardcoded to random)
+				vertex[1][0], vertex[1][1], 0							# uv
+				))
 		indexOffset = fOutput.tell()
-		# write indexes
-		for i in range(0, vertexCount):
-			fOutput.write(struct.pack("<H", i))
+		# write indexes as 32 bit, the engine still loads 16 bit indexes from older files
+		for i in indexes:
+			fOutput.write(struct.pack("<I", i))
 		# jump back to the start to write the header
 		fOutput.seek(4, 0)
 		fOutput.write(struct.pack("<IIII",
-			4 + 16,			# vertexOffset
-			vertexCount,	# vertexCount
-			indexOffset,	# indexOffset
-			vertexCount		# indexCount
+			4 + 16,					# vertexOffset
+			len(uniqueVertexs),		# vertexCount
+			indexOffset,			# indexOffset
+			len(indexes)			# indexCount
 			))
 
 def main(args):